@@ -0,0 +1,68 @@
+struct VS_INPUT
+{
+    float3 Pos: POSITION;
+    float2 TexCoord: TEXCOORD;
+
+    // Rotation from the tangent space to the local space, its sign is the handedness
+    float4 QTangent: QTANGENT;
+
+    // Per instance : the first 3 columns of the world matrix, the last one is always (0, 0, 0, 1)
+    float4 World0: WORLD0;
+    float4 World1: WORLD1;
+    float4 World2: WORLD2;
+
+    // Per instance : the first 3 columns of the inverse transpose of the world matrix
+    float3 Normal0: NORMALMATRIX0;
+    float3 Normal1: NORMALMATRIX1;
+    float3 Normal2: NORMALMATRIX2;
+};
+
+struct VS_OUTPUT
+{
+    float4 Pos : SV_POSITION;
+    float2 TexCoord : TEXCOORD;
+    float3 Normal : NORMAL;
+    float4 Tangent : TANGENT;
+};
+
+cbuffer ConstantBuffer : register(b0)
+{
+    float4x4 ViewProjMatrix;
+
+    // The positions are quantized inside the box of the mesh
+    float4 DequantizationScale;
+    float4 DequantizationOffset;
+}
+
+float3 RotateByQuaternion(float3 V, float4 Q)
+{
+    return V + 2 * cross(Q.xyz, cross(Q.xyz, V) + Q.w * V);
+}
+
+float3 ToWorldDirection(float3 V, VS_INPUT Input)
+{
+    return normalize(float3(dot(V, Input.World0.xyz), dot(V, Input.World1.xyz), dot(V, Input.World2.xyz)));
+}
+
+// By the inverse transpose of the world matrix, the normal stays perpendicular to the surface under any scale or shear
+float3 ToWorldNormal(float3 N, VS_INPUT Input)
+{
+    return normalize(float3(dot(N, Input.Normal0), dot(N, Input.Normal1), dot(N, Input.Normal2)));
+}
+
+VS_OUTPUT main(VS_INPUT Input)
+{
+    VS_OUTPUT Output;
+
+    float4 LocalPos = float4(Input.Pos * DequantizationScale.xyz + DequantizationOffset.xyz, 1);
+    float3 WorldPos = float3(dot(LocalPos, Input.World0), dot(LocalPos, Input.World1), dot(LocalPos, Input.World2));
+
+    Output.TexCoord = Input.TexCoord;
+    Output.Pos = mul(float4(WorldPos, 1), ViewProjMatrix);
+
+    float4 Q = normalize(Input.QTangent);
+    Output.Normal = ToWorldNormal(RotateByQuaternion(float3(0, 0, 1), Q), Input);
+    Output.Tangent = float4(ToWorldDirection(RotateByQuaternion(float3(1, 0, 0), Q), Input), Input.QTangent.w < 0 ? -1 : 1);
+
+    return Output;
+}
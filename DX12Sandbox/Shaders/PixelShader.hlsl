@@ -5,9 +5,15 @@ struct VS_OUTPUT
 {
     float4 Pos: SV_POSITION;
     float2 TexCoord : TEXCOORD;
+    float3 Normal : NORMAL;
+    float4 Tangent : TANGENT;
 };
 
+// Wrapped diffuse from a fixed light, so the shape reads without a normal map
+static const float3 LightDirection = normalize(float3(0.3, 0.8, -0.5));
+
 float4 main(VS_OUTPUT Input) : SV_TARGET
 {
-    return Tex1.Sample(Sampler1, Input.TexCoord);
-}
\ No newline at end of file
+    float Lighting = 0.5 + 0.5 * dot(normalize(Input.Normal), LightDirection);
+    return Tex1.Sample(Sampler1, Input.TexCoord) * float4(Lighting.xxx, 1);
+}
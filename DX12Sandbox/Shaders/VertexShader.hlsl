@@ -1,18 +1,35 @@
 struct VS_INPUT
 {
+    // Quantized inside the box of the mesh, WorldViewProjMatrix includes the dequantization
     float3 Pos: POSITION;
     float2 TexCoord: TEXCOORD;
+
+    // Rotation from the tangent space to the local space, its sign is the handedness
+    float4 QTangent: QTANGENT;
 };
 
 struct VS_OUTPUT
 {
     float4 Pos : SV_POSITION;
     float2 TexCoord : TEXCOORD;
+    float3 Normal : NORMAL;
+    float4 Tangent : TANGENT;
 };
 
 cbuffer ConstantBuffer : register(b0)
 {
     float4x4 WorldViewProjMatrix;
+
+    // Without the dequantization, for the tangent
+    float4x4 WorldMatrix;
+
+    // Inverse transpose of WorldMatrix, the normal stays perpendicular to the surface under a non uniform scale
+    float4x4 NormalMatrix;
+}
+
+float3 RotateByQuaternion(float3 V, float4 Q)
+{
+    return V + 2 * cross(Q.xyz, cross(Q.xyz, V) + Q.w * V);
 }
 
 VS_OUTPUT main(VS_INPUT Input)
@@ -21,6 +38,10 @@ VS_OUTPUT main(VS_INPUT Input)
     
     Output.TexCoord = Input.TexCoord; //Input.Color;
     Output.Pos = mul(float4(Input.Pos, 1), WorldViewProjMatrix);
+
+    float4 Q = normalize(Input.QTangent);
+    Output.Normal = normalize(mul(float4(RotateByQuaternion(float3(0, 0, 1), Q), 0), NormalMatrix).xyz);
+    Output.Tangent = float4(normalize(mul(float4(RotateByQuaternion(float3(1, 0, 0), Q), 0), WorldMatrix).xyz), Input.QTangent.w < 0 ? -1 : 1);
     
     return Output;
-}
\ No newline at end of file
+}
@@ -1,24 +1,69 @@
 #include "Actor.h"
 #include "pch.h"
 
+#include <algorithm>
+
 using namespace DirectX;
 
 Actor::Actor()
 {
-	XMStoreFloat4x4(&WorldMatrix, XMMatrixIdentity());
+	TransformHandle = CTransformStore::Get().Allocate();
+}
+
+Actor::~Actor()
+{
+	// The store turns the children into roots, keep the Actors in sync
+	for (Actor* Child : Children)
+	{
+		Child->Parent = nullptr;
+	}
+
+	if (Parent)
+	{
+		std::vector<Actor*>& Siblings = Parent->Children;
+		Siblings.erase(std::find(Siblings.begin(), Siblings.end(), this));
+	}
+
+	CTransformStore::Get().Free(TransformHandle);
+}
+
+bool Actor::SetParent(Actor* InParent)
+{
+	if (InParent == Parent)
+	{
+		return true;
+	}
+
+	if (!CTransformStore::Get().SetParent(TransformHandle, InParent ? InParent->TransformHandle : INVALID_TRANSFORM_HANDLE))
+	{
+		return false;
+	}
+
+	if (Parent)
+	{
+		std::vector<Actor*>& Siblings = Parent->Children;
+		Siblings.erase(std::find(Siblings.begin(), Siblings.end(), this));
+	}
+
+	Parent = InParent;
+	if (Parent)
+	{
+		Parent->Children.push_back(this);
+	}
+
+	OnTransformChanged();
+	return true;
 }
 
-void Actor::RecomputeMatrices()
+void Actor::AddRotation(const XMFLOAT3& DeltaRotation)
 {
-	// Compute Rotation
-	XMMATRIX RotationXMatrix = XMMatrixRotationX(XMConvertToRadians(Rotation.x));
-	XMMATRIX RotationYMatrix = XMMatrixRotationY(XMConvertToRadians(Rotation.y));
-	XMMATRIX RotationZMatrix = XMMatrixRotationZ(XMConvertToRadians(Rotation.z));
-	XMMATRIX RotationMatrix = RotationXMatrix * RotationYMatrix * RotationZMatrix;
-
-	// Compute Translation
-	XMFLOAT4 PositionF4 = XMFLOAT4(Position.x, Position.y, Position.z, 1.0f);
-	XMMATRIX TranslationMatrix = XMMatrixTranslationFromVector(XMLoadFloat4(&PositionF4));
-	XMMATRIX TmpWorldMatrix = RotationMatrix * TranslationMatrix;
-	XMStoreFloat4x4(&WorldMatrix, TmpWorldMatrix);
+	const XMVECTOR DeltaQuat = XMQuaternionMultiply(XMQuaternionMultiply(
+		XMQuaternionRotationNormal(XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f), XMConvertToRadians(DeltaRotation.x)),
+		XMQuaternionRotationNormal(XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f), XMConvertToRadians(DeltaRotation.y))),
+		XMQuaternionRotationNormal(XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), XMConvertToRadians(DeltaRotation.z)));
+
+	XMFLOAT4 Rotation = GetRotationQuaternion();
+	XMFLOAT4 NewRotation;
+	XMStoreFloat4(&NewRotation, XMQuaternionMultiply(XMLoadFloat4(&Rotation), DeltaQuat));
+	SetRotationQuaternion(NewRotation);
 }
@@ -1,7 +1,9 @@
 #pragma once
 
 #include <DirectXMath.h>
+#include <vector>
 #include "pch.h"
+#include "TransformStore.h"
 
 using namespace DirectX;
 
@@ -10,77 +12,101 @@ class Actor
 public:
 	Actor();
 
+	virtual ~Actor();
+
+	// The transform lives in the store, an Actor can't be copied
+	Actor(const Actor&) = delete;
+	Actor& operator=(const Actor&) = delete;
+
 	XMFLOAT3 GetPosition() const
 	{
-		return Position;
+		return CTransformStore::Get().GetPosition(TransformHandle);
 	}
 	XMFLOAT3 GetRotation() const
 	{
-		return Rotation;
+		return CTransformStore::Get().GetRotation(TransformHandle);
 	}
 	XMFLOAT3 GetScale() const
 	{
-		return Scale;
+		return CTransformStore::Get().GetScale(TransformHandle);
 	}
-	XMFLOAT4X4 GetWorldMatrix()
+	XMFLOAT4X4 GetWorldMatrix() const
 	{
-		return WorldMatrix;
+		return CTransformStore::Get().GetWorldMatrix(TransformHandle);
 	}
-	XMFLOAT3 GetForwardVector() const
+	XMFLOAT4 GetRotationQuaternion() const
 	{
-		XMFLOAT3 DefaultForward = XMFLOAT3(0.0f, 0.0f, 1.0f);
-		XMVECTOR ForwardVector = XMVector3Transform(XMLoadFloat3(&DefaultForward), XMMatrixRotationRollPitchYaw(Rotation.x, Rotation.y, Rotation.z));
-		XMFLOAT3 Result;
-		XMStoreFloat3(&Result, ForwardVector);
-
-		return Result;
+		return CTransformStore::Get().GetRotationQuaternion(TransformHandle);
+	}
 
+	// Axes relative to the parent, cached by the store when the rotation changes
+	XMFLOAT3 GetForwardVector() const
+	{
+		return CTransformStore::Get().GetForwardVector(TransformHandle);
 	}
 	XMFLOAT3 GetRightVector() const
 	{
-		XMFLOAT3 DefaultRight = XMFLOAT3(1.0f, 0.0f, 0.0f);
-		XMVECTOR RightVector = XMVector3Transform(XMLoadFloat3(&DefaultRight), XMMatrixRotationRollPitchYaw(Rotation.x, Rotation.y, Rotation.z));
-		XMFLOAT3 Result;
-		XMStoreFloat3(&Result, RightVector);
-
-		return Result;
+		return CTransformStore::Get().GetRightVector(TransformHandle);
 	}
 	XMFLOAT3 GetUpVector() const
 	{
-		XMFLOAT3 DefaultUp = XMFLOAT3(0.0f, 1.0f, 0.0f);
-		XMVECTOR UpVector = XMVector3Transform(XMLoadFloat3(&DefaultUp), XMMatrixRotationRollPitchYaw(Rotation.x, Rotation.y, Rotation.z));
-		XMFLOAT3 Result;
-		XMStoreFloat3(&Result, UpVector);
-
-		return Result;
+		return CTransformStore::Get().GetUpVector(TransformHandle);
 	}
 
-
 	void SetPosition(const XMFLOAT3& InPosition)
 	{
-		Position = InPosition;
-		RecomputeMatrices();
+		CTransformStore::Get().SetPosition(TransformHandle, InPosition);
+		OnTransformChanged();
 	}
 	void SetRotation(const XMFLOAT3& InRotation)
 	{
-		Rotation = InRotation;
-		RecomputeMatrices();
+		CTransformStore::Get().SetRotation(TransformHandle, InRotation);
+		OnTransformChanged();
 	}
+	void SetRotationQuaternion(const XMFLOAT4& InRotation)
+	{
+		CTransformStore::Get().SetRotationQuaternion(TransformHandle, InRotation);
+		OnTransformChanged();
+	}
+	// Applies DeltaRotation, Euler angles in degrees, on top of the current rotation
+	void AddRotation(const XMFLOAT3& DeltaRotation);
+
 	void SetScale(const XMFLOAT3& InScale)
 	{
-		Scale = InScale;
-		RecomputeMatrices();
+		CTransformStore::Get().SetScale(TransformHandle, InScale);
+		OnTransformChanged();
+	}
+
+	// The transform of the Actor becomes relative to InParent, nullptr makes it relative to the world
+	// Returns false if InParent is the Actor itself or one of its children
+	bool SetParent(Actor* InParent);
+
+	Actor* GetParent() const
+	{
+		return Parent;
+	}
+
+	const std::vector<Actor*>& GetChildren() const
+	{
+		return Children;
+	}
+
+	uint32_t GetTransformHandle() const
+	{
+		return TransformHandle;
 	}
 
 protected:
 
-	virtual void RecomputeMatrices();
+	// Called by the setters, the world matrix itself is recomputed in batch by CTransformStore
+	virtual void OnTransformChanged() {}
+
+	// Handle of the Actor's Transform in the CTransformStore
+	uint32_t TransformHandle;
+
+private:
 
-	// The world Matrix holding the transform of the Actor
-	XMFLOAT4X4 WorldMatrix = XMFLOAT4X4();
+	Actor* Parent = nullptr;
 
-	// Actor's Transform
-	XMFLOAT3 Position = XMFLOAT3(0.0f, 0.0f, 0.0f);
-	XMFLOAT3 Rotation = XMFLOAT3(0.0f, 0.0f, 0.0f);
-	XMFLOAT3 Scale = XMFLOAT3(1.0f, 1.0f, 1.0f);
+	std::vector<Actor*> Children;
 };
\ No newline at end of file
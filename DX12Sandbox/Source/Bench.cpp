@@ -0,0 +1,114 @@
+#include "pch.h"
+#include "Bench.h"
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <utility>
+
+bool Check(bool bPassed, const char* Format, ...)
+{
+	printf("%s ", bPassed ? "passed" : "FAILED");
+	va_list Arguments;
+	va_start(Arguments, Format);
+	vprintf(Format, Arguments);
+	va_end(Arguments);
+	printf("\n");
+	return bPassed;
+}
+
+void BuildShuffledSphere(int Rings, int Segments, std::vector<Vertex>& OutVertices, std::vector<unsigned int>& OutIndices)
+{
+	for (int Ring = 0; Ring <= Rings; ++Ring)
+	{
+		for (int Segment = 0; Segment <= Segments; ++Segment)
+		{
+			const float Theta = XM_PI * float(Ring) / float(Rings);
+			const float Phi = XM_2PI * float(Segment) / float(Segments);
+			OutVertices.emplace_back(XMFLOAT3(sinf(Theta) * cosf(Phi), cosf(Theta), sinf(Theta) * sinf(Phi)),
+				XMFLOAT2(float(Segment) / float(Segments), float(Ring) / float(Rings)));
+		}
+	}
+	std::vector<uint32_t> Quads(uint32_t(Rings * Segments));
+	for (uint32_t Quad = 0; Quad < Quads.size(); ++Quad)
+	{
+		Quads[Quad] = Quad;
+	}
+	for (uint32_t Quad = uint32_t(Quads.size()) - 1; Quad > 0; --Quad)
+	{
+		std::swap(Quads[Quad], Quads[(uint32_t(rand()) * (RAND_MAX + 1u) + uint32_t(rand())) % (Quad + 1)]);
+	}
+	for (uint32_t Quad : Quads)
+	{
+		const unsigned int Corner = Quad / Segments * (Segments + 1) + Quad % Segments;
+		const unsigned int Below = Corner + Segments + 1;
+		OutIndices.insert(OutIndices.end(), { Corner, Corner + 1, Below, Corner + 1, Below + 1, Below });
+	}
+}
+
+void BuildGrid(uint32_t Columns, uint32_t Rows, CMesh& Mesh)
+{
+	for (uint32_t Row = 0; Row < Rows; ++Row)
+	{
+		for (uint32_t Column = 0; Column < Columns; ++Column)
+		{
+			Mesh.Vertices.emplace_back(XMFLOAT3(float(Column), float(Row), 0.0f), XMFLOAT2(float(Column) / float(Columns - 1), float(Row) / float(Rows - 1)));
+		}
+	}
+	for (uint32_t Row = 0; Row + 1 < Rows; ++Row)
+	{
+		for (uint32_t Column = 0; Column + 1 < Columns; ++Column)
+		{
+			const unsigned int Corner = Row * Columns + Column;
+			const unsigned int Above = Corner + Columns;
+			Mesh.Indices.insert(Mesh.Indices.end(), { Corner, Above, Corner + 1, Corner + 1, Above, Above + 1 });
+		}
+	}
+}
+
+CNullUploadContext::CNullUploadContext()
+{
+	Device = CRHIDevice::Create(ERHIBackend::Null);
+	Device->Init(RHIDeviceDesc());
+	Allocator = Device->CreateCommandAllocator();
+	CommandList = Device->CreateCommandList(Allocator);
+	Pool = new CGeometryPool(Device);
+}
+
+CNullUploadContext::~CNullUploadContext()
+{
+	Pool->FinishUploads(CommandList);
+	CommandList->Close();
+	delete Pool;
+	SAFE_RELEASE(CommandList);
+	SAFE_RELEASE(Allocator);
+	Device->Shutdown();
+	delete Device;
+}
+
+void RunBenchmarks()
+{
+	RunTransformBenchmarks();
+	RunCullingBenchmarks();
+	RunMeshBenchmarks();
+	RunMeshImportBenchmarks();
+	RunJobSystemBenchmarks();
+	RunRendererBenchmarks();
+}
+
+bool RunChecks()
+{
+	bool bPassed = true;
+	bPassed &= RunTransformChecks();
+	bPassed &= RunCullingChecks();
+	bPassed &= RunLODSelectionChecks();
+	bPassed &= RunGeometryPoolChecks();
+	bPassed &= RunMeshChecks();
+	bPassed &= RunMeshImportChecks();
+	bPassed &= RunJobSystemChecks();
+	bPassed &= RunRendererChecks();
+
+	printf(bPassed ? "All checks passed\n" : "Some checks FAILED\n");
+	return bPassed;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include "Mesh.h"
+
+#include <chrono>
+#include <vector>
+
+// Benchmarks and checks of the headless runner, one file per module. The benchmarks print what they measured, the checks
+// print a line per check and return false if any failed
+
+// Time per call of Function, run Iterations times
+template<typename FunctionType>
+double MeasureNs(int Iterations, FunctionType Function)
+{
+	const std::chrono::high_resolution_clock::time_point Start = std::chrono::high_resolution_clock::now();
+	for (int Iteration = 0; Iteration < Iterations; ++Iteration)
+	{
+		Function(Iteration);
+	}
+	return std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - Start).count() / Iterations;
+}
+
+// Prints "passed" or "FAILED" then the printf formatted description, returns bPassed
+bool Check(bool bPassed, const char* Format, ...);
+
+// Unit sphere whose quads come in random order, like an unoptimized export
+void BuildShuffledSphere(int Rings, int Segments, std::vector<Vertex>& OutVertices, std::vector<unsigned int>& OutIndices);
+
+// Grid of Columns x Rows vertices, two triangles per cell
+void BuildGrid(uint32_t Columns, uint32_t Rows, CMesh& Mesh);
+
+// A Null backend device, a command list to record uploads on and a geometry pool, for the meshes of the benchmarks and checks
+class CNullUploadContext
+{
+public:
+	CNullUploadContext();
+
+	// Closes the command list after finishing the uploads, the meshes using Pool must be gone
+	~CNullUploadContext();
+
+	CNullUploadContext(const CNullUploadContext&) = delete;
+	CNullUploadContext& operator=(const CNullUploadContext&) = delete;
+
+	CRHIDevice* Device;
+	CRHICommandAllocator* Allocator;
+	CRHICommandList* CommandList;
+	CGeometryPool* Pool;
+};
+
+void RunTransformBenchmarks();
+bool RunTransformChecks();
+
+void RunCullingBenchmarks();
+bool RunCullingChecks();
+bool RunLODSelectionChecks();
+
+bool RunGeometryPoolChecks();
+
+void RunMeshBenchmarks();
+bool RunMeshChecks();
+
+void RunMeshImportBenchmarks();
+bool RunMeshImportChecks();
+
+void RunJobSystemBenchmarks();
+bool RunJobSystemChecks();
+
+void RunRendererBenchmarks();
+bool RunRendererChecks();
+
+// Microbenchmarks of the CPU side building blocks, run with "bench" as first argument
+void RunBenchmarks();
+
+// Checks of results the benchmarks don't look at, run with "check" as first argument. Returns false if any failed
+bool RunChecks();
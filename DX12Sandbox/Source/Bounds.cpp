@@ -0,0 +1,60 @@
+#include "pch.h"
+#include "Bounds.h"
+
+#include <cstdint>
+
+BoundingVolume ComputeBoundingVolume(const XMFLOAT3* FirstPosition, size_t Count, size_t Stride)
+{
+	BoundingVolume Result;
+	if (Count == 0)
+	{
+		return Result;
+	}
+
+	const uint8_t* Positions = reinterpret_cast<const uint8_t*>(FirstPosition);
+	auto LoadPosition = [Positions, Stride](size_t Index)
+	{
+		return XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(Positions + Index * Stride));
+	};
+
+	// Two accumulators per pass so consecutive iterations don't wait on each other
+	XMVECTOR Min0 = LoadPosition(0);
+	XMVECTOR Max0 = Min0;
+	XMVECTOR Min1 = Min0;
+	XMVECTOR Max1 = Min0;
+	size_t Index = 1;
+	for (; Index + 1 < Count; Index += 2)
+	{
+		const XMVECTOR Position0 = LoadPosition(Index);
+		const XMVECTOR Position1 = LoadPosition(Index + 1);
+		Min0 = XMVectorMin(Min0, Position0);
+		Max0 = XMVectorMax(Max0, Position0);
+		Min1 = XMVectorMin(Min1, Position1);
+		Max1 = XMVectorMax(Max1, Position1);
+	}
+	if (Index < Count)
+	{
+		Min0 = XMVectorMin(Min0, LoadPosition(Index));
+		Max0 = XMVectorMax(Max0, LoadPosition(Index));
+	}
+	const XMVECTOR Min = XMVectorMin(Min0, Min1);
+	const XMVECTOR Max = XMVectorMax(Max0, Max1);
+
+	const XMVECTOR Center = (Min + Max) * 0.5f;
+	XMVECTOR RadiusSq0 = XMVectorZero();
+	XMVECTOR RadiusSq1 = XMVectorZero();
+	for (Index = 0; Index + 1 < Count; Index += 2)
+	{
+		RadiusSq0 = XMVectorMax(RadiusSq0, XMVector3LengthSq(LoadPosition(Index) - Center));
+		RadiusSq1 = XMVectorMax(RadiusSq1, XMVector3LengthSq(LoadPosition(Index + 1) - Center));
+	}
+	if (Index < Count)
+	{
+		RadiusSq0 = XMVectorMax(RadiusSq0, XMVector3LengthSq(LoadPosition(Index) - Center));
+	}
+
+	XMStoreFloat3(&Result.Center, Center);
+	XMStoreFloat3(&Result.Extents, (Max - Min) * 0.5f);
+	Result.Radius = XMVectorGetX(XMVectorSqrt(XMVectorMax(RadiusSq0, RadiusSq1)));
+	return Result;
+}
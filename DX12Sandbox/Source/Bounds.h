@@ -0,0 +1,45 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstddef>
+#include "pch.h"
+
+using namespace DirectX;
+
+// Box and sphere around a set of points. The sphere is centered on the box, one center serves both
+struct BoundingVolume
+{
+	XMFLOAT3 Center = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	float Radius = 0.0f;
+
+	// Half the size of the box on each axis
+	XMFLOAT3 Extents = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	float Padding = 0.0f;
+};
+
+// Box of Count positions read every Stride bytes from FirstPosition, and the smallest sphere around them centered on the box
+BoundingVolume ComputeBoundingVolume(const XMFLOAT3* FirstPosition, size_t Count, size_t Stride);
+
+// Volume moved by World. The box stays axis aligned : its extent along a world axis is the sum of the local extents
+// scaled by the absolute values of that column of the matrix. The radius grows with the largest scale axis
+inline BoundingVolume XM_CALLCONV TransformBoundingVolume(FXMMATRIX World, const BoundingVolume& Local)
+{
+	const XMVECTOR Center = XMLoadFloat3(&Local.Center);
+	const XMVECTOR Extents = XMLoadFloat3(&Local.Extents);
+
+	XMVECTOR WorldCenter = XMVectorMultiplyAdd(XMVectorSplatX(Center), World.r[0], World.r[3]);
+	WorldCenter = XMVectorMultiplyAdd(XMVectorSplatY(Center), World.r[1], WorldCenter);
+	WorldCenter = XMVectorMultiplyAdd(XMVectorSplatZ(Center), World.r[2], WorldCenter);
+
+	XMVECTOR WorldExtents = XMVectorAbs(World.r[0]) * XMVectorSplatX(Extents);
+	WorldExtents = XMVectorMultiplyAdd(XMVectorAbs(World.r[1]), XMVectorSplatY(Extents), WorldExtents);
+	WorldExtents = XMVectorMultiplyAdd(XMVectorAbs(World.r[2]), XMVectorSplatZ(Extents), WorldExtents);
+
+	const XMVECTOR MaxScaleSq = XMVectorMax(XMVectorMax(XMVector3LengthSq(World.r[0]), XMVector3LengthSq(World.r[1])), XMVector3LengthSq(World.r[2]));
+
+	BoundingVolume Result;
+	XMStoreFloat3(&Result.Center, WorldCenter);
+	XMStoreFloat3(&Result.Extents, WorldExtents);
+	Result.Radius = Local.Radius * XMVectorGetX(XMVectorSqrt(MaxScaleSq));
+	return Result;
+}
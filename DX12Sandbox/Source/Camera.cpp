@@ -3,33 +3,70 @@
 
 Camera::Camera()
 {
-	Position = DirectX::XMFLOAT3(0.0f, 0.0f, -4.0f);
 	CameraTarget = DirectX::XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
 	CameraUp = DirectX::XMFLOAT4(0.0f, 1.0f, 0.0f, 0.0f);
 
 	// Perspective Camera
 	DirectX::XMMATRIX PerspectiveMatrix = DirectX::XMMatrixPerspectiveFovLH(FOV * (3.14f / 180.0f), AspectRatio, Near, Far);
 	XMStoreFloat4x4(&ProjectionMatrix, PerspectiveMatrix);
-	RecomputeMatrices();
+
+	SetPosition(DirectX::XMFLOAT3(0.0f, 0.0f, -4.0f));
 }
 
 void Camera::RecomputeMatrices()
 {
-	Actor::RecomputeMatrices();
-	XMFLOAT4 PositionF4 = XMFLOAT4(Position.x, Position.y, Position.z, 0.0f);
+	// Position in world space, the camera may be attached to another Actor
+	XMFLOAT4X4 World = GetWorldMatrix();
+	XMFLOAT4 PositionF4 = XMFLOAT4(World._41, World._42, World._43, 0.0f);
 	DirectX::XMVECTOR CamPos = XMLoadFloat4(&PositionF4);
 	DirectX::XMVECTOR CamUp = XMLoadFloat4(&CameraUp);
 	XMFLOAT3 ComputedForward = GetForwardVector();
 	XMFLOAT4 CameraForward = XMFLOAT4(ComputedForward.x, ComputedForward.y, ComputedForward.z, 0.0f);
 	DirectX::XMVECTOR CamForward = XMLoadFloat4(&CameraForward);
+	if (GetParent())
+	{
+		// The cached forward is relative to the parent
+		XMFLOAT4X4 ParentWorld = GetParent()->GetWorldMatrix();
+		CamForward = XMVector3TransformNormal(CamForward, XMLoadFloat4x4(&ParentWorld));
+	}
 
 	DirectX::XMMATRIX LookAtMatrix = DirectX::XMMatrixLookToLH(CamPos, CamForward, CamUp);
 	XMStoreFloat4x4(&ViewMatrix, LookAtMatrix);
+
+	// Extract the planes from the columns of ViewProjection, clip space z goes from 0 to 1
+	XMFLOAT4X4 ViewProjection;
+	XMStoreFloat4x4(&ViewProjection, LookAtMatrix * XMLoadFloat4x4(&ProjectionMatrix));
+	const XMVECTOR Column0 = XMVectorSet(ViewProjection._11, ViewProjection._21, ViewProjection._31, ViewProjection._41);
+	const XMVECTOR Column1 = XMVectorSet(ViewProjection._12, ViewProjection._22, ViewProjection._32, ViewProjection._42);
+	const XMVECTOR Column2 = XMVectorSet(ViewProjection._13, ViewProjection._23, ViewProjection._33, ViewProjection._43);
+	const XMVECTOR Column3 = XMVectorSet(ViewProjection._14, ViewProjection._24, ViewProjection._34, ViewProjection._44);
+
+	XMStoreFloat4(&FrustumPlanes[0], XMPlaneNormalize(Column3 + Column0));
+	XMStoreFloat4(&FrustumPlanes[1], XMPlaneNormalize(Column3 - Column0));
+	XMStoreFloat4(&FrustumPlanes[2], XMPlaneNormalize(Column3 + Column1));
+	XMStoreFloat4(&FrustumPlanes[3], XMPlaneNormalize(Column3 - Column1));
+	XMStoreFloat4(&FrustumPlanes[4], XMPlaneNormalize(Column2));
+	XMStoreFloat4(&FrustumPlanes[5], XMPlaneNormalize(Column3 - Column2));
+
+	bViewDirty = false;
+}
+
+XMFLOAT4X4 Camera::GetInterpolatedViewMatrix(float Alpha, XMFLOAT3& OutPosition) const
+{
+	// The world matrix already holds the parents, its forward row is the world forward
+	const XMFLOAT4X4 World = CTransformStore::Get().GetInterpolatedWorldMatrix(TransformHandle, Alpha);
+	OutPosition = XMFLOAT3(World._41, World._42, World._43);
+	const XMVECTOR CamForward = XMVector3Normalize(XMVectorSet(World._31, World._32, World._33, 0.0f));
+
+	XMFLOAT4X4 InterpolatedView;
+	XMStoreFloat4x4(&InterpolatedView, XMMatrixLookToLH(XMLoadFloat3(&OutPosition), CamForward, XMLoadFloat4(&CameraUp)));
+	return InterpolatedView;
 }
 
 void Camera::MoveForward(float InputValue)
 {
 	XMFLOAT3 ForwardVector = GetForwardVector();
+	XMFLOAT3 Position = GetPosition();
 	XMVECTOR NewPos = XMLoadFloat3(&Position) + XMLoadFloat3(&ForwardVector) * InputValue * CameraSpeed;
 	XMFLOAT3 UpdatedPosition;
 	XMStoreFloat3(&UpdatedPosition, NewPos);
@@ -38,6 +75,7 @@ void Camera::MoveForward(float InputValue)
 void Camera::MoveRight(float InputValue)
 {
 	XMFLOAT3 RightVector = GetRightVector();
+	XMFLOAT3 Position = GetPosition();
 	XMVECTOR NewPos = XMLoadFloat3(&Position) + XMLoadFloat3(&RightVector) * InputValue * CameraSpeed;
 	XMFLOAT3 UpdatedPosition;
 	XMStoreFloat3(&UpdatedPosition, NewPos);
@@ -47,6 +85,7 @@ void Camera::MoveRight(float InputValue)
 void Camera::MoveUp(float InputValue)
 {
 	XMFLOAT3 UpVector = GetUpVector();
+	XMFLOAT3 Position = GetPosition();
 	XMVECTOR NewPos = XMLoadFloat3(&Position) + XMLoadFloat3(&UpVector) * InputValue * CameraSpeed;
 	XMFLOAT3 UpdatedPosition;
 	XMStoreFloat3(&UpdatedPosition, NewPos);
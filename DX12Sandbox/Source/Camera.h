@@ -27,8 +27,44 @@ public:
 
 	float Far = 1000.0f;
 
-	float CameraSpeed = 0.05f;
+	// World units per second of input, the Move functions are given the input times the elapsed seconds.
+	// The speed key messages used to give, 0.05 per message at the default repeat rate of about 30 per second
+	float CameraSpeed = 1.5f;
 
-	void RecomputeMatrices() override;
+	// Rebuild the view matrix from the Actor's transform
+	void RecomputeMatrices();
+
+	// Rebuilt here rather than in the setters, moving the camera several times in a frame costs one rebuild
+	const DirectX::XMFLOAT4X4& GetViewMatrix()
+	{
+		// A parent can move without notifying the camera
+		if (bViewDirty || GetParent())
+		{
+			RecomputeMatrices();
+		}
+		return ViewMatrix;
+	}
+
+	// View matrix and position Alpha of the way from before the last transform update to after it
+	DirectX::XMFLOAT4X4 GetInterpolatedViewMatrix(float Alpha, DirectX::XMFLOAT3& OutPosition) const;
+
+	// Left, right, bottom, top, near and far planes in world space, normals point inside
+	const DirectX::XMFLOAT4* GetFrustumPlanes()
+	{
+		GetViewMatrix();
+		return FrustumPlanes;
+	}
+
+protected:
+
+	// Rebuilt with the view matrix
+	DirectX::XMFLOAT4 FrustumPlanes[6];
+
+	void OnTransformChanged() override
+	{
+		bViewDirty = true;
+	}
+
+	bool bViewDirty = true;
 };
 
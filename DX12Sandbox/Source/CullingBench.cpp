@@ -0,0 +1,194 @@
+#include "pch.h"
+#include "Bench.h"
+#include "Camera.h"
+#include "FrustumCuller.h"
+#include "LODSelector.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+void RunCullingBenchmarks()
+{
+	// Frustum culling of spheres scattered in a box around the camera, turning a bit every iteration
+	const uint32_t SphereCount = 1 << 17;
+	CFrustumCuller Culler;
+	Culler.Resize(SphereCount);
+	srand(1);
+	for (uint32_t Index = 0; Index < SphereCount; ++Index)
+	{
+		const XMFLOAT3 Center(float(rand() % 2000 - 1000) * 0.1f, float(rand() % 2000 - 1000) * 0.1f, float(rand() % 2000 - 1000) * 0.1f);
+		Culler.SetSphere(Index, Center, 0.5f + float(rand() % 100) * 0.01f);
+	}
+
+	Camera CullingCamera;
+	std::vector<uint32_t> Visible(Culler.GetPaddedCount());
+	uint32_t VisibleCount = 0;
+	const double CullingNs = MeasureNs(64, [&](int Iteration)
+	{
+		CullingCamera.SetRotation(XMFLOAT3(0.0f, float(Iteration) * 5.0f, 0.0f));
+		VisibleCount = Culler.Cull(CullingCamera.GetFrustumPlanes(), Visible.data());
+	});
+
+	printf("Frustum culling of %u spheres       : %.3f ms (%u visible)\n", SphereCount, CullingNs / 1e6, VisibleCount);
+
+	// LOD selection of the spheres in the frustum, each with the errors of a 4 LOD chain
+	CLODSelector Selector;
+	Selector.Resize(SphereCount);
+	const float RelativeErrors[] = { 0.0005f, 0.002f, 0.006f, 0.015f };
+	for (uint32_t Index = 0; Index < SphereCount; ++Index)
+	{
+		Selector.SetLODErrors(Index, RelativeErrors, 4);
+	}
+
+	const float ProjectionScale = CLODSelector::GetProjectionScale(CullingCamera.ProjectionMatrix, 720.0f);
+	std::vector<uint32_t> Selected(Culler.GetPaddedCount());
+	std::vector<uint8_t> SelectedLODs(Culler.GetPaddedCount());
+	uint32_t SelectedCount = 0;
+	const double SelectionNs = MeasureNs(64, [&](int)
+	{
+		SelectedCount = Selector.Select(Culler, CullingCamera.GetPosition(), ProjectionScale, Visible.data(), VisibleCount, Selected.data(), SelectedLODs.data());
+	});
+
+	uint32_t LODHistogram[MESH_MAX_LODS] = {};
+	for (uint32_t Index = 0; Index < SelectedCount; ++Index)
+	{
+		LODHistogram[SelectedLODs[Index]]++;
+	}
+	printf("LOD selection of %u spheres          : %.3f ms (%u dropped, LODs %u %u %u %u %u)\n", VisibleCount, SelectionNs / 1e6,
+		VisibleCount - SelectedCount, LODHistogram[0], LODHistogram[1], LODHistogram[2], LODHistogram[3], LODHistogram[4]);
+}
+
+bool RunCullingChecks()
+{
+	// Spheres scattered around a turned camera, and as many straddling its planes, against a scalar plane by plane test.
+	// The count isn't a multiple of 4, the padding must never be visible
+	Camera CullingCamera;
+	CullingCamera.SetPosition(XMFLOAT3(2.0f, -1.0f, -3.0f));
+	CullingCamera.SetRotation(XMFLOAT3(10.0f, 35.0f, 0.0f));
+	const XMFLOAT4* Planes = CullingCamera.GetFrustumPlanes();
+
+	const uint32_t SphereCount = 4001;
+	CFrustumCuller Culler;
+	Culler.Resize(SphereCount);
+	srand(2);
+	auto Random = [](float Min, float Max) { return Min + (Max - Min) * float(rand()) / float(RAND_MAX); };
+	std::vector<XMFLOAT4> Spheres(SphereCount);
+	for (uint32_t Index = 0; Index < SphereCount; ++Index)
+	{
+		const float Radius = Random(0.05f, 3.0f);
+		XMVECTOR Center = XMVectorSet(Random(-60.0f, 60.0f), Random(-60.0f, 60.0f), Random(-60.0f, 60.0f), 0.0f);
+		if (Index % 2 == 1)
+		{
+			// Moved onto a plane then off it by up to 1.5 radius on either side
+			const XMVECTOR Plane = XMLoadFloat4(&Planes[rand() % 6]);
+			Center = Center - Plane * (XMVectorGetX(XMVector3Dot(Plane, Center)) + XMVectorGetW(Plane)) + Plane * Random(-1.5f, 1.5f) * Radius;
+		}
+		XMStoreFloat4(&Spheres[Index], XMVectorSetW(Center, Radius));
+		Culler.SetSphere(Index, XMFLOAT3(Spheres[Index].x, Spheres[Index].y, Spheres[Index].z), Radius);
+	}
+
+	std::vector<uint32_t> Visible(Culler.GetPaddedCount());
+	const uint32_t VisibleCount = Culler.Cull(Planes, Visible.data());
+
+	// The same by ranges, like the renderer culls them on several threads
+	std::vector<uint32_t> RangeVisible;
+	std::vector<uint32_t> Range(64);
+	for (uint32_t Begin = 0; Begin < Culler.GetPaddedCount(); Begin += 64)
+	{
+		const uint32_t End = std::min(Begin + 64, Culler.GetPaddedCount());
+		RangeVisible.insert(RangeVisible.end(), Range.begin(), Range.begin() + Culler.Cull(Planes, Begin, End, Range.data()));
+	}
+
+	uint32_t Mismatches = 0, Straddling = 0, ExpectedCount = 0, Next = 0;
+	for (uint32_t Index = 0; Index < SphereCount; ++Index)
+	{
+		const XMFLOAT4& Sphere = Spheres[Index];
+		float MinDistance = FLT_MAX;
+		bool bStraddling = false;
+		for (int Plane = 0; Plane < 6; ++Plane)
+		{
+			const float Distance = Planes[Plane].x * Sphere.x + Planes[Plane].y * Sphere.y + Planes[Plane].z * Sphere.z + Planes[Plane].w;
+			MinDistance = std::min(MinDistance, Distance);
+			bStraddling |= fabsf(Distance) < Sphere.w;
+		}
+		Straddling += bStraddling ? 1 : 0;
+		const bool bExpected = MinDistance >= -Sphere.w;
+		const bool bCulledVisible = Next < VisibleCount && Visible[Next] == Index;
+		Next += bCulledVisible ? 1 : 0;
+		ExpectedCount += bExpected ? 1 : 0;
+
+		// Rounding may only differ right at the surface of the sphere
+		Mismatches += bExpected != bCulledVisible && fabsf(MinDistance + Sphere.w) > 1e-4f ? 1 : 0;
+	}
+	bool bPassed = Check(Mismatches == 0 && Next == VisibleCount, "frustum culling : %u of %u spheres visible (%u expected), %u differ from the scalar test",
+		VisibleCount, SphereCount, ExpectedCount, Mismatches + (VisibleCount - Next));
+	bPassed &= Check(Straddling > SphereCount / 4, "frustum culling : %u of the spheres straddle a plane", Straddling);
+	bPassed &= Check(RangeVisible == std::vector<uint32_t>(Visible.begin(), Visible.begin() + VisibleCount),
+		"frustum culling : the same spheres culled in ranges of 64");
+	return bPassed;
+}
+
+// Places sphere Index of radius 1 in front of a camera at the origin so it is PixelsPerRadius pixels on screen for a
+// projection scale of 100, then selects its LOD alone
+static uint8_t SelectAt(CLODSelector& Selector, CFrustumCuller& Spheres, uint32_t Index, float PixelsPerRadius)
+{
+	Spheres.SetSphere(Index, XMFLOAT3(0.0f, 0.0f, 1.0f + 100.0f / PixelsPerRadius), 1.0f);
+	uint32_t Visible = Index;
+	uint8_t LOD = 0;
+	return Selector.Select(Spheres, XMFLOAT3(0.0f, 0.0f, 0.0f), 100.0f, &Visible, 1, &Visible, &LOD) == 1 ? LOD : uint8_t(LOD_DROPPED);
+}
+
+bool RunLODSelectionChecks()
+{
+	// One reduced LOD with an error of 1% of the radius : it is fine under 100 pixels per radius, the default 1 pixel
+	// threshold, and only taken under 75 with the default hysteresis. Dropped under 0.375 pixels, back at 0.5
+	CFrustumCuller Spheres;
+	Spheres.Resize(11);
+	CLODSelector Selector;
+	Selector.Resize(11);
+	const float RelativeError = 0.01f;
+	for (uint32_t Index = 0; Index < 11; ++Index)
+	{
+		Selector.SetLODErrors(Index, &RelativeError, 1);
+	}
+
+	const float Sizes[] = { 200.0f, 90.0f, 70.0f, 90.0f, 110.0f, 90.0f, 0.45f, 0.3f, 0.45f, 0.55f };
+	const uint8_t ExpectedLODs[] = { 0, 0, 1, 1, 0, 0, 1, LOD_DROPPED, LOD_DROPPED, 1 };
+	bool bPassed = true;
+	for (uint32_t Step = 0; Step < 10; ++Step)
+	{
+		const uint8_t LOD = SelectAt(Selector, Spheres, 0, Sizes[Step]);
+		bPassed &= Check(LOD == ExpectedLODs[Step], "LOD selection : at %.2f pixels per radius, %s (expected %s)", Sizes[Step],
+			LOD == LOD_DROPPED ? "dropped" : LOD == 0 ? "LOD 0" : "LOD 1", ExpectedLODs[Step] == LOD_DROPPED ? "dropped" : ExpectedLODs[Step] == 0 ? "LOD 0" : "LOD 1");
+	}
+
+	// Selected in place from a shuffled list whose count isn't a multiple of 4 : the kept entries stay in order with their LOD
+	const uint32_t Order[11] = { 7, 2, 10, 0, 5, 9, 1, 4, 8, 3, 6 };
+	const float OrderSizes[3] = { 1000.0f, 50.0f, 0.1f };
+	std::vector<uint32_t> Visible(Spheres.GetPaddedCount());
+	std::vector<uint8_t> LODs(Spheres.GetPaddedCount());
+	std::vector<uint32_t> ExpectedVisible;
+	std::vector<uint8_t> ExpectedLODList;
+	Selector.Resize(0);
+	Selector.Resize(11);
+	for (uint32_t Index = 0; Index < 11; ++Index)
+	{
+		Selector.SetLODErrors(Index, &RelativeError, 1);
+		Spheres.SetSphere(Index, XMFLOAT3(0.0f, 0.0f, 1.0f + 100.0f / OrderSizes[Index % 3]), 1.0f);
+		Visible[Index] = Order[Index];
+		if (Order[Index] % 3 != 2)
+		{
+			ExpectedVisible.push_back(Order[Index]);
+			ExpectedLODList.push_back(uint8_t(Order[Index] % 3));
+		}
+	}
+	const uint32_t SelectedCount = Selector.Select(Spheres, XMFLOAT3(0.0f, 0.0f, 0.0f), 100.0f, Visible.data(), 11, Visible.data(), LODs.data());
+	bPassed &= Check(SelectedCount == ExpectedVisible.size() && std::equal(ExpectedVisible.begin(), ExpectedVisible.end(), Visible.begin())
+		&& std::equal(ExpectedLODList.begin(), ExpectedLODList.end(), LODs.begin()),
+		"LOD selection : %u of 11 objects kept in place (expected %zu), in order and with their LOD", SelectedCount, ExpectedVisible.size());
+	return bPassed;
+}
@@ -0,0 +1,1103 @@
+#include "pch.h"
+#include "D3D12RHI.h"
+#include <shlobj.h>
+#include <strsafe.h>
+#include <wincodec.h>
+#include <cstring>
+#include <string>
+
+#define D3DCOMPILE_DEBUG 1
+
+static std::wstring GetLatestWinPixGpuCapturerPath()
+{
+	LPWSTR ProgramFilesPath = nullptr;
+	SHGetKnownFolderPath(FOLDERID_ProgramFiles, KF_FLAG_DEFAULT, NULL, &ProgramFilesPath);
+
+	std::wstring PixSearchPath = ProgramFilesPath + std::wstring(L"\\Microsoft PIX\\*");
+
+	WIN32_FIND_DATA FindData;
+	bool bFoundPixInstallation = false;
+	wchar_t NewestVersionFound[MAX_PATH];
+
+	HANDLE hFind = FindFirstFile(PixSearchPath.c_str(), &FindData);
+	if (hFind != INVALID_HANDLE_VALUE)
+	{
+		do
+		{
+			if (((FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == FILE_ATTRIBUTE_DIRECTORY) &&
+				(FindData.cFileName[0] != '.'))
+			{
+				if (!bFoundPixInstallation || wcscmp(NewestVersionFound, FindData.cFileName) <= 0)
+				{
+					bFoundPixInstallation = true;
+					StringCchCopy(NewestVersionFound, _countof(NewestVersionFound), FindData.cFileName);
+				}
+			}
+		} while (FindNextFile(hFind, &FindData) != 0);
+	}
+
+	FindClose(hFind);
+
+	if (!bFoundPixInstallation)
+	{
+		MessageBox(0, L"Error: no PIX installation found", 0, 0);
+	}
+
+	wchar_t Output[MAX_PATH];
+	StringCchCopy(Output, PixSearchPath.length(), PixSearchPath.data());
+	StringCchCat(Output, MAX_PATH, &NewestVersionFound[0]);
+	StringCchCat(Output, MAX_PATH, L"\\WinPixGpuCapturer.dll");
+
+	return &Output[0];
+}
+
+
+DXGI_FORMAT CD3D12RHIDevice::GetDXGIFormat(ERHIFormat Format)
+{
+	switch (Format)
+	{
+	case ERHIFormat::R32G32B32A32_Float: return DXGI_FORMAT_R32G32B32A32_FLOAT;
+	case ERHIFormat::R32G32B32_Float: return DXGI_FORMAT_R32G32B32_FLOAT;
+	case ERHIFormat::R32G32_Float: return DXGI_FORMAT_R32G32_FLOAT;
+	case ERHIFormat::R32_UInt: return DXGI_FORMAT_R32_UINT;
+	case ERHIFormat::R16G16B16A16_Float: return DXGI_FORMAT_R16G16B16A16_FLOAT;
+	case ERHIFormat::R16G16B16A16_UNorm: return DXGI_FORMAT_R16G16B16A16_UNORM;
+	case ERHIFormat::R16G16B16A16_SNorm: return DXGI_FORMAT_R16G16B16A16_SNORM;
+	case ERHIFormat::R16G16_Float: return DXGI_FORMAT_R16G16_FLOAT;
+	case ERHIFormat::R16G16_UNorm: return DXGI_FORMAT_R16G16_UNORM;
+	case ERHIFormat::R16_UInt: return DXGI_FORMAT_R16_UINT;
+	default: return DXGI_FORMAT_UNKNOWN;
+	}
+}
+
+D3D12_RESOURCE_STATES CD3D12RHIDevice::GetResourceState(ERHIResourceState State)
+{
+	switch (State)
+	{
+	case ERHIResourceState::CopyDest: return D3D12_RESOURCE_STATE_COPY_DEST;
+	case ERHIResourceState::CopySource: return D3D12_RESOURCE_STATE_COPY_SOURCE;
+	case ERHIResourceState::GenericRead: return D3D12_RESOURCE_STATE_GENERIC_READ;
+	case ERHIResourceState::VertexAndConstantBuffer: return D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER;
+	case ERHIResourceState::IndexBuffer: return D3D12_RESOURCE_STATE_INDEX_BUFFER;
+	case ERHIResourceState::PixelShaderResource: return D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+	case ERHIResourceState::RenderTarget: return D3D12_RESOURCE_STATE_RENDER_TARGET;
+	case ERHIResourceState::DepthWrite: return D3D12_RESOURCE_STATE_DEPTH_WRITE;
+	case ERHIResourceState::Present: return D3D12_RESOURCE_STATE_PRESENT;
+	default: return D3D12_RESOURCE_STATE_COMMON;
+	}
+}
+
+/* Resources */
+
+void* CD3D12RHIResource::Map()
+{
+	// We do not intend to read from this resource on the CPU
+	CD3DX12_RANGE ReadRange(0, 0);
+	void* MappedData = nullptr;
+	if (FAILED(Resource->Map(0, &ReadRange, &MappedData)))
+	{
+		return nullptr;
+	}
+	return MappedData;
+}
+
+void CD3D12RHIResource::Unmap()
+{
+	Resource->Unmap(0, nullptr);
+}
+
+CD3D12RHIFence::~CD3D12RHIFence()
+{
+	SAFE_RELEASE(Fence);
+	if (FenceEvent)
+	{
+		CloseHandle(FenceEvent);
+	}
+}
+
+bool CD3D12RHIFence::Wait(uint64_t Value)
+{
+	if (Fence->GetCompletedValue() < Value)
+	{
+		HRESULT Hr = Fence->SetEventOnCompletion(Value, FenceEvent);
+		if (FAILED(Hr))
+		{
+			return false;
+		}
+
+		WaitForSingleObject(FenceEvent, INFINITE);
+	}
+	return true;
+}
+
+/* Command List */
+
+double CD3D12RHITimestampQueries::GetTimeMs(uint32_t Index)
+{
+	const D3D12_RANGE ReadRange = { Index * sizeof(uint64_t), (Index + 1) * sizeof(uint64_t) };
+	const D3D12_RANGE WrittenRange = { 0, 0 };
+	uint8_t* Data = nullptr;
+	if (FAILED(ReadbackBuffer->Map(0, &ReadRange, reinterpret_cast<void**>(&Data))))
+	{
+		return 0.0;
+	}
+	uint64_t Ticks;
+	memcpy(&Ticks, Data + ReadRange.Begin, sizeof(Ticks));
+	ReadbackBuffer->Unmap(0, &WrittenRange);
+
+	return CalibrationMs + (double(Ticks) - double(CalibrationTicks)) / TicksPerMs;
+}
+
+bool CD3D12RHICommandList::Reset(CRHICommandAllocator* Allocator, CRHIPipelineState* InitialState)
+{
+	ID3D12PipelineState* PSO = InitialState ? static_cast<CD3D12RHIPipelineState*>(InitialState)->PSO : nullptr;
+	HRESULT Hr = CommandList->Reset(static_cast<CD3D12RHICommandAllocator*>(Allocator)->Allocator, PSO);
+	if (FAILED(Hr))
+	{
+		return false;
+	}
+	RecordStartMs = RHINowMs();
+	if (InitialState)
+	{
+		RecordedStats.PipelineStateChanges++;
+	}
+
+	SetSharedState();
+	return true;
+}
+
+bool CD3D12RHICommandList::Close()
+{
+	RecordedStats.RecordTimeMs += RHINowMs() - RecordStartMs;
+	return SUCCEEDED(CommandList->Close());
+}
+
+void CD3D12RHICommandList::SetSharedState()
+{
+	// Set the root signature
+	CommandList->SetGraphicsRootSignature(Device->RootSignature);
+
+	// Set the descriptor heap
+	ID3D12DescriptorHeap* DescriptorHeaps[] = { Device->MainDescriptorHeap };
+	CommandList->SetDescriptorHeaps(_countof(DescriptorHeaps), DescriptorHeaps);
+}
+
+void CD3D12RHICommandList::ResourceBarrier(CRHIResource* Resource, ERHIResourceState Before, ERHIResourceState After)
+{
+	CD3DX12_RESOURCE_BARRIER Barrier = CD3DX12_RESOURCE_BARRIER::Transition(static_cast<CD3D12RHIResource*>(Resource)->Resource,
+		CD3D12RHIDevice::GetResourceState(Before), CD3D12RHIDevice::GetResourceState(After));
+	CommandList->ResourceBarrier(1, &Barrier);
+	RecordedStats.Barriers++;
+}
+
+void CD3D12RHICommandList::SetRenderTarget(CRHIResource* RenderTarget)
+{
+	const D3D12_CPU_DESCRIPTOR_HANDLE RTVHandle = static_cast<CD3D12RHIResource*>(RenderTarget)->RTVHandle;
+	const D3D12_CPU_DESCRIPTOR_HANDLE DepthStencilHandle = Device->DepthStencilDescriptorHeap->GetCPUDescriptorHandleForHeapStart();
+
+	CommandList->OMSetRenderTargets(1, &RTVHandle, false, &DepthStencilHandle);
+}
+
+void CD3D12RHICommandList::ClearRenderTarget(CRHIResource* RenderTarget, const float Color[4])
+{
+	CommandList->ClearRenderTargetView(static_cast<CD3D12RHIResource*>(RenderTarget)->RTVHandle, Color, 0, nullptr);
+}
+
+void CD3D12RHICommandList::ClearDepth(float Depth)
+{
+	CommandList->ClearDepthStencilView(Device->DepthStencilDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), D3D12_CLEAR_FLAG_DEPTH, Depth, 0, 0, nullptr);
+}
+
+void CD3D12RHICommandList::SetViewport(const RHIViewport& Viewport)
+{
+	D3D12_VIEWPORT D3DViewport = { Viewport.TopLeftX, Viewport.TopLeftY, Viewport.Width, Viewport.Height, Viewport.MinDepth, Viewport.MaxDepth };
+	CommandList->RSSetViewports(1, &D3DViewport);
+}
+
+void CD3D12RHICommandList::SetScissorRect(const RHIRect& Rect)
+{
+	D3D12_RECT D3DRect = { Rect.Left, Rect.Top, Rect.Right, Rect.Bottom };
+	CommandList->RSSetScissorRects(1, &D3DRect);
+}
+
+void CD3D12RHICommandList::SetPipelineState(CRHIPipelineState* PipelineState)
+{
+	CommandList->SetPipelineState(static_cast<CD3D12RHIPipelineState*>(PipelineState)->PSO);
+	RecordedStats.PipelineStateChanges++;
+}
+
+void CD3D12RHICommandList::SetGraphicsRootConstantBufferView(uint32_t RootParameterIndex, uint64_t GPUAddress)
+{
+	CommandList->SetGraphicsRootConstantBufferView(RootParameterIndex, GPUAddress);
+}
+
+void CD3D12RHICommandList::SetGraphicsRootTexture(uint32_t RootParameterIndex, CRHIResource* Texture)
+{
+	CommandList->SetGraphicsRootDescriptorTable(RootParameterIndex, static_cast<CD3D12RHIResource*>(Texture)->SRVHandle);
+	RecordedStats.DescriptorTableChanges++;
+}
+
+void CD3D12RHICommandList::SetPrimitiveTopology(ERHIPrimitiveTopology Topology)
+{
+	CommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+}
+
+void CD3D12RHICommandList::SetVertexBuffers(uint32_t StartSlot, uint32_t NumViews, const RHIVertexBufferView* Views)
+{
+	D3D12_VERTEX_BUFFER_VIEW D3DViews[D3D12_IA_VERTEX_INPUT_RESOURCE_SLOT_COUNT];
+	for (uint32_t i = 0; i < NumViews; ++i)
+	{
+		D3DViews[i].BufferLocation = Views[i].BufferLocation;
+		D3DViews[i].SizeInBytes = Views[i].SizeInBytes;
+		D3DViews[i].StrideInBytes = Views[i].StrideInBytes;
+	}
+	CommandList->IASetVertexBuffers(StartSlot, NumViews, D3DViews);
+	RecordedStats.VertexBufferChanges++;
+}
+
+void CD3D12RHICommandList::SetIndexBuffer(const RHIIndexBufferView& View)
+{
+	D3D12_INDEX_BUFFER_VIEW D3DView;
+	D3DView.BufferLocation = View.BufferLocation;
+	D3DView.SizeInBytes = View.SizeInBytes;
+	D3DView.Format = CD3D12RHIDevice::GetDXGIFormat(View.Format);
+	CommandList->IASetIndexBuffer(&D3DView);
+	RecordedStats.IndexBufferChanges++;
+}
+
+void CD3D12RHICommandList::DrawIndexedInstanced(uint32_t IndexCountPerInstance, uint32_t InstanceCount, uint32_t StartIndexLocation, int32_t BaseVertexLocation, uint32_t StartInstanceLocation)
+{
+	CommandList->DrawIndexedInstanced(IndexCountPerInstance, InstanceCount, StartIndexLocation, BaseVertexLocation, StartInstanceLocation);
+	RecordedStats.DrawCalls++;
+	RecordedStats.InstancesDrawn += InstanceCount;
+	RecordedStats.IndicesDrawn += uint64_t(IndexCountPerInstance) * InstanceCount;
+}
+
+void CD3D12RHICommandList::CopyBufferRegion(CRHIResource* Dest, uint64_t DestOffset, CRHIResource* Source, uint64_t SourceOffset, uint64_t NumBytes)
+{
+	CommandList->CopyBufferRegion(static_cast<CD3D12RHIResource*>(Dest)->Resource, DestOffset, static_cast<CD3D12RHIResource*>(Source)->Resource, SourceOffset, NumBytes);
+	RecordedStats.BytesCopied += NumBytes;
+}
+
+/* Device */
+
+void CD3D12RHICommandList::WriteTimestamp(CRHITimestampQueries* Queries, uint32_t Index)
+{
+	CD3D12RHITimestampQueries* D3DQueries = static_cast<CD3D12RHITimestampQueries*>(Queries);
+	CommandList->EndQuery(D3DQueries->QueryHeap, D3D12_QUERY_TYPE_TIMESTAMP, Index);
+	CommandList->ResolveQueryData(D3DQueries->QueryHeap, D3D12_QUERY_TYPE_TIMESTAMP, Index, 1, D3DQueries->ReadbackBuffer, Index * sizeof(uint64_t));
+}
+
+bool CD3D12RHIDevice::Init(const RHIDeviceDesc& Desc)
+{
+	HRESULT Hr;
+
+	// ----- Create the Device by going through the Graphics cards (adapters) and selecting one that has the required feature level -----
+	IDXGIFactory4* Factory;
+	Hr = CreateDXGIFactory1(IID_PPV_ARGS(&Factory));
+	if (FAILED(Hr))
+	{
+		MessageBox(0, L"Couldn't create a factory", 0, 0);
+		return false;
+	}
+
+	// Check to see if a copy of WinPixGpuCapturer.dll has already been injected into the application.
+	// This may happen if the application is launched through the PIX UI.
+	if (GetModuleHandle(L"WinPixGpuCapturer.dll") == 0)
+	{
+		LoadLibrary(GetLatestWinPixGpuCapturerPath().c_str());
+	}
+
+	IDXGIAdapter1* Adapter;
+	int AdapterIndex = 0;
+	bool bAdapterFound = false;
+
+	while (Factory->EnumAdapters1(AdapterIndex, &Adapter) != DXGI_ERROR_NOT_FOUND)
+	{
+		DXGI_ADAPTER_DESC1 AdapterDesc;
+		Adapter->GetDesc1(&AdapterDesc);
+
+		if (AdapterDesc.Flags & DXGI_ADAPTER_FLAG_SOFTWARE)
+		{
+			// This is a software device, not an actual graphics card
+			AdapterIndex++;
+			continue;
+		}
+
+		Hr = D3D12CreateDevice(Adapter, D3D_FEATURE_LEVEL_11_0, _uuidof(ID3D12Device), nullptr);
+		if (SUCCEEDED(Hr))
+		{
+			bAdapterFound = true;
+			break;
+		}
+
+		AdapterIndex++;
+	}
+
+	if (!bAdapterFound)
+	{
+		MessageBox(0, L"Didn't find an adapter", 0, 0);
+		return false;
+	}
+	OutputDebugString(L"Found an adapter\n");
+
+	Microsoft::WRL::ComPtr<ID3D12Debug> debugController;
+	if (SUCCEEDED(D3D12GetDebugInterface(IID_PPV_ARGS(&debugController))))
+	{
+		debugController->EnableDebugLayer();
+	}
+
+	// Create the Device
+	Hr = D3D12CreateDevice(Adapter, D3D_FEATURE_LEVEL_11_0,	IID_PPV_ARGS(&Device));
+	if (FAILED(Hr))
+	{
+		MessageBox(0, L"Couldn't create the device", 0, 0);
+		return false;
+	}
+	OutputDebugString(L"Device Created\n");
+
+	// Create the RTV Command Queue
+	D3D12_COMMAND_QUEUE_DESC CommandQueueDesc = {};
+	Hr = Device->CreateCommandQueue(&CommandQueueDesc, IID_PPV_ARGS(&CommandQueue));
+	if (FAILED(Hr))
+	{
+		MessageBox(0, L"Couldn't create the Command Queue", 0, 0);
+		return false;
+	}
+	OutputDebugString(L"Command Queue Created\n");
+
+	// Create the SwapChain
+	DXGI_MODE_DESC BackBufferDesc = {};
+	BackBufferDesc.Width = Desc.Width;
+	BackBufferDesc.Height = Desc.Height;
+	BackBufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+
+	DXGI_SAMPLE_DESC SampleDesc = {};
+	SampleDesc.Count = 1;
+
+	DXGI_SWAP_CHAIN_DESC SwapChainDesc = {};
+	SwapChainDesc.BufferCount = Desc.BackBufferCount;
+	SwapChainDesc.BufferDesc = BackBufferDesc;
+	SwapChainDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+	SwapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
+	SwapChainDesc.OutputWindow = static_cast<HWND>(Desc.WindowHandle);
+	SwapChainDesc.SampleDesc = SampleDesc;
+	SwapChainDesc.Windowed = !Desc.bFullScreen;
+
+	IDXGISwapChain* TempSwapChain;
+	Factory->CreateSwapChain(CommandQueue, &SwapChainDesc, &TempSwapChain);
+
+	SwapChain = static_cast<IDXGISwapChain3*>(TempSwapChain);
+	OutputDebugString(L"Swap Chain Created\n");
+
+	// Create the Descriptor Heap for the Back Buffers (Render Targets)
+	D3D12_DESCRIPTOR_HEAP_DESC RTVHeapDesc = {};
+	RTVHeapDesc.NumDescriptors = Desc.BackBufferCount;
+	RTVHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
+	RTVHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE; // Not shader visible
+
+	Hr = Device->CreateDescriptorHeap(&RTVHeapDesc, IID_PPV_ARGS(&RTVDescriptorHeap));
+	if (FAILED(Hr))
+	{
+		MessageBox(0, L"Couldn't create the RTV Descriptor Heap", 0, 0);
+		return false;
+	}
+
+	RTVDescriptorSize = Device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+
+	CD3DX12_CPU_DESCRIPTOR_HANDLE RTVHandle(RTVDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
+
+	for (int i = 0; i < Desc.BackBufferCount; ++i)
+	{
+		ID3D12Resource* BackBuffer;
+		Hr = SwapChain->GetBuffer(i, IID_PPV_ARGS(&BackBuffer));
+		if (FAILED(Hr))
+		{
+			MessageBox(0, L"Couldn't Get the Buffer", 0, 0);
+			return false;
+		}
+		Device->CreateRenderTargetView(BackBuffer, nullptr, RTVHandle);
+
+		CD3D12RHIResource* RenderTarget = new CD3D12RHIResource(BackBuffer, 0);
+		RenderTarget->RTVHandle = RTVHandle;
+		RenderTargets.push_back(RenderTarget);
+
+		RTVHandle.Offset(1, RTVDescriptorSize);
+	}
+	OutputDebugString(L"RTV Handles Created\n");
+
+	// Create the Root Signature
+	D3D12_ROOT_DESCRIPTOR RootDescriptor;
+	RootDescriptor.RegisterSpace = 0;
+	RootDescriptor.ShaderRegister = 0;
+
+	// Create the descriptor Range
+	D3D12_DESCRIPTOR_RANGE DescriptorTableRanges[1];
+	DescriptorTableRanges[0].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+	DescriptorTableRanges[0].NumDescriptors = 1;
+	DescriptorTableRanges[0].BaseShaderRegister = 0;
+	DescriptorTableRanges[0].RegisterSpace = 0;
+	DescriptorTableRanges[0].OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
+
+	// Create the descriptor Table
+	D3D12_ROOT_DESCRIPTOR_TABLE DescriptorTable;
+	DescriptorTable.NumDescriptorRanges = _countof(DescriptorTableRanges);
+	DescriptorTable.pDescriptorRanges = &DescriptorTableRanges[0];
+
+	D3D12_ROOT_PARAMETER RootParameters[2];
+	RootParameters[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
+	RootParameters[0].Descriptor = RootDescriptor;
+	RootParameters[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
+
+	RootParameters[1].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+	RootParameters[1].DescriptorTable = DescriptorTable;
+	RootParameters[1].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+
+	// Static Sampler
+	D3D12_STATIC_SAMPLER_DESC Sampler = {
+		D3D12_FILTER_COMPARISON_MIN_MAG_MIP_POINT, D3D12_TEXTURE_ADDRESS_MODE_BORDER, D3D12_TEXTURE_ADDRESS_MODE_BORDER,
+		D3D12_TEXTURE_ADDRESS_MODE_BORDER, 0, 0, D3D12_COMPARISON_FUNC_NEVER,
+		D3D12_STATIC_BORDER_COLOR_TRANSPARENT_BLACK, 0.0f, D3D12_FLOAT32_MAX, 0, 0, D3D12_SHADER_VISIBILITY_PIXEL
+	};
+
+	CD3DX12_ROOT_SIGNATURE_DESC RootSignatureDescriptor;
+	RootSignatureDescriptor.Init(_countof(RootParameters), RootParameters, 1, &Sampler,
+		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT |
+		D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS |
+		D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS |
+		D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS);
+
+	ID3DBlob* Signature = nullptr;
+	Hr = D3D12SerializeRootSignature(&RootSignatureDescriptor, D3D_ROOT_SIGNATURE_VERSION_1, &Signature, nullptr);
+	if (FAILED(Hr))
+	{
+		return false;
+	}
+
+	Hr = Device->CreateRootSignature(0, Signature->GetBufferPointer(), Signature->GetBufferSize(), IID_PPV_ARGS(&RootSignature));
+	if (FAILED(Hr))
+	{
+		return false;
+	}
+
+	// Depth / Stencil
+
+	// Create the Depth/Stencil descriptor heap
+	D3D12_DESCRIPTOR_HEAP_DESC DepthStencilViewHeapDesc = {};
+	DepthStencilViewHeapDesc.NumDescriptors = 1;
+	DepthStencilViewHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
+	DepthStencilViewHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+	Hr = Device->CreateDescriptorHeap(&DepthStencilViewHeapDesc, IID_PPV_ARGS(&DepthStencilDescriptorHeap));
+	if (FAILED(Hr))
+	{
+		return false;
+	}
+	DepthStencilDescriptorHeap->SetName(L"Depth/Stencil Resource Heap");
+
+	D3D12_DEPTH_STENCIL_VIEW_DESC DepthStencilDesc = {};
+	DepthStencilDesc.Format = DXGI_FORMAT_D32_FLOAT;
+	DepthStencilDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
+	DepthStencilDesc.Flags = D3D12_DSV_FLAG_NONE;
+
+	// the value we want when the depth/stencil is clear
+	D3D12_CLEAR_VALUE DepthClearValue = {};
+	DepthClearValue.Format = DXGI_FORMAT_D32_FLOAT;
+	DepthClearValue.DepthStencil.Depth = 1.0f;
+	DepthClearValue.DepthStencil.Stencil = 0;
+
+	CD3DX12_HEAP_PROPERTIES HeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+	CD3DX12_RESOURCE_DESC Texture = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_D32_FLOAT, Desc.Width, Desc.Height, 1, 0, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL);
+	Device->CreateCommittedResource(
+		&HeapProperties,
+		D3D12_HEAP_FLAG_NONE,
+		&Texture,
+		D3D12_RESOURCE_STATE_DEPTH_WRITE,
+		&DepthClearValue,
+		IID_PPV_ARGS(&DepthStencilBuffer)
+	);
+
+	Device->CreateDepthStencilView(DepthStencilBuffer, &DepthStencilDesc, DepthStencilDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
+
+	// Shader visible heap for the textures
+	D3D12_DESCRIPTOR_HEAP_DESC HeapDescriptor = {};
+	HeapDescriptor.NumDescriptors = D3D12RHI_MAX_TEXTURES;
+	HeapDescriptor.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+	HeapDescriptor.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+	Hr = Device->CreateDescriptorHeap(&HeapDescriptor, IID_PPV_ARGS(&MainDescriptorHeap));
+	if (FAILED(Hr))
+	{
+		return false;
+	}
+
+	SRVDescriptorSize = Device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+	return true;
+}
+
+void CD3D12RHIDevice::Shutdown()
+{
+	// Get SwapChain out of fullscreen before exiting
+	BOOL bFS = false;
+	if (SwapChain && SwapChain->GetFullscreenState(&bFS, nullptr))
+	{
+		SwapChain->SetFullscreenState(false, nullptr);
+	}
+
+	for (CD3D12RHIResource* RenderTarget : RenderTargets)
+	{
+		SAFE_RELEASE(RenderTarget);
+	}
+	RenderTargets.clear();
+
+	for (ID3D12Resource* UploadHeap : TextureUploadHeaps)
+	{
+		SAFE_RELEASE(UploadHeap);
+	}
+	TextureUploadHeaps.clear();
+
+	SAFE_RELEASE(SwapChain);
+	SAFE_RELEASE(CommandQueue);
+	SAFE_RELEASE(RTVDescriptorHeap);
+	SAFE_RELEASE(RootSignature);
+	SAFE_RELEASE(DepthStencilBuffer);
+	SAFE_RELEASE(DepthStencilDescriptorHeap);
+	SAFE_RELEASE(MainDescriptorHeap);
+	SAFE_RELEASE(Device);
+}
+
+CRHIResource* CD3D12RHIDevice::CreateBuffer(uint64_t Size, ERHIHeapType HeapType, ERHIResourceState InitialState, const wchar_t* Name)
+{
+	CD3DX12_HEAP_PROPERTIES HeapProperties = CD3DX12_HEAP_PROPERTIES(HeapType == ERHIHeapType::Upload ? D3D12_HEAP_TYPE_UPLOAD : D3D12_HEAP_TYPE_DEFAULT);
+	CD3DX12_RESOURCE_DESC BufferDesc = CD3DX12_RESOURCE_DESC::Buffer(Size);
+
+	ID3D12Resource* Buffer = nullptr;
+	HRESULT Hr = Device->CreateCommittedResource(
+		&HeapProperties,
+		D3D12_HEAP_FLAG_NONE,
+		&BufferDesc,
+		GetResourceState(InitialState),
+		nullptr,
+		IID_PPV_ARGS(&Buffer)
+	);
+	if (FAILED(Hr))
+	{
+		return nullptr;
+	}
+
+	if (Name)
+	{
+		Buffer->SetName(Name);
+	}
+	return new CD3D12RHIResource(Buffer, Size);
+}
+
+CRHIResource* CD3D12RHIDevice::CreateTextureFromFile(const wchar_t* Filename, CRHICommandList* CommandList)
+{
+	if (NumTextures >= D3D12RHI_MAX_TEXTURES)
+	{
+		OutputDebugString(L"The texture descriptor heap is full\n");
+		return nullptr;
+	}
+
+	// Load the image from a file
+	D3D12_RESOURCE_DESC TextureDescriptor = {};
+	int ImageBytesPerRow = 0;
+	BYTE* ImageData;
+	int ImageSize = LoadImageDataFromFile(&ImageData, TextureDescriptor, Filename, ImageBytesPerRow);
+
+	if (ImageSize <= 0)
+	{
+		OutputDebugString(L"ImageSize is not valid\n");
+		return nullptr;
+	}
+
+	ID3D12Resource* TextureBuffer;
+	CD3DX12_HEAP_PROPERTIES TextureHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+	HRESULT Hr = Device->CreateCommittedResource(&TextureHeapProperties, D3D12_HEAP_FLAG_NONE, &TextureDescriptor,
+	                                     D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&TextureBuffer));
+	if (FAILED(Hr))
+	{
+		return nullptr;
+	}
+	TextureBuffer->SetName(L"Texture Buffer resource Heap");
+
+	// Upload heap to upload the texture
+	UINT64 TextureUploadBufferSize;
+	Device->GetCopyableFootprints(&TextureDescriptor, 0, 1, 0, nullptr, nullptr, nullptr, &TextureUploadBufferSize);
+
+	ID3D12Resource* TextureBufferUploadHeap;
+	CD3DX12_HEAP_PROPERTIES TextureUploadHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+	CD3DX12_RESOURCE_DESC TextureUploadHeapResourceDescriptor = CD3DX12_RESOURCE_DESC::Buffer(TextureUploadBufferSize);
+	Hr = Device->CreateCommittedResource(&TextureUploadHeapProperties, D3D12_HEAP_FLAG_NONE,
+	                                     &TextureUploadHeapResourceDescriptor, D3D12_RESOURCE_STATE_GENERIC_READ,
+	                                     nullptr, IID_PPV_ARGS(&TextureBufferUploadHeap));
+	if (FAILED(Hr))
+	{
+		SAFE_RELEASE(TextureBuffer);
+		return nullptr;
+	}
+	TextureBufferUploadHeap->SetName(L"Texture Buffer Upload Resource Heap");
+	TextureUploadHeaps.push_back(TextureBufferUploadHeap);
+
+	// Store the texture in an upload heap
+	D3D12_SUBRESOURCE_DATA TextureData = {};
+	TextureData.pData = &ImageData[0];
+	TextureData.RowPitch = ImageBytesPerRow;
+	TextureData.SlicePitch = ImageBytesPerRow * TextureDescriptor.Height;
+
+	ID3D12GraphicsCommandList* D3DCommandList = static_cast<CD3D12RHICommandList*>(CommandList)->CommandList;
+	UpdateSubresources(D3DCommandList, TextureBuffer, TextureBufferUploadHeap, 0, 0, 1, &TextureData);
+	CD3DX12_RESOURCE_BARRIER Barrier = CD3DX12_RESOURCE_BARRIER::Transition(TextureBuffer, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+	D3DCommandList->ResourceBarrier(1, &Barrier);
+	TrackUpload(TextureData.SlicePitch);
+
+	// Create the shader resource view
+	D3D12_SHADER_RESOURCE_VIEW_DESC SrvDesc = {};
+	SrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	SrvDesc.Format = TextureDescriptor.Format;
+	SrvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+	SrvDesc.Texture2D.MipLevels = 1;
+	CD3DX12_CPU_DESCRIPTOR_HANDLE SRVCPUHandle(MainDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), NumTextures, SRVDescriptorSize);
+	Device->CreateShaderResourceView(TextureBuffer, &SrvDesc, SRVCPUHandle);
+
+	CD3D12RHIResource* Texture = new CD3D12RHIResource(TextureBuffer, ImageSize);
+	Texture->SRVHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(MainDescriptorHeap->GetGPUDescriptorHandleForHeapStart(), NumTextures, SRVDescriptorSize);
+	NumTextures++;
+
+	// We can delete the image data now that it's in the upload heap
+	free(ImageData);
+
+	return Texture;
+}
+
+CRHIPipelineState* CD3D12RHIDevice::CreatePipelineState(const RHIPipelineStateDesc& Desc)
+{
+	HRESULT Hr;
+
+	// Create the Vertex and Pixel Shader
+	ID3DBlob* VertexShader;
+	ID3DBlob* ErrorBuffer;
+	Hr = D3DCompileFromFile(Desc.VertexShaderFile, nullptr, nullptr, "main", "vs_5_0", D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION, 0, &VertexShader, &ErrorBuffer);
+	if (FAILED(Hr))
+	{
+		OutputDebugStringA((char*)ErrorBuffer->GetBufferPointer());
+		return nullptr;
+	}
+
+	D3D12_SHADER_BYTECODE VertexShaderBytecode = {};
+	VertexShaderBytecode.BytecodeLength = VertexShader->GetBufferSize();
+	VertexShaderBytecode.pShaderBytecode = VertexShader->GetBufferPointer();
+
+	ID3DBlob* PixelShader;
+	Hr = D3DCompileFromFile(Desc.PixelShaderFile, nullptr, nullptr, "main", "ps_5_0", D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION, 0, &PixelShader, &ErrorBuffer);
+	if (FAILED(Hr))
+	{
+		OutputDebugStringA((char*)ErrorBuffer->GetBufferPointer());
+		return nullptr;
+	}
+
+	D3D12_SHADER_BYTECODE PixelShaderBytecode = {};
+	PixelShaderBytecode.BytecodeLength = PixelShader->GetBufferSize();
+	PixelShaderBytecode.pShaderBytecode = PixelShader->GetBufferPointer();
+
+	// Create an input layout
+	std::vector<D3D12_INPUT_ELEMENT_DESC> InputLayout(Desc.NumInputElements);
+	for (uint32_t i = 0; i < Desc.NumInputElements; ++i)
+	{
+		const RHIInputElement& Element = Desc.InputElements[i];
+		InputLayout[i].SemanticName = Element.SemanticName;
+		InputLayout[i].SemanticIndex = Element.SemanticIndex;
+		InputLayout[i].Format = GetDXGIFormat(Element.Format);
+		InputLayout[i].InputSlot = Element.InputSlot;
+		InputLayout[i].AlignedByteOffset = Element.AlignedByteOffset;
+		InputLayout[i].InputSlotClass = Element.Classification == ERHIInputClassification::PerInstance ? D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA : D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA;
+		InputLayout[i].InstanceDataStepRate = Element.InstanceDataStepRate;
+	}
+
+	D3D12_INPUT_LAYOUT_DESC InputLayoutDesc = {};
+	InputLayoutDesc.NumElements = Desc.NumInputElements;
+	InputLayoutDesc.pInputElementDescs = InputLayout.data();
+
+	DXGI_SAMPLE_DESC SampleDesc = {};
+	SampleDesc.Count = 1;
+
+	// Create a PSO
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC PSODesc = {};
+	PSODesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT); // default depth/stencil state
+	PSODesc.InputLayout = InputLayoutDesc;
+	PSODesc.pRootSignature = RootSignature;
+	PSODesc.VS = VertexShaderBytecode;
+	PSODesc.PS = PixelShaderBytecode;
+	PSODesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+	PSODesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+	PSODesc.SampleDesc = SampleDesc;
+	PSODesc.SampleMask = 0xffffffff;
+	PSODesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+	PSODesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+	PSODesc.NumRenderTargets = 1;
+
+	CD3D12RHIPipelineState* PipelineState = new CD3D12RHIPipelineState;
+	Hr = Device->CreateGraphicsPipelineState(&PSODesc, IID_PPV_ARGS(&PipelineState->PSO));
+	if (FAILED(Hr))
+	{
+		SAFE_RELEASE(PipelineState);
+		return nullptr;
+	}
+
+	return PipelineState;
+}
+
+CRHICommandAllocator* CD3D12RHIDevice::CreateCommandAllocator()
+{
+	CD3D12RHICommandAllocator* CommandAllocator = new CD3D12RHICommandAllocator;
+	HRESULT Hr = Device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&CommandAllocator->Allocator));
+	if (FAILED(Hr))
+	{
+		MessageBox(0, L"Couldn't Create the Command Allocator", 0, 0);
+		SAFE_RELEASE(CommandAllocator);
+		return nullptr;
+	}
+	return CommandAllocator;
+}
+
+CRHICommandList* CD3D12RHIDevice::CreateCommandList(CRHICommandAllocator* Allocator)
+{
+	CD3D12RHICommandList* CommandList = new CD3D12RHICommandList(this);
+	HRESULT Hr = Device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, static_cast<CD3D12RHICommandAllocator*>(Allocator)->Allocator, NULL, IID_PPV_ARGS(&CommandList->CommandList));
+	if (FAILED(Hr))
+	{
+		MessageBox(0, L"Couldn't Create the Command List", 0, 0);
+		SAFE_RELEASE(CommandList);
+		return nullptr;
+	}
+
+	CommandList->SetSharedState();
+	return CommandList;
+}
+
+CRHIFence* CD3D12RHIDevice::CreateFence(uint64_t InitialValue)
+{
+	CD3D12RHIFence* Fence = new CD3D12RHIFence;
+	HRESULT Hr = Device->CreateFence(InitialValue, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&Fence->Fence));
+	if (FAILED(Hr))
+	{
+		MessageBox(0, L"Couldn't Create the Fence", 0, 0);
+		SAFE_RELEASE(Fence);
+		return nullptr;
+	}
+
+	Fence->FenceEvent = CreateEvent(nullptr, false, false, nullptr);
+	if (!Fence->FenceEvent)
+	{
+		MessageBox(0, L"Couldn't Create the Fence Event", 0, 0);
+		SAFE_RELEASE(Fence);
+		return nullptr;
+	}
+	return Fence;
+}
+
+CRHITimestampQueries* CD3D12RHIDevice::CreateTimestampQueries(uint32_t Count)
+{
+	CD3D12RHITimestampQueries* Queries = new CD3D12RHITimestampQueries;
+
+	D3D12_QUERY_HEAP_DESC QueryHeapDesc = {};
+	QueryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+	QueryHeapDesc.Count = Count;
+	HRESULT Hr = Device->CreateQueryHeap(&QueryHeapDesc, IID_PPV_ARGS(&Queries->QueryHeap));
+	if (FAILED(Hr))
+	{
+		MessageBox(0, L"Couldn't Create the Timestamp Query Heap", 0, 0);
+		SAFE_RELEASE(Queries);
+		return nullptr;
+	}
+
+	CD3DX12_HEAP_PROPERTIES ReadbackHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK);
+	CD3DX12_RESOURCE_DESC ReadbackDesc = CD3DX12_RESOURCE_DESC::Buffer(Count * sizeof(uint64_t));
+	Hr = Device->CreateCommittedResource(&ReadbackHeapProperties, D3D12_HEAP_FLAG_NONE, &ReadbackDesc,
+		D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&Queries->ReadbackBuffer));
+	if (FAILED(Hr))
+	{
+		MessageBox(0, L"Couldn't Create the Timestamp Readback Buffer", 0, 0);
+		SAFE_RELEASE(Queries);
+		return nullptr;
+	}
+	Queries->ReadbackBuffer->SetName(L"Timestamp Readback Buffer");
+
+	// The QPC value is what std::chrono::high_resolution_clock counts on Windows, RHINowMs and the timestamps then agree
+	UINT64 Frequency = 1;
+	UINT64 CPUTicks = 0;
+	LARGE_INTEGER CPUFrequency;
+	QueryPerformanceFrequency(&CPUFrequency);
+	if (FAILED(CommandQueue->GetTimestampFrequency(&Frequency)) || FAILED(CommandQueue->GetClockCalibration(&Queries->CalibrationTicks, &CPUTicks)))
+	{
+		MessageBox(0, L"Couldn't Calibrate the GPU Clock", 0, 0);
+		SAFE_RELEASE(Queries);
+		return nullptr;
+	}
+	Queries->CalibrationMs = double(CPUTicks) * 1000.0 / double(CPUFrequency.QuadPart);
+	Queries->TicksPerMs = double(Frequency) / 1000.0;
+	return Queries;
+}
+
+void CD3D12RHIDevice::ExecuteCommandLists(uint32_t NumCommandLists, CRHICommandList* const* CommandLists)
+{
+	const double StartMs = RHINowMs();
+
+	std::vector<ID3D12CommandList*> D3DCommandLists(NumCommandLists);
+	for (uint32_t i = 0; i < NumCommandLists; ++i)
+	{
+		CD3D12RHICommandList* CommandList = static_cast<CD3D12RHICommandList*>(CommandLists[i]);
+		D3DCommandLists[i] = CommandList->CommandList;
+
+		// What the list recorded counts once it is executed, like on the Null backend
+		const RHIStats& Recorded = CommandList->RecordedStats;
+		Stats.DrawCalls += Recorded.DrawCalls;
+		Stats.InstancesDrawn += Recorded.InstancesDrawn;
+		Stats.IndicesDrawn += Recorded.IndicesDrawn;
+		Stats.PipelineStateChanges += Recorded.PipelineStateChanges;
+		Stats.DescriptorTableChanges += Recorded.DescriptorTableChanges;
+		Stats.VertexBufferChanges += Recorded.VertexBufferChanges;
+		Stats.IndexBufferChanges += Recorded.IndexBufferChanges;
+		Stats.Barriers += Recorded.Barriers;
+		Stats.BytesCopied += Recorded.BytesCopied;
+		Stats.RecordTimeMs += Recorded.RecordTimeMs;
+		CommandList->RecordedStats = RHIStats();
+	}
+	CommandQueue->ExecuteCommandLists(NumCommandLists, D3DCommandLists.data());
+	Stats.CommandListsExecuted += NumCommandLists;
+	Stats.SubmitTimeMs += RHINowMs() - StartMs;
+}
+
+bool CD3D12RHIDevice::Signal(CRHIFence* Fence, uint64_t Value)
+{
+	Stats.FenceSignals++;
+	return SUCCEEDED(CommandQueue->Signal(static_cast<CD3D12RHIFence*>(Fence)->Fence, Value));
+}
+
+bool CD3D12RHIDevice::Present()
+{
+	Stats.Presents++;
+	return SUCCEEDED(SwapChain->Present(0, 0));
+}
+
+// get the dxgi format equivilent of a wic format
+DXGI_FORMAT CD3D12RHIDevice::GetDXGIFormatFromWICFormat(WICPixelFormatGUID& WicFormatGUID)
+{
+    if (WicFormatGUID == GUID_WICPixelFormat128bppRGBAFloat) return DXGI_FORMAT_R32G32B32A32_FLOAT;
+    if (WicFormatGUID == GUID_WICPixelFormat64bppRGBAHalf) return DXGI_FORMAT_R16G16B16A16_FLOAT;
+    if (WicFormatGUID == GUID_WICPixelFormat64bppRGBA) return DXGI_FORMAT_R16G16B16A16_UNORM;
+    if (WicFormatGUID == GUID_WICPixelFormat32bppRGBA) return DXGI_FORMAT_R8G8B8A8_UNORM;
+    if (WicFormatGUID == GUID_WICPixelFormat32bppBGRA) return DXGI_FORMAT_B8G8R8A8_UNORM;
+    if (WicFormatGUID == GUID_WICPixelFormat32bppBGR) return DXGI_FORMAT_B8G8R8X8_UNORM;
+    if (WicFormatGUID == GUID_WICPixelFormat32bppRGBA1010102XR) return DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM;
+
+    if (WicFormatGUID == GUID_WICPixelFormat32bppRGBA1010102) return DXGI_FORMAT_R10G10B10A2_UNORM;
+    if (WicFormatGUID == GUID_WICPixelFormat16bppBGRA5551) return DXGI_FORMAT_B5G5R5A1_UNORM;
+    if (WicFormatGUID == GUID_WICPixelFormat16bppBGR565) return DXGI_FORMAT_B5G6R5_UNORM;
+    if (WicFormatGUID == GUID_WICPixelFormat32bppGrayFloat) return DXGI_FORMAT_R32_FLOAT;
+    if (WicFormatGUID == GUID_WICPixelFormat16bppGrayHalf) return DXGI_FORMAT_R16_FLOAT;
+    if (WicFormatGUID == GUID_WICPixelFormat16bppGray) return DXGI_FORMAT_R16_UNORM;
+    if (WicFormatGUID == GUID_WICPixelFormat8bppGray) return DXGI_FORMAT_R8_UNORM;
+    if (WicFormatGUID == GUID_WICPixelFormat8bppAlpha) return DXGI_FORMAT_A8_UNORM;
+
+    return DXGI_FORMAT_UNKNOWN;
+}
+
+// get a dxgi compatible wic format from another wic format
+WICPixelFormatGUID CD3D12RHIDevice::GetConvertToWICFormat(WICPixelFormatGUID& WicFormatGUID)
+{
+    if (WicFormatGUID == GUID_WICPixelFormatBlackWhite) return GUID_WICPixelFormat8bppGray;
+    if (WicFormatGUID == GUID_WICPixelFormat1bppIndexed) return GUID_WICPixelFormat32bppRGBA;
+    if (WicFormatGUID == GUID_WICPixelFormat2bppIndexed) return GUID_WICPixelFormat32bppRGBA;
+    if (WicFormatGUID == GUID_WICPixelFormat4bppIndexed) return GUID_WICPixelFormat32bppRGBA;
+    if (WicFormatGUID == GUID_WICPixelFormat8bppIndexed) return GUID_WICPixelFormat32bppRGBA;
+    if (WicFormatGUID == GUID_WICPixelFormat2bppGray) return GUID_WICPixelFormat8bppGray;
+    if (WicFormatGUID == GUID_WICPixelFormat4bppGray) return GUID_WICPixelFormat8bppGray;
+    if (WicFormatGUID == GUID_WICPixelFormat16bppGrayFixedPoint) return GUID_WICPixelFormat16bppGrayHalf;
+    if (WicFormatGUID == GUID_WICPixelFormat32bppGrayFixedPoint) return GUID_WICPixelFormat32bppGrayFloat;
+    if (WicFormatGUID == GUID_WICPixelFormat16bppBGR555) return GUID_WICPixelFormat16bppBGRA5551;
+    if (WicFormatGUID == GUID_WICPixelFormat32bppBGR101010) return GUID_WICPixelFormat32bppRGBA1010102;
+    if (WicFormatGUID == GUID_WICPixelFormat24bppBGR) return GUID_WICPixelFormat32bppRGBA;
+    if (WicFormatGUID == GUID_WICPixelFormat24bppRGB) return GUID_WICPixelFormat32bppRGBA;
+    if (WicFormatGUID == GUID_WICPixelFormat32bppPBGRA) return GUID_WICPixelFormat32bppRGBA;
+    if (WicFormatGUID == GUID_WICPixelFormat32bppPRGBA) return GUID_WICPixelFormat32bppRGBA;
+    if (WicFormatGUID == GUID_WICPixelFormat48bppRGB) return GUID_WICPixelFormat64bppRGBA;
+    if (WicFormatGUID == GUID_WICPixelFormat48bppBGR) return GUID_WICPixelFormat64bppRGBA;
+    if (WicFormatGUID == GUID_WICPixelFormat64bppBGRA) return GUID_WICPixelFormat64bppRGBA;
+    if (WicFormatGUID == GUID_WICPixelFormat64bppPRGBA) return GUID_WICPixelFormat64bppRGBA;
+    if (WicFormatGUID == GUID_WICPixelFormat64bppPBGRA) return GUID_WICPixelFormat64bppRGBA;
+    if (WicFormatGUID == GUID_WICPixelFormat48bppRGBFixedPoint) return GUID_WICPixelFormat64bppRGBAHalf;
+    if (WicFormatGUID == GUID_WICPixelFormat48bppBGRFixedPoint) return GUID_WICPixelFormat64bppRGBAHalf;
+    if (WicFormatGUID == GUID_WICPixelFormat64bppRGBAFixedPoint) return GUID_WICPixelFormat64bppRGBAHalf;
+    if (WicFormatGUID == GUID_WICPixelFormat64bppBGRAFixedPoint) return GUID_WICPixelFormat64bppRGBAHalf;
+    if (WicFormatGUID == GUID_WICPixelFormat64bppRGBFixedPoint) return GUID_WICPixelFormat64bppRGBAHalf;
+    if (WicFormatGUID == GUID_WICPixelFormat64bppRGBHalf) return GUID_WICPixelFormat64bppRGBAHalf;
+    if (WicFormatGUID == GUID_WICPixelFormat48bppRGBHalf) return GUID_WICPixelFormat64bppRGBAHalf;
+    if (WicFormatGUID == GUID_WICPixelFormat128bppPRGBAFloat) return GUID_WICPixelFormat128bppRGBAFloat;
+    if (WicFormatGUID == GUID_WICPixelFormat128bppRGBFloat) return GUID_WICPixelFormat128bppRGBAFloat;
+    if (WicFormatGUID == GUID_WICPixelFormat128bppRGBAFixedPoint) return GUID_WICPixelFormat128bppRGBAFloat;
+    if (WicFormatGUID == GUID_WICPixelFormat128bppRGBFixedPoint) return GUID_WICPixelFormat128bppRGBAFloat;
+    if (WicFormatGUID == GUID_WICPixelFormat32bppRGBE) return GUID_WICPixelFormat128bppRGBAFloat;
+    if (WicFormatGUID == GUID_WICPixelFormat32bppCMYK) return GUID_WICPixelFormat32bppRGBA;
+    if (WicFormatGUID == GUID_WICPixelFormat64bppCMYK) return GUID_WICPixelFormat64bppRGBA;
+    if (WicFormatGUID == GUID_WICPixelFormat40bppCMYKAlpha) return GUID_WICPixelFormat64bppRGBA;
+    if (WicFormatGUID == GUID_WICPixelFormat80bppCMYKAlpha) return GUID_WICPixelFormat64bppRGBA;
+
+#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8) || defined(_WIN7_PLATFORM_UPDATE)
+    if (WicFormatGUID == GUID_WICPixelFormat32bppRGB) return GUID_WICPixelFormat32bppRGBA;
+    if (WicFormatGUID == GUID_WICPixelFormat64bppRGB) return GUID_WICPixelFormat64bppRGBA;
+    if (WicFormatGUID == GUID_WICPixelFormat64bppPRGBAHalf) return GUID_WICPixelFormat64bppRGBAHalf;
+#endif
+
+    return GUID_WICPixelFormatDontCare;
+}
+
+// get the number of bits per pixel for a dxgi format
+int CD3D12RHIDevice::GetDXGIFormatBitsPerPixel(DXGI_FORMAT& DxgiFormat)
+{
+    if (DxgiFormat == DXGI_FORMAT_R32G32B32A32_FLOAT) return 128;
+    if (DxgiFormat == DXGI_FORMAT_R16G16B16A16_FLOAT) return 64;
+    if (DxgiFormat == DXGI_FORMAT_R16G16B16A16_UNORM) return 64;
+    if (DxgiFormat == DXGI_FORMAT_R8G8B8A8_UNORM) return 32;
+    if (DxgiFormat == DXGI_FORMAT_B8G8R8A8_UNORM) return 32;
+    if (DxgiFormat == DXGI_FORMAT_B8G8R8X8_UNORM) return 32;
+    if (DxgiFormat == DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM) return 32;
+
+    if (DxgiFormat == DXGI_FORMAT_R10G10B10A2_UNORM) return 32;
+    if (DxgiFormat == DXGI_FORMAT_B5G5R5A1_UNORM) return 16;
+    if (DxgiFormat == DXGI_FORMAT_B5G6R5_UNORM) return 16;
+    if (DxgiFormat == DXGI_FORMAT_R32_FLOAT) return 32;
+    if (DxgiFormat == DXGI_FORMAT_R16_FLOAT) return 16;
+    if (DxgiFormat == DXGI_FORMAT_R16_UNORM) return 16;
+    if (DxgiFormat == DXGI_FORMAT_R8_UNORM) return 8;
+    if (DxgiFormat == DXGI_FORMAT_A8_UNORM) return 8;
+	return 0;
+}
+
+// load and decode image from file
+int CD3D12RHIDevice::LoadImageDataFromFile(BYTE** ImageData, D3D12_RESOURCE_DESC& ResourceDescription, LPCWSTR Filename, int& BytesPerRow)
+{
+    HRESULT Hr;
+
+    // we only need one instance of the imaging factory to create decoders and frames
+    static IWICImagingFactory* WicFactory;
+
+    // reset decoder, frame and converter since these will be different for each image we load
+    IWICBitmapDecoder* WicDecoder = NULL;
+    IWICBitmapFrameDecode* WicFrame = NULL;
+    IWICFormatConverter* WicConverter = NULL;
+
+    bool bImageConverted = false;
+
+    if (WicFactory == NULL)
+    {
+        // Initialize the COM library
+        CoInitialize(NULL);
+
+        // create the WIC factory
+        Hr = CoCreateInstance(
+            CLSID_WICImagingFactory,
+            NULL,
+            CLSCTX_INPROC_SERVER,
+            IID_PPV_ARGS(&WicFactory)
+        );
+        if (FAILED(Hr)) return 0;
+    }
+
+    // load a decoder for the image
+    Hr = WicFactory->CreateDecoderFromFilename(
+        Filename,                        // Image we want to load in
+        NULL,                            // This is a vendor ID, we do not prefer a specific one so set to null
+        GENERIC_READ,                    // We want to read from this file
+        WICDecodeMetadataCacheOnLoad,    // We will cache the metadata right away, rather than when needed, which might be unknown
+        &WicDecoder                      // the wic decoder to be created
+    );
+    if (FAILED(Hr)) return 0;
+
+    // get image from decoder (this will decode the "frame")
+    Hr = WicDecoder->GetFrame(0, &WicFrame);
+    if (FAILED(Hr)) return 0;
+
+    // get wic pixel format of image
+    WICPixelFormatGUID PixelFormat;
+    Hr = WicFrame->GetPixelFormat(&PixelFormat);
+    if (FAILED(Hr)) return 0;
+
+    // get size of image
+    UINT TextureWidth, TextureHeight;
+    Hr = WicFrame->GetSize(&TextureWidth, &TextureHeight);
+    if (FAILED(Hr)) return 0;
+
+    // we are not handling sRGB types in this tutorial, so if you need that support, you'll have to figure
+    // out how to implement the support yourself
+
+    // convert wic pixel format to dxgi pixel format
+    DXGI_FORMAT DxgiFormat = GetDXGIFormatFromWICFormat(PixelFormat);
+
+    // if the format of the image is not a supported dxgi format, try to convert it
+    if (DxgiFormat == DXGI_FORMAT_UNKNOWN)
+    {
+        // get a dxgi compatible wic format from the current image format
+        WICPixelFormatGUID ConvertToPixelFormat = GetConvertToWICFormat(PixelFormat);
+
+        // return if no dxgi compatible format was found
+        if (ConvertToPixelFormat == GUID_WICPixelFormatDontCare) return 0;
+
+        // set the dxgi format
+        DxgiFormat = GetDXGIFormatFromWICFormat(ConvertToPixelFormat);
+
+        // create the format converter
+        Hr = WicFactory->CreateFormatConverter(&WicConverter);
+        if (FAILED(Hr)) return 0;
+
+        // make sure we can convert to the dxgi compatible format
+        BOOL bCanConvert = FALSE;
+        Hr = WicConverter->CanConvert(PixelFormat, ConvertToPixelFormat, &bCanConvert);
+        if (FAILED(Hr) || !bCanConvert) return 0;
+
+        // do the conversion (wicConverter will contain the converted image)
+        Hr = WicConverter->Initialize(WicFrame, ConvertToPixelFormat, WICBitmapDitherTypeErrorDiffusion, 0, 0, WICBitmapPaletteTypeCustom);
+        if (FAILED(Hr)) return 0;
+
+        // this is so we know to get the image data from the wicConverter (otherwise we will get from wicFrame)
+        bImageConverted = true;
+    }
+
+    int BitsPerPixel = GetDXGIFormatBitsPerPixel(DxgiFormat); // number of bits per pixel
+    BytesPerRow = (TextureWidth * BitsPerPixel) / 8; // number of bytes in each row of the image data
+    int ImageSize = BytesPerRow * TextureHeight; // total image size in bytes
+
+    // allocate enough memory for the raw image data, and set imageData to point to that memory
+    *ImageData = (BYTE*)malloc(ImageSize);
+
+    // copy (decoded) raw image data into the newly allocated memory (imageData)
+    if (bImageConverted)
+    {
+        // if image format needed to be converted, the wic converter will contain the converted image
+        Hr = WicConverter->CopyPixels(0, BytesPerRow, ImageSize, *ImageData);
+        if (FAILED(Hr)) return 0;
+    }
+    else
+    {
+        // no need to convert, just copy data from the wic frame
+        Hr = WicFrame->CopyPixels(0, BytesPerRow, ImageSize, *ImageData);
+        if (FAILED(Hr)) return 0;
+    }
+
+    // now describe the texture with the information we have obtained from the image
+    ResourceDescription = {};
+    ResourceDescription.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+    ResourceDescription.Alignment = 0; // may be 0, 4KB, 64KB, or 4MB. 0 will let runtime decide between 64KB and 4MB (4MB for multi-sampled textures)
+    ResourceDescription.Width = TextureWidth; // width of the texture
+    ResourceDescription.Height = TextureHeight; // height of the texture
+    ResourceDescription.DepthOrArraySize = 1; // if 3d image, depth of 3d image. Otherwise an array of 1D or 2D textures (we only have one image, so we set 1)
+    ResourceDescription.MipLevels = 1; // Number of mipmaps. We are not generating mipmaps for this texture, so we have only one level
+    ResourceDescription.Format = DxgiFormat; // This is the dxgi format of the image (format of the pixels)
+    ResourceDescription.SampleDesc.Count = 1; // This is the number of samples per pixel, we just want 1 sample
+    ResourceDescription.SampleDesc.Quality = 0; // The quality level of the samples. Higher is better quality, but worse performance
+    ResourceDescription.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN; // The arrangement of the pixels. Setting to unknown lets the driver choose the most efficient one
+    ResourceDescription.Flags = D3D12_RESOURCE_FLAG_NONE; // no flags
+
+    // return the size of the image. remember to delete the image once your done with it (in this tutorial once its uploaded to the gpu)
+    return ImageSize;
+}
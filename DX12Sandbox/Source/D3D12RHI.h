@@ -0,0 +1,270 @@
+#pragma once
+#include "pch.h"
+#include "RHI.h"
+#include <wincodec.h>
+#include <vector>
+
+// Number of SRVs the shader visible descriptor heap can hold
+#define D3D12RHI_MAX_TEXTURES 64
+
+class CD3D12RHIDevice;
+
+class CD3D12RHIResource : public CRHIResource
+{
+public:
+	CD3D12RHIResource(ID3D12Resource* InResource, uint64_t InSize)
+		: Resource(InResource), Size(InSize)
+	{
+	}
+
+	~CD3D12RHIResource()
+	{
+		SAFE_RELEASE(Resource);
+	}
+
+	uint64_t GetGPUVirtualAddress() const override
+	{
+		return Resource->GetGPUVirtualAddress();
+	}
+
+	uint64_t GetSize() const override
+	{
+		return Size;
+	}
+
+	void* Map() override;
+
+	void Unmap() override;
+
+	ID3D12Resource* Resource;
+
+	uint64_t Size;
+
+	// RTV of the back buffers
+	D3D12_CPU_DESCRIPTOR_HANDLE RTVHandle = {};
+
+	// SRV of the textures in the shader visible heap
+	D3D12_GPU_DESCRIPTOR_HANDLE SRVHandle = {};
+};
+
+class CD3D12RHIPipelineState : public CRHIPipelineState
+{
+public:
+	~CD3D12RHIPipelineState()
+	{
+		SAFE_RELEASE(PSO);
+	}
+
+	ID3D12PipelineState* PSO = nullptr;
+};
+
+class CD3D12RHICommandAllocator : public CRHICommandAllocator
+{
+public:
+	~CD3D12RHICommandAllocator()
+	{
+		SAFE_RELEASE(Allocator);
+	}
+
+	bool Reset() override
+	{
+		return SUCCEEDED(Allocator->Reset());
+	}
+
+	ID3D12CommandAllocator* Allocator = nullptr;
+};
+
+class CD3D12RHIFence : public CRHIFence
+{
+public:
+	~CD3D12RHIFence();
+
+	uint64_t GetCompletedValue() const override
+	{
+		return Fence->GetCompletedValue();
+	}
+
+	bool Wait(uint64_t Value) override;
+
+	ID3D12Fence* Fence = nullptr;
+
+	// Handle to an event for our fence
+	HANDLE FenceEvent = nullptr;
+};
+
+class CD3D12RHITimestampQueries : public CRHITimestampQueries
+{
+public:
+	~CD3D12RHITimestampQueries()
+	{
+		SAFE_RELEASE(QueryHeap);
+		SAFE_RELEASE(ReadbackBuffer);
+	}
+
+	double GetTimeMs(uint32_t Index) override;
+
+	ID3D12QueryHeap* QueryHeap = nullptr;
+
+	// The ticks of every query, resolved right after it is written
+	ID3D12Resource* ReadbackBuffer = nullptr;
+
+	// GPU ticks and CPU time sampled together at creation, and the frequency of the GPU clock
+	uint64_t CalibrationTicks = 0;
+	double CalibrationMs = 0.0;
+	double TicksPerMs = 1.0;
+};
+
+class CD3D12RHICommandList : public CRHICommandList
+{
+public:
+	CD3D12RHICommandList(CD3D12RHIDevice* InDevice)
+		: Device(InDevice)
+	{
+	}
+
+	~CD3D12RHICommandList()
+	{
+		SAFE_RELEASE(CommandList);
+	}
+
+	bool Reset(CRHICommandAllocator* Allocator, CRHIPipelineState* InitialState) override;
+
+	bool Close() override;
+
+	void ResourceBarrier(CRHIResource* Resource, ERHIResourceState Before, ERHIResourceState After) override;
+
+	void SetRenderTarget(CRHIResource* RenderTarget) override;
+
+	void ClearRenderTarget(CRHIResource* RenderTarget, const float Color[4]) override;
+
+	void ClearDepth(float Depth) override;
+
+	void SetViewport(const RHIViewport& Viewport) override;
+
+	void SetScissorRect(const RHIRect& Rect) override;
+
+	void SetPipelineState(CRHIPipelineState* PipelineState) override;
+
+	void SetGraphicsRootConstantBufferView(uint32_t RootParameterIndex, uint64_t GPUAddress) override;
+
+	void SetGraphicsRootTexture(uint32_t RootParameterIndex, CRHIResource* Texture) override;
+
+	void SetPrimitiveTopology(ERHIPrimitiveTopology Topology) override;
+
+	void SetVertexBuffers(uint32_t StartSlot, uint32_t NumViews, const RHIVertexBufferView* Views) override;
+
+	void SetIndexBuffer(const RHIIndexBufferView& View) override;
+
+	void DrawIndexedInstanced(uint32_t IndexCountPerInstance, uint32_t InstanceCount, uint32_t StartIndexLocation, int32_t BaseVertexLocation, uint32_t StartInstanceLocation) override;
+
+	void CopyBufferRegion(CRHIResource* Dest, uint64_t DestOffset, CRHIResource* Source, uint64_t SourceOffset, uint64_t NumBytes) override;
+
+	void WriteTimestamp(CRHITimestampQueries* Queries, uint32_t Index) override;
+
+	// Binds the root signature and descriptor heap shared by every pipeline
+	void SetSharedState();
+
+	ID3D12GraphicsCommandList* CommandList = nullptr;
+
+	// State changes, draws, copies and recording time since the last execution, merged into the device stats when
+	// executed. Counted per list, the lists are recorded on several threads
+	RHIStats RecordedStats;
+
+	double RecordStartMs = 0.0;
+
+private:
+	CD3D12RHIDevice* Device;
+};
+
+class CD3D12RHIDevice : public CRHIDevice
+{
+public:
+	ERHIBackend GetBackend() const override
+	{
+		return ERHIBackend::D3D12;
+	}
+
+	bool Init(const RHIDeviceDesc& Desc) override;
+
+	void Shutdown() override;
+
+	CRHIResource* CreateBuffer(uint64_t Size, ERHIHeapType HeapType, ERHIResourceState InitialState, const wchar_t* Name) override;
+
+	CRHIResource* CreateTextureFromFile(const wchar_t* Filename, CRHICommandList* CommandList) override;
+
+	CRHIPipelineState* CreatePipelineState(const RHIPipelineStateDesc& Desc) override;
+
+	CRHICommandAllocator* CreateCommandAllocator() override;
+
+	CRHICommandList* CreateCommandList(CRHICommandAllocator* Allocator) override;
+
+	CRHIFence* CreateFence(uint64_t InitialValue) override;
+
+	CRHITimestampQueries* CreateTimestampQueries(uint32_t Count) override;
+
+	void ExecuteCommandLists(uint32_t NumCommandLists, CRHICommandList* const* CommandLists) override;
+
+	bool Signal(CRHIFence* Fence, uint64_t Value) override;
+
+	bool Present() override;
+
+	int GetCurrentBackBufferIndex() const override
+	{
+		return SwapChain->GetCurrentBackBufferIndex();
+	}
+
+	CRHIResource* GetBackBuffer(int Index) const override
+	{
+		return RenderTargets[Index];
+	}
+
+	static DXGI_FORMAT GetDXGIFormat(ERHIFormat Format);
+	static D3D12_RESOURCE_STATES GetResourceState(ERHIResourceState State);
+
+	DXGI_FORMAT GetDXGIFormatFromWICFormat(WICPixelFormatGUID& WicFormatGUID);
+	WICPixelFormatGUID GetConvertToWICFormat(WICPixelFormatGUID& WicFormatGUID);
+	int GetDXGIFormatBitsPerPixel(DXGI_FORMAT& DxgiFormat);
+	// Load an image in the form of a bitmap
+	int LoadImageDataFromFile(BYTE** ImageData, D3D12_RESOURCE_DESC& ResourceDescription, LPCWSTR Filename, int& BytesPerRow);
+
+	/********** Direct 3D Variables **********/
+
+	// The direct3D Device
+	ID3D12Device* Device = nullptr;
+
+	// SwapChain to switch between render targets
+	IDXGISwapChain3* SwapChain = nullptr;
+
+	// Command Queue to contain Command Lists
+	ID3D12CommandQueue* CommandQueue = nullptr;
+
+	// Descriptor Heap to hold Resources
+	ID3D12DescriptorHeap* RTVDescriptorHeap = nullptr;
+
+	// The back buffers of the swap chain
+	std::vector<CD3D12RHIResource*> RenderTargets;
+
+	// Depth/Stencil
+	ID3D12Resource* DepthStencilBuffer = nullptr; // This is the memory for our depth buffer
+	ID3D12DescriptorHeap* DepthStencilDescriptorHeap = nullptr; // This is a heap for our depth/stencil buffer descriptor
+
+	// Defines the data that shaders will access
+	ID3D12RootSignature* RootSignature = nullptr;
+
+	// Shader visible heap holding the SRVs of the textures
+	ID3D12DescriptorHeap* MainDescriptorHeap = nullptr;
+
+	// Number of SRVs created in MainDescriptorHeap
+	int NumTextures = 0;
+
+	// Size of the Render Target Descriptor
+	int RTVDescriptorSize = 0;
+
+	// Size of a CBV/SRV/UAV Descriptor
+	int SRVDescriptorSize = 0;
+
+	// Upload heaps of the textures, they need to live until the copy is executed
+	std::vector<ID3D12Resource*> TextureUploadHeaps;
+
+	/********** End Direct 3D Variables **********/
+};
@@ -0,0 +1,93 @@
+#include "pch.h"
+#include "DrawList.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+static const uint32_t DepthBits = 30;
+static const uint64_t DepthMask = (uint64_t(1) << DepthBits) - 1;
+
+// Positive floats sort like their bits, the 30 below the sign keep the exponent and 22 bits of mantissa
+static uint64_t QuantizeDepth(float Depth)
+{
+	Depth = std::max(Depth, 0.0f);
+	uint32_t Bits;
+	memcpy(&Bits, &Depth, sizeof(Bits));
+	return (Bits >> 1) & DepthMask;
+}
+
+uint64_t CDrawList::MakeKey(ERenderPass Pass, uint32_t Material, uint32_t Geometry, uint32_t LOD, float Depth)
+{
+	const uint64_t State = uint64_t(std::min(Material, MaxMaterials - 1)) << 20
+		| uint64_t(std::min(Geometry, MaxGeometries - 1)) << 4
+		| uint64_t(std::min(LOD, MaxLODs - 1));
+	const uint64_t PassBits = uint64_t(Pass) << 62;
+
+	if (Pass == ERenderPass::Transparent)
+	{
+		return PassBits | (DepthMask - QuantizeDepth(Depth)) << 32 | State;
+	}
+	return PassBits | State << DepthBits | QuantizeDepth(Depth);
+}
+
+uint32_t CDrawList::GetLOD(uint64_t Key)
+{
+	const bool bTransparent = ERenderPass(Key >> 62) == ERenderPass::Transparent;
+	return uint32_t(Key >> (bTransparent ? 0 : DepthBits)) & (MaxLODs - 1);
+}
+
+void CDrawList::Reset(uint32_t Count)
+{
+	Keys.clear();
+	Values.clear();
+	Keys.reserve(Count);
+	Values.reserve(Count);
+}
+
+void CDrawList::Sort()
+{
+	const size_t Count = Keys.size();
+	if (Count < 2)
+	{
+		return;
+	}
+	TempKeys.resize(Count);
+	TempValues.resize(Count);
+
+	// The histograms of every byte in a single read of the keys
+	uint32_t Histograms[8][256] = {};
+	for (uint64_t Key : Keys)
+	{
+		for (uint32_t Byte = 0; Byte < 8; ++Byte)
+		{
+			++Histograms[Byte][(Key >> (Byte * 8)) & 0xFF];
+		}
+	}
+
+	for (uint32_t Byte = 0; Byte < 8; ++Byte)
+	{
+		uint32_t* Histogram = Histograms[Byte];
+		if (Histogram[(Keys[0] >> (Byte * 8)) & 0xFF] == Count)
+		{
+			continue;
+		}
+
+		// Offsets of the buckets, then a stable scatter into the other buffers
+		uint32_t Offset = 0;
+		for (uint32_t Bucket = 0; Bucket < 256; ++Bucket)
+		{
+			const uint32_t BucketSize = Histogram[Bucket];
+			Histogram[Bucket] = Offset;
+			Offset += BucketSize;
+		}
+		for (size_t Index = 0; Index < Count; ++Index)
+		{
+			const uint32_t Destination = Histogram[(Keys[Index] >> (Byte * 8)) & 0xFF]++;
+			TempKeys[Destination] = Keys[Index];
+			TempValues[Destination] = Values[Index];
+		}
+		std::swap(Keys, TempKeys);
+		std::swap(Values, TempValues);
+	}
+}
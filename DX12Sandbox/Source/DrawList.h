@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "pch.h"
+
+// Passes in the order they are drawn, the first field of every draw key
+enum class ERenderPass : uint32_t
+{
+	Opaque,
+	Transparent
+};
+
+// Draws of a frame as 64 bits keys and what to draw for each, sorted so the state changes as rarely as possible.
+// Opaque keys are, from the most significant bits : pass (2), material (12), geometry (16), LOD (4), depth (30),
+// the draws of a mesh are then grouped for instancing and front to back inside a group. There is no pipeline field, the
+// pipeline only depends on whether a run is instanced and the runs are only known once sorted.
+// Transparent keys put the depth, reversed, right after the pass so they are drawn back to front whatever their state
+class CDrawList
+{
+public:
+
+	static constexpr uint32_t MaxMaterials = 1 << 12;
+	static constexpr uint32_t MaxGeometries = 1 << 16;
+	static constexpr uint32_t MaxLODs = 1 << 4;
+
+	// Depth is the distance to the camera, only its order matters. The other fields are clamped to their maximum
+	static uint64_t MakeKey(ERenderPass Pass, uint32_t Material, uint32_t Geometry, uint32_t LOD, float Depth);
+
+	static uint32_t GetLOD(uint64_t Key);
+
+	// Empties the list and makes room for Count draws
+	void Reset(uint32_t Count);
+
+	void Add(uint64_t Key, uint32_t Value)
+	{
+		Keys.push_back(Key);
+		Values.push_back(Value);
+	}
+
+	// LSD radix sort over the bytes of the keys, Values follow their key and equal keys keep their order.
+	// Bytes every key has in common are skipped, usually the pass and material ones
+	void Sort();
+
+	uint32_t GetCount() const
+	{
+		return uint32_t(Keys.size());
+	}
+
+	uint64_t GetKey(uint32_t Index) const
+	{
+		return Keys[Index];
+	}
+
+	uint32_t GetValue(uint32_t Index) const
+	{
+		return Values[Index];
+	}
+
+private:
+
+	std::vector<uint64_t> Keys;
+	std::vector<uint32_t> Values;
+
+	// Destination of the odd passes of the sort
+	std::vector<uint64_t> TempKeys;
+	std::vector<uint32_t> TempValues;
+};
@@ -0,0 +1,80 @@
+#include "pch.h"
+#include "FramePacer.h"
+#include "RHI.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+// Weight of the last frame in the running averages of the frame costs
+static const double AverageWeight = 0.1;
+
+// Share of the waits the next start moves by. Both threads usually wait for the same stall, half of their sum moves
+// the start by about the stall
+static const double WaitGain = 0.5;
+
+static void UpdateAverage(double& Average, double Value)
+{
+	Average = Average > 0.0 ? Average + (Value - Average) * AverageWeight : Value;
+}
+
+double CFramePacer::BeginFrame()
+{
+	const double NowMs = RHINowMs();
+	double SleepMs = 0.0;
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+		if (bLowLatency && LastStartMs > 0.0)
+		{
+			// Frames started faster than the slowest stage queue up in front of it, the waits say they did anyway
+			const double PeriodMs = std::max(GPUFrameMs, RenderFrameMs) + MarginMs;
+			SleepMs = std::min(std::max(LastStartMs + PeriodMs + WaitedMs * WaitGain - NowMs, 0.0), MaxDelayMs);
+		}
+		DelayMs = SleepMs;
+		WaitedMs = 0.0;
+	}
+
+	if (SleepMs > 0.0)
+	{
+		std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(SleepMs));
+	}
+
+	const double StartMs = RHINowMs();
+	std::lock_guard<std::mutex> Lock(Mutex);
+	LastStartMs = StartMs;
+	return StartMs;
+}
+
+void CFramePacer::AddWait(double WaitMs)
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+	WaitedMs += WaitMs;
+}
+
+void CFramePacer::AddGPUFrame(double FrameMs)
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+	UpdateAverage(GPUFrameMs, FrameMs);
+}
+
+void CFramePacer::AddRenderFrame(double FrameMs)
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+	UpdateAverage(RenderFrameMs, FrameMs);
+}
+
+double CFramePacer::GetDelayMs() const
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+	return DelayMs;
+}
+
+void CFramePacer::Reset()
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+	WaitedMs = 0.0;
+	GPUFrameMs = 0.0;
+	RenderFrameMs = 0.0;
+	LastStartMs = 0.0;
+	DelayMs = 0.0;
+}
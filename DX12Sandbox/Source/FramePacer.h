@@ -0,0 +1,51 @@
+#pragma once
+#include "pch.h"
+
+#include <mutex>
+
+// Paces the frames against the GPU. Both threads report the time they spent waiting, for the GPU or for each other,
+// the render thread what a frame cost the GPU and itself. In low latency mode the frames are started one bottleneck
+// period apart, where the input is read, later by what was waited since the last one. A frame then reaches the GPU
+// as it gets free instead of queuing behind the others
+class CFramePacer
+{
+public:
+	bool bLowLatency = false;
+
+	// Added to the period, the frame time varies from one frame to the next and a late frame leaves the GPU idle
+	double MarginMs = 0.25;
+
+	// The delay never grows past this, a stall mustn't hold the next frames back
+	double MaxDelayMs = 50.0;
+
+	// Game thread, before the input of a frame is read. Sleeps until the frame should start in low latency mode,
+	// returns the time it starts at on the clock of RHINowMs
+	double BeginFrame();
+
+	// Any thread, time the CPU waited this frame
+	void AddWait(double WaitMs);
+
+	// Render thread, GPU time of a finished frame and CPU time of a recorded one, waits excluded
+	void AddGPUFrame(double FrameMs);
+	void AddRenderFrame(double FrameMs);
+
+	// What the last BeginFrame slept
+	double GetDelayMs() const;
+
+	void Reset();
+
+private:
+	mutable std::mutex Mutex;
+
+	// Waited since the last BeginFrame
+	double WaitedMs = 0.0;
+
+	// Running averages of the frame costs
+	double GPUFrameMs = 0.0;
+	double RenderFrameMs = 0.0;
+
+	// When the last frame started, 0 before the first one
+	double LastStartMs = 0.0;
+
+	double DelayMs = 0.0;
+};
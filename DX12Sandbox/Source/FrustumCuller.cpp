@@ -0,0 +1,73 @@
+#include "pch.h"
+#include "FrustumCuller.h"
+
+#include <cfloat>
+
+// A sphere with this radius is outside of every plane
+static const float CulledRadius = -FLT_MAX;
+
+void CFrustumCuller::Resize(uint32_t InCount)
+{
+	const uint32_t PaddedCount = (InCount + 3) & ~3u;
+
+	CenterX.resize(PaddedCount, 0.0f);
+	CenterY.resize(PaddedCount, 0.0f);
+	CenterZ.resize(PaddedCount, 0.0f);
+	Radii.resize(PaddedCount, CulledRadius);
+
+	// Shrinking leaves spheres in the padding, make sure they are culled
+	for (uint32_t Index = InCount; Index < PaddedCount; ++Index)
+	{
+		Radii[Index] = CulledRadius;
+	}
+
+	Count = InCount;
+}
+
+uint32_t CFrustumCuller::Cull(const XMFLOAT4 Planes[6], uint32_t Begin, uint32_t End, uint32_t* OutVisible) const
+{
+	// Each component of each plane splatted once, every lane tests a different sphere against the same plane
+	XMVECTOR PlaneX[6], PlaneY[6], PlaneZ[6], PlaneW[6];
+	for (int Plane = 0; Plane < 6; ++Plane)
+	{
+		PlaneX[Plane] = XMVectorReplicate(Planes[Plane].x);
+		PlaneY[Plane] = XMVectorReplicate(Planes[Plane].y);
+		PlaneZ[Plane] = XMVectorReplicate(Planes[Plane].z);
+		PlaneW[Plane] = XMVectorReplicate(Planes[Plane].w);
+	}
+
+	const XMVECTOR Zero = XMVectorZero();
+	uint32_t VisibleCount = 0;
+
+	for (uint32_t Index = Begin; Index < End; Index += 4)
+	{
+		const XMVECTOR X = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&CenterX[Index]));
+		const XMVECTOR Y = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&CenterY[Index]));
+		const XMVECTOR Z = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&CenterZ[Index]));
+		const XMVECTOR Radius = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&Radii[Index]));
+
+		// Visible when the signed distance to every plane is greater than -Radius
+		XMVECTOR Inside = XMVectorTrueInt();
+		for (int Plane = 0; Plane < 6; ++Plane)
+		{
+			XMVECTOR Distance = XMVectorMultiplyAdd(X, PlaneX[Plane], PlaneW[Plane]);
+			Distance = XMVectorMultiplyAdd(Y, PlaneY[Plane], Distance);
+			Distance = XMVectorMultiplyAdd(Z, PlaneZ[Plane], Distance);
+			Inside = XMVectorAndInt(Inside, XMVectorGreaterOrEqual(Distance + Radius, Zero));
+		}
+
+		// Branchless compaction : always write the index, only advance when visible
+		XMUINT4 Mask;
+		XMStoreUInt4(&Mask, Inside);
+		OutVisible[VisibleCount] = Index;
+		VisibleCount += Mask.x & 1;
+		OutVisible[VisibleCount] = Index + 1;
+		VisibleCount += Mask.y & 1;
+		OutVisible[VisibleCount] = Index + 2;
+		VisibleCount += Mask.z & 1;
+		OutVisible[VisibleCount] = Index + 3;
+		VisibleCount += Mask.w & 1;
+	}
+
+	return VisibleCount;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+#include "pch.h"
+
+using namespace DirectX;
+
+// Bounding spheres in world space, stored as Structure of Arrays so they can be tested
+// against the 6 planes of the frustum 4 at a time.
+class CFrustumCuller
+{
+public:
+
+	// Sets the number of spheres, new ones are never visible until they are set
+	void Resize(uint32_t InCount);
+
+	void SetSphere(uint32_t Index, const XMFLOAT3& Center, float Radius)
+	{
+		CenterX[Index] = Center.x;
+		CenterY[Index] = Center.y;
+		CenterZ[Index] = Center.z;
+		Radii[Index] = Radius;
+	}
+
+	// Center in xyz, radius in w
+	XMVECTOR GetSphere(uint32_t Index) const
+	{
+		return XMVectorSet(CenterX[Index], CenterY[Index], CenterZ[Index], Radii[Index]);
+	}
+
+	// Writes the index of every sphere intersecting the frustum in OutVisible, which needs room for GetPaddedCount() entries
+	// Planes point inside the frustum and are normalized, returns the number of visible spheres
+	uint32_t Cull(const XMFLOAT4 Planes[6], uint32_t* OutVisible) const
+	{
+		return Cull(Planes, 0, GetPaddedCount(), OutVisible);
+	}
+
+	// Same for the spheres from Begin to End, multiples of 4 up to the padded count. OutVisible needs room for End - Begin
+	// entries, ranges can be culled on several threads
+	uint32_t Cull(const XMFLOAT4 Planes[6], uint32_t Begin, uint32_t End, uint32_t* OutVisible) const;
+
+	uint32_t GetCount() const
+	{
+		return Count;
+	}
+
+	uint32_t GetPaddedCount() const
+	{
+		return uint32_t(Radii.size());
+	}
+
+private:
+
+	uint32_t Count = 0;
+
+	// Padded to a multiple of 4 with spheres that are always culled, so there is no scalar tail
+	std::vector<float> CenterX;
+	std::vector<float> CenterY;
+	std::vector<float> CenterZ;
+	std::vector<float> Radii;
+};
@@ -0,0 +1,371 @@
+#include "pch.h"
+#include "GeometryPool.h"
+
+#include <cstring>
+#include <iterator>
+
+void CRangeAllocator::Init(uint64_t InSize)
+{
+	Size = InSize;
+	FreeSize = InSize;
+	FreeRanges.clear();
+	FreeRanges[0] = InSize;
+}
+
+bool CRangeAllocator::Allocate(uint64_t InSize, uint64_t Alignment, uint64_t& OutOffset)
+{
+	for (auto It = FreeRanges.begin(); It != FreeRanges.end(); ++It)
+	{
+		const uint64_t RangeStart = It->first;
+		const uint64_t RangeEnd = It->first + It->second;
+		const uint64_t AlignedOffset = (RangeStart + Alignment - 1) & ~(Alignment - 1);
+		if (AlignedOffset + InSize > RangeEnd)
+		{
+			continue;
+		}
+
+		// Split the range, the alignment padding and the remainder stay free
+		FreeRanges.erase(It);
+		if (AlignedOffset > RangeStart)
+		{
+			FreeRanges[RangeStart] = AlignedOffset - RangeStart;
+		}
+		if (AlignedOffset + InSize < RangeEnd)
+		{
+			FreeRanges[AlignedOffset + InSize] = RangeEnd - AlignedOffset - InSize;
+		}
+
+		FreeSize -= InSize;
+		OutOffset = AlignedOffset;
+		return true;
+	}
+
+	return false;
+}
+
+void CRangeAllocator::Free(uint64_t Offset, uint64_t InSize)
+{
+	FreeSize += InSize;
+
+	auto Next = FreeRanges.lower_bound(Offset);
+
+	// Merge with the range ending where this one starts
+	if (Next != FreeRanges.begin())
+	{
+		auto Previous = std::prev(Next);
+		if (Previous->first + Previous->second == Offset)
+		{
+			Offset = Previous->first;
+			InSize += Previous->second;
+			FreeRanges.erase(Previous);
+		}
+	}
+
+	// And with the one starting where it ends
+	if (Next != FreeRanges.end() && Offset + InSize == Next->first)
+	{
+		InSize += Next->second;
+		FreeRanges.erase(Next);
+	}
+
+	FreeRanges[Offset] = InSize;
+}
+
+CGeometryPool::CGeometryPool(CRHIDevice* InDevice, uint64_t InBlockSize)
+	: Device(InDevice), BlockSize(InBlockSize), StagingAllocator(InDevice, 4 * 1024 * 1024)
+{
+}
+
+CGeometryPool::~CGeometryPool()
+{
+	for (Block& CurrentBlock : Blocks)
+	{
+		SAFE_RELEASE(CurrentBlock.Resource);
+	}
+}
+
+void CGeometryPool::BeginFrame()
+{
+	while (!InFlightRetired.empty() && InFlightRetired.front().Fence->GetCompletedValue() >= InFlightRetired.front().FenceValue)
+	{
+		RetiredFrame& Retired = InFlightRetired.front();
+		for (const Allocation& Range : Retired.Ranges)
+		{
+			Blocks[Range.BlockIndex].Ranges.Free(Range.Offset, Range.Size);
+		}
+		for (uint32_t BlockIndex : Retired.Blocks)
+		{
+			SAFE_RELEASE(Blocks[BlockIndex].Resource);
+			Blocks[BlockIndex] = Block();
+			FreeBlockSlots.push_back(BlockIndex);
+		}
+		InFlightRetired.pop_front();
+	}
+
+	// Geometry is mostly uploaded at load time, don't keep the staging memory around afterwards
+	StagingAllocator.BeginFrame();
+	StagingAllocator.ReleaseFreePages();
+}
+
+uint32_t CGeometryPool::Allocate(CRHICommandList* CommandList, EGeometryType Type, const void* Data, uint64_t Size, uint64_t Alignment)
+{
+	Allocation NewAllocation;
+	if (Size == 0 || !AllocateRange(Type, Size, Alignment, NewAllocation))
+	{
+		return INVALID_GEOMETRY_HANDLE;
+	}
+
+	Block& DestBlock = Blocks[NewAllocation.BlockIndex];
+
+	const RHIUploadAllocation Staging = StagingAllocator.Allocate(Size, 16);
+	if (!Staging.CPUAddress)
+	{
+		DestBlock.Ranges.Free(NewAllocation.Offset, NewAllocation.Size);
+		return INVALID_GEOMETRY_HANDLE;
+	}
+
+	memcpy(Staging.CPUAddress, Data, Size);
+	TransitionBlock(CommandList, DestBlock, ERHIResourceState::CopyDest);
+	CommandList->CopyBufferRegion(DestBlock.Resource, NewAllocation.Offset, Staging.Resource, Staging.Offset, Size);
+	DestBlock.AllocationCount++;
+
+	uint32_t Handle;
+	if (!FreeHandles.empty())
+	{
+		Handle = FreeHandles.back();
+		FreeHandles.pop_back();
+		Allocations[Handle] = NewAllocation;
+	}
+	else
+	{
+		Handle = uint32_t(Allocations.size());
+		Allocations.push_back(NewAllocation);
+	}
+	return Handle;
+}
+
+void CGeometryPool::FinishUploads(CRHICommandList* CommandList)
+{
+	for (Block& CurrentBlock : Blocks)
+	{
+		if (CurrentBlock.Resource)
+		{
+			TransitionBlock(CommandList, CurrentBlock, GetReadState(CurrentBlock.Type));
+		}
+	}
+}
+
+void CGeometryPool::Free(uint32_t Handle)
+{
+	if (Handle == INVALID_GEOMETRY_HANDLE)
+	{
+		return;
+	}
+
+	Allocation& Freed = Allocations[Handle];
+	Blocks[Freed.BlockIndex].AllocationCount--;
+	FrameRetired.Ranges.push_back(Freed);
+
+	Freed = Allocation();
+	FreeHandles.push_back(Handle);
+}
+
+void CGeometryPool::EndFrame(CRHIFence* Fence, uint64_t FenceValue)
+{
+	StagingAllocator.EndFrame(Fence, FenceValue);
+
+	if (FrameRetired.Ranges.empty() && FrameRetired.Blocks.empty())
+	{
+		return;
+	}
+
+	FrameRetired.Fence = Fence;
+	FrameRetired.FenceValue = FenceValue;
+	InFlightRetired.push_back(std::move(FrameRetired));
+	FrameRetired = RetiredFrame();
+}
+
+uint32_t CGeometryPool::Defragment(CRHICommandList* CommandList, float MaxUsage)
+{
+	// The content of the sparse blocks goes into the other blocks, or packed into a new one when they are all sparse
+	std::vector<uint32_t> Sparse;
+	for (uint32_t BlockIndex = 0; BlockIndex < Blocks.size(); ++BlockIndex)
+	{
+		Block& CurrentBlock = Blocks[BlockIndex];
+		if (!CurrentBlock.Resource || CurrentBlock.bRetiring)
+		{
+			continue;
+		}
+
+		const uint64_t Used = CurrentBlock.Ranges.GetSize() - CurrentBlock.Ranges.GetFreeSize();
+		if (Used < uint64_t(MaxUsage * CurrentBlock.Ranges.GetSize()))
+		{
+			CurrentBlock.bRetiring = true;
+			Sparse.push_back(BlockIndex);
+		}
+	}
+
+	uint32_t MovedCount = 0;
+	for (Allocation& Moved : Allocations)
+	{
+		if (Moved.BlockIndex == INVALID_GEOMETRY_HANDLE || !Blocks[Moved.BlockIndex].bRetiring)
+		{
+			continue;
+		}
+
+		const uint32_t SourceIndex = Moved.BlockIndex;
+		Allocation NewAllocation;
+		if (!AllocateRange(Blocks[SourceIndex].Type, Moved.Size, 16, NewAllocation))
+		{
+			continue;
+		}
+
+		// AllocateRange can grow Blocks, take the references after it
+		Block& SourceBlock = Blocks[SourceIndex];
+		Block& DestBlock = Blocks[NewAllocation.BlockIndex];
+		TransitionBlock(CommandList, SourceBlock, ERHIResourceState::CopySource);
+		TransitionBlock(CommandList, DestBlock, ERHIResourceState::CopyDest);
+		CommandList->CopyBufferRegion(DestBlock.Resource, NewAllocation.Offset, SourceBlock.Resource, Moved.Offset, Moved.Size);
+
+		// The old range is still read by the frames in flight, it goes back to its block once they are done
+		SourceBlock.AllocationCount--;
+		DestBlock.AllocationCount++;
+		FrameRetired.Ranges.push_back(Moved);
+		Moved = NewAllocation;
+		MovedCount++;
+	}
+
+	// The emptied blocks are released once the GPU is done with the draws and copies reading them
+	for (uint32_t BlockIndex : Sparse)
+	{
+		Block& CurrentBlock = Blocks[BlockIndex];
+		if (CurrentBlock.AllocationCount == 0)
+		{
+			FrameRetired.Blocks.push_back(BlockIndex);
+		}
+		else
+		{
+			// Some allocations didn't find room elsewhere, keep using the block
+			CurrentBlock.bRetiring = false;
+		}
+	}
+
+	FinishUploads(CommandList);
+	return MovedCount;
+}
+
+RHIVertexBufferView CGeometryPool::GetVertexBufferView(uint32_t Handle, uint32_t Stride) const
+{
+	const Allocation& Range = Allocations[Handle];
+
+	RHIVertexBufferView View;
+	View.BufferLocation = Blocks[Range.BlockIndex].Resource->GetGPUVirtualAddress() + Range.Offset;
+	View.SizeInBytes = uint32_t(Range.Size);
+	View.StrideInBytes = Stride;
+	return View;
+}
+
+RHIIndexBufferView CGeometryPool::GetIndexBufferView(uint32_t Handle, ERHIFormat Format) const
+{
+	const Allocation& Range = Allocations[Handle];
+
+	RHIIndexBufferView View;
+	View.BufferLocation = Blocks[Range.BlockIndex].Resource->GetGPUVirtualAddress() + Range.Offset;
+	View.SizeInBytes = uint32_t(Range.Size);
+	View.Format = Format;
+	return View;
+}
+
+uint32_t CGeometryPool::GetBlockCount() const
+{
+	return uint32_t(Blocks.size() - FreeBlockSlots.size());
+}
+
+uint64_t CGeometryPool::GetUsedSize() const
+{
+	uint64_t Used = 0;
+	for (const Block& CurrentBlock : Blocks)
+	{
+		Used += CurrentBlock.Ranges.GetSize() - CurrentBlock.Ranges.GetFreeSize();
+	}
+	return Used;
+}
+
+uint64_t CGeometryPool::GetReservedSize() const
+{
+	uint64_t Reserved = 0;
+	for (const Block& CurrentBlock : Blocks)
+	{
+		Reserved += CurrentBlock.Ranges.GetSize();
+	}
+	return Reserved;
+}
+
+bool CGeometryPool::AllocateRange(EGeometryType Type, uint64_t Size, uint64_t Alignment, Allocation& OutAllocation)
+{
+	for (uint32_t BlockIndex = 0; BlockIndex < Blocks.size(); ++BlockIndex)
+	{
+		Block& CurrentBlock = Blocks[BlockIndex];
+		if (CurrentBlock.Resource && CurrentBlock.Type == Type && !CurrentBlock.bRetiring
+			&& CurrentBlock.Ranges.Allocate(Size, Alignment, OutAllocation.Offset))
+		{
+			OutAllocation.BlockIndex = BlockIndex;
+			OutAllocation.Size = Size;
+			return true;
+		}
+	}
+
+	const uint32_t BlockIndex = CreateBlock(Type, Size);
+	if (BlockIndex == INVALID_GEOMETRY_HANDLE || !Blocks[BlockIndex].Ranges.Allocate(Size, Alignment, OutAllocation.Offset))
+	{
+		return false;
+	}
+
+	OutAllocation.BlockIndex = BlockIndex;
+	OutAllocation.Size = Size;
+	return true;
+}
+
+uint32_t CGeometryPool::CreateBlock(EGeometryType Type, uint64_t MinSize)
+{
+	// A buffer larger than a block gets a block of its own
+	const uint64_t Size = MinSize <= BlockSize ? BlockSize : (MinSize + 0xFFFF) & ~uint64_t(0xFFFF);
+
+	Block NewBlock;
+	NewBlock.Resource = Device->CreateBuffer(Size, ERHIHeapType::Default, ERHIResourceState::CopyDest,
+		Type == EGeometryType::Vertex ? L"Geometry Pool Vertex Block" : L"Geometry Pool Index Block");
+	if (!NewBlock.Resource)
+	{
+		return INVALID_GEOMETRY_HANDLE;
+	}
+	NewBlock.Type = Type;
+	NewBlock.Ranges.Init(Size);
+
+	uint32_t BlockIndex;
+	if (!FreeBlockSlots.empty())
+	{
+		BlockIndex = FreeBlockSlots.back();
+		FreeBlockSlots.pop_back();
+		Blocks[BlockIndex] = NewBlock;
+	}
+	else
+	{
+		BlockIndex = uint32_t(Blocks.size());
+		Blocks.push_back(NewBlock);
+	}
+	return BlockIndex;
+}
+
+void CGeometryPool::TransitionBlock(CRHICommandList* CommandList, Block& InBlock, ERHIResourceState State)
+{
+	if (InBlock.State != State)
+	{
+		CommandList->ResourceBarrier(InBlock.Resource, InBlock.State, State);
+		InBlock.State = State;
+	}
+}
+
+ERHIResourceState CGeometryPool::GetReadState(EGeometryType Type)
+{
+	return Type == EGeometryType::Vertex ? ERHIResourceState::VertexAndConstantBuffer : ERHIResourceState::IndexBuffer;
+}
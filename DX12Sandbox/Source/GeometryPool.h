@@ -0,0 +1,155 @@
+#pragma once
+#include "RHI.h"
+#include "UploadAllocator.h"
+
+#include <deque>
+#include <map>
+#include <vector>
+
+#define INVALID_GEOMETRY_HANDLE 0xFFFFFFFFu
+
+// What a block of the pool holds, vertex and index data never share a block
+enum class EGeometryType
+{
+	Vertex,
+	Index
+};
+
+// First fit allocator of ranges inside [0, Size), the free ranges are kept sorted and merged with their neighbours on free
+class CRangeAllocator
+{
+public:
+	void Init(uint64_t InSize);
+
+	// Alignment must be a power of two, returns false if no free range is large enough
+	bool Allocate(uint64_t Size, uint64_t Alignment, uint64_t& OutOffset);
+
+	void Free(uint64_t Offset, uint64_t Size);
+
+	uint64_t GetSize() const
+	{
+		return Size;
+	}
+
+	uint64_t GetFreeSize() const
+	{
+		return FreeSize;
+	}
+
+private:
+	// Offset to size of each free range
+	std::map<uint64_t, uint64_t> FreeRanges;
+
+	uint64_t Size = 0;
+
+	uint64_t FreeSize = 0;
+};
+
+// Vertices and indices of every mesh, sub allocated from a few large default heap buffers instead of one committed
+// resource per buffer. The data is staged through an upload allocator whose pages are recycled with the frame fences,
+// and freed ranges only go back to their block once the GPU is done with the frame that freed them.
+class CGeometryPool
+{
+public:
+	CGeometryPool(CRHIDevice* InDevice, uint64_t InBlockSize = 16 * 1024 * 1024);
+
+	// The GPU must be done with every block
+	~CGeometryPool();
+
+	CGeometryPool(const CGeometryPool&) = delete;
+	CGeometryPool& operator=(const CGeometryPool&) = delete;
+
+	// Returns the ranges, blocks and staging pages the GPU is done with
+	void BeginFrame();
+
+	// Records the copy of Data into a range of a block of Type, returns INVALID_GEOMETRY_HANDLE if out of memory
+	// FinishUploads must be recorded before the range is drawn
+	uint32_t Allocate(CRHICommandList* CommandList, EGeometryType Type, const void* Data, uint64_t Size, uint64_t Alignment = 16);
+
+	// Moves the blocks written since the last call back to their vertex or index buffer state
+	void FinishUploads(CRHICommandList* CommandList);
+
+	// The range stays valid until the fence of the next EndFrame completes, the handle can't be used anymore
+	void Free(uint32_t Handle);
+
+	// The staging memory, ranges and blocks released since BeginFrame can be reused once Fence reaches FenceValue
+	void EndFrame(CRHIFence* Fence, uint64_t FenceValue);
+
+	// Moves the allocations of the blocks filled below MaxUsage into the other blocks, then releases the emptied blocks
+	// The handles stay the same, only call between frames since views taken before are invalidated
+	// Returns the number of allocations moved
+	uint32_t Defragment(CRHICommandList* CommandList, float MaxUsage = 0.5f);
+
+	// Views are cheap to build, take them when recording a draw since Defragment can move the data
+	RHIVertexBufferView GetVertexBufferView(uint32_t Handle, uint32_t Stride) const;
+
+	RHIIndexBufferView GetIndexBufferView(uint32_t Handle, ERHIFormat Format) const;
+
+	uint32_t GetBlockCount() const;
+
+	// Bytes of the blocks handed out to allocations
+	uint64_t GetUsedSize() const;
+
+	// Bytes of every block
+	uint64_t GetReservedSize() const;
+
+private:
+	struct Block
+	{
+		// Null for an unused slot
+		CRHIResource* Resource = nullptr;
+		EGeometryType Type = EGeometryType::Vertex;
+		ERHIResourceState State = ERHIResourceState::CopyDest;
+		CRangeAllocator Ranges;
+		uint32_t AllocationCount = 0;
+		// Being emptied by Defragment, nothing is allocated from it
+		bool bRetiring = false;
+	};
+
+	struct Allocation
+	{
+		uint32_t BlockIndex = INVALID_GEOMETRY_HANDLE;
+		uint64_t Offset = 0;
+		uint64_t Size = 0;
+	};
+
+	// Everything released during one frame
+	struct RetiredFrame
+	{
+		CRHIFence* Fence;
+		uint64_t FenceValue;
+		std::vector<Allocation> Ranges;
+		std::vector<uint32_t> Blocks;
+	};
+
+	// Finds room in a block of Type, creates a block if none has enough
+	bool AllocateRange(EGeometryType Type, uint64_t Size, uint64_t Alignment, Allocation& OutAllocation);
+
+	uint32_t CreateBlock(EGeometryType Type, uint64_t MinSize);
+
+	void TransitionBlock(CRHICommandList* CommandList, Block& InBlock, ERHIResourceState State);
+
+	static ERHIResourceState GetReadState(EGeometryType Type);
+
+	CRHIDevice* Device;
+
+	uint64_t BlockSize;
+
+	std::vector<Block> Blocks;
+
+	std::vector<uint32_t> FreeBlockSlots;
+
+	// Indexed by handle
+	std::vector<Allocation> Allocations;
+
+	std::vector<uint32_t> FreeHandles;
+
+	// Released since BeginFrame
+	RetiredFrame FrameRetired;
+
+	// Released by the frames in flight, oldest first
+	std::deque<RetiredFrame> InFlightRetired;
+
+	// Source of the copies into the blocks
+	CUploadAllocator StagingAllocator;
+};
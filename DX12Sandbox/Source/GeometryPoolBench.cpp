@@ -0,0 +1,85 @@
+#include "pch.h"
+#include "Bench.h"
+#include "GeometryPool.h"
+
+#include <vector>
+
+bool RunGeometryPoolChecks()
+{
+	// Blocks of 8 allocations of 8 KB, so two blocks hold 16 of them
+	CNullUploadContext Context;
+	const uint64_t BlockSize = 64 * 1024;
+	const uint64_t AllocationSize = 8 * 1024;
+	CGeometryPool* Pool = new CGeometryPool(Context.Device, BlockSize);
+	CRHIFence* Fence = Context.Device->CreateFence(0);
+	uint64_t FenceValue = 0;
+
+	// The GPU is instant, the frame is done as soon as it is submitted
+	auto EndFrame = [&]()
+	{
+		Pool->EndFrame(Fence, ++FenceValue);
+		Context.Device->Signal(Fence, FenceValue);
+		Pool->BeginFrame();
+	};
+
+	const std::vector<uint8_t> Data(AllocationSize);
+	std::vector<uint32_t> Handles;
+	for (int Index = 0; Index < 16; ++Index)
+	{
+		Handles.push_back(Pool->Allocate(Context.CommandList, EGeometryType::Vertex, Data.data(), AllocationSize));
+	}
+	EndFrame();
+	bool bPassed = Check(Pool->GetBlockCount() == 2 && Pool->GetUsedSize() == 16 * AllocationSize,
+		"geometry pool : 16 allocations in %u blocks, %llu KB used", Pool->GetBlockCount(), (unsigned long long)(Pool->GetUsedSize() / 1024));
+
+	// Two allocations left in each block, both a quarter full
+	const uint32_t Kept[] = { Handles[0], Handles[5], Handles[9], Handles[14] };
+	for (int Index = 0; Index < 16; ++Index)
+	{
+		if (Index != 0 && Index != 5 && Index != 9 && Index != 14)
+		{
+			Pool->Free(Handles[Index]);
+		}
+	}
+	EndFrame();
+	bPassed &= Check(Pool->GetBlockCount() == 2 && Pool->GetUsedSize() == 4 * AllocationSize,
+		"geometry pool : freed ranges return to their blocks after the fence, %llu KB used", (unsigned long long)(Pool->GetUsedSize() / 1024));
+
+	// Both blocks are emptied into a new one, they stay alive until the frames reading them are done
+	const uint32_t MovedCount = Pool->Defragment(Context.CommandList);
+	const uint32_t BlocksBeforeFence = Pool->GetBlockCount();
+	EndFrame();
+	bPassed &= Check(MovedCount == 4 && BlocksBeforeFence == 3 && Pool->GetBlockCount() == 1,
+		"geometry pool : defragmenting moved %u allocations, %u blocks until the fence then %u", MovedCount, BlocksBeforeFence, Pool->GetBlockCount());
+	bPassed &= Check(Pool->GetUsedSize() == 4 * AllocationSize && Pool->GetReservedSize() - Pool->GetUsedSize() == BlockSize - 4 * AllocationSize,
+		"geometry pool : %llu KB used and %llu KB free after defragmenting", (unsigned long long)(Pool->GetUsedSize() / 1024),
+		(unsigned long long)((Pool->GetReservedSize() - Pool->GetUsedSize()) / 1024));
+
+	// The handles still work, each in its own range of the new block
+	bool bViewsValid = true;
+	for (uint32_t Handle : Kept)
+	{
+		const RHIVertexBufferView View = Pool->GetVertexBufferView(Handle, 16);
+		for (uint32_t Other : Kept)
+		{
+			const RHIVertexBufferView OtherView = Pool->GetVertexBufferView(Other, 16);
+			bViewsValid &= Other == Handle || View.BufferLocation + View.SizeInBytes <= OtherView.BufferLocation
+				|| OtherView.BufferLocation + OtherView.SizeInBytes <= View.BufferLocation;
+		}
+		bViewsValid &= View.SizeInBytes == AllocationSize;
+	}
+	bPassed &= Check(bViewsValid, "geometry pool : the moved handles keep their size and don't overlap");
+
+	// Freeing the moved allocations empties the new block
+	for (uint32_t Handle : Kept)
+	{
+		Pool->Free(Handle);
+	}
+	EndFrame();
+	bPassed &= Check(Pool->GetUsedSize() == 0, "geometry pool : nothing used once every allocation is freed");
+
+	Pool->FinishUploads(Context.CommandList);
+	delete Pool;
+	SAFE_RELEASE(Fence);
+	return bPassed;
+}
@@ -0,0 +1,307 @@
+#include "pch.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+
+static const int64_t DequeMask = CWorkStealingDeque::Capacity - 1;
+
+// Times an idle worker looks for a job before it sleeps, bursts of small jobs don't pay for a wake up
+static const uint32_t MaxIdleSpins = 64;
+
+// Queue of the calling thread and the start it was claimed in
+static thread_local uint32_t ThreadQueueIndex = UINT32_MAX;
+static thread_local uint32_t ThreadGeneration = 0;
+
+// Deque the calling thread steals from first, moves on so the thieves spread out
+static thread_local uint32_t NextVictim = 0;
+
+/* Deque */
+
+bool CWorkStealingDeque::Push(Job* NewJob)
+{
+	const int64_t CurrentBottom = Bottom.load(std::memory_order_relaxed);
+	const int64_t CurrentTop = Top.load(std::memory_order_acquire);
+	if (CurrentBottom - CurrentTop >= Capacity)
+	{
+		return false;
+	}
+
+	// The release publishes the job to the thieves
+	Slots[CurrentBottom & DequeMask].store(NewJob, std::memory_order_relaxed);
+	Bottom.store(CurrentBottom + 1, std::memory_order_release);
+	return true;
+}
+
+Job* CWorkStealingDeque::Pop()
+{
+	// Claims the bottom before looking at the top, a thief reading Bottom after this can't take the same job
+	const int64_t NewBottom = Bottom.load(std::memory_order_relaxed) - 1;
+	Bottom.store(NewBottom, std::memory_order_seq_cst);
+	int64_t CurrentTop = Top.load(std::memory_order_seq_cst);
+
+	if (CurrentTop > NewBottom)
+	{
+		// Empty
+		Bottom.store(NewBottom + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Job* Popped = Slots[NewBottom & DequeMask].load(std::memory_order_relaxed);
+	if (CurrentTop == NewBottom)
+	{
+		// The last job, the thieves may be after it too
+		if (!Top.compare_exchange_strong(CurrentTop, CurrentTop + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		{
+			Popped = nullptr;
+		}
+		Bottom.store(NewBottom + 1, std::memory_order_relaxed);
+	}
+	return Popped;
+}
+
+Job* CWorkStealingDeque::Steal()
+{
+	int64_t CurrentTop = Top.load(std::memory_order_seq_cst);
+	const int64_t CurrentBottom = Bottom.load(std::memory_order_seq_cst);
+	if (CurrentTop >= CurrentBottom)
+	{
+		return nullptr;
+	}
+
+	// Only ours if nobody moved the top meanwhile, the owner popping the last job included
+	Job* Stolen = Slots[CurrentTop & DequeMask].load(std::memory_order_relaxed);
+	if (!Top.compare_exchange_strong(CurrentTop, CurrentTop + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+	{
+		return nullptr;
+	}
+	return Stolen;
+}
+
+/* Job System */
+
+CJobSystem& CJobSystem::Get()
+{
+	static CJobSystem Instance;
+	return Instance;
+}
+
+CJobSystem::CJobSystem()
+{
+	Start();
+}
+
+CJobSystem::~CJobSystem()
+{
+	Stop();
+}
+
+void CJobSystem::Start(uint32_t ThreadCount)
+{
+	Stop();
+
+	if (ThreadCount == 0)
+	{
+		ThreadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+	WorkerCount = ThreadCount - 1;
+	++Generation;
+
+	Queues.clear();
+	for (uint32_t Index = 0; Index < WorkerCount + MaxExternalThreads; ++Index)
+	{
+		Queues.push_back(std::unique_ptr<ThreadQueue>(new ThreadQueue));
+	}
+	NextExternalQueue = 0;
+	QueuedJobs = 0;
+	bStopping = false;
+
+	for (uint32_t Index = 0; Index < WorkerCount; ++Index)
+	{
+		Workers.emplace_back(&CJobSystem::WorkerLoop, this, Index);
+	}
+}
+
+void CJobSystem::Stop()
+{
+	{
+		std::lock_guard<std::mutex> Lock(SleepMutex);
+		bStopping = true;
+	}
+	WakeCondition.notify_all();
+
+	for (std::thread& Worker : Workers)
+	{
+		Worker.join();
+	}
+	Workers.clear();
+}
+
+CJobSystem::ThreadQueue* CJobSystem::GetThreadQueue()
+{
+	if (ThreadGeneration != Generation)
+	{
+		ThreadGeneration = Generation;
+		const uint32_t External = NextExternalQueue.fetch_add(1, std::memory_order_relaxed);
+		ThreadQueueIndex = External < MaxExternalThreads ? WorkerCount + External : UINT32_MAX;
+	}
+	return ThreadQueueIndex < Queues.size() ? Queues[ThreadQueueIndex].get() : nullptr;
+}
+
+Job* CJobSystem::AllocateJob(ThreadQueue* Queue)
+{
+	// The oldest slot, still running only when this thread submitted a whole ring of jobs without waiting
+	Job* Slot = &Queue->Ring[Queue->NextJob++ % ThreadQueue::RingSize];
+	while (!Slot->bFinished.load(std::memory_order_acquire))
+	{
+		if (Job* ReadyJob = FindJob(Queue))
+		{
+			Execute(ReadyJob);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+	Slot->bFinished.store(false, std::memory_order_relaxed);
+	return Slot;
+}
+
+void CJobSystem::Submit(Job* NewJob, CJobCounter* Dependency)
+{
+	if (Dependency)
+	{
+		// The thread finishing the last job of Dependency takes the lock after its decrement, it sees the job
+		std::lock_guard<std::mutex> Lock(Dependency->DependentsMutex);
+		if (Dependency->Count.load(std::memory_order_acquire) > 0)
+		{
+			Dependency->Dependents.push_back(NewJob);
+			return;
+		}
+	}
+	Push(NewJob);
+}
+
+void CJobSystem::Push(Job* ReadyJob)
+{
+	ThreadQueue* Queue = GetThreadQueue();
+	if (!Queue || !Queue->Deque.Push(ReadyJob))
+	{
+		Execute(ReadyJob);
+		return;
+	}
+
+	// Sleeping workers count themselves before checking QueuedJobs, one of the two sides sees the other
+	QueuedJobs.fetch_add(1, std::memory_order_seq_cst);
+	if (SleepingWorkers.load(std::memory_order_seq_cst) > 0)
+	{
+		std::lock_guard<std::mutex> Lock(SleepMutex);
+		WakeCondition.notify_one();
+	}
+}
+
+Job* CJobSystem::FindJob(ThreadQueue* Queue)
+{
+	if (Queue)
+	{
+		if (Job* Popped = Queue->Deque.Pop())
+		{
+			QueuedJobs.fetch_sub(1, std::memory_order_relaxed);
+			return Popped;
+		}
+	}
+
+	const uint32_t QueueCount = uint32_t(Queues.size());
+	for (uint32_t Attempt = 0; Attempt < QueueCount; ++Attempt)
+	{
+		ThreadQueue* Victim = Queues[(NextVictim + Attempt) % QueueCount].get();
+		if (Victim == Queue)
+		{
+			continue;
+		}
+		if (Job* Stolen = Victim->Deque.Steal())
+		{
+			NextVictim += Attempt + 1;
+			QueuedJobs.fetch_sub(1, std::memory_order_relaxed);
+			return Stolen;
+		}
+	}
+	return nullptr;
+}
+
+void CJobSystem::Execute(Job* ReadyJob)
+{
+	ReadyJob->Invoke(ReadyJob->Storage);
+
+	// The slot can be reused as soon as it is flagged
+	CJobCounter* Counter = ReadyJob->Counter;
+	ReadyJob->bFinished.store(true, std::memory_order_release);
+	if (Counter)
+	{
+		Finish(Counter);
+	}
+}
+
+void CJobSystem::Finish(CJobCounter* Counter)
+{
+	Counter->Releasing.fetch_add(1, std::memory_order_acq_rel);
+	if (Counter->Count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+	{
+		std::vector<Job*> ReadyJobs;
+		{
+			std::lock_guard<std::mutex> Lock(Counter->DependentsMutex);
+			ReadyJobs.swap(Counter->Dependents);
+		}
+		for (Job* ReadyJob : ReadyJobs)
+		{
+			Push(ReadyJob);
+		}
+	}
+	Counter->Releasing.fetch_sub(1, std::memory_order_release);
+}
+
+void CJobSystem::Wait(CJobCounter& Counter)
+{
+	ThreadQueue* Queue = GetThreadQueue();
+	while (!Counter.IsDone())
+	{
+		if (Job* ReadyJob = FindJob(Queue))
+		{
+			Execute(ReadyJob);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+void CJobSystem::WorkerLoop(uint32_t QueueIndex)
+{
+	ThreadQueueIndex = QueueIndex;
+	ThreadGeneration = Generation;
+	ThreadQueue* Queue = Queues[QueueIndex].get();
+
+	uint32_t IdleSpins = 0;
+	while (!bStopping.load(std::memory_order_acquire))
+	{
+		if (Job* ReadyJob = FindJob(Queue))
+		{
+			Execute(ReadyJob);
+			IdleSpins = 0;
+			continue;
+		}
+
+		if (++IdleSpins < MaxIdleSpins)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		// Nothing to run for a while, sleep until a job is queued
+		std::unique_lock<std::mutex> Lock(SleepMutex);
+		SleepingWorkers.fetch_add(1, std::memory_order_seq_cst);
+		WakeCondition.wait(Lock, [this]() { return QueuedJobs.load(std::memory_order_seq_cst) > 0 || bStopping.load(); });
+		SleepingWorkers.fetch_sub(1, std::memory_order_relaxed);
+		IdleSpins = 0;
+	}
+}
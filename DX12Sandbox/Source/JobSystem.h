@@ -0,0 +1,244 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "pch.h"
+
+// A function and what it captured, copied into a slot of the ring of the thread that submitted it
+struct alignas(64) Job
+{
+	static constexpr size_t StorageSize = 88;
+
+	void (*Invoke)(void* Storage) = nullptr;
+
+	class CJobCounter* Counter = nullptr;
+
+	// Cleared when the slot is handed out, set once the job ran, the slot can be reused then
+	std::atomic<bool> bFinished{ true };
+
+	alignas(16) unsigned char Storage[StorageSize];
+};
+
+// Unfinished jobs of a group, the group is done at 0. Jobs can be held back until a counter is done
+class CJobCounter
+{
+public:
+	CJobCounter() = default;
+
+	CJobCounter(const CJobCounter&) = delete;
+	CJobCounter& operator=(const CJobCounter&) = delete;
+
+	bool IsDone() const
+	{
+		// The thread finishing the last job may still be releasing the dependents
+		return Count.load(std::memory_order_acquire) == 0 && Releasing.load(std::memory_order_acquire) == 0;
+	}
+
+private:
+	friend class CJobSystem;
+
+	std::atomic<uint32_t> Count{ 0 };
+
+	// Threads between their decrement and the end of the release of the dependents, the counter must outlive them
+	std::atomic<uint32_t> Releasing{ 0 };
+
+	// Jobs submitted with this counter as their dependency before it was done, only locked by those
+	std::mutex DependentsMutex;
+	std::vector<Job*> Dependents;
+};
+
+// Fixed size lock free deque (Chase-Lev), the owner pushes and pops at the bottom, the other threads steal from the top
+class CWorkStealingDeque
+{
+public:
+	static constexpr int64_t Capacity = 4096;
+
+	// Owner only, false when full
+	bool Push(Job* NewJob);
+
+	// Owner only, the last pushed job
+	Job* Pop();
+
+	// Any thread, the oldest job
+	Job* Steal();
+
+	bool IsEmpty() const
+	{
+		return Bottom.load(std::memory_order_relaxed) <= Top.load(std::memory_order_relaxed);
+	}
+
+private:
+	std::atomic<int64_t> Top{ 0 };
+	std::atomic<int64_t> Bottom{ 0 };
+	std::atomic<Job*> Slots[Capacity] = {};
+};
+
+// Worker threads running jobs from a deque per thread, stealing from the others when theirs is empty.
+// Jobs live in a ring per submitting thread, submitting never allocates. A thread waiting for a counter runs jobs
+// meanwhile, so jobs can wait for other jobs. The thread calling Get first is not a worker, it helps while it waits
+class CJobSystem
+{
+public:
+	// Started with a thread per core on first use
+	static CJobSystem& Get();
+
+	~CJobSystem();
+
+	// ThreadCount counts the thread waiting, it starts ThreadCount - 1 workers, 0 for a thread per core.
+	// Stops the running workers first, no job may be left
+	void Start(uint32_t ThreadCount = 0);
+
+	void Stop();
+
+	// Workers and the thread waiting
+	uint32_t GetThreadCount() const
+	{
+		return WorkerCount + 1;
+	}
+
+	// Runs Function() on any thread. Counter, when given, counts the job until it ran, Dependency holds it back until
+	// it is done. Function is copied into the job, capture by reference or pointer
+	template<typename FunctionType>
+	void Run(const FunctionType& Function, CJobCounter* Counter = nullptr, CJobCounter* Dependency = nullptr);
+
+	// Runs jobs until Counter is done
+	void Wait(CJobCounter& Counter);
+
+	// Function(Begin, End) over [0, Count) in ranges of BatchSize, on at most MaxJobs threads (0 for all), returns once done.
+	// Ranges are claimed with an atomic add, a batch costs no job, so small batches are fine
+	template<typename FunctionType>
+	void ParallelFor(size_t Count, size_t BatchSize, const FunctionType& Function, uint32_t MaxJobs = 0);
+
+private:
+	CJobSystem();
+
+	// The deque and the job ring of a thread
+	struct ThreadQueue
+	{
+		CWorkStealingDeque Deque;
+
+		static constexpr uint32_t RingSize = 4096;
+		Job Ring[RingSize];
+		uint32_t NextJob = 0;
+	};
+
+	// Threads besides the workers that may submit jobs, the game and render threads. Any other one runs its jobs inline
+	static constexpr uint32_t MaxExternalThreads = 7;
+
+	// Queue of the calling thread, claimed on first use, nullptr when none is left
+	ThreadQueue* GetThreadQueue();
+
+	// A free slot of the ring of Queue, runs jobs until the oldest one is done if it isn't
+	Job* AllocateJob(ThreadQueue* Queue);
+
+	// Queues the job, or parks it on Dependency until it is done
+	void Submit(Job* NewJob, CJobCounter* Dependency);
+
+	// Pushes on the deque of the calling thread, runs the job when there is no room
+	void Push(Job* ReadyJob);
+
+	// Pops the calling thread's deque, then steals
+	Job* FindJob(ThreadQueue* Queue);
+
+	void Execute(Job* ReadyJob);
+
+	// Counts one job of Counter as done, queues its dependents when it was the last one
+	void Finish(CJobCounter* Counter);
+
+	void WorkerLoop(uint32_t QueueIndex);
+
+	uint32_t WorkerCount = 0;
+
+	// Workers first, then the external threads
+	std::vector<std::unique_ptr<ThreadQueue>> Queues;
+	std::atomic<uint32_t> NextExternalQueue{ 0 };
+
+	// Bumped by Start, queue indices kept by threads from a previous start are stale
+	uint32_t Generation = 0;
+
+	std::vector<std::thread> Workers;
+	std::atomic<bool> bStopping{ false };
+
+	// Idle workers sleep until a job is queued, pushing only locks when one is asleep
+	std::atomic<int32_t> QueuedJobs{ 0 };
+	std::atomic<uint32_t> SleepingWorkers{ 0 };
+	std::mutex SleepMutex;
+	std::condition_variable WakeCondition;
+};
+
+template<typename FunctionType>
+void CJobSystem::Run(const FunctionType& Function, CJobCounter* Counter, CJobCounter* Dependency)
+{
+	static_assert(std::is_trivially_copyable<FunctionType>::value && sizeof(FunctionType) <= Job::StorageSize
+		&& alignof(FunctionType) <= 16, "Jobs copy their function into a fixed slot, capture by reference or pointer");
+
+	if (Counter)
+	{
+		Counter->Count.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	ThreadQueue* Queue = GetThreadQueue();
+	if (!Queue)
+	{
+		// No ring to put the job in, run it now
+		if (Dependency)
+		{
+			Wait(*Dependency);
+		}
+		Function();
+		if (Counter)
+		{
+			Finish(Counter);
+		}
+		return;
+	}
+
+	Job* NewJob = AllocateJob(Queue);
+	new (NewJob->Storage) FunctionType(Function);
+	NewJob->Invoke = [](void* Storage) { (*static_cast<FunctionType*>(Storage))(); };
+	NewJob->Counter = Counter;
+	Submit(NewJob, Dependency);
+}
+
+template<typename FunctionType>
+void CJobSystem::ParallelFor(size_t Count, size_t BatchSize, const FunctionType& Function, uint32_t MaxJobs)
+{
+	BatchSize = BatchSize > 0 ? BatchSize : 1;
+	const size_t BatchCount = (Count + BatchSize - 1) / BatchSize;
+	size_t JobCount = MaxJobs > 0 && MaxJobs < GetThreadCount() ? MaxJobs : GetThreadCount();
+	JobCount = JobCount < BatchCount ? JobCount : BatchCount;
+	if (JobCount <= 1)
+	{
+		if (Count > 0)
+		{
+			Function(size_t(0), Count);
+		}
+		return;
+	}
+
+	// Every job takes batches until there are none left, the calling thread being one of them
+	std::atomic<size_t> NextBatch(0);
+	auto RunBatches = [&NextBatch, BatchCount, BatchSize, Count, &Function]()
+	{
+		for (size_t Batch = NextBatch.fetch_add(1, std::memory_order_relaxed); Batch < BatchCount; Batch = NextBatch.fetch_add(1, std::memory_order_relaxed))
+		{
+			const size_t Begin = Batch * BatchSize;
+			Function(Begin, Begin + BatchSize < Count ? Begin + BatchSize : Count);
+		}
+	};
+
+	CJobCounter Counter;
+	for (size_t Index = 1; Index < JobCount; ++Index)
+	{
+		Run(RunBatches, &Counter);
+	}
+	RunBatches();
+	Wait(Counter);
+}
@@ -0,0 +1,156 @@
+#include "pch.h"
+#include "Bench.h"
+#include "Camera.h"
+#include "JobSystem.h"
+#include "Renderer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+void RunJobSystemBenchmarks()
+{
+	// The job system from 1 thread to every core : tiny jobs, a parallel for over 1M matrices, then the frame stages of
+	// a renderer with a draw per cube on the Null backend
+	const uint32_t CoreCount = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<XMFLOAT4X4> Matrices(1 << 20);
+	for (uint32_t ThreadCount = 1; ; ThreadCount = std::min(ThreadCount * 2, CoreCount))
+	{
+		CJobSystem::Get().Start(ThreadCount);
+
+		const int TinyJobCount = 1 << 16;
+		std::atomic<int> TinyJobsRun(0);
+		const double TinyJobNs = MeasureNs(1, [&](int)
+		{
+			CJobCounter Counter;
+			for (int Index = 0; Index < TinyJobCount; ++Index)
+			{
+				CJobSystem::Get().Run([&TinyJobsRun]() { TinyJobsRun.fetch_add(1, std::memory_order_relaxed); }, &Counter);
+			}
+			CJobSystem::Get().Wait(Counter);
+		}) / TinyJobCount;
+
+		const double ParallelForMs = MeasureNs(4, [&](int Iteration)
+		{
+			const XMMATRIX Rotation = XMMatrixRotationRollPitchYaw(float(Iteration), 0.5f, 0.25f);
+			CJobSystem::Get().ParallelFor(Matrices.size(), 1024, [&](size_t Begin, size_t End)
+			{
+				for (size_t Index = Begin; Index < End; ++Index)
+				{
+					XMStoreFloat4x4(&Matrices[Index], XMMatrixMultiply(Rotation, XMMatrixTranslation(float(Index), 0.0f, 0.0f)));
+				}
+			});
+		}) / 1e6;
+
+		CRenderer* BenchRenderer = new CRenderer;
+		BenchRenderer->Backend = ERHIBackend::Null;
+		BenchRenderer->ObjectCount = 65536;
+		BenchRenderer->bInstancing = false;
+		BenchRenderer->TicksPerUpdate = 1;
+		if (BenchRenderer->Init())
+		{
+			// Far enough back to see the whole grid, one frame so the upload pages exist before measuring
+			BenchRenderer->SceneCamera->SetPosition(XMFLOAT3(0.0f, 0.0f, -150.0f));
+			BenchRenderer->Update();
+			BenchRenderer->Render();
+			BenchRenderer->Stats = RendererStats();
+
+			const int BenchFrames = 16;
+			for (int Frame = 0; Frame < BenchFrames; ++Frame)
+			{
+				BenchRenderer->Update();
+				BenchRenderer->Render();
+			}
+			const RendererStats& FrameStats = BenchRenderer->Stats;
+			printf("%2u threads : %.0f ns/tiny job, parallel for %.2f ms, %u draws : transforms %.2f ms, culling %.2f ms, recording %.2f ms\n",
+				ThreadCount, TinyJobNs, ParallelForMs, BenchRenderer->DrawList.GetCount(),
+				FrameStats.TransformUpdateMs / BenchFrames, FrameStats.CullingMs / BenchFrames, FrameStats.RecordingMs / BenchFrames);
+		}
+		BenchRenderer->Cleanup();
+		delete BenchRenderer;
+
+		if (ThreadCount == CoreCount)
+		{
+			break;
+		}
+	}
+	CJobSystem::Get().Start();
+}
+
+bool RunJobSystemChecks()
+{
+	// Three stages, each held back by the counter of the one before : every job must see the whole previous stage done.
+	// Repeated so the workers race the submission in every possible order, with a few workers even on a single core
+	CJobSystem::Get().Start(4);
+	const int Rounds = 2000;
+	const int JobsPerStage = 16;
+	std::atomic<int> FirstRun(0), SecondRun(0), LastRun(0), OutOfOrder(0);
+	for (int Round = 0; Round < Rounds; ++Round)
+	{
+		FirstRun = 0;
+		SecondRun = 0;
+		CJobCounter First, Second, Last;
+		for (int Index = 0; Index < JobsPerStage; ++Index)
+		{
+			CJobSystem::Get().Run([&FirstRun]() { FirstRun.fetch_add(1); }, &First);
+		}
+		for (int Index = 0; Index < JobsPerStage; ++Index)
+		{
+			CJobSystem::Get().Run([&FirstRun, &SecondRun, &OutOfOrder]()
+			{
+				OutOfOrder.fetch_add(FirstRun.load() == JobsPerStage ? 0 : 1);
+				SecondRun.fetch_add(1);
+			}, &Second, &First);
+		}
+		CJobSystem::Get().Run([&SecondRun, &LastRun, &OutOfOrder]()
+		{
+			OutOfOrder.fetch_add(SecondRun.load() == JobsPerStage ? 0 : 1);
+			LastRun.fetch_add(1);
+		}, &Last, &Second);
+		// The counters must outlive the threads still releasing their dependents
+		CJobSystem::Get().Wait(First);
+		CJobSystem::Get().Wait(Second);
+		CJobSystem::Get().Wait(Last);
+	}
+
+	// A dependency already done doesn't hold the job back
+	CJobCounter Done, AfterDone;
+	std::atomic<bool> bRanAfterDone(false);
+	CJobSystem::Get().Run([&bRanAfterDone]() { bRanAfterDone = true; }, &AfterDone, &Done);
+	CJobSystem::Get().Wait(AfterDone);
+
+	// Floods of tiny jobs from a single worker to every core : none may be lost or run twice, and the wait returns only
+	// once they all ran
+	const uint32_t CoreCount = std::max(1u, std::thread::hardware_concurrency());
+	const int TinyJobCount = 1 << 16;
+	int LostJobs = 0;
+	for (uint32_t ThreadCount = 1; ; ThreadCount = std::min(ThreadCount * 2, CoreCount))
+	{
+		CJobSystem::Get().Start(ThreadCount);
+		for (int Round = 0; Round < 4; ++Round)
+		{
+			std::atomic<int> TinyJobsRun(0);
+			CJobCounter Counter;
+			for (int Index = 0; Index < TinyJobCount; ++Index)
+			{
+				CJobSystem::Get().Run([&TinyJobsRun]() { TinyJobsRun.fetch_add(1, std::memory_order_relaxed); }, &Counter);
+			}
+			CJobSystem::Get().Wait(Counter);
+			LostJobs += std::abs(TinyJobCount - TinyJobsRun.load());
+		}
+		if (ThreadCount == CoreCount)
+		{
+			break;
+		}
+	}
+
+	bool bPassed = Check(OutOfOrder == 0 && LastRun == Rounds, "job dependencies : %d rounds of 3 dependent stages on %u threads, %d jobs ran early",
+		Rounds, CJobSystem::Get().GetThreadCount(), OutOfOrder.load());
+	bPassed &= Check(bRanAfterDone, "job dependencies : a job depending on a done counter runs");
+	bPassed &= Check(LostJobs == 0, "job system : %d tiny jobs lost or run twice from 1 to %u threads", LostJobs, CoreCount);
+	CJobSystem::Get().Start();
+	return bPassed;
+}
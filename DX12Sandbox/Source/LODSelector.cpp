@@ -0,0 +1,101 @@
+#include "pch.h"
+#include "LODSelector.h"
+
+#include <algorithm>
+#include <cfloat>
+
+// Spheres closer than this are treated as this close, the camera inside a sphere gets the full mesh
+static const float MinDistance = 0.001f;
+
+void CLODSelector::Resize(uint32_t InCount)
+{
+	for (std::vector<float>& Errors : LODErrors)
+	{
+		Errors.resize(InCount, FLT_MAX);
+	}
+	CurrentLODs.resize(InCount, 0);
+	Count = InCount;
+}
+
+void CLODSelector::SetLODErrors(uint32_t Index, const float* RelativeErrors, uint32_t ReducedLODCount)
+{
+	for (uint32_t Reduced = 0; Reduced < MESH_MAX_LODS - 1; ++Reduced)
+	{
+		LODErrors[Reduced][Index] = Reduced < ReducedLODCount ? RelativeErrors[Reduced] : FLT_MAX;
+	}
+}
+
+uint32_t CLODSelector::Select(const CFrustumCuller& Spheres, const XMFLOAT3& CameraPosition, float ProjectionScale,
+	const uint32_t* Visible, uint32_t VisibleCount, uint32_t* OutVisible, uint8_t* OutLODs)
+{
+	const XMVECTOR CameraX = XMVectorReplicate(CameraPosition.x);
+	const XMVECTOR CameraY = XMVectorReplicate(CameraPosition.y);
+	const XMVECTOR CameraZ = XMVectorReplicate(CameraPosition.z);
+	const XMVECTOR Scale = XMVectorReplicate(ProjectionScale);
+	const XMVECTOR ClosestDistance = XMVectorReplicate(MinDistance);
+	const XMVECTOR MaxError = XMVectorReplicate(MaxPixelError);
+	const XMVECTOR MaxCoarserError = XMVectorReplicate(MaxPixelError * Hysteresis);
+	const XMVECTOR MinRadius = XMVectorReplicate(MinPixelRadius);
+	const XMVECTOR MinShownRadius = XMVectorReplicate(MinPixelRadius * Hysteresis);
+	const XMVECTOR Dropped = XMVectorReplicate(float(LOD_DROPPED));
+	const XMVECTOR Zero = XMVectorZero();
+	const XMVECTOR One = XMVectorSplatOne();
+
+	uint32_t SelectedCount = 0;
+	for (uint32_t First = 0; First < VisibleCount; First += 4)
+	{
+		// The last group repeats its last object, the extra lanes are never written
+		uint32_t Indices[4];
+		for (uint32_t Lane = 0; Lane < 4; ++Lane)
+		{
+			Indices[Lane] = Visible[std::min(First + Lane, VisibleCount - 1)];
+		}
+
+		// One sphere per row, transposed to one component per vector
+		const XMMATRIX Gathered = XMMatrixTranspose(XMMATRIX(Spheres.GetSphere(Indices[0]), Spheres.GetSphere(Indices[1]),
+			Spheres.GetSphere(Indices[2]), Spheres.GetSphere(Indices[3])));
+		const XMVECTOR DeltaX = Gathered.r[0] - CameraX;
+		const XMVECTOR DeltaY = Gathered.r[1] - CameraY;
+		const XMVECTOR DeltaZ = Gathered.r[2] - CameraZ;
+		const XMVECTOR Radius = Gathered.r[3];
+
+		// Pixels per world unit at the closest point of the sphere
+		const XMVECTOR CenterDistance = XMVectorSqrt(DeltaX * DeltaX + DeltaY * DeltaY + DeltaZ * DeltaZ);
+		const XMVECTOR PixelsPerUnit = Scale / XMVectorMax(CenterDistance - Radius, ClosestDistance);
+		const XMVECTOR PixelsPerRadius = Radius * PixelsPerUnit;
+
+		const XMVECTOR Current = XMVectorSet(float(CurrentLODs[Indices[0]]), float(CurrentLODs[Indices[1]]),
+			float(CurrentLODs[Indices[2]]), float(CurrentLODs[Indices[3]]));
+
+		// Errors grow with the level, the number of levels under their threshold is the LOD
+		XMVECTOR Level = Zero;
+		for (uint32_t Reduced = 0; Reduced < MESH_MAX_LODS - 1; ++Reduced)
+		{
+			const std::vector<float>& Errors = LODErrors[Reduced];
+			const XMVECTOR Error = XMVectorSet(Errors[Indices[0]], Errors[Indices[1]], Errors[Indices[2]], Errors[Indices[3]]) * PixelsPerRadius;
+			const XMVECTOR Coarser = XMVectorGreater(XMVectorReplicate(float(Reduced + 1)), Current);
+			Level = Level + XMVectorSelect(Zero, One, XMVectorLessOrEqual(Error, XMVectorSelect(MaxError, MaxCoarserError, Coarser)));
+		}
+
+		// Dropped objects come back at the full threshold, shown ones leave under the lower one
+		const XMVECTOR WasDropped = XMVectorEqual(Current, Dropped);
+		const XMVECTOR Shown = XMVectorGreaterOrEqual(PixelsPerRadius, XMVectorSelect(MinShownRadius, MinRadius, WasDropped));
+		Level = XMVectorSelect(Dropped, Level, Shown);
+
+		XMFLOAT4 Levels;
+		XMStoreFloat4(&Levels, Level);
+		const uint8_t LaneLevels[4] = { uint8_t(Levels.x), uint8_t(Levels.y), uint8_t(Levels.z), uint8_t(Levels.w) };
+
+		// Same branchless compaction as the culler, Indices are read before OutVisible can overwrite Visible
+		const uint32_t LaneCount = std::min(4u, VisibleCount - First);
+		for (uint32_t Lane = 0; Lane < LaneCount; ++Lane)
+		{
+			CurrentLODs[Indices[Lane]] = LaneLevels[Lane];
+			OutVisible[SelectedCount] = Indices[Lane];
+			OutLODs[SelectedCount] = LaneLevels[Lane];
+			SelectedCount += LaneLevels[Lane] != LOD_DROPPED ? 1 : 0;
+		}
+	}
+
+	return SelectedCount;
+}
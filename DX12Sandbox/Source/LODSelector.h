@@ -0,0 +1,58 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+#include "pch.h"
+#include "FrustumCuller.h"
+#include "Mesh.h"
+
+using namespace DirectX;
+
+// Value of OutLODs for the objects Select drops
+#define LOD_DROPPED 0xFF
+
+// Picks the LOD of the visible objects from the size of their bounding sphere on screen, 4 objects at a time.
+// The spheres come from the frustum culler, the LOD errors are stored relative to the radius so they follow the scale
+class CLODSelector
+{
+public:
+
+	// Sets the number of objects, new ones have a single LOD until SetLODErrors
+	void Resize(uint32_t InCount);
+
+	// Errors of the reduced LODs divided by the local bounding radius, from the most to the least detailed
+	void SetLODErrors(uint32_t Index, const float* RelativeErrors, uint32_t ReducedLODCount);
+
+	// ProjectionScale converts a size at distance 1 to pixels, see GetProjectionScale
+	// Writes in OutVisible the entries of Visible big enough to be drawn and their LOD in OutLODs, returns their count
+	// OutVisible can be Visible, both need room for the padded count of the culler
+	uint32_t Select(const CFrustumCuller& Spheres, const XMFLOAT3& CameraPosition, float ProjectionScale,
+		const uint32_t* Visible, uint32_t VisibleCount, uint32_t* OutVisible, uint8_t* OutLODs);
+
+	// Half the viewport height over tan(FOV / 2), read from the projection matrix
+	static float GetProjectionScale(const XMFLOAT4X4& ProjectionMatrix, float ViewportHeight)
+	{
+		return ProjectionMatrix._22 * ViewportHeight * 0.5f;
+	}
+
+	// Largest distance in pixels between a LOD and the full mesh
+	float MaxPixelError = 1.0f;
+
+	// Objects whose radius is smaller than this on screen aren't drawn
+	float MinPixelRadius = 0.5f;
+
+	// A coarser LOD, or dropping the object, needs to get under Hysteresis times the threshold. Objects near a threshold
+	// don't switch back and forth every frame
+	float Hysteresis = 0.75f;
+
+private:
+
+	uint32_t Count = 0;
+
+	// Errors of level 1 to MESH_MAX_LODS - 1, one array per level, FLT_MAX past the last LOD of the object
+	std::vector<float> LODErrors[MESH_MAX_LODS - 1];
+
+	// LOD of the last frame the object was visible
+	std::vector<uint8_t> CurrentLODs;
+};
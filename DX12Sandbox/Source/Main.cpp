@@ -2,9 +2,18 @@
 
 #include "Camera.h"
 #include "Renderer.h"
+#include "JobSystem.h"
+#include "UploadAllocator.h"
+#include "GeometryPool.h"
+#include "Bench.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 
 CRenderer* Renderer = nullptr;
 
+#ifdef _WIN32
+
 LRESULT CALLBACK WindowProcess(HWND HWnd, UINT Message, WPARAM WParam, LPARAM LParam)
 {
 	switch (Message)
@@ -14,30 +23,7 @@ LRESULT CALLBACK WindowProcess(HWND HWnd, UINT Message, WPARAM WParam, LPARAM LP
 		{
 			DestroyWindow(HWnd);
 		}
-		if (WParam == 'Z' && Renderer)
-		{
-			Renderer->SceneCamera->MoveForward(1.0f);
-		}
-		if (WParam == 'S' && Renderer)
-		{
-			Renderer->SceneCamera->MoveForward(-1.0f);
-		}
-		if (WParam == 'D' && Renderer)
-		{
-			Renderer->SceneCamera->MoveRight(1.0f);
-		}
-		if (WParam == 'Q' && Renderer)
-		{
-			Renderer->SceneCamera->MoveRight(-1.0f);
-		}
-		if (WParam == 'A' && Renderer)
-		{
-			Renderer->SceneCamera->MoveUp(1.0f);
-		}
-		if (WParam == 'E' && Renderer)
-		{
-			Renderer->SceneCamera->MoveUp(-1.0f);
-		}
+		break;
 
 	case WM_DESTROY:
 		PostQuitMessage(0);
@@ -47,6 +33,12 @@ LRESULT CALLBACK WindowProcess(HWND HWnd, UINT Message, WPARAM WParam, LPARAM LP
 	return DefWindowProc(HWnd, Message, WParam, LParam);
 }
 
+// -1, 0 or 1 from two keys, as they are once the messages before are handled
+static float ReadAxis(int PositiveKey, int NegativeKey)
+{
+	return ((GetKeyState(PositiveKey) & 0x8000) ? 1.0f : 0.0f) - ((GetKeyState(NegativeKey) & 0x8000) ? 1.0f : 0.0f);
+}
+
 int CALLBACK WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nShowCmd)
 {
 	/* Create the Window Class */
@@ -80,6 +72,8 @@ int CALLBACK WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLi
 	if (!HWnd)
 	{
 		MessageBox(0, L"Failed to create the window! Aborting!", 0, 0);
+		delete Renderer;
+		Renderer = nullptr;
 		return 1;
 	}
 	ShowWindow(HWnd, SW_SHOW);
@@ -87,32 +81,167 @@ int CALLBACK WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLi
 	Renderer->HWindow = HWnd;
 	
 	// Initialize Direct3D
-	if (!Renderer->InitD3D())
+	if (!Renderer->Init())
 	{
 		MessageBox(0, L"Failed to init Direct3D! Aborting!", L"Error", MB_OK);
 		Renderer->Cleanup();
+		delete Renderer;
+		Renderer = nullptr;
 		return 1;
 	}	
 
+	// This thread simulates and handles the input, the frames are drawn one behind on the render thread
+	Renderer->StartRenderThread();
+
 	/* Handle Messages */
 	MSG Message = { 0 };
-	while (Message.message != WM_CLOSE && Renderer->bRunning)
+	bool bQuit = false;
+	while (!bQuit && Renderer->bRunning)
 	{
-		if (PeekMessage(&Message, 0, 0, 0, PM_REMOVE))
+		// Paced before the messages are read, the input of the frame is as recent as it can be
+		Renderer->BeginFrame();
+		while (PeekMessage(&Message, 0, 0, 0, PM_REMOVE))
 		{
+			bQuit |= Message.message == WM_QUIT;
 			TranslateMessage(&Message);
 			DispatchMessage(&Message);
 		}
-		else
+
+		// Polled once per frame, every tick of the frame moves the camera by what is held
+		Renderer->Input = CameraInput();
+		if (GetForegroundWindow() == HWnd)
 		{
-			Renderer->Update();
-			Renderer->Render();
+			Renderer->Input.Forward = ReadAxis('Z', 'S');
+			Renderer->Input.Right = ReadAxis('D', 'Q');
+			Renderer->Input.Up = ReadAxis('A', 'E');
 		}
+		Renderer->Update();
 	}
 
 	// Wait for the GPU to finish, then cleanup
-	Renderer->WaitForPreviousFrame();
-	CloseHandle(Renderer->FenceEvent);
+	Renderer->Cleanup();
+	delete Renderer;
+	Renderer = nullptr;
 
 	return 0;
-}
\ No newline at end of file
+}
+
+#else
+
+static void PrintStats(const RendererStats& FrameStats, const RHIStats& Stats, int FrameCount, double ElapsedMs)
+{
+	const double Frames = FrameCount > 0 ? double(FrameCount) : 1.0;
+
+	printf("Frames                  : %d\n", FrameCount);
+	printf("CPU frame time          : %.4f ms\n", ElapsedMs / Frames);
+	printf("Job threads             : %u\n", CJobSystem::Get().GetThreadCount());
+	printf("Simulation ticks        : %.2f /frame\n", FrameStats.SimulationTicks / Frames);
+	printf("Transform update        : %.4f ms/frame\n", FrameStats.TransformUpdateMs / Frames);
+	printf("Culling                 : %.4f ms/frame\n", FrameStats.CullingMs / Frames);
+	printf("Render snapshot         : %.4f ms/frame\n", FrameStats.SnapshotMs / Frames);
+	printf("Game / render waits     : %.4f / %.4f ms/frame\n", FrameStats.GameWaitMs / Frames, FrameStats.RenderWaitMs / Frames);
+	printf("CPU waiting for GPU     : %.4f ms/frame\n", FrameStats.CPUWaitForGPUMs / Frames);
+	printf("GPU waiting for CPU     : %.4f ms/frame\n", FrameStats.GPUWaitForCPUMs / Frames);
+	printf("Pacing delay            : %.4f ms/frame\n", FrameStats.PacingDelayMs / Frames);
+	printf("Input to GPU done       : %.4f ms avg, %.4f ms max\n", FrameStats.LatencyFrames > 0 ? FrameStats.InputLatencyMs / FrameStats.LatencyFrames : 0.0,
+		FrameStats.MaxInputLatencyMs);
+	printf("Visible objects         : %.1f / %.1f per frame\n", FrameStats.ObjectsVisible / Frames, FrameStats.ObjectsTested / Frames);
+	printf("Dropped as too small    : %.1f /frame\n", FrameStats.ObjectsDropped / Frames);
+	printf("LOD triangles           : %.1f /frame (%.1f saved)\n", FrameStats.TrianglesSelected / Frames, FrameStats.TrianglesSaved / Frames);
+	printf("Draw sorting            : %.4f ms/frame\n", FrameStats.SortingMs / Frames);
+	printf("Command recording       : %.4f ms/frame (%.4f ms/frame of CPU time)\n", FrameStats.RecordingMs / Frames, Stats.RecordTimeMs / Frames);
+	printf("Command lists           : %.1f /frame\n", Stats.CommandListsExecuted / Frames);
+	printf("Command submission      : %.4f ms/frame\n", Stats.SubmitTimeMs / Frames);
+	printf("Draw calls              : %.1f /frame (%.0f /s)\n", Stats.DrawCalls / Frames, Stats.DrawCalls / (ElapsedMs / 1000.0));
+	printf("Instances drawn         : %.1f /frame\n", Stats.InstancesDrawn / Frames);
+	printf("Triangles drawn         : %.1f /frame\n", Stats.IndicesDrawn / 3 / Frames);
+	printf("Commands executed       : %.1f /frame\n", Stats.CommandsExecuted / Frames);
+	printf("Pipeline state changes  : %.1f /frame\n", Stats.PipelineStateChanges / Frames);
+	printf("Texture changes         : %.1f /frame\n", Stats.DescriptorTableChanges / Frames);
+	printf("Vertex buffer changes   : %.1f /frame\n", Stats.VertexBufferChanges / Frames);
+	printf("Index buffer changes    : %.1f /frame\n", Stats.IndexBufferChanges / Frames);
+	printf("Barriers                : %.1f /frame\n", Stats.Barriers / Frames);
+	printf("Barrier state mismatches: %llu\n", (unsigned long long)Stats.BarrierStateMismatches);
+	printf("Uploaded                : %.1f KB/frame\n", Stats.BytesUploaded / 1024.0 / Frames);
+	printf("Copied on GPU           : %.1f KB/frame\n", Stats.BytesCopied / 1024.0 / Frames);
+}
+
+// Runs FrameCount frames on the initialized renderer then prints what they cost
+static void RunFrames(int FrameCount)
+{
+	// Only measure the frame loop, not the initial uploads
+	Renderer->Device->ResetStats();
+	Renderer->Stats = RendererStats();
+
+	// This thread is the game thread, the render thread draws each frame while the next one is simulated
+	Renderer->StartRenderThread();
+
+	const std::chrono::high_resolution_clock::time_point Start = std::chrono::high_resolution_clock::now();
+	int Frame = 0;
+	for (; Frame < FrameCount && Renderer->bRunning; ++Frame)
+	{
+		Renderer->Update();
+	}
+	Renderer->StopRenderThread();
+	const double ElapsedMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - Start).count();
+
+	PrintStats(Renderer->Stats, Renderer->Device->GetStats(), Frame, ElapsedMs);
+	printf("Frames in flight        : %u, %d back buffers%s\n", Renderer->FramesInFlight, Renderer->BackBufferCount,
+		Renderer->Pacer.bLowLatency ? ", low latency" : "");
+	printf("Static batches          : %zu for %d static objects, %u not baked\n", Renderer->Meshes.size() - Renderer->FirstBatchMesh,
+		Renderer->ObjectCount - int(Renderer->DynamicMeshCount), Renderer->FirstBatchMesh - Renderer->DynamicMeshCount);
+	uint32_t ConstantPageCount = 0;
+	for (const RenderRecordContext& Context : Renderer->RecordContexts)
+	{
+		ConstantPageCount += Context.ConstantAllocator->GetPageCount();
+	}
+	printf("Constant buffer pages   : %u for %zu recording threads\n", ConstantPageCount, Renderer->RecordContexts.size());
+	printf("Geometry pool           : %u blocks, %.1f KB used of %.1f KB\n", Renderer->GeometryPool->GetBlockCount(),
+		Renderer->GeometryPool->GetUsedSize() / 1024.0, Renderer->GeometryPool->GetReservedSize() / 1024.0);
+}
+
+// Headless entry point : runs the frame loop on the Null RHI and prints what it cost
+// Arguments : frame count, "bench" or "check", object count, mesh path or "-" for cubes, number of static objects, frames in
+// flight, triangles the Null GPU draws per ms (0 for instant), 1 for the low latency mode
+int main(int argc, char** argv)
+{
+	if (argc > 1 && strcmp(argv[1], "bench") == 0)
+	{
+		RunBenchmarks();
+		return 0;
+	}
+	if (argc > 1 && strcmp(argv[1], "check") == 0)
+	{
+		return RunChecks() ? 0 : 1;
+	}
+
+	const int FrameCount = argc > 1 ? atoi(argv[1]) : 1000;
+
+	Renderer = new CRenderer();
+	Renderer->Backend = ERHIBackend::Null;
+	Renderer->ObjectCount = argc > 2 ? atoi(argv[2]) : 1;
+	Renderer->MeshPath = argc > 3 && strcmp(argv[3], "-") != 0 ? argv[3] : nullptr;
+	Renderer->StaticObjectCount = argc > 4 ? atoi(argv[4]) : 0;
+	Renderer->FramesInFlight = argc > 5 ? uint32_t(atoi(argv[5])) : Renderer->FramesInFlight;
+	Renderer->NullGPUTrianglesPerMs = argc > 6 ? atof(argv[6]) : 0.0;
+	Renderer->Pacer.bLowLatency = argc > 7 && atoi(argv[7]) != 0;
+
+	// Cleaned up the same way whether the init failed or the frames ran
+	const bool bInitialized = Renderer->Init();
+	if (bInitialized)
+	{
+		RunFrames(FrameCount);
+	}
+	else
+	{
+		fprintf(stderr, "Failed to init the renderer! Aborting!\n");
+	}
+
+	Renderer->Cleanup();
+	delete Renderer;
+	Renderer = nullptr;
+
+	return bInitialized ? 0 : 1;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,128 @@
+#include "pch.h"
+#include "MappedFile.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+CMappedFile::~CMappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+bool CMappedFile::Open(const char* Path)
+{
+	Close();
+
+	// Sequential scan lets the cache manager read ahead of the parser
+	File = CreateFileA(Path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (File == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER FileSize;
+	if (!GetFileSizeEx(File, &FileSize))
+	{
+		Close();
+		return false;
+	}
+	if (FileSize.QuadPart == 0)
+	{
+		return true;
+	}
+
+	Mapping = CreateFileMappingA(File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!Mapping)
+	{
+		Close();
+		return false;
+	}
+
+	Data = static_cast<const char*>(MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0));
+	if (!Data)
+	{
+		Close();
+		return false;
+	}
+
+	Size = size_t(FileSize.QuadPart);
+	return true;
+}
+
+void CMappedFile::Close()
+{
+	if (Data)
+	{
+		UnmapViewOfFile(Data);
+	}
+	if (Mapping)
+	{
+		CloseHandle(Mapping);
+	}
+	if (File != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(File);
+	}
+
+	Data = nullptr;
+	Size = 0;
+	Mapping = nullptr;
+	File = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool CMappedFile::Open(const char* Path)
+{
+	Close();
+
+	const int File = open(Path, O_RDONLY);
+	if (File < 0)
+	{
+		return false;
+	}
+
+	struct stat FileStat;
+	if (fstat(File, &FileStat) != 0)
+	{
+		close(File);
+		return false;
+	}
+	if (FileStat.st_size == 0)
+	{
+		close(File);
+		return true;
+	}
+
+	// The mapping keeps its own reference to the file
+	void* Mapped = mmap(nullptr, size_t(FileStat.st_size), PROT_READ, MAP_PRIVATE, File, 0);
+	close(File);
+	if (Mapped == MAP_FAILED)
+	{
+		return false;
+	}
+
+	madvise(Mapped, size_t(FileStat.st_size), MADV_SEQUENTIAL);
+	Data = static_cast<const char*>(Mapped);
+	Size = size_t(FileStat.st_size);
+	return true;
+}
+
+void CMappedFile::Close()
+{
+	if (Data)
+	{
+		munmap(const_cast<char*>(Data), Size);
+	}
+
+	Data = nullptr;
+	Size = 0;
+}
+
+#endif
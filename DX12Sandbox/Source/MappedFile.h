@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include "pch.h"
+
+// Read only view of a whole file mapped in memory, the pages are read by the OS when first touched
+class CMappedFile
+{
+public:
+
+	CMappedFile() = default;
+
+	~CMappedFile();
+
+	CMappedFile(const CMappedFile&) = delete;
+	CMappedFile& operator=(const CMappedFile&) = delete;
+
+	// Returns false when the file can't be opened or mapped, an empty file maps to no data
+	bool Open(const char* Path);
+
+	void Close();
+
+	const char* GetData() const
+	{
+		return Data;
+	}
+
+	size_t GetSize() const
+	{
+		return Size;
+	}
+
+private:
+
+	const char* Data = nullptr;
+
+	size_t Size = 0;
+
+#ifdef _WIN32
+	HANDLE File = INVALID_HANDLE_VALUE;
+	HANDLE Mapping = nullptr;
+#endif
+};
@@ -1,5 +1,12 @@
 #include "Mesh.h"
 #include "pch.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "MeshCache.h"
+#include "TangentGenerator.h"
+
+#include <algorithm>
+#include <cmath>
 
 //using namespace DirectX;
 
@@ -7,112 +14,212 @@ CMesh::CMesh()
 {
 }
 
-void CMesh::Init(ID3D12Device* Device, ID3D12GraphicsCommandList* CommandList)
-{
-	int VertexBufferSize = GetVertexBufferSize();
-
-	CD3DX12_HEAP_PROPERTIES HeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-	CD3DX12_RESOURCE_DESC BufferDesc = CD3DX12_RESOURCE_DESC::Buffer(VertexBufferSize);
-	Device->CreateCommittedResource(
-		&HeapProperties,
-		D3D12_HEAP_FLAG_NONE,
-		&BufferDesc,
-		D3D12_RESOURCE_STATE_COPY_DEST,
-		nullptr,
-		IID_PPV_ARGS(&VertexBuffer)
-	);
-	VertexBuffer->SetName(L"Vertex Buffer Resource Heap");
-
-	ID3D12Resource* VBufferUploadHeap;
-	HeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-	Device->CreateCommittedResource(
-		&HeapProperties,
-		D3D12_HEAP_FLAG_NONE,
-		&BufferDesc,
-		D3D12_RESOURCE_STATE_GENERIC_READ,
-		nullptr,
-		IID_PPV_ARGS(&VBufferUploadHeap)
-	);
-	VBufferUploadHeap->SetName(L"Vertex Buffer Upload Resource Heap");
-
-	D3D12_SUBRESOURCE_DATA VertexData = {};
-	VertexData.pData = this->Vertices.data();
-	VertexData.RowPitch = VertexBufferSize;
-	VertexData.SlicePitch = VertexBufferSize;
-
-	UpdateSubresources(CommandList, VertexBuffer, VBufferUploadHeap, 0, 0, 1, &VertexData);
-	CD3DX12_RESOURCE_BARRIER Barrier = CD3DX12_RESOURCE_BARRIER::Transition(VertexBuffer, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
-	CommandList->ResourceBarrier(1, &Barrier);
-
-	// Create the IndexBuffer
-	int IndexBufferSize = GetIndexBufferSize();
-
-	HeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-	BufferDesc = CD3DX12_RESOURCE_DESC::Buffer(IndexBufferSize);
-	Device->CreateCommittedResource(
-		&HeapProperties,
-		D3D12_HEAP_FLAG_NONE,
-		&BufferDesc,
-		D3D12_RESOURCE_STATE_COPY_DEST,
-		nullptr,
-		IID_PPV_ARGS(&IndexBuffer)
-	);
-	IndexBuffer->SetName(L"Index Buffer Resource Heap");
-
-	ID3D12Resource* IBufferUploadHeap;
-	HeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-	Device->CreateCommittedResource(
-		&HeapProperties,
-		D3D12_HEAP_FLAG_NONE,
-		&BufferDesc,
-		D3D12_RESOURCE_STATE_GENERIC_READ,
-		nullptr,
-		IID_PPV_ARGS(&IBufferUploadHeap)
-	);
-	IBufferUploadHeap->SetName(L"Vertex Buffer Upload Resource Heap");
-
-	D3D12_SUBRESOURCE_DATA IndexData = {};
-	IndexData.pData = Indices.data();
-	IndexData.RowPitch = IndexBufferSize;
-	IndexData.SlicePitch = IndexBufferSize;
-
-	UpdateSubresources(CommandList, IndexBuffer, IBufferUploadHeap, 0, 0, 1, &IndexData);
-	Barrier = CD3DX12_RESOURCE_BARRIER::Transition(IndexBuffer, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER);
-	CommandList->ResourceBarrier(1, &Barrier);
-
-	VertexBufferView.BufferLocation = VertexBuffer->GetGPUVirtualAddress();
-	VertexBufferView.StrideInBytes = sizeof(Vertex);
-	VertexBufferView.SizeInBytes = GetVertexBufferSize();
-
-	IndexBufferView.BufferLocation = IndexBuffer->GetGPUVirtualAddress();
-	IndexBufferView.Format = DXGI_FORMAT_R32_UINT;
-	IndexBufferView.SizeInBytes = GetIndexBufferSize();
+void CMesh::GenerateTangentFrames(uint32_t ThreadCount)
+{
+	if (!bHasTangentFrames && !bOptimized)
+	{
+		CTangentGenerator::Generate(Vertices, Indices, ThreadCount);
+		bHasTangentFrames = true;
+	}
+}
+
+void CMesh::Optimize()
+{
+	if (!bOptimized)
+	{
+		GenerateTangentFrames();
+		CMeshOptimizer::Optimize(Vertices, Indices);
+		bOptimized = true;
+	}
+}
+
+void CMesh::GenerateLODs()
+{
+	// The LODs index the vertices, they must be in their final order first
+	Optimize();
+	CMeshSimplifier::BuildLODChain(Vertices, Indices, LODs);
+	for (MeshLOD& LOD : LODs)
+	{
+		CMeshOptimizer::OptimizeVertexCache(LOD.Indices, Vertices.size());
+	}
+}
+
+// Position in the box to 16 bits, clamped since the box corners are rounded from its center and extents
+static uint16_t Quantize(float Position, float Offset, float Scale)
+{
+	return uint16_t(std::min(std::max((Position - Offset) / Scale, 0.0f), 1.0f) * 65535.0f + 0.5f);
+}
+
+void CMesh::Prepare()
+{
+	Optimize();
+	ComputeBounds();
+	IndexFormat = SelectIndexFormat(Vertices.size());
+}
+
+void CMesh::PackVertices(std::vector<PackedVertex>& OutVertices) const
+{
+	// 16 bits per axis inside the box of the vertices, half floats for the texture coordinates so they can still repeat
+	OutVertices.resize(Vertices.size());
+	for (size_t i = 0; i < Vertices.size(); ++i)
+	{
+		const XMFLOAT3& Pos = Vertices[i].Pos;
+		OutVertices[i].Pos = PackedVector::XMUSHORTN4(
+			Quantize(Pos.x, QuantizationOffset.x, QuantizationScale.x),
+			Quantize(Pos.y, QuantizationOffset.y, QuantizationScale.y),
+			Quantize(Pos.z, QuantizationOffset.z, QuantizationScale.z),
+			0);
+		OutVertices[i].TexCoord = PackedVector::XMHALF2(Vertices[i].TexCoord.x, Vertices[i].TexCoord.y);
+		OutVertices[i].QTangent = CTangentGenerator::EncodeQTangent(Vertices[i].Normal, Vertices[i].Tangent);
+	}
+}
+
+bool CMesh::Init(CGeometryPool* InGeometryPool, CRHICommandList* CommandList)
+{
+	Prepare();
+
+	std::vector<PackedVertex> PackedVertices;
+	PackVertices(PackedVertices);
+
+	GeometryPool = InGeometryPool;
+	VertexAllocation = GeometryPool->Allocate(CommandList, EGeometryType::Vertex, PackedVertices.data(), GetVertexBufferSize());
+
+	IndexAllocation = AllocateIndices(CommandList, Indices);
+	IndexCount = uint32_t(Indices.size());
+
+	// An empty stream or a full pool gives an invalid handle, the draws couldn't take views of it
+	bool bAllocated = VertexAllocation != INVALID_GEOMETRY_HANDLE && IndexAllocation != INVALID_GEOMETRY_HANDLE;
+	for (MeshLOD& LOD : LODs)
+	{
+		LOD.IndexAllocation = AllocateIndices(CommandList, LOD.Indices);
+		LOD.IndexCount = uint32_t(LOD.Indices.size());
+		bAllocated &= LOD.IndexAllocation != INVALID_GEOMETRY_HANDLE;
+	}
+	return bAllocated;
+}
 
+bool CMesh::InitFromCache(const CMeshCache& Cache, CGeometryPool* InGeometryPool, CRHICommandList* CommandList)
+{
+	const MeshCacheHeader& Header = Cache.GetHeader();
+	BoundsCenter = Header.BoundsCenter;
+	BoundsRadius = Header.BoundsRadius;
+	BoundsExtents = Header.BoundsExtents;
+	QuantizationOffset = Header.QuantizationOffset;
+	QuantizationScale = Header.QuantizationScale;
+	IndexFormat = Header.IndexStride == 2 ? ERHIFormat::R16_UInt : ERHIFormat::R32_UInt;
+	IndexCount = Header.IndexCount;
+	bOptimized = true;
+
+	// The streams are already in their GPU format, the upload copies them out of the mapping
+	GeometryPool = InGeometryPool;
+	VertexAllocation = GeometryPool->Allocate(CommandList, EGeometryType::Vertex, Cache.GetVertices(), uint64_t(Header.VertexCount) * sizeof(PackedVertex));
+	IndexAllocation = GeometryPool->Allocate(CommandList, EGeometryType::Index, Cache.GetIndices(), uint64_t(IndexCount) * Header.IndexStride);
+
+	bool bAllocated = VertexAllocation != INVALID_GEOMETRY_HANDLE && IndexAllocation != INVALID_GEOMETRY_HANDLE;
+	LODs.resize(Header.LODCount);
+	for (uint32_t Level = 0; Level < Header.LODCount; ++Level)
+	{
+		const MeshCacheLOD& CachedLOD = Cache.GetLOD(Level);
+		LODs[Level].IndexCount = CachedLOD.IndexCount;
+		LODs[Level].Error = CachedLOD.Error;
+		LODs[Level].IndexAllocation = GeometryPool->Allocate(CommandList, EGeometryType::Index, Cache.GetLODIndices(Level),
+			uint64_t(CachedLOD.IndexCount) * Header.IndexStride);
+		bAllocated &= LODs[Level].IndexAllocation != INVALID_GEOMETRY_HANDLE;
+	}
+	return bAllocated;
+}
+
+uint32_t CMesh::AllocateIndices(CRHICommandList* CommandList, const std::vector<unsigned int>& InIndices)
+{
+	const uint32_t Size = GetIndexStride() * uint32_t(InIndices.size());
+	if (IndexFormat == ERHIFormat::R16_UInt)
+	{
+		const std::vector<uint16_t> ShortIndices(InIndices.begin(), InIndices.end());
+		return GeometryPool->Allocate(CommandList, EGeometryType::Index, ShortIndices.data(), Size);
+	}
+	return GeometryPool->Allocate(CommandList, EGeometryType::Index, InIndices.data(), Size);
+}
+
+void CMesh::InitShared(const CMesh* Source)
+{
+	GeometryPool = Source->GeometryPool;
+	VertexAllocation = Source->VertexAllocation;
+	IndexAllocation = Source->IndexAllocation;
+	IndexCount = Source->IndexCount;
+	IndexFormat = Source->IndexFormat;
+	BoundsCenter = Source->BoundsCenter;
+	BoundsRadius = Source->BoundsRadius;
+	BoundsExtents = Source->BoundsExtents;
+	QuantizationOffset = Source->QuantizationOffset;
+	QuantizationScale = Source->QuantizationScale;
+	bOwnsGeometry = false;
+
+	LODs.resize(Source->LODs.size());
+	for (size_t Level = 0; Level < LODs.size(); ++Level)
+	{
+		LODs[Level].IndexCount = Source->LODs[Level].IndexCount;
+		LODs[Level].IndexAllocation = Source->LODs[Level].IndexAllocation;
+		LODs[Level].Error = Source->LODs[Level].Error;
+	}
+
+	// The CPU copy is only needed to create the buffers
+	Vertices.clear();
+	Vertices.shrink_to_fit();
+	Indices.clear();
+	Indices.shrink_to_fit();
 }
 
 int CMesh::GetVertexBufferSize() const
 {
-	return sizeof(Vertex) * this->Vertices.size();
+	return sizeof(PackedVertex) * this->Vertices.size();
 }
 
 int CMesh::GetIndexBufferSize() const
 {
-	return sizeof(Vertex) * Indices.size();
+	return GetIndexStride() * Indices.size();
+}
+
+void CMesh::ComputeBounds()
+{
+	if (Vertices.empty())
+	{
+		return;
+	}
+
+	const BoundingVolume Bounds = ComputeBoundingVolume(&Vertices[0].Pos, Vertices.size(), sizeof(Vertex));
+	BoundsCenter = Bounds.Center;
+	BoundsRadius = Bounds.Radius;
+	BoundsExtents = Bounds.Extents;
+
+	// Flat meshes keep a unit extent on their flat axis to avoid dividing by 0
+	const XMVECTOR Center = XMLoadFloat3(&Bounds.Center);
+	const XMVECTOR Extents = XMLoadFloat3(&Bounds.Extents);
+	const XMVECTOR Size = Extents * 2.0f;
+	XMStoreFloat3(&QuantizationOffset, Center - Extents);
+	XMStoreFloat3(&QuantizationScale, XMVectorSelect(Size, XMVectorSplatOne(), XMVectorEqual(Size, XMVectorZero())));
+}
+
+XMMATRIX CMesh::GetDequantizationMatrix() const
+{
+	return XMMatrixScaling(QuantizationScale.x, QuantizationScale.y, QuantizationScale.z)
+		* XMMatrixTranslation(QuantizationOffset.x, QuantizationOffset.y, QuantizationOffset.z);
 }
 
-void CMesh::Draw(ID3D12GraphicsCommandList* CommandList)
+BoundingVolume CMesh::GetWorldBounds() const
 {
-	// Set Vertex Buffer
-	CommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-	CommandList->IASetVertexBuffers(0 ,1, &VertexBufferView);
-		
-	// Set Index Buffer
-	CommandList->IASetIndexBuffer(&IndexBufferView);
-	CommandList->DrawIndexedInstanced(Indices.size(), 1, 0, 0, 0);
+	const XMFLOAT4X4 World = GetWorldMatrix();
+	return TransformBoundingVolume(XMLoadFloat4x4(&World), GetLocalBounds());
 }
 
 CMesh::~CMesh()
 {
-	SAFE_RELEASE(VertexBuffer);
-	SAFE_RELEASE(IndexBuffer);
+	if (bOwnsGeometry && GeometryPool)
+	{
+		GeometryPool->Free(VertexAllocation);
+		GeometryPool->Free(IndexAllocation);
+		for (const MeshLOD& LOD : LODs)
+		{
+			GeometryPool->Free(LOD.IndexAllocation);
+		}
+	}
 }
@@ -4,18 +4,112 @@
 #include <vector>
 #include "pch.h"
 #include "Actor.h"
+#include "RHI.h"
+#include "GeometryPool.h"
+#include "VertexLayout.h"
+#include "Bounds.h"
 
 struct Vertex
 {
+	// Left uninitialized, for arrays sized first and filled after
+	Vertex() = default;
+
+	// The tangent frame is left to CTangentGenerator
 	Vertex(XMFLOAT3 InPos, XMFLOAT2 InTexCoord)
 	{ 
 		Pos = InPos; 
 		TexCoord = InTexCoord;
+		Normal = XMFLOAT3(0.0f, 1.0f, 0.0f);
+		Tangent = XMFLOAT4(1.0f, 0.0f, 0.0f, 1.0f);
 	}
 
 	XMFLOAT3 Pos;
 	//XMFLOAT4 Color;
 	XMFLOAT2 TexCoord;
+
+	XMFLOAT3 Normal;
+
+	// w is the handedness, the bitangent is cross(Normal, Tangent) * w
+	XMFLOAT4 Tangent;
+};
+
+// Vertex as stored in GPU memory, 20 bytes instead of 48 :
+// the position is quantized to 16 bits inside the box of the mesh (w unused), the dequantization is folded in the world transform,
+// the normal, tangent and handedness are a single quaternion, see CTangentGenerator::EncodeQTangent
+struct PackedVertex
+{
+	PackedVector::XMUSHORTN4 Pos;
+	PackedVector::XMHALF2 TexCoord;
+	PackedVector::XMSHORTN4 QTangent;
+};
+
+template<>
+struct TVertexLayout<PackedVertex>
+{
+	static constexpr ERHIInputClassification Classification = ERHIInputClassification::PerVertex;
+	static constexpr RHIInputElement Elements[] =
+	{
+		RHI_VERTEX_ELEMENT(PackedVertex, Pos, "POSITION", 0),
+		RHI_VERTEX_ELEMENT(PackedVertex, TexCoord, "TEXCOORD", 0),
+		RHI_VERTEX_ELEMENT(PackedVertex, QTangent, "QTANGENT", 0)
+	};
+};
+
+// Per instance vertex data of the instanced path : the first 3 columns of the world matrix, the 4th is always (0, 0, 0, 1),
+// then the first 3 columns of its inverse transpose for the normals
+struct InstanceData
+{
+	XMFLOAT4 World[3];
+	XMFLOAT3 Normal[3];
+};
+
+// Fills Instance from World member by member, the instances are written straight into write combined memory. The normal
+// matrix is the one of the non instanced path, exact for any world matrix, sheared by a rotated child of a non uniform scale too
+inline void WriteInstanceData(const XMFLOAT4X4& World, InstanceData& Instance)
+{
+	Instance.World[0] = XMFLOAT4(World._11, World._21, World._31, World._41);
+	Instance.World[1] = XMFLOAT4(World._12, World._22, World._32, World._42);
+	Instance.World[2] = XMFLOAT4(World._13, World._23, World._33, World._43);
+
+	// The columns of the inverse transpose are the rows of the inverse
+	XMFLOAT4X4 Inverse;
+	XMStoreFloat4x4(&Inverse, XMMatrixInverse(nullptr, XMLoadFloat4x4(&World)));
+	Instance.Normal[0] = XMFLOAT3(Inverse._11, Inverse._12, Inverse._13);
+	Instance.Normal[1] = XMFLOAT3(Inverse._21, Inverse._22, Inverse._23);
+	Instance.Normal[2] = XMFLOAT3(Inverse._31, Inverse._32, Inverse._33);
+}
+
+template<>
+struct TVertexLayout<InstanceData>
+{
+	static constexpr ERHIInputClassification Classification = ERHIInputClassification::PerInstance;
+	static constexpr RHIInputElement Elements[] =
+	{
+		RHI_VERTEX_ELEMENT(InstanceData, World[0], "WORLD", 0),
+		RHI_VERTEX_ELEMENT(InstanceData, World[1], "WORLD", 1),
+		RHI_VERTEX_ELEMENT(InstanceData, World[2], "WORLD", 2),
+		RHI_VERTEX_ELEMENT(InstanceData, Normal[0], "NORMALMATRIX", 0),
+		RHI_VERTEX_ELEMENT(InstanceData, Normal[1], "NORMALMATRIX", 1),
+		RHI_VERTEX_ELEMENT(InstanceData, Normal[2], "NORMALMATRIX", 2)
+	};
+};
+
+// The full mesh and up to 4 reduced versions
+#define MESH_MAX_LODS 5
+
+// A reduced version of the mesh, drawn with the vertices of the full mesh
+struct MeshLOD
+{
+	// Emptied by InitShared like CMesh::Indices
+	std::vector<unsigned int> Indices;
+
+	uint32_t IndexCount = 0;
+
+	// Range of the pool holding Indices, in the IndexFormat of the mesh
+	uint32_t IndexAllocation = INVALID_GEOMETRY_HANDLE;
+
+	// Upper bound of the distance from this LOD to the full mesh, in local units
+	float Error = 0.0f;
 };
 
 class CMesh : public Actor
@@ -27,33 +121,159 @@ public:
 
 	~CMesh();
 
-	void Init(ID3D12Device* Device, ID3D12GraphicsCommandList* CommandList);
+	// Fills the normals and tangents of Vertices, only runs once. Can add vertices, so it runs before anything indexes them
+	void GenerateTangentFrames(uint32_t ThreadCount = 0);
+
+	// Generates the tangent frames if needed then reorders Vertices and Indices for the GPU caches, only runs once
+	void Optimize();
+
+	// Optimizes the mesh then fills LODs, call before Init. Thread safe across different meshes
+	void GenerateLODs();
+
+	// Optimizes the mesh, computes its bounds and picks the index format, what Init and the mesh cache need before packing
+	void Prepare();
+
+	// Vertices quantized in the box of the mesh, Prepare must have run
+	void PackVertices(std::vector<PackedVertex>& OutVertices) const;
+
+	// Optimizes Vertices and Indices then records their upload into the pool, the pool's FinishUploads must be recorded before drawing
+	// Returns false when the mesh or one of its LODs is empty or the pool is out of memory, the mesh can't be drawn then
+	bool Init(CGeometryPool* InGeometryPool, CRHICommandList* CommandList);
+
+	// Records the upload of a cooked mesh straight from its mapping, Vertices and Indices stay empty. Fails like Init
+	bool InitFromCache(const class CMeshCache& Cache, CGeometryPool* InGeometryPool, CRHICommandList* CommandList);
+
+	// Draws the geometry of Source instead of owning a copy, Source must outlive this mesh
+	void InitShared(const CMesh* Source);
+
+	// True when both meshes draw the same geometry, they can then be drawn in a single instanced draw
+	bool SharesGeometryWith(const CMesh* Other) const
+	{
+		return GeometryPool == Other->GeometryPool
+			&& VertexAllocation == Other->VertexAllocation
+			&& IndexAllocation == Other->IndexAllocation
+			&& IndexCount == Other->IndexCount;
+	}
 
 	int GetVertexBufferSize() const;	
 
+	// Size of the indices once converted to IndexFormat
 	int GetIndexBufferSize() const;
 
-	void Draw(ID3D12GraphicsCommandList* CommandList);
+	// 16 bits indices when every vertex can be addressed with them, they halve the index memory and bandwidth
+	static ERHIFormat SelectIndexFormat(size_t VertexCount)
+	{
+		return VertexCount <= 0x10000 ? ERHIFormat::R16_UInt : ERHIFormat::R32_UInt;
+	}
+
+	uint32_t GetIndexStride() const
+	{
+		return IndexFormat == ERHIFormat::R16_UInt ? 2 : 4;
+	}
+
+	// LOD 0 is the full mesh, LOD N is LODs[N - 1]
+	uint32_t GetLODCount() const
+	{
+		return 1 + uint32_t(LODs.size());
+	}
+
+	uint32_t GetIndexCount(uint32_t LOD) const
+	{
+		return LOD == 0 ? IndexCount : LODs[LOD - 1].IndexCount;
+	}
+
+	// Views of the buffers Draw needs bound, taken at draw time since the pool can move them. The caller binds them so
+	// meshes drawn one after the other don't bind the same buffers again
+	RHIVertexBufferView GetVertexBufferView() const
+	{
+		return GeometryPool->GetVertexBufferView(VertexAllocation, sizeof(PackedVertex));
+	}
+
+	RHIIndexBufferView GetIndexBufferView(uint32_t LOD) const
+	{
+		return GeometryPool->GetIndexBufferView(GetIndexAllocation(LOD), IndexFormat);
+	}
+
+	// Draws InstanceCount copies of LOD with the views above bound, for more than one the InstanceData are bound on slot 1
+	void Draw(CRHICommandList* CommandList, uint32_t InstanceCount = 1, uint32_t LOD = 0)
+	{
+		CommandList->DrawIndexedInstanced(GetIndexCount(LOD), InstanceCount, 0, 0, 0);
+	}
+
+	// Box of the vertices and the smallest sphere around them centered on the box, in local space
+	void ComputeBounds();
+
+	BoundingVolume GetLocalBounds() const
+	{
+		BoundingVolume Bounds;
+		Bounds.Center = BoundsCenter;
+		Bounds.Radius = BoundsRadius;
+		Bounds.Extents = BoundsExtents;
+		return Bounds;
+	}
 
-	// The list of vertices
+	// Maps the quantized positions of the vertex buffer back to local space, to apply before the world matrix
+	XMMATRIX GetDequantizationMatrix() const;
+
+	// The local bounds moved by the world matrix, use CTransformStore::TransformBounds for many meshes at once
+	BoundingVolume GetWorldBounds() const;
+
+	XMFLOAT3 BoundsCenter = XMFLOAT3(0.0f, 0.0f, 0.0f);
+
+	float BoundsRadius = 0.0f;
+
+	// Half the size of the box of the vertices, around BoundsCenter
+	XMFLOAT3 BoundsExtents = XMFLOAT3(0.0f, 0.0f, 0.0f);
+
+	// Local position = quantized position * QuantizationScale + QuantizationOffset, the box of the vertices
+	XMFLOAT3 QuantizationOffset = XMFLOAT3(0.0f, 0.0f, 0.0f);
+
+	XMFLOAT3 QuantizationScale = XMFLOAT3(1.0f, 1.0f, 1.0f);
+
+	// The list of vertices, packed into PackedVertex for the GPU
 	std::vector<Vertex> Vertices;
 
 	// The list of indices
 	std::vector<unsigned int> Indices;
 
-	/*	DX12 stuff*/
+	// Number of indices in the GPU buffer, Indices is emptied by InitShared
+	uint32_t IndexCount = 0;
+
+	// Reduced versions of the mesh, from the most to the least detailed, LOD 0 is the mesh itself
+	std::vector<MeshLOD> LODs;
 
-	// Default Buffer in GPU memory to send our Vertices
-	ID3D12Resource* VertexBuffer;
+	// Format of the indices in the GPU buffer, Indices are always stored as 32 bits on the CPU
+	ERHIFormat IndexFormat = ERHIFormat::R32_UInt;
 
-	// A structure containing data to describe our VertexBuffer (pointer, size of the buffer, size of each element)
-	D3D12_VERTEX_BUFFER_VIEW VertexBufferView;
+	/*	RHI stuff*/
 
-	// Default Buffer in GPU memory to send our Indices
-	ID3D12Resource* IndexBuffer;
+	// Holds the vertices and indices, the views are taken from it at draw time since it can move them
+	CGeometryPool* GeometryPool = nullptr;
 
-	// A structure containing data to describe our IndexBuffer 
-	D3D12_INDEX_BUFFER_VIEW IndexBufferView;
+	// Range of the pool holding our Vertices
+	uint32_t VertexAllocation = INVALID_GEOMETRY_HANDLE;
+
+	// Range of the pool holding our Indices
+	uint32_t IndexAllocation = INVALID_GEOMETRY_HANDLE;
+
+	// True once Optimize ran, Init doesn't reorder the vertices the LODs index
+	bool bOptimized = false;
+
+	// True once the normals and tangents of Vertices are filled
+	bool bHasTangentFrames = false;
+
+	// False when the ranges belong to the mesh given to InitShared
+	bool bOwnsGeometry = true;
+
+	/* End RHI stuff */
+
+private:
+
+	uint32_t GetIndexAllocation(uint32_t LOD) const
+	{
+		return LOD == 0 ? IndexAllocation : LODs[LOD - 1].IndexAllocation;
+	}
 
-	/* End DX12 stuff */
+	// Records the upload of InIndices converted to IndexFormat
+	uint32_t AllocateIndices(CRHICommandList* CommandList, const std::vector<unsigned int>& InIndices);
 };
\ No newline at end of file
@@ -0,0 +1,563 @@
+#include "pch.h"
+#include "Bench.h"
+#include "Camera.h"
+#include "CCube.h"
+#include "MeshOptimizer.h"
+#include "MeshletBuilder.h"
+#include "MeshSimplifier.h"
+#include "StaticBatcher.h"
+#include "TangentGenerator.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+void RunMeshBenchmarks()
+{
+	// Mesh optimization of a finely tessellated sphere
+	std::vector<Vertex> SphereVertices;
+	std::vector<unsigned int> SphereIndices;
+	BuildShuffledSphere(512, 1024, SphereVertices, SphereIndices);
+
+	const MeshCacheStats Before = CMeshOptimizer::AnalyzeVertexCache(SphereIndices, SphereVertices.size());
+	const double CacheMs = MeasureNs(1, [&](int) { CMeshOptimizer::OptimizeVertexCache(SphereIndices, SphereVertices.size()); }) / 1e6;
+	const MeshCacheStats AfterCache = CMeshOptimizer::AnalyzeVertexCache(SphereIndices, SphereVertices.size());
+	const double OverdrawMs = MeasureNs(1, [&](int) { CMeshOptimizer::OptimizeOverdraw(SphereIndices, SphereVertices); }) / 1e6;
+	const MeshCacheStats AfterOverdraw = CMeshOptimizer::AnalyzeVertexCache(SphereIndices, SphereVertices.size());
+	const double FetchMs = MeasureNs(1, [&](int) { CMeshOptimizer::OptimizeVertexFetch(SphereVertices, SphereIndices); }) / 1e6;
+
+	BoundingVolume SphereBounds;
+	const double BoundsMs = MeasureNs(16, [&](int)
+	{
+		SphereBounds = ComputeBoundingVolume(&SphereVertices[0].Pos, SphereVertices.size(), sizeof(Vertex));
+	}) / 1e6;
+	printf("Local bounds of %zu vertices      : %.3f ms (radius %.3f)\n", SphereVertices.size(), BoundsMs, SphereBounds.Radius);
+
+	printf("Mesh optimization of %zu triangles:\n", SphereIndices.size() / 3);
+	printf("  Unoptimized                        : ACMR %.3f ATVR %.3f\n", Before.ACMR, Before.ATVR);
+	printf("  Vertex cache  %8.1f ms           : ACMR %.3f ATVR %.3f\n", CacheMs, AfterCache.ACMR, AfterCache.ATVR);
+	printf("  Overdraw      %8.1f ms           : ACMR %.3f ATVR %.3f\n", OverdrawMs, AfterOverdraw.ACMR, AfterOverdraw.ATVR);
+	printf("  Vertex fetch  %8.1f ms\n", FetchMs);
+
+	// Tangent frames of a sphere twice as fine, from one thread then all of them
+	std::vector<Vertex> FrameVertices[2];
+	std::vector<unsigned int> FrameIndices[2];
+	BuildShuffledSphere(1024, 1024, FrameVertices[0], FrameIndices[0]);
+	FrameVertices[1] = FrameVertices[0];
+	FrameIndices[1] = FrameIndices[0];
+	double FrameMs[2];
+	for (uint32_t Run = 0; Run < 2; ++Run)
+	{
+		FrameMs[Run] = MeasureNs(1, [&](int) { CTangentGenerator::Generate(FrameVertices[Run], FrameIndices[Run], Run == 0 ? 1 : 0); }) / 1e6;
+	}
+
+	std::vector<PackedVector::XMSHORTN4> QTangents(FrameVertices[0].size());
+	const double EncodeMs = MeasureNs(1, [&](int)
+	{
+		for (size_t Index = 0; Index < QTangents.size(); ++Index)
+		{
+			QTangents[Index] = CTangentGenerator::EncodeQTangent(FrameVertices[0][Index].Normal, FrameVertices[0][Index].Tangent);
+		}
+	}) / 1e6;
+
+	printf("Tangent frames of %zu triangles:\n", FrameIndices[0].size() / 3);
+	printf("  1 thread      %8.1f ms\n", FrameMs[0]);
+	printf("  All threads   %8.1f ms\n", FrameMs[1]);
+	printf("  QTangent      %8.1f ms           : %zu bytes per vertex instead of %zu\n", EncodeMs, sizeof(PackedVertex), sizeof(Vertex));
+
+	// Meshlets of the same sphere, culled from a camera looking at it from outside
+	MeshletData SphereMeshlets;
+	const double MeshletBuildMs = MeasureNs(1, [&](int) { CMeshletBuilder::Build(SphereVertices, SphereIndices, SphereMeshlets); }) / 1e6;
+
+	XMFLOAT4X4 SphereWorld;
+	XMStoreFloat4x4(&SphereWorld, XMMatrixTranslation(0.0f, 0.0f, 3.0f));
+	Camera MeshletCamera;
+	std::vector<uint32_t> VisibleMeshlets(SphereMeshlets.Meshlets.size());
+	uint32_t VisibleMeshletCount = 0;
+	const double MeshletCullNs = MeasureNs(64, [&](int)
+	{
+		VisibleMeshletCount = CMeshletBuilder::Cull(SphereMeshlets, SphereWorld, MeshletCamera.GetFrustumPlanes(), MeshletCamera.GetPosition(), VisibleMeshlets.data());
+	});
+
+	printf("Meshlet build                        : %.1f ms (%zu meshlets)\n", MeshletBuildMs, SphereMeshlets.Meshlets.size());
+	printf("Meshlet frustum and cone culling     : %.3f ms (%u visible)\n", MeshletCullNs / 1e6, VisibleMeshletCount);
+
+	// LOD chain of the sphere, the error is relative to its radius of 1
+	std::vector<MeshLOD> SphereLODs;
+	const double LODChainMs = MeasureNs(1, [&](int) { CMeshSimplifier::BuildLODChain(SphereVertices, SphereIndices, SphereLODs); }) / 1e6;
+	printf("LOD chain                            : %.1f ms\n", LODChainMs);
+	for (size_t Level = 0; Level < SphereLODs.size(); ++Level)
+	{
+		printf("  LOD %zu                              : %zu triangles, error %.5f\n", Level + 1, SphereLODs[Level].Indices.size() / 3, SphereLODs[Level].Error);
+	}
+
+	// Smaller spheres simplified on one thread then on all of them
+	const int LODMeshCount = 16;
+	auto MakeLODMeshes = [&](std::vector<CMesh*>& OutMeshes)
+	{
+		for (int Index = 0; Index < LODMeshCount; ++Index)
+		{
+			CMesh* Mesh = new CMesh;
+			BuildShuffledSphere(128, 256, Mesh->Vertices, Mesh->Indices);
+			OutMeshes.push_back(Mesh);
+		}
+	};
+	for (uint32_t ThreadCount : { 1u, 0u })
+	{
+		std::vector<CMesh*> LODMeshes;
+		MakeLODMeshes(LODMeshes);
+		const double LODMeshesMs = MeasureNs(1, [&](int) { CMeshSimplifier::GenerateLODs(LODMeshes, ThreadCount); }) / 1e6;
+		printf("LODs of %d meshes, %s            : %.1f ms\n", LODMeshCount, ThreadCount == 1 ? "1 thread   " : "all threads", LODMeshesMs);
+		for (CMesh* Mesh : LODMeshes)
+		{
+			delete Mesh;
+		}
+	}
+
+	// Static batches of cubes turned and spread on a grid, one draw per sub-batch instead of one per cube
+	CNullUploadContext Context;
+	CCube* BatchSource = new CCube;
+	BatchSource->Init(Context.Pool, Context.CommandList);
+	std::vector<CMesh*> StaticBatches;
+	std::vector<StaticMaterial> StaticMaterials;
+	const int StaticCubeCount = 16384;
+	const double StaticBatchMs = MeasureNs(1, [&](int)
+	{
+		CStaticBatcher Batcher;
+		for (int Index = 0; Index < StaticCubeCount; ++Index)
+		{
+			XMFLOAT4X4 World;
+			XMStoreFloat4x4(&World, XMMatrixRotationRollPitchYaw(float(Index % 7), float(Index % 11), 0.0f)
+				* XMMatrixTranslation(float(Index % 32) * 2.0f, float(Index / 32 % 32) * 2.0f, float(Index / 1024) * 2.0f));
+			Batcher.Add(BatchSource, World, StaticMaterial());
+		}
+		Batcher.Build(Context.Pool, Context.CommandList, StaticBatches, StaticMaterials);
+	}) / 1e6;
+	printf("Static batching of %d cubes       : %.1f ms (%zu draws instead of %d)\n", StaticCubeCount, StaticBatchMs, StaticBatches.size(), StaticCubeCount);
+	for (CMesh* Batch : StaticBatches)
+	{
+		delete Batch;
+	}
+	delete BatchSource;
+}
+
+// Uploads Mesh, then compares the index format and size Init picked with the expected ones
+static bool CheckIndexFormat(const char* Name, CMesh& Mesh, CNullUploadContext& Context, ERHIFormat ExpectedFormat, uint32_t ExpectedStride)
+{
+	const bool bUploaded = Mesh.Init(Context.Pool, Context.CommandList);
+	const int ExpectedSize = int(ExpectedStride * Mesh.Indices.size());
+	return Check(bUploaded && Mesh.IndexFormat == ExpectedFormat && Mesh.GetIndexStride() == ExpectedStride && Mesh.GetIndexBufferSize() == ExpectedSize,
+		"index format, %s : %zu vertices, %zu indices, %d bytes of %u bits indices (expected %d bytes of %u bits)", Name, Mesh.Vertices.size(),
+		Mesh.Indices.size(), Mesh.GetIndexBufferSize(), Mesh.GetIndexStride() * 8, ExpectedSize, ExpectedStride * 8);
+}
+
+// Encodes Normal and Tangent as a QTangent then decodes them, returns how far the decoded ones are and if the handedness held
+static float RoundTripQTangent(const XMFLOAT3& Normal, const XMFLOAT4& Tangent, bool& bOutSameHandedness)
+{
+	XMFLOAT3 DecodedNormal;
+	XMFLOAT4 DecodedTangent;
+	CTangentGenerator::DecodeQTangent(CTangentGenerator::EncodeQTangent(Normal, Tangent), DecodedNormal, DecodedTangent);
+	bOutSameHandedness = (DecodedTangent.w < 0.0f) == (Tangent.w < 0.0f);
+	return std::max(XMVectorGetX(XMVector3Length(XMLoadFloat3(&DecodedNormal) - XMLoadFloat3(&Normal))),
+		XMVectorGetX(XMVector3Length(XMVectorSetW(XMLoadFloat4(&DecodedTangent) - XMLoadFloat4(&Tangent), 0.0f))));
+}
+
+static bool RunTangentFrameChecks()
+{
+	// Frames of a sphere from one thread then all of them, the output must not depend on it
+	std::vector<Vertex> Vertices[2];
+	std::vector<unsigned int> Indices[2];
+	BuildShuffledSphere(64, 128, Vertices[0], Indices[0]);
+	Vertices[1] = Vertices[0];
+	Indices[1] = Indices[0];
+	CTangentGenerator::Generate(Vertices[0], Indices[0], 1);
+	CTangentGenerator::Generate(Vertices[1], Indices[1], 0);
+	bool bPassed = Check(Vertices[0].size() == Vertices[1].size() && Indices[0] == Indices[1]
+		&& memcmp(Vertices[0].data(), Vertices[1].data(), Vertices[0].size() * sizeof(Vertex)) == 0,
+		"tangent frames : the same from 1 thread and from all of them");
+
+	// Orthonormal frames with normals along the radius, the winding of the sphere decides the side, then through a QTangent
+	// and back
+	float MaxFrameError = 0.0f, MinRadialCosine = 1.0f, MaxRoundTripError = 0.0f;
+	uint32_t Inward = 0, HandednessLost = 0, LeftHanded = 0;
+	for (const Vertex& FrameVertex : Vertices[0])
+	{
+		const XMVECTOR Normal = XMLoadFloat3(&FrameVertex.Normal);
+		const XMVECTOR Tangent = XMVectorSetW(XMLoadFloat4(&FrameVertex.Tangent), 0.0f);
+		MaxFrameError = std::max({ MaxFrameError, fabsf(XMVectorGetX(XMVector3Length(Normal)) - 1.0f),
+			fabsf(XMVectorGetX(XMVector3Length(Tangent)) - 1.0f), fabsf(XMVectorGetX(XMVector3Dot(Normal, Tangent))),
+			fabsf(fabsf(FrameVertex.Tangent.w) - 1.0f) });
+
+		const float RadialCosine = XMVectorGetX(XMVector3Dot(Normal, XMVector3Normalize(XMLoadFloat3(&FrameVertex.Pos))));
+		MinRadialCosine = std::min(MinRadialCosine, fabsf(RadialCosine));
+		Inward += RadialCosine < 0.0f ? 1 : 0;
+		LeftHanded += FrameVertex.Tangent.w < 0.0f ? 1 : 0;
+
+		bool bSameHandedness;
+		MaxRoundTripError = std::max(MaxRoundTripError, RoundTripQTangent(FrameVertex.Normal, FrameVertex.Tangent, bSameHandedness));
+		HandednessLost += bSameHandedness ? 0 : 1;
+	}
+	const uint32_t VertexCount = uint32_t(Vertices[0].size());
+	bPassed &= Check(MaxFrameError < 1e-4f, "tangent frames : %u frames orthonormal within %.6f", VertexCount, MaxFrameError);
+	bPassed &= Check(MinRadialCosine > 0.99f && (Inward == 0 || Inward == VertexCount),
+		"tangent frames : normals along the radius of the sphere, cosine at least %.4f, %u of %u on the other side", MinRadialCosine,
+		std::min(Inward, VertexCount - Inward), VertexCount);
+	bPassed &= Check(MaxRoundTripError < 1e-3f && HandednessLost == 0,
+		"QTangent : frames of the sphere decoded within %.6f, %u of %u lost their handedness (%u left handed)", MaxRoundTripError,
+		HandednessLost, VertexCount, LeftHanded);
+
+	// Half turns have w = 0 : the bias must keep it off 0 so both handedness survive 16 bits
+	const XMFLOAT3 HalfTurnNormal(0.0f, 0.0f, -1.0f);
+	float MaxHalfTurnError = 0.0f;
+	bool bHalfTurnHandedness = true;
+	for (float Sign : { 1.0f, -1.0f })
+	{
+		bool bSameHandedness;
+		MaxHalfTurnError = std::max(MaxHalfTurnError, RoundTripQTangent(HalfTurnNormal, XMFLOAT4(1.0f, 0.0f, 0.0f, Sign), bSameHandedness));
+		bHalfTurnHandedness = bHalfTurnHandedness && bSameHandedness;
+	}
+	bPassed &= Check(MaxHalfTurnError < 1e-3f && bHalfTurnHandedness, "QTangent : a half turn frame decoded within %.6f, %s",
+		MaxHalfTurnError, bHalfTurnHandedness ? "both handedness kept" : "handedness LOST");
+	return bPassed;
+}
+
+// Triangle with its smallest index first, the winding kept
+static std::array<unsigned int, 3> MakeTriangle(unsigned int A, unsigned int B, unsigned int C)
+{
+	if (B < A && B < C)
+	{
+		return { B, C, A };
+	}
+	if (C < A && C < B)
+	{
+		return { C, A, B };
+	}
+	return { A, B, C };
+}
+
+static bool RunMeshletChecks()
+{
+	std::vector<Vertex> Vertices;
+	std::vector<unsigned int> Indices;
+	BuildShuffledSphere(64, 128, Vertices, Indices);
+	CMeshOptimizer::OptimizeVertexCache(Indices, Vertices.size());
+	MeshletData Data;
+	CMeshletBuilder::Build(Vertices, Indices, Data);
+
+	// Limits, local indices in range and bounding spheres around their vertices
+	uint32_t OverLimits = 0, BadIndices = 0;
+	float MaxOutside = 0.0f;
+	std::vector<std::array<unsigned int, 3>> MeshletTriangles;
+	for (const Meshlet& CurrentMeshlet : Data.Meshlets)
+	{
+		const MeshletBounds& Bounds = Data.Bounds[&CurrentMeshlet - Data.Meshlets.data()];
+		OverLimits += CurrentMeshlet.VertexCount == 0 || CurrentMeshlet.VertexCount > MESHLET_MAX_VERTICES || CurrentMeshlet.TriangleCount == 0
+			|| CurrentMeshlet.TriangleCount > MESHLET_MAX_TRIANGLES ? 1 : 0;
+		if (CurrentMeshlet.VertexOffset + CurrentMeshlet.VertexCount > Data.Vertices.size()
+			|| (CurrentMeshlet.TriangleOffset + CurrentMeshlet.TriangleCount) * 3 > Data.Triangles.size())
+		{
+			BadIndices++;
+			continue;
+		}
+		for (uint32_t Entry = 0; Entry < CurrentMeshlet.VertexCount; ++Entry)
+		{
+			const XMVECTOR Position = XMLoadFloat3(&Vertices[Data.Vertices[CurrentMeshlet.VertexOffset + Entry]].Pos);
+			MaxOutside = std::max(MaxOutside, XMVectorGetX(XMVector3Length(Position - XMLoadFloat3(&Bounds.Center))) - Bounds.Radius);
+		}
+		const uint8_t* Locals = &Data.Triangles[CurrentMeshlet.TriangleOffset * 3];
+		for (uint32_t Triangle = 0; Triangle < CurrentMeshlet.TriangleCount; ++Triangle)
+		{
+			if (Locals[Triangle * 3] >= CurrentMeshlet.VertexCount || Locals[Triangle * 3 + 1] >= CurrentMeshlet.VertexCount
+				|| Locals[Triangle * 3 + 2] >= CurrentMeshlet.VertexCount)
+			{
+				BadIndices++;
+				continue;
+			}
+			const unsigned int* MeshletVertices = &Data.Vertices[CurrentMeshlet.VertexOffset];
+			MeshletTriangles.push_back(MakeTriangle(MeshletVertices[Locals[Triangle * 3]], MeshletVertices[Locals[Triangle * 3 + 1]],
+				MeshletVertices[Locals[Triangle * 3 + 2]]));
+		}
+	}
+	bool bPassed = Check(!Data.Meshlets.empty() && OverLimits == 0 && BadIndices == 0,
+		"meshlets : %zu meshlets, %u over %u vertices or %u triangles, %u indices out of their range", Data.Meshlets.size(), OverLimits,
+		MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES, BadIndices);
+	bPassed &= Check(MaxOutside <= 1e-5f, "meshlets : vertices at most %.7f outside their bounding sphere", std::max(MaxOutside, 0.0f));
+
+	// Every triangle of the mesh in exactly one meshlet, with its winding
+	std::vector<std::array<unsigned int, 3>> MeshTriangles;
+	for (size_t Index = 0; Index < Indices.size(); Index += 3)
+	{
+		MeshTriangles.push_back(MakeTriangle(Indices[Index], Indices[Index + 1], Indices[Index + 2]));
+	}
+	std::sort(MeshTriangles.begin(), MeshTriangles.end());
+	std::sort(MeshletTriangles.begin(), MeshletTriangles.end());
+	bPassed &= Check(MeshTriangles == MeshletTriangles, "meshlets : %zu triangles in the meshlets for the %zu of the mesh, each exactly once",
+		MeshletTriangles.size(), MeshTriangles.size());
+
+	// Asked for more vertices than 8 bits local indices address, the meshlets stop at the limit and keep every triangle
+	MeshletData WideData;
+	CMeshletBuilder::Build(Vertices, Indices, WideData, 1024, 1024);
+	uint32_t WideVertices = 0, WideTriangles = 0;
+	for (const Meshlet& WideMeshlet : WideData.Meshlets)
+	{
+		WideVertices = std::max(WideVertices, WideMeshlet.VertexCount);
+		WideTriangles += WideMeshlet.TriangleCount;
+	}
+	bPassed &= Check(WideVertices > MESHLET_MAX_VERTICES && WideVertices <= MESHLET_VERTEX_LIMIT && WideTriangles == Indices.size() / 3,
+		"meshlets : at most %u vertices per meshlet when asked for 1024 (limit %u), %u of the %zu triangles", WideVertices,
+		MESHLET_VERTEX_LIMIT, WideTriangles, Indices.size() / 3);
+
+	// Culling is conservative : a meshlet with a triangle facing the camera is never backfacing, and one with a vertex in the
+	// frustum never outside of it. From cameras around, close to and looking away from the sphere, in its local space
+	const XMFLOAT3 CameraPositions[] = { XMFLOAT3(0.0f, 0.0f, -4.0f), XMFLOAT3(0.0f, 0.0f, -1.6f), XMFLOAT3(-3.0f, 0.5f, 0.0f), XMFLOAT3(0.3f, 2.5f, 0.2f) };
+	const XMFLOAT3 CameraRotations[] = { XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 10.0f, 0.0f), XMFLOAT3(0.0f, 90.0f, 0.0f), XMFLOAT3(-90.0f, 0.0f, 0.0f) };
+	uint32_t WronglyBackfacing = 0, WronglyOutside = 0, Backfacing = 0, Outside = 0;
+	for (int CameraIndex = 0; CameraIndex < 4; ++CameraIndex)
+	{
+		Camera CullingCamera;
+		CullingCamera.SetPosition(CameraPositions[CameraIndex]);
+		CullingCamera.SetRotation(CameraRotations[CameraIndex]);
+		const XMFLOAT4* Planes = CullingCamera.GetFrustumPlanes();
+		const XMVECTOR CameraPosition = XMLoadFloat3(&CameraPositions[CameraIndex]);
+
+		for (size_t Index = 0; Index < Data.Meshlets.size(); ++Index)
+		{
+			const Meshlet& CurrentMeshlet = Data.Meshlets[Index];
+			const unsigned int* MeshletVertices = &Data.Vertices[CurrentMeshlet.VertexOffset];
+			const uint8_t* Locals = &Data.Triangles[CurrentMeshlet.TriangleOffset * 3];
+			bool bFrontFacing = false, bInFrustum = false;
+			for (uint32_t Triangle = 0; Triangle < CurrentMeshlet.TriangleCount; ++Triangle)
+			{
+				const XMVECTOR P0 = XMLoadFloat3(&Vertices[MeshletVertices[Locals[Triangle * 3]]].Pos);
+				const XMVECTOR P1 = XMLoadFloat3(&Vertices[MeshletVertices[Locals[Triangle * 3 + 1]]].Pos);
+				const XMVECTOR P2 = XMLoadFloat3(&Vertices[MeshletVertices[Locals[Triangle * 3 + 2]]].Pos);
+				bFrontFacing |= XMVectorGetX(XMVector3Dot(XMVector3Cross(P1 - P0, P2 - P0), P0 - CameraPosition)) < 0.0f;
+			}
+			for (uint32_t Entry = 0; Entry < CurrentMeshlet.VertexCount && !bInFrustum; ++Entry)
+			{
+				const XMVECTOR Position = XMVectorSetW(XMLoadFloat3(&Vertices[MeshletVertices[Entry]].Pos), 1.0f);
+				bInFrustum = true;
+				for (int Plane = 0; Plane < 6; ++Plane)
+				{
+					bInFrustum = bInFrustum && XMVectorGetX(XMVector4Dot(XMLoadFloat4(&Planes[Plane]), Position)) >= 0.0f;
+				}
+			}
+
+			const bool bBackfacing = CMeshletBuilder::IsBackfacing(Data.Bounds[Index], CameraPositions[CameraIndex]);
+			const bool bOutside = CMeshletBuilder::IsOutsideFrustum(Data.Bounds[Index], Planes);
+			Backfacing += bBackfacing ? 1 : 0;
+			Outside += bOutside ? 1 : 0;
+			WronglyBackfacing += bBackfacing && bFrontFacing ? 1 : 0;
+			WronglyOutside += bOutside && bInFrustum ? 1 : 0;
+		}
+	}
+	bPassed &= Check(WronglyBackfacing == 0 && Backfacing > 0, "meshlet culling : %u backfacing from 4 cameras, %u of them with a triangle facing the camera",
+		Backfacing, WronglyBackfacing);
+	bPassed &= Check(WronglyOutside == 0 && Outside > 0, "meshlet culling : %u outside of the frustum of 4 cameras, %u of them with a vertex in it",
+		Outside, WronglyOutside);
+	return bPassed;
+}
+
+// A triangle as its 3 positions in a row, rotated to start at its smallest vertex so the winding is kept
+typedef std::array<float, 9> WorldTriangle;
+
+// Appends the triangles of Vertices and Indices moved by World, in the winding a mirroring World must give them
+static void AppendWorldTriangles(const std::vector<Vertex>& Vertices, const std::vector<unsigned int>& Indices, const XMFLOAT4X4& World,
+	std::vector<WorldTriangle>& OutTriangles)
+{
+	const XMMATRIX Transform = XMLoadFloat4x4(&World);
+	const bool bMirrored = XMVectorGetX(XMMatrixDeterminant(Transform)) < 0.0f;
+	for (size_t Index = 0; Index + 2 < Indices.size(); Index += 3)
+	{
+		std::array<XMFLOAT3, 3> Corners;
+		for (size_t Corner = 0; Corner < 3; ++Corner)
+		{
+			const size_t Source = bMirrored && Corner > 0 ? Index + 3 - Corner : Index + Corner;
+			XMStoreFloat3(&Corners[Corner], XMVector3TransformCoord(XMLoadFloat3(&Vertices[Indices[Source]].Pos), Transform));
+		}
+
+		const auto Less = [](const XMFLOAT3& A, const XMFLOAT3& B)
+		{
+			return A.x != B.x ? A.x < B.x : A.y != B.y ? A.y < B.y : A.z < B.z;
+		};
+		const size_t First = size_t(std::min_element(Corners.begin(), Corners.end(), Less) - Corners.begin());
+		WorldTriangle Triangle;
+		for (size_t Corner = 0; Corner < 3; ++Corner)
+		{
+			memcpy(&Triangle[Corner * 3], &Corners[(First + Corner) % 3], sizeof(XMFLOAT3));
+		}
+		OutTriangles.push_back(Triangle);
+	}
+}
+
+static bool RunStaticBatchChecks()
+{
+	// Cubes turned, scaled and mirrored, a small grid, then a grid too big for 16 bits indices that gets a sub-batch of
+	// its own. The batches must hold the same triangles in world space with the same winding, in the index format of
+	// their vertex count
+	CNullUploadContext Context;
+	CCube Cube;
+	Cube.Init(Context.Pool, Context.CommandList);
+	CMesh SmallGrid;
+	BuildGrid(16, 16, SmallGrid);
+	SmallGrid.Init(Context.Pool, Context.CommandList);
+	CMesh LargeGrid;
+	BuildGrid(257, 256, LargeGrid);
+	LargeGrid.Init(Context.Pool, Context.CommandList);
+
+	struct BatchSource
+	{
+		const CMesh* Geometry;
+		XMMATRIX World;
+	};
+	const BatchSource Sources[] =
+	{
+		{ &Cube, XMMatrixRotationRollPitchYaw(0.3f, 0.5f, 0.7f) * XMMatrixTranslation(2.0f, 0.0f, 0.0f) },
+		{ &Cube, XMMatrixScaling(1.0f, 2.0f, 3.0f) * XMMatrixRotationY(1.0f) * XMMatrixTranslation(-3.0f, 1.0f, 0.0f) },
+		{ &Cube, XMMatrixScaling(-1.0f, 1.0f, 1.0f) * XMMatrixTranslation(0.0f, 0.0f, 5.0f) },
+		{ &SmallGrid, XMMatrixScaling(0.5f, 0.5f, 0.5f) * XMMatrixRotationX(0.4f) * XMMatrixTranslation(0.0f, -4.0f, 2.0f) },
+		{ &LargeGrid, XMMatrixTranslation(100.0f, 0.0f, 0.0f) }
+	};
+
+	CStaticBatcher Batcher;
+	Batcher.bKeepCPUCopy = true;
+	std::vector<WorldTriangle> Expected;
+	size_t ExpectedVertices = 0;
+	bool bAllAdded = true;
+	for (const BatchSource& Source : Sources)
+	{
+		XMFLOAT4X4 World;
+		XMStoreFloat4x4(&World, Source.World);
+		bAllAdded &= Batcher.Add(Source.Geometry, World, StaticMaterial());
+		AppendWorldTriangles(Source.Geometry->Vertices, Source.Geometry->Indices, World, Expected);
+		ExpectedVertices += Source.Geometry->Vertices.size();
+	}
+
+	// Neither a mesh without its CPU copy nor one not optimized yet can be baked
+	XMFLOAT4X4 Identity;
+	XMStoreFloat4x4(&Identity, XMMatrixIdentity());
+	CMesh Empty;
+	CCube Unprepared;
+	const bool bRejected = !Batcher.Add(&Empty, Identity, StaticMaterial()) && !Batcher.Add(&Unprepared, Identity, StaticMaterial());
+
+	std::vector<CMesh*> Batches;
+	std::vector<StaticMaterial> Materials;
+	Batcher.Build(Context.Pool, Context.CommandList, Batches, Materials);
+
+	std::vector<WorldTriangle> Baked;
+	size_t BakedVertices = 0;
+	bool bFormatsMatch = true;
+	bool bAnyLarge = false;
+	for (const CMesh* Batch : Batches)
+	{
+		AppendWorldTriangles(Batch->Vertices, Batch->Indices, Identity, Baked);
+		BakedVertices += Batch->Vertices.size();
+		bFormatsMatch &= Batch->IndexFormat == CMesh::SelectIndexFormat(Batch->Vertices.size()) && Batch->IndexCount == Batch->Indices.size()
+			&& Batch->GetIndexBufferSize() == int(Batch->Indices.size() * Batch->GetIndexStride());
+		bAnyLarge |= Batch->IndexFormat == ERHIFormat::R32_UInt;
+	}
+
+	// Same triangles whatever sub-batch and order they were baked in
+	std::sort(Expected.begin(), Expected.end());
+	std::sort(Baked.begin(), Baked.end());
+	float MaxDistance = 0.0f;
+	for (size_t Index = 0; Index < Expected.size() && Expected.size() == Baked.size(); ++Index)
+	{
+		for (size_t Component = 0; Component < 9; ++Component)
+		{
+			MaxDistance = std::max(MaxDistance, fabsf(Expected[Index][Component] - Baked[Index][Component]));
+		}
+	}
+
+	bool bPassed = Check(bAllAdded && bRejected, "static batching : prepared meshes are added, empty or unoptimized ones rejected");
+	bPassed &= Check(Baked.size() == Expected.size() && BakedVertices == ExpectedVertices && MaxDistance < 1e-4f,
+		"static batching : %zu batches, %zu triangles and %zu vertices baked (expected %zu and %zu), %g from the sources in world space",
+		Batches.size(), Baked.size(), BakedVertices, Expected.size(), ExpectedVertices, MaxDistance);
+	bPassed &= Check(bFormatsMatch && bAnyLarge, "static batching : index formats follow the vertex count of each batch");
+
+	for (CMesh* Batch : Batches)
+	{
+		delete Batch;
+	}
+	return bPassed;
+}
+
+bool RunMeshChecks()
+{
+	bool bPassed = true;
+	{
+		CNullUploadContext Context;
+
+		CCube Cube;
+		bPassed &= CheckIndexFormat("cube", Cube, Context, ERHIFormat::R16_UInt, 2);
+		bPassed &= Check(Cube.Indices.size() == 36 && Cube.GetIndexBufferSize() == 72, "index format, cube : 36 indices in 72 bytes");
+
+		// On both sides of the last vertex 16 bits indices can address
+		CMesh BoundaryGrid;
+		BuildGrid(256, 256, BoundaryGrid);
+		bPassed &= CheckIndexFormat("65536 vertices grid", BoundaryGrid, Context, ERHIFormat::R16_UInt, 2);
+
+		CMesh PastBoundaryGrid;
+		BuildGrid(257, 256, PastBoundaryGrid);
+		bPassed &= CheckIndexFormat("65792 vertices grid", PastBoundaryGrid, Context, ERHIFormat::R32_UInt, 4);
+
+		CMesh LargeGrid;
+		BuildGrid(280, 250, LargeGrid);
+		bPassed &= CheckIndexFormat("70000 vertices grid", LargeGrid, Context, ERHIFormat::R32_UInt, 4);
+
+		// Nothing to allocate, the handles would be invalid
+		CMesh EmptyMesh;
+		EmptyMesh.bOptimized = true;
+		EmptyMesh.bHasTangentFrames = true;
+		bPassed &= Check(!EmptyMesh.Init(Context.Pool, Context.CommandList), "mesh upload : an empty mesh fails to init");
+	}
+
+	bPassed &= RunTangentFrameChecks();
+	bPassed &= RunMeshletChecks();
+	bPassed &= RunStaticBatchChecks();
+
+	// LOD chain of a unit sphere : each LOD at most about half the triangles of the previous one, and every triangle
+	// within the error it reports of the sphere, the full mesh itself being within FullMeshError of it
+	std::vector<Vertex> SphereVertices;
+	std::vector<unsigned int> SphereIndices;
+	BuildShuffledSphere(64, 128, SphereVertices, SphereIndices);
+	std::vector<MeshLOD> SphereLODs;
+	CMeshSimplifier::BuildLODChain(SphereVertices, SphereIndices, SphereLODs);
+	const float FullMeshError = 1.0f - cosf(XM_PI / 64.0f);
+
+	bPassed &= Check(SphereLODs.size() >= 3, "LOD chain : %zu LODs of a sphere of %zu triangles", SphereLODs.size(), SphereIndices.size() / 3);
+	size_t PreviousTriangles = SphereIndices.size() / 3;
+	float PreviousError = 0.0f;
+	for (size_t Level = 0; Level < SphereLODs.size(); ++Level)
+	{
+		const MeshLOD& LOD = SphereLODs[Level];
+		const size_t Triangles = LOD.Indices.size() / 3;
+
+		// Farthest point of the triangles from the sphere, at their centers or vertices
+		float MeasuredError = 0.0f;
+		bool bValidIndices = LOD.Indices.size() % 3 == 0;
+		for (size_t Index = 0; Index + 2 < LOD.Indices.size() && bValidIndices; Index += 3)
+		{
+			bValidIndices = LOD.Indices[Index] < SphereVertices.size() && LOD.Indices[Index + 1] < SphereVertices.size()
+				&& LOD.Indices[Index + 2] < SphereVertices.size();
+			if (bValidIndices)
+			{
+				const XMVECTOR Center = (XMLoadFloat3(&SphereVertices[LOD.Indices[Index]].Pos) + XMLoadFloat3(&SphereVertices[LOD.Indices[Index + 1]].Pos)
+					+ XMLoadFloat3(&SphereVertices[LOD.Indices[Index + 2]].Pos)) / 3.0f;
+				MeasuredError = fmaxf(MeasuredError, fabsf(1.0f - XMVectorGetX(XMVector3Length(Center))));
+			}
+		}
+
+		bPassed &= Check(bValidIndices && Triangles > 0 && Triangles <= PreviousTriangles * 6 / 10,
+			"LOD chain, LOD %zu : %zu triangles, at most 60%% of the %zu before", Level + 1, Triangles, PreviousTriangles);
+		bPassed &= Check(LOD.Error >= PreviousError && MeasuredError <= LOD.Error + FullMeshError,
+			"LOD chain, LOD %zu : error %.5f, not below the one before (%.5f) nor below the measured %.5f", Level + 1, LOD.Error, PreviousError,
+			MeasuredError - FullMeshError);
+		PreviousTriangles = Triangles;
+		PreviousError = LOD.Error;
+	}
+	return bPassed;
+}
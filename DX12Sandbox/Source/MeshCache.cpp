@@ -0,0 +1,173 @@
+#include "pch.h"
+#include "MeshCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+static const uint64_t StreamAlignment = 16;
+
+// Appends Size bytes of Data at the next aligned offset of Blob and returns the offset
+static uint64_t AppendStream(std::vector<uint8_t>& Blob, const void* Data, size_t Size)
+{
+	const uint64_t Offset = (Blob.size() + StreamAlignment - 1) & ~(StreamAlignment - 1);
+	Blob.resize(size_t(Offset) + Size);
+	if (Size > 0)
+	{
+		memcpy(Blob.data() + Offset, Data, Size);
+	}
+	return Offset;
+}
+
+// Indices narrowed to 16 bits when the mesh uses them
+static uint64_t AppendIndices(std::vector<uint8_t>& Blob, const std::vector<unsigned int>& Indices, uint32_t IndexStride)
+{
+	if (IndexStride == 2)
+	{
+		const std::vector<uint16_t> ShortIndices(Indices.begin(), Indices.end());
+		return AppendStream(Blob, ShortIndices.data(), ShortIndices.size() * sizeof(uint16_t));
+	}
+	return AppendStream(Blob, Indices.data(), Indices.size() * sizeof(unsigned int));
+}
+
+// True when Count elements of Size bytes at Offset are inside the file
+static bool IsInFile(uint64_t Offset, uint64_t Count, uint64_t Size, uint64_t FileSize)
+{
+	return Offset % StreamAlignment == 0 && Offset <= FileSize && Count <= (FileSize - Offset) / Size;
+}
+
+// Size and last write time of the file at Path, false when it doesn't exist
+static bool GetFileStamp(const char* Path, uint64_t& OutSize, uint64_t& OutWriteTime)
+{
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA Attributes;
+	if (!GetFileAttributesExA(Path, GetFileExInfoStandard, &Attributes))
+	{
+		return false;
+	}
+	OutSize = uint64_t(Attributes.nFileSizeHigh) << 32 | Attributes.nFileSizeLow;
+	OutWriteTime = uint64_t(Attributes.ftLastWriteTime.dwHighDateTime) << 32 | Attributes.ftLastWriteTime.dwLowDateTime;
+#else
+	struct stat Status;
+	if (stat(Path, &Status) != 0)
+	{
+		return false;
+	}
+	OutSize = uint64_t(Status.st_size);
+	OutWriteTime = uint64_t(Status.st_mtim.tv_sec) * 1000000000 + uint64_t(Status.st_mtim.tv_nsec);
+#endif
+	return true;
+}
+
+bool CMeshCache::Write(const char* Path, CMesh& Mesh, const char* SourcePath)
+{
+	Mesh.Prepare();
+
+	MeshletData Meshlets;
+	CMeshletBuilder::Build(Mesh.Vertices, Mesh.Indices, Meshlets);
+
+	std::vector<PackedVertex> PackedVertices;
+	Mesh.PackVertices(PackedVertices);
+
+	MeshCacheHeader Header;
+	Header.VertexCount = uint32_t(Mesh.Vertices.size());
+	Header.IndexCount = uint32_t(Mesh.Indices.size());
+	Header.IndexStride = Mesh.GetIndexStride();
+	Header.LODCount = uint32_t(Mesh.LODs.size());
+	Header.MeshletCount = uint32_t(Meshlets.Meshlets.size());
+	Header.MeshletVertexCount = uint32_t(Meshlets.Vertices.size());
+	Header.MeshletTriangleCount = uint32_t(Meshlets.Triangles.size() / 3);
+	Header.BoundsCenter = Mesh.BoundsCenter;
+	Header.BoundsRadius = Mesh.BoundsRadius;
+	Header.BoundsExtents = Mesh.BoundsExtents;
+	Header.QuantizationOffset = Mesh.QuantizationOffset;
+	Header.QuantizationScale = Mesh.QuantizationScale;
+	if (SourcePath && !GetFileStamp(SourcePath, Header.SourceSize, Header.SourceWriteTime))
+	{
+		return false;
+	}
+
+	// The header is written last, once the offsets are known
+	std::vector<uint8_t> Blob(sizeof(MeshCacheHeader));
+	Header.VertexOffset = AppendStream(Blob, PackedVertices.data(), PackedVertices.size() * sizeof(PackedVertex));
+	Header.IndexOffset = AppendIndices(Blob, Mesh.Indices, Header.IndexStride);
+
+	std::vector<MeshCacheLOD> LODs(Mesh.LODs.size());
+	for (size_t Level = 0; Level < LODs.size(); ++Level)
+	{
+		LODs[Level].IndexCount = uint32_t(Mesh.LODs[Level].Indices.size());
+		LODs[Level].Error = Mesh.LODs[Level].Error;
+		LODs[Level].IndexOffset = AppendIndices(Blob, Mesh.LODs[Level].Indices, Header.IndexStride);
+	}
+	Header.LODOffset = AppendStream(Blob, LODs.data(), LODs.size() * sizeof(MeshCacheLOD));
+
+	Header.MeshletOffset = AppendStream(Blob, Meshlets.Meshlets.data(), Meshlets.Meshlets.size() * sizeof(Meshlet));
+	Header.MeshletBoundsOffset = AppendStream(Blob, Meshlets.Bounds.data(), Meshlets.Bounds.size() * sizeof(MeshletBounds));
+	Header.MeshletVerticesOffset = AppendStream(Blob, Meshlets.Vertices.data(), Meshlets.Vertices.size() * sizeof(unsigned int));
+	Header.MeshletTrianglesOffset = AppendStream(Blob, Meshlets.Triangles.data(), Meshlets.Triangles.size());
+	Header.FileSize = Blob.size();
+	memcpy(Blob.data(), &Header, sizeof(Header));
+
+	FILE* File = fopen(Path, "wb");
+	if (!File)
+	{
+		return false;
+	}
+	const bool bWritten = fwrite(Blob.data(), 1, Blob.size(), File) == Blob.size();
+	return fclose(File) == 0 && bWritten;
+}
+
+bool CMeshCache::Open(const char* Path)
+{
+	Close();
+	if (!File.Open(Path) || File.GetSize() < sizeof(MeshCacheHeader))
+	{
+		File.Close();
+		return false;
+	}
+
+	// Every stream is checked once here so the getters don't have to
+	const MeshCacheHeader* Candidate = reinterpret_cast<const MeshCacheHeader*>(File.GetData());
+	const uint64_t Size = File.GetSize();
+	bool bValid = Candidate->Magic == MESH_CACHE_MAGIC && Candidate->Version == MESH_CACHE_VERSION && Candidate->FileSize == Size
+		&& (Candidate->IndexStride == 2 || Candidate->IndexStride == 4) && Candidate->LODCount < MESH_MAX_LODS
+		&& IsInFile(Candidate->VertexOffset, Candidate->VertexCount, sizeof(PackedVertex), Size)
+		&& IsInFile(Candidate->IndexOffset, Candidate->IndexCount, Candidate->IndexStride, Size)
+		&& IsInFile(Candidate->LODOffset, Candidate->LODCount, sizeof(MeshCacheLOD), Size)
+		&& IsInFile(Candidate->MeshletOffset, Candidate->MeshletCount, sizeof(Meshlet), Size)
+		&& IsInFile(Candidate->MeshletBoundsOffset, Candidate->MeshletCount, sizeof(MeshletBounds), Size)
+		&& IsInFile(Candidate->MeshletVerticesOffset, Candidate->MeshletVertexCount, sizeof(unsigned int), Size)
+		&& IsInFile(Candidate->MeshletTrianglesOffset, Candidate->MeshletTriangleCount, 3, Size);
+
+	const MeshCacheLOD* LODs = bValid ? reinterpret_cast<const MeshCacheLOD*>(File.GetData() + Candidate->LODOffset) : nullptr;
+	for (uint32_t Level = 0; bValid && Level < Candidate->LODCount; ++Level)
+	{
+		bValid = IsInFile(LODs[Level].IndexOffset, LODs[Level].IndexCount, Candidate->IndexStride, Size);
+	}
+
+	if (!bValid)
+	{
+		File.Close();
+		return false;
+	}
+
+	Header = Candidate;
+	return true;
+}
+
+bool CMeshCache::IsUpToDate(const char* SourcePath) const
+{
+	uint64_t SourceSize, SourceWriteTime;
+	return Header && GetFileStamp(SourcePath, SourceSize, SourceWriteTime)
+		&& Header->SourceSize == SourceSize && Header->SourceWriteTime == SourceWriteTime;
+}
+
+void CMeshCache::Close()
+{
+	File.Close();
+	Header = nullptr;
+}
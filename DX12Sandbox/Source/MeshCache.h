@@ -0,0 +1,135 @@
+#pragma once
+#include "Mesh.h"
+#include "MeshletBuilder.h"
+#include "MappedFile.h"
+
+#define MESH_CACHE_MAGIC 0x4853454D
+#define MESH_CACHE_VERSION 3
+
+// Start of a cooked mesh file, the streams follow at their offsets, each aligned to 16 bytes
+struct MeshCacheHeader
+{
+	uint32_t Magic = MESH_CACHE_MAGIC;
+	uint32_t Version = MESH_CACHE_VERSION;
+
+	uint32_t VertexCount = 0;
+	uint32_t IndexCount = 0;
+
+	// 2 or 4 bytes, the LODs use the same
+	uint32_t IndexStride = 4;
+	uint32_t LODCount = 0;
+
+	uint32_t MeshletCount = 0;
+	uint32_t MeshletVertexCount = 0;
+	uint32_t MeshletTriangleCount = 0;
+
+	float BoundsRadius = 0.0f;
+	XMFLOAT3 BoundsCenter = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	XMFLOAT3 QuantizationOffset = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	XMFLOAT3 QuantizationScale = XMFLOAT3(1.0f, 1.0f, 1.0f);
+	XMFLOAT3 BoundsExtents = XMFLOAT3(0.0f, 0.0f, 0.0f);
+
+	// PackedVertex[VertexCount], indices[IndexCount] and MeshCacheLOD[LODCount]
+	uint64_t VertexOffset = 0;
+	uint64_t IndexOffset = 0;
+	uint64_t LODOffset = 0;
+
+	// Meshlet[MeshletCount], MeshletBounds[MeshletCount], unsigned int[MeshletVertexCount] and uint8_t[MeshletTriangleCount * 3]
+	uint64_t MeshletOffset = 0;
+	uint64_t MeshletBoundsOffset = 0;
+	uint64_t MeshletVerticesOffset = 0;
+	uint64_t MeshletTrianglesOffset = 0;
+
+	uint64_t FileSize = 0;
+
+	// Size and last write time of the file the mesh was cooked from, both 0 when it wasn't given
+	uint64_t SourceSize = 0;
+	uint64_t SourceWriteTime = 0;
+};
+
+static_assert(sizeof(MeshCacheHeader) == 168, "The header layout is part of the file format, bump MESH_CACHE_VERSION when changing it");
+
+struct MeshCacheLOD
+{
+	uint32_t IndexCount = 0;
+	float Error = 0.0f;
+	uint64_t IndexOffset = 0;
+};
+
+// A mesh cooked after import : vertices already packed, indices in their GPU format, bounds, LODs and meshlets.
+// Opening maps the file and checks the header, the streams are used in place and uploaded straight from the mapping
+class CMeshCache
+{
+public:
+
+	// Prepares Mesh (see CMesh::Prepare), builds its meshlets and writes everything to Path. Generate the LODs first.
+	// SourcePath is the file Mesh was imported from, its size and write time are stored so a later edit is noticed
+	static bool Write(const char* Path, CMesh& Mesh, const char* SourcePath = nullptr);
+
+	// Returns false when the file is missing, truncated or from another version of the format
+	bool Open(const char* Path);
+
+	void Close();
+
+	// True when SourcePath has the size and write time it had when the open file was cooked from it
+	bool IsUpToDate(const char* SourcePath) const;
+
+	const MeshCacheHeader& GetHeader() const
+	{
+		return *Header;
+	}
+
+	const PackedVertex* GetVertices() const
+	{
+		return GetStream<PackedVertex>(Header->VertexOffset);
+	}
+
+	// IndexStride bytes per index
+	const void* GetIndices() const
+	{
+		return GetStream<uint8_t>(Header->IndexOffset);
+	}
+
+	const MeshCacheLOD& GetLOD(uint32_t Index) const
+	{
+		return GetStream<MeshCacheLOD>(Header->LODOffset)[Index];
+	}
+
+	const void* GetLODIndices(uint32_t Index) const
+	{
+		return GetStream<uint8_t>(GetLOD(Index).IndexOffset);
+	}
+
+	const Meshlet* GetMeshlets() const
+	{
+		return GetStream<Meshlet>(Header->MeshletOffset);
+	}
+
+	const MeshletBounds* GetMeshletBounds() const
+	{
+		return GetStream<MeshletBounds>(Header->MeshletBoundsOffset);
+	}
+
+	const unsigned int* GetMeshletVertices() const
+	{
+		return GetStream<unsigned int>(Header->MeshletVerticesOffset);
+	}
+
+	const uint8_t* GetMeshletTriangles() const
+	{
+		return GetStream<uint8_t>(Header->MeshletTrianglesOffset);
+	}
+
+private:
+
+	template<typename T>
+	const T* GetStream(uint64_t Offset) const
+	{
+		return reinterpret_cast<const T*>(File.GetData() + Offset);
+	}
+
+	CMappedFile File;
+
+	// Start of the mapping, null until Open succeeds
+	const MeshCacheHeader* Header = nullptr;
+};
@@ -0,0 +1,283 @@
+#include "pch.h"
+#include "Bench.h"
+#include "MeshCache.h"
+#include "MeshImporter.h"
+#include "MeshSimplifier.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Vertices and triangles as OBJ text, every corner with its own texture coordinate index
+static std::string BuildOBJText(const std::vector<Vertex>& Vertices, const std::vector<unsigned int>& Indices)
+{
+	std::string OBJText;
+	OBJText.reserve(Indices.size() * 24 + Vertices.size() * 64);
+	char Line[128];
+	for (const Vertex& CurrentVertex : Vertices)
+	{
+		OBJText.append(Line, size_t(snprintf(Line, sizeof(Line), "v %f %f %f\n", CurrentVertex.Pos.x, CurrentVertex.Pos.y, CurrentVertex.Pos.z)));
+	}
+	for (const Vertex& CurrentVertex : Vertices)
+	{
+		OBJText.append(Line, size_t(snprintf(Line, sizeof(Line), "vt %f %f\n", CurrentVertex.TexCoord.x, 1.0f - CurrentVertex.TexCoord.y)));
+	}
+	for (size_t Index = 0; Index < Indices.size(); Index += 3)
+	{
+		OBJText.append(Line, size_t(snprintf(Line, sizeof(Line), "f %u/%u %u/%u %u/%u\n", Indices[Index] + 1, Indices[Index] + 1,
+			Indices[Index + 1] + 1, Indices[Index + 1] + 1, Indices[Index + 2] + 1, Indices[Index + 2] + 1)));
+	}
+	return OBJText;
+}
+
+static bool WriteFile(const char* Path, const std::string& Content)
+{
+	FILE* File = fopen(Path, "wb");
+	if (!File)
+	{
+		return false;
+	}
+	const bool bWritten = fwrite(Content.data(), 1, Content.size(), File) == Content.size();
+	return fclose(File) == 0 && bWritten;
+}
+
+void RunMeshImportBenchmarks()
+{
+	// A finely tessellated sphere written as OBJ text, parsed back and welded
+	std::vector<Vertex> SphereVertices;
+	std::vector<unsigned int> SphereIndices;
+	BuildShuffledSphere(512, 1024, SphereVertices, SphereIndices);
+	const std::string OBJText = BuildOBJText(SphereVertices, SphereIndices);
+
+	for (uint32_t ThreadCount : { 1u, 0u })
+	{
+		std::vector<Vertex> ImportedVertices;
+		std::vector<unsigned int> ImportedIndices;
+		bool bImported = false;
+		const double ImportMs = MeasureNs(1, [&](int)
+		{
+			bImported = CMeshImporter::ParseOBJ(OBJText.data(), OBJText.size(), ImportedVertices, ImportedIndices, ThreadCount);
+		}) / 1e6;
+		printf("OBJ import, %s                : %.1f ms, %.0f MB/s (%s, %zu vertices, %zu triangles)\n", ThreadCount == 1 ? "1 thread   " : "all threads",
+			ImportMs, OBJText.size() / 1e3 / ImportMs, bImported ? "ok" : "failed", ImportedVertices.size(), ImportedIndices.size() / 3);
+	}
+
+	// Startup of the sphere from its OBJ text then from the mesh cooked from it, both uploaded to a pool of the Null backend
+	CNullUploadContext Context;
+	const char* CachePath = "BenchSphere.mesh";
+
+	CMesh* ImportedMesh = new CMesh;
+	const double ImportStartupMs = MeasureNs(1, [&](int)
+	{
+		CMeshImporter::ParseOBJ(OBJText.data(), OBJText.size(), ImportedMesh->Vertices, ImportedMesh->Indices);
+		CMeshSimplifier::GenerateLODs({ ImportedMesh });
+		ImportedMesh->Init(Context.Pool, Context.CommandList);
+	}) / 1e6;
+	const bool bCooked = CMeshCache::Write(CachePath, *ImportedMesh);
+
+	CMesh* CachedMesh = new CMesh;
+	CMeshCache Cache;
+	bool bCacheLoaded = false;
+	const double CacheStartupMs = MeasureNs(1, [&](int)
+	{
+		bCacheLoaded = Cache.Open(CachePath);
+		if (bCacheLoaded)
+		{
+			CachedMesh->InitFromCache(Cache, Context.Pool, Context.CommandList);
+		}
+	}) / 1e6;
+	printf("Startup from OBJ (import, LODs, pack): %.1f ms\n", ImportStartupMs);
+	printf("Startup from mesh cache              : %.1f ms (%s, %u LODs, %u meshlets)\n", CacheStartupMs,
+		bCooked && bCacheLoaded ? "ok" : "failed", bCacheLoaded ? Cache.GetHeader().LODCount : 0, bCacheLoaded ? Cache.GetHeader().MeshletCount : 0);
+
+	Cache.Close();
+	remove(CachePath);
+	delete ImportedMesh;
+	delete CachedMesh;
+}
+
+// Binary glTF with one triangle primitive, 16 bits indices and its texture coordinates, the JSON and binary chunks padded to 4 bytes
+static std::string BuildGLB(const float (&Positions)[9], const float (&TexCoords)[6], const uint16_t (&Indices)[3])
+{
+	std::string Binary;
+	Binary.append(reinterpret_cast<const char*>(Positions), sizeof(Positions));
+	Binary.append(reinterpret_cast<const char*>(TexCoords), sizeof(TexCoords));
+	Binary.append(reinterpret_cast<const char*>(Indices), sizeof(Indices));
+	Binary.resize((Binary.size() + 3) & ~size_t(3), '\0');
+
+	char Json[1024];
+	snprintf(Json, sizeof(Json), "{\"asset\":{\"version\":\"2.0\"},\"buffers\":[{\"byteLength\":%zu}],"
+		"\"bufferViews\":[{\"buffer\":0,\"byteOffset\":0,\"byteLength\":36},{\"buffer\":0,\"byteOffset\":36,\"byteLength\":24},"
+		"{\"buffer\":0,\"byteOffset\":60,\"byteLength\":6}],"
+		"\"accessors\":[{\"bufferView\":0,\"componentType\":5126,\"count\":3,\"type\":\"VEC3\"},"
+		"{\"bufferView\":1,\"componentType\":5126,\"count\":3,\"type\":\"VEC2\"},"
+		"{\"bufferView\":2,\"componentType\":5123,\"count\":3,\"type\":\"SCALAR\"}],"
+		"\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0,\"TEXCOORD_0\":1},\"indices\":2}]}]}", Binary.size());
+	std::string JsonChunk = Json;
+	JsonChunk.resize((JsonChunk.size() + 3) & ~size_t(3), ' ');
+
+	const uint32_t Header[3] = { 0x46546C67, 2, uint32_t(12 + 8 + JsonChunk.size() + 8 + Binary.size()) };
+	const uint32_t JsonChunkHeader[2] = { uint32_t(JsonChunk.size()), 0x4E4F534A };
+	const uint32_t BinaryChunkHeader[2] = { uint32_t(Binary.size()), 0x004E4942 };
+	std::string GLB;
+	GLB.append(reinterpret_cast<const char*>(Header), sizeof(Header));
+	GLB.append(reinterpret_cast<const char*>(JsonChunkHeader), sizeof(JsonChunkHeader));
+	GLB.append(JsonChunk);
+	GLB.append(reinterpret_cast<const char*>(BinaryChunkHeader), sizeof(BinaryChunkHeader));
+	GLB.append(Binary);
+	return GLB;
+}
+
+static bool IsNearlyEqual(const XMFLOAT3& A, const XMFLOAT3& B)
+{
+	return fabsf(A.x - B.x) < 1e-5f && fabsf(A.y - B.y) < 1e-5f && fabsf(A.z - B.z) < 1e-5f;
+}
+
+static bool IsNearlyEqual(const XMFLOAT2& A, const XMFLOAT2& B)
+{
+	return fabsf(A.x - B.x) < 1e-5f && fabsf(A.y - B.y) < 1e-5f;
+}
+
+bool RunMeshImportChecks()
+{
+	bool bPassed = true;
+
+	// A quad triangulated as a fan, a triangle through relative indices welded with the quad's corners, and one without
+	// texture coordinates that can't be. Z is flipped into our left handed space and V flipped to a top left origin
+	const char* OBJText =
+		"# comment\n"
+		"v 0 0 2\n"
+		"v 1 0 2\n"
+		"v 1 1 2\n"
+		"v 0 1 2\n"
+		"vt 0 0\n"
+		"vt 1 0\n"
+		"vt 1 1\n"
+		"vt 0 1\n"
+		"vn 0 0 1\n"
+		"f 1/1 2/2 3/3 4/4\n"
+		"f -4/-4 -2/-2 -1/-1\n"
+		"f 1//1 2//1 3//1\n";
+	std::vector<Vertex> Vertices;
+	std::vector<unsigned int> Indices;
+	bool bParsed = CMeshImporter::ParseOBJ(OBJText, strlen(OBJText), Vertices, Indices);
+	bool bCornersMatch = bParsed && Indices.size() == 12 && Vertices.size() == 7;
+	const XMFLOAT3 QuadPositions[] = { XMFLOAT3(0.0f, 0.0f, -2.0f), XMFLOAT3(1.0f, 0.0f, -2.0f), XMFLOAT3(1.0f, 1.0f, -2.0f), XMFLOAT3(0.0f, 1.0f, -2.0f) };
+	const XMFLOAT2 QuadTexCoords[] = { XMFLOAT2(0.0f, 1.0f), XMFLOAT2(1.0f, 1.0f), XMFLOAT2(1.0f, 0.0f), XMFLOAT2(0.0f, 0.0f) };
+	const uint32_t ExpectedCorners[] = { 0, 1, 2, 0, 2, 3, 0, 2, 3, 0, 1, 2 };
+	for (size_t Corner = 0; Corner < 12 && bCornersMatch; ++Corner)
+	{
+		const Vertex& CornerVertex = Vertices[Indices[Corner]];
+		const bool bTextured = Corner < 9;
+		bCornersMatch = IsNearlyEqual(CornerVertex.Pos, QuadPositions[ExpectedCorners[Corner]])
+			&& IsNearlyEqual(CornerVertex.TexCoord, bTextured ? QuadTexCoords[ExpectedCorners[Corner]] : XMFLOAT2(0.0f, 0.0f));
+	}
+	bCornersMatch = bCornersMatch && Indices[6] == Indices[0] && Indices[7] == Indices[2] && Indices[8] == Indices[5] && Indices[9] != Indices[0];
+	bPassed &= Check(bCornersMatch, "OBJ import : %s, %zu vertices and %zu triangles (expected 7 and 4), corners welded and flipped as expected",
+		bParsed ? "parsed" : "not parsed", Vertices.size(), Indices.size() / 3);
+
+	const char* BadOBJText = "v 0 0 0\nv 1 0 0\nv 1 1 0\nf 1 2 4\n";
+	bPassed &= Check(!CMeshImporter::ParseOBJ(BadOBJText, strlen(BadOBJText), Vertices, Indices), "OBJ import : a face past the last position is rejected");
+
+	// The same triangle from a binary glTF
+	const float Positions[9] = { 0.0f, 0.0f, 2.0f, 1.0f, 0.0f, 2.0f, 1.0f, 1.0f, 2.0f };
+	const float TexCoords[6] = { 0.0f, 1.0f, 1.0f, 1.0f, 1.0f, 0.0f };
+	const uint16_t TriangleIndices[3] = { 0, 1, 2 };
+	const std::string GLB = BuildGLB(Positions, TexCoords, TriangleIndices);
+	Vertices.clear();
+	Indices.clear();
+	bParsed = CMeshImporter::ParseGLB(GLB.data(), GLB.size(), Vertices, Indices);
+	bCornersMatch = bParsed && Vertices.size() == 3 && Indices.size() == 3;
+	for (size_t Corner = 0; Corner < 3 && bCornersMatch; ++Corner)
+	{
+		bCornersMatch = Indices[Corner] == Corner && IsNearlyEqual(Vertices[Corner].Pos, QuadPositions[Corner])
+			&& IsNearlyEqual(Vertices[Corner].TexCoord, QuadTexCoords[Corner]);
+	}
+	bPassed &= Check(bCornersMatch, "glb import : %s, %zu vertices and %zu triangles (expected 3 and 1), corners as expected",
+		bParsed ? "parsed" : "not parsed", Vertices.size(), Indices.size() / 3);
+	bPassed &= Check(!CMeshImporter::ParseGLB(GLB.data(), GLB.size() - 8, Vertices, Indices), "glb import : a truncated file is rejected");
+
+	// The same file with only 2 of its indices, the length of the JSON doesn't change
+	const std::string IndexAccessor = "\"componentType\":5123,\"count\":3";
+	std::string ShortGLB = GLB;
+	const size_t IndexCountAt = ShortGLB.find(IndexAccessor);
+	if (IndexCountAt != std::string::npos)
+	{
+		ShortGLB[IndexCountAt + IndexAccessor.size() - 1] = '2';
+	}
+	bPassed &= Check(IndexCountAt != std::string::npos && !CMeshImporter::ParseGLB(ShortGLB.data(), ShortGLB.size(), Vertices, Indices),
+		"glb import : a file without a whole triangle is rejected");
+
+	// A sphere cooked from an OBJ file then read back, and seen as stale once the OBJ changes
+	const char* SourcePath = "CheckSphere.obj";
+	const char* CachePath = "CheckSphere.obj.mesh";
+	std::vector<Vertex> SphereVertices;
+	std::vector<unsigned int> SphereIndices;
+	BuildShuffledSphere(32, 64, SphereVertices, SphereIndices);
+	const std::string SphereText = BuildOBJText(SphereVertices, SphereIndices);
+
+	CMesh SourceMesh;
+	bool bCooked = WriteFile(SourcePath, SphereText) && CMeshImporter::Load(SourcePath, SourceMesh);
+	if (bCooked)
+	{
+		SourceMesh.GenerateLODs();
+		bCooked = CMeshCache::Write(CachePath, SourceMesh, SourcePath);
+	}
+
+	CMeshCache Cache;
+	bool bSameContent = bCooked && Cache.Open(CachePath);
+	if (bSameContent)
+	{
+		const MeshCacheHeader& Header = Cache.GetHeader();
+		std::vector<PackedVertex> PackedVertices;
+		SourceMesh.PackVertices(PackedVertices);
+		bSameContent = Header.VertexCount == PackedVertices.size() && Header.IndexCount == SourceMesh.Indices.size()
+			&& Header.IndexStride == SourceMesh.GetIndexStride() && Header.LODCount == SourceMesh.LODs.size()
+			&& Header.BoundsRadius == SourceMesh.BoundsRadius && Header.MeshletCount > 0
+			&& memcmp(Cache.GetVertices(), PackedVertices.data(), PackedVertices.size() * sizeof(PackedVertex)) == 0;
+
+		// Indices in their GPU format, the LODs in the same
+		auto SameIndices = [&Header](const void* Cached, const std::vector<unsigned int>& Expected)
+		{
+			for (size_t Index = 0; Index < Expected.size(); ++Index)
+			{
+				const uint32_t CachedIndex = Header.IndexStride == 2 ? static_cast<const uint16_t*>(Cached)[Index] : static_cast<const uint32_t*>(Cached)[Index];
+				if (CachedIndex != Expected[Index])
+				{
+					return false;
+				}
+			}
+			return true;
+		};
+		bSameContent = bSameContent && SameIndices(Cache.GetIndices(), SourceMesh.Indices);
+		for (uint32_t Level = 0; bSameContent && Level < Header.LODCount; ++Level)
+		{
+			bSameContent = Cache.GetLOD(Level).IndexCount == SourceMesh.LODs[Level].Indices.size() && Cache.GetLOD(Level).Error == SourceMesh.LODs[Level].Error
+				&& SameIndices(Cache.GetLODIndices(Level), SourceMesh.LODs[Level].Indices);
+		}
+	}
+	bPassed &= Check(bSameContent, "mesh cache : %s, vertices, indices and %zu LODs read back as written", bCooked ? "cooked" : "not cooked", SourceMesh.LODs.size());
+	bPassed &= Check(Cache.IsUpToDate(SourcePath), "mesh cache : up to date with the unchanged OBJ");
+
+	// Mapped files can't be rewritten on every platform, close the cache first
+	const uint64_t CacheSize = bSameContent ? Cache.GetHeader().FileSize : 0;
+	Cache.Close();
+	const bool bEdited = WriteFile(SourcePath, SphereText + "v 0 0 0\n");
+	bPassed &= Check(bEdited && Cache.Open(CachePath) && !Cache.IsUpToDate(SourcePath), "mesh cache : stale once the OBJ changed");
+	Cache.Close();
+
+	std::string Truncated;
+	if (FILE* File = fopen(CachePath, "rb"))
+	{
+		Truncated.resize(size_t(CacheSize / 2));
+		Truncated.resize(fread(&Truncated[0], 1, Truncated.size(), File));
+		fclose(File);
+	}
+	bPassed &= Check(!Truncated.empty() && WriteFile(CachePath, Truncated) && !Cache.Open(CachePath), "mesh cache : a truncated file is rejected");
+
+	remove(CachePath);
+	remove(SourcePath);
+	return bPassed;
+}
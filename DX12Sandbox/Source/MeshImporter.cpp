@@ -0,0 +1,828 @@
+#include "pch.h"
+#include "MeshImporter.h"
+#include "MappedFile.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <string>
+#include <utility>
+
+// Smallest piece of OBJ text worth a thread
+static const size_t MinOBJChunkSize = 1 << 20;
+
+// Negative OBJ indices count back from the last element of the chunk's own range, they are stored with this bias
+// until the chunk knows where its range starts
+static const int64_t RelativeIndex = int64_t(1) << 48;
+
+// Face corner without a texture coordinate
+static const int64_t NoIndex = -1;
+
+static const uint32_t GLBMagic = 0x46546C67;
+static const uint32_t GLBJsonChunk = 0x4E4F534A;
+static const uint32_t GLBBinaryChunk = 0x004E4942;
+
+// Runs Function(Thread) for each Thread below ThreadCount as jobs, the calling thread being one of them
+template<typename FunctionType>
+static void RunOnThreads(uint32_t ThreadCount, const FunctionType& Function)
+{
+	CJobSystem::Get().ParallelFor(ThreadCount, 1, [&Function](size_t Begin, size_t End)
+	{
+		for (size_t Thread = Begin; Thread < End; ++Thread)
+		{
+			Function(uint32_t(Thread));
+		}
+	}, ThreadCount);
+}
+
+static uint64_t HashKey(uint64_t Key)
+{
+	Key ^= Key >> 33;
+	Key *= 0xFF51AFD7ED558CCDull;
+	Key ^= Key >> 33;
+	Key *= 0xC4CEB9FE1A85EC53ull;
+	Key ^= Key >> 33;
+	return Key;
+}
+
+static bool EndsWith(const char* Text, const char* Suffix)
+{
+	const size_t TextLength = strlen(Text);
+	const size_t SuffixLength = strlen(Suffix);
+	if (TextLength < SuffixLength)
+	{
+		return false;
+	}
+
+	for (size_t Index = 0; Index < SuffixLength; ++Index)
+	{
+		if (tolower(Text[TextLength - SuffixLength + Index]) != tolower(Suffix[Index]))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// Right handed, counter clockwise front faces to the left handed, clockwise front faces of the renderer : mirroring Z flips both
+static XMFLOAT3 ToLeftHanded(float X, float Y, float Z)
+{
+	return XMFLOAT3(X, Y, -Z);
+}
+
+bool CMeshImporter::Load(const char* Path, CMesh& OutMesh, uint32_t ThreadCount)
+{
+	const bool bLoaded = (EndsWith(Path, ".obj") && LoadOBJ(Path, OutMesh, ThreadCount))
+		|| (EndsWith(Path, ".glb") && LoadGLB(Path, OutMesh));
+
+	// The files' own normals aren't read, every mesh gets the same generated frames whatever its format
+	if (bLoaded)
+	{
+		OutMesh.GenerateTangentFrames(ThreadCount);
+	}
+	return bLoaded;
+}
+
+/********** OBJ **********/
+
+// A face corner, indices are 0 based and absolute, or biased by RelativeIndex
+struct OBJCorner
+{
+	int64_t Position;
+	int64_t TexCoord;
+};
+
+// What a thread found in its range of lines
+struct OBJChunk
+{
+	const char* Begin = nullptr;
+	const char* End = nullptr;
+
+	std::vector<XMFLOAT3> Positions;
+	std::vector<XMFLOAT2> TexCoords;
+
+	// 3 per triangle
+	std::vector<OBJCorner> Corners;
+
+	// Where the chunk's own positions, texture coordinates and corners start in the whole file
+	size_t PositionBase = 0;
+	size_t TexCoordBase = 0;
+	size_t CornerBase = 0;
+
+	bool bValid = true;
+};
+
+static const char* SkipSpaces(const char* Cursor, const char* End)
+{
+	while (Cursor < End && (*Cursor == ' ' || *Cursor == '\t' || *Cursor == '\r'))
+	{
+		++Cursor;
+	}
+	return Cursor;
+}
+
+static bool ParseFloat(const char*& Cursor, const char* End, float& OutValue)
+{
+	Cursor = SkipSpaces(Cursor, End);
+	if (Cursor < End && *Cursor == '+')
+	{
+		++Cursor;
+	}
+
+	const std::from_chars_result Result = std::from_chars(Cursor, End, OutValue);
+	if (Result.ec != std::errc())
+	{
+		return false;
+	}
+	Cursor = Result.ptr;
+	return true;
+}
+
+// 1 based index or negative index counting back from Count, to an index for OBJCorner
+static bool ParseIndex(const char*& Cursor, const char* End, size_t Count, int64_t& OutIndex)
+{
+	int64_t Value = 0;
+	const std::from_chars_result Result = std::from_chars(Cursor, End, Value);
+	if (Result.ec != std::errc() || Value == 0)
+	{
+		return false;
+	}
+	Cursor = Result.ptr;
+	OutIndex = Value > 0 ? Value - 1 : RelativeIndex + int64_t(Count) + Value;
+	return true;
+}
+
+static int64_t ResolveIndex(int64_t Index, size_t Base)
+{
+	return Index >= RelativeIndex / 2 ? Index - RelativeIndex + int64_t(Base) : Index;
+}
+
+static void ParseOBJChunk(OBJChunk& Chunk)
+{
+	// Corners of the current polygon, kept between faces
+	std::vector<OBJCorner> Polygon;
+
+	const char* Line = Chunk.Begin;
+	while (Line < Chunk.End && Chunk.bValid)
+	{
+		const char* LineEnd = static_cast<const char*>(memchr(Line, '\n', size_t(Chunk.End - Line)));
+		if (!LineEnd)
+		{
+			LineEnd = Chunk.End;
+		}
+
+		const char* Cursor = SkipSpaces(Line, LineEnd);
+		if (LineEnd - Cursor >= 2 && Cursor[0] == 'v' && (Cursor[1] == ' ' || Cursor[1] == '\t'))
+		{
+			float X, Y, Z;
+			Cursor += 2;
+			Chunk.bValid = ParseFloat(Cursor, LineEnd, X) && ParseFloat(Cursor, LineEnd, Y) && ParseFloat(Cursor, LineEnd, Z);
+			Chunk.Positions.push_back(ToLeftHanded(X, Y, Z));
+		}
+		else if (LineEnd - Cursor >= 3 && Cursor[0] == 'v' && Cursor[1] == 't' && (Cursor[2] == ' ' || Cursor[2] == '\t'))
+		{
+			// V is optional, OBJ's origin is the bottom left of the texture and ours the top left
+			float U, V = 0.0f;
+			Cursor += 3;
+			Chunk.bValid = ParseFloat(Cursor, LineEnd, U);
+			ParseFloat(Cursor, LineEnd, V);
+			Chunk.TexCoords.push_back(XMFLOAT2(U, 1.0f - V));
+		}
+		else if (LineEnd - Cursor >= 2 && Cursor[0] == 'f' && (Cursor[1] == ' ' || Cursor[1] == '\t'))
+		{
+			// Corners are p, p/t, p//n or p/t/n
+			Polygon.clear();
+			Cursor = SkipSpaces(Cursor + 2, LineEnd);
+			while (Cursor < LineEnd && Chunk.bValid)
+			{
+				OBJCorner Corner = { NoIndex, NoIndex };
+				Chunk.bValid = ParseIndex(Cursor, LineEnd, Chunk.Positions.size(), Corner.Position);
+				if (Chunk.bValid && Cursor < LineEnd && *Cursor == '/' && Cursor + 1 < LineEnd && Cursor[1] != '/')
+				{
+					++Cursor;
+					Chunk.bValid = ParseIndex(Cursor, LineEnd, Chunk.TexCoords.size(), Corner.TexCoord);
+				}
+				while (Cursor < LineEnd && *Cursor != ' ' && *Cursor != '\t' && *Cursor != '\r')
+				{
+					++Cursor;
+				}
+				Cursor = SkipSpaces(Cursor, LineEnd);
+				Polygon.push_back(Corner);
+			}
+
+			for (size_t Corner = 2; Corner < Polygon.size(); ++Corner)
+			{
+				Chunk.Corners.push_back(Polygon[0]);
+				Chunk.Corners.push_back(Polygon[Corner - 1]);
+				Chunk.Corners.push_back(Polygon[Corner]);
+			}
+		}
+
+		// Normals, groups, materials and comments are skipped
+		Line = LineEnd + 1;
+	}
+}
+
+bool CMeshImporter::LoadOBJ(const char* Path, CMesh& OutMesh, uint32_t ThreadCount)
+{
+	CMappedFile File;
+	if (!File.Open(Path))
+	{
+		return false;
+	}
+	return ParseOBJ(File.GetData(), File.GetSize(), OutMesh.Vertices, OutMesh.Indices, ThreadCount);
+}
+
+bool CMeshImporter::ParseOBJ(const char* Data, size_t Size, std::vector<Vertex>& OutVertices, std::vector<unsigned int>& OutIndices,
+	uint32_t ThreadCount)
+{
+	if (ThreadCount == 0)
+	{
+		ThreadCount = CJobSystem::Get().GetThreadCount();
+	}
+	ThreadCount = uint32_t(std::min<size_t>(ThreadCount, Size / MinOBJChunkSize + 1));
+
+	// Ranges of whole lines of about the same size
+	std::vector<OBJChunk> Chunks(ThreadCount);
+	const char* End = Data + Size;
+	const char* Begin = Data;
+	for (uint32_t Thread = 0; Thread < ThreadCount; ++Thread)
+	{
+		const char* ChunkEnd = Thread + 1 == ThreadCount ? End : std::max(Begin, Data + Size / ThreadCount * (Thread + 1));
+		const char* LineEnd = ChunkEnd < End ? static_cast<const char*>(memchr(ChunkEnd, '\n', size_t(End - ChunkEnd))) : nullptr;
+		ChunkEnd = LineEnd ? LineEnd + 1 : End;
+		Chunks[Thread].Begin = Begin;
+		Chunks[Thread].End = ChunkEnd;
+		Begin = ChunkEnd;
+	}
+
+	RunOnThreads(ThreadCount, [&](uint32_t Thread)
+	{
+		ParseOBJChunk(Chunks[Thread]);
+	});
+
+	size_t PositionCount = 0, TexCoordCount = 0, CornerCount = 0;
+	for (OBJChunk& Chunk : Chunks)
+	{
+		if (!Chunk.bValid)
+		{
+			return false;
+		}
+		Chunk.PositionBase = PositionCount;
+		Chunk.TexCoordBase = TexCoordCount;
+		Chunk.CornerBase = CornerCount;
+		PositionCount += Chunk.Positions.size();
+		TexCoordCount += Chunk.TexCoords.size();
+		CornerCount += Chunk.Corners.size();
+	}
+	if (CornerCount == 0 || PositionCount >= 0xFFFFFFFFu || TexCoordCount >= 0xFFFFFFFFu)
+	{
+		return false;
+	}
+
+	// Welding : the keys are split by hash between the threads, each numbers its keys in its own table
+	const uint32_t BucketCount = ThreadCount;
+	auto GetBucket = [BucketCount](uint64_t Hash)
+	{
+		return uint16_t((Hash >> 32) * BucketCount >> 32);
+	};
+
+	// Every corner as a position and texture coordinate pair, the welding key. Texture coordinates are offset by one, 0 is none
+	std::vector<XMFLOAT3> Positions(PositionCount);
+	std::vector<XMFLOAT2> TexCoords(TexCoordCount);
+	std::vector<uint64_t> Keys(CornerCount);
+	std::vector<uint16_t> CornerBuckets(CornerCount);
+	std::vector<std::vector<size_t>> ChunkBucketCorners(ThreadCount, std::vector<size_t>(BucketCount, 0));
+	std::vector<uint8_t> ChunkValid(ThreadCount, 1);
+	RunOnThreads(ThreadCount, [&](uint32_t Thread)
+	{
+		const OBJChunk& Chunk = Chunks[Thread];
+		std::copy(Chunk.Positions.begin(), Chunk.Positions.end(), Positions.begin() + Chunk.PositionBase);
+		std::copy(Chunk.TexCoords.begin(), Chunk.TexCoords.end(), TexCoords.begin() + Chunk.TexCoordBase);
+
+		bool bValid = true;
+		for (size_t Corner = 0; Corner < Chunk.Corners.size(); ++Corner)
+		{
+			const int64_t Position = ResolveIndex(Chunk.Corners[Corner].Position, Chunk.PositionBase);
+			const int64_t TexCoord = Chunk.Corners[Corner].TexCoord == NoIndex ? NoIndex : ResolveIndex(Chunk.Corners[Corner].TexCoord, Chunk.TexCoordBase);
+			bValid &= Position >= 0 && Position < int64_t(PositionCount) && TexCoord >= NoIndex && TexCoord < int64_t(TexCoordCount);
+			const uint64_t Key = (uint64_t(Position) << 32) | uint64_t(TexCoord + 1);
+			const uint16_t Bucket = GetBucket(HashKey(Key));
+			Keys[Chunk.CornerBase + Corner] = Key;
+			CornerBuckets[Chunk.CornerBase + Corner] = Bucket;
+			ChunkBucketCorners[Thread][Bucket]++;
+		}
+		ChunkValid[Thread] = bValid ? 1 : 0;
+	});
+	if (std::find(ChunkValid.begin(), ChunkValid.end(), 0) != ChunkValid.end())
+	{
+		return false;
+	}
+
+	std::vector<uint32_t> CornerVertices(CornerCount);
+	std::vector<std::vector<uint64_t>> BucketKeys(BucketCount);
+	RunOnThreads(BucketCount, [&](uint32_t Bucket)
+	{
+		size_t BucketCorners = 0;
+		for (const std::vector<size_t>& BucketCornerCounts : ChunkBucketCorners)
+		{
+			BucketCorners += BucketCornerCounts[Bucket];
+		}
+
+		// Open addressing with linear probing, at most half full
+		size_t Capacity = 16;
+		while (Capacity < BucketCorners * 2)
+		{
+			Capacity *= 2;
+		}
+		const uint64_t EmptySlot = ~0ull;
+		std::vector<uint64_t> SlotKeys(Capacity, EmptySlot);
+		std::vector<uint32_t> SlotVertices(Capacity);
+
+		std::vector<uint64_t>& UniqueKeys = BucketKeys[Bucket];
+		UniqueKeys.reserve(BucketCorners);
+		for (size_t Corner = 0; Corner < CornerCount; ++Corner)
+		{
+			if (CornerBuckets[Corner] != Bucket)
+			{
+				continue;
+			}
+
+			const uint64_t Hash = HashKey(Keys[Corner]);
+			size_t Slot = size_t(Hash) & (Capacity - 1);
+			while (SlotKeys[Slot] != EmptySlot && SlotKeys[Slot] != Keys[Corner])
+			{
+				Slot = (Slot + 1) & (Capacity - 1);
+			}
+			if (SlotKeys[Slot] == EmptySlot)
+			{
+				SlotKeys[Slot] = Keys[Corner];
+				SlotVertices[Slot] = uint32_t(UniqueKeys.size());
+				UniqueKeys.push_back(Keys[Corner]);
+			}
+			CornerVertices[Corner] = SlotVertices[Slot];
+		}
+	});
+
+	std::vector<uint32_t> BucketBases(BucketCount);
+	size_t VertexCount = 0;
+	for (uint32_t Bucket = 0; Bucket < BucketCount; ++Bucket)
+	{
+		BucketBases[Bucket] = uint32_t(VertexCount);
+		VertexCount += BucketKeys[Bucket].size();
+	}
+
+	// Sized once, each thread writes its own vertices and its own range of indices
+	OutVertices.resize(VertexCount);
+	OutIndices.resize(CornerCount);
+	RunOnThreads(BucketCount, [&](uint32_t Thread)
+	{
+		const std::vector<uint64_t>& UniqueKeys = BucketKeys[Thread];
+		Vertex* Vertices = OutVertices.data() + BucketBases[Thread];
+		for (size_t Index = 0; Index < UniqueKeys.size(); ++Index)
+		{
+			const uint32_t TexCoord = uint32_t(UniqueKeys[Index]);
+			Vertices[Index].Pos = Positions[UniqueKeys[Index] >> 32];
+			Vertices[Index].TexCoord = TexCoord == 0 ? XMFLOAT2(0.0f, 0.0f) : TexCoords[TexCoord - 1];
+		}
+
+		const size_t First = CornerCount * Thread / BucketCount;
+		const size_t Last = CornerCount * (Thread + 1) / BucketCount;
+		for (size_t Corner = First; Corner < Last; ++Corner)
+		{
+			OutIndices[Corner] = BucketBases[CornerBuckets[Corner]] + CornerVertices[Corner];
+		}
+	});
+
+	return true;
+}
+
+/********** glTF **********/
+
+// Just enough JSON for the glTF header
+struct JsonValue
+{
+	enum class EType : uint8_t { Null, Bool, Number, String, Array, Object };
+
+	EType Type = EType::Null;
+	double Number = 0.0;
+	std::string String;
+	std::vector<JsonValue> Array;
+	std::vector<std::pair<std::string, JsonValue>> Members;
+
+	const JsonValue* Find(const char* Key) const
+	{
+		for (const std::pair<std::string, JsonValue>& Member : Members)
+		{
+			if (Member.first == Key)
+			{
+				return &Member.second;
+			}
+		}
+		return nullptr;
+	}
+
+	// Member Key as a number, Default when it is missing
+	double GetNumber(const char* Key, double Default) const
+	{
+		const JsonValue* Value = Find(Key);
+		return Value && Value->Type == EType::Number ? Value->Number : Default;
+	}
+
+	const JsonValue* GetElement(double Index) const
+	{
+		return Type == EType::Array && Index >= 0.0 && Index < double(Array.size()) ? &Array[size_t(Index)] : nullptr;
+	}
+};
+
+class CJsonParser
+{
+public:
+
+	CJsonParser(const char* InCursor, const char* InEnd)
+		: Cursor(InCursor), End(InEnd)
+	{
+	}
+
+	bool Parse(JsonValue& OutValue, int Depth = 0)
+	{
+		SkipSpaces();
+		if (Cursor >= End || Depth > 64)
+		{
+			return false;
+		}
+
+		switch (*Cursor)
+		{
+		case '{':
+			OutValue.Type = JsonValue::EType::Object;
+			++Cursor;
+			SkipSpaces();
+			if (Cursor < End && *Cursor == '}')
+			{
+				++Cursor;
+				return true;
+			}
+			for (;;)
+			{
+				OutValue.Members.emplace_back();
+				SkipSpaces();
+				if (!ParseString(OutValue.Members.back().first) || !Expect(':') || !Parse(OutValue.Members.back().second, Depth + 1))
+				{
+					return false;
+				}
+				SkipSpaces();
+				if (Cursor < End && *Cursor == ',')
+				{
+					++Cursor;
+					continue;
+				}
+				return Expect('}');
+			}
+		case '[':
+			OutValue.Type = JsonValue::EType::Array;
+			++Cursor;
+			SkipSpaces();
+			if (Cursor < End && *Cursor == ']')
+			{
+				++Cursor;
+				return true;
+			}
+			for (;;)
+			{
+				OutValue.Array.emplace_back();
+				if (!Parse(OutValue.Array.back(), Depth + 1))
+				{
+					return false;
+				}
+				SkipSpaces();
+				if (Cursor < End && *Cursor == ',')
+				{
+					++Cursor;
+					continue;
+				}
+				return Expect(']');
+			}
+		case '"':
+			OutValue.Type = JsonValue::EType::String;
+			return ParseString(OutValue.String);
+		case 't':
+			OutValue.Type = JsonValue::EType::Bool;
+			OutValue.Number = 1.0;
+			return ExpectWord("true");
+		case 'f':
+			OutValue.Type = JsonValue::EType::Bool;
+			return ExpectWord("false");
+		case 'n':
+			return ExpectWord("null");
+		default:
+		{
+			OutValue.Type = JsonValue::EType::Number;
+			const std::from_chars_result Result = std::from_chars(Cursor, End, OutValue.Number);
+			Cursor = Result.ptr;
+			return Result.ec == std::errc();
+		}
+		}
+	}
+
+private:
+
+	void SkipSpaces()
+	{
+		while (Cursor < End && (*Cursor == ' ' || *Cursor == '\t' || *Cursor == '\r' || *Cursor == '\n'))
+		{
+			++Cursor;
+		}
+	}
+
+	bool Expect(char Character)
+	{
+		SkipSpaces();
+		if (Cursor < End && *Cursor == Character)
+		{
+			++Cursor;
+			return true;
+		}
+		return false;
+	}
+
+	bool ExpectWord(const char* Word)
+	{
+		const size_t Length = strlen(Word);
+		if (size_t(End - Cursor) < Length || memcmp(Cursor, Word, Length) != 0)
+		{
+			return false;
+		}
+		Cursor += Length;
+		return true;
+	}
+
+	// Escaped characters are kept as is except quotes and backslashes, glTF keys and names we read are plain ASCII
+	bool ParseString(std::string& OutString)
+	{
+		if (Cursor >= End || *Cursor != '"')
+		{
+			return false;
+		}
+		++Cursor;
+		while (Cursor < End && *Cursor != '"')
+		{
+			if (*Cursor == '\\' && Cursor + 1 < End)
+			{
+				++Cursor;
+			}
+			OutString.push_back(*Cursor++);
+		}
+		return Expect('"');
+	}
+
+	const char* Cursor;
+	const char* End;
+};
+
+// Where the elements of an accessor are in the binary chunk
+struct GLBAccessor
+{
+	const uint8_t* Data = nullptr;
+	size_t Count = 0;
+	size_t Stride = 0;
+	int ComponentType = 0;
+	bool bNormalized = false;
+};
+
+static size_t GetComponentSize(int ComponentType)
+{
+	switch (ComponentType)
+	{
+	case 5120: case 5121: return 1;
+	case 5122: case 5123: return 2;
+	case 5125: case 5126: return 4;
+	default: return 0;
+	}
+}
+
+static bool FindAccessor(const JsonValue& Root, const uint8_t* Binary, size_t BinarySize, double Index, size_t ComponentCount, GLBAccessor& OutAccessor)
+{
+	const JsonValue* Accessors = Root.Find("accessors");
+	const JsonValue* BufferViews = Root.Find("bufferViews");
+	const JsonValue* Accessor = Accessors ? Accessors->GetElement(Index) : nullptr;
+	const JsonValue* BufferView = Accessor && BufferViews ? BufferViews->GetElement(Accessor->GetNumber("bufferView", -1.0)) : nullptr;
+
+	// Sparse accessors and external buffers aren't supported
+	if (!BufferView || BufferView->GetNumber("buffer", 0.0) != 0.0)
+	{
+		return false;
+	}
+
+	const JsonValue* Normalized = Accessor->Find("normalized");
+	OutAccessor.ComponentType = int(Accessor->GetNumber("componentType", 0.0));
+	OutAccessor.Count = size_t(Accessor->GetNumber("count", 0.0));
+	OutAccessor.bNormalized = Normalized && Normalized->Number != 0.0;
+
+	const size_t ElementSize = GetComponentSize(OutAccessor.ComponentType) * ComponentCount;
+	const size_t Offset = size_t(BufferView->GetNumber("byteOffset", 0.0)) + size_t(Accessor->GetNumber("byteOffset", 0.0));
+	const size_t ViewEnd = size_t(BufferView->GetNumber("byteOffset", 0.0)) + size_t(BufferView->GetNumber("byteLength", 0.0));
+	OutAccessor.Stride = size_t(BufferView->GetNumber("byteStride", double(ElementSize)));
+	OutAccessor.Data = Binary + Offset;
+
+	return ElementSize > 0 && OutAccessor.Count > 0 && ViewEnd <= BinarySize
+		&& Offset + OutAccessor.Stride * (OutAccessor.Count - 1) + ElementSize <= ViewEnd;
+}
+
+// Component of element Index as a float, normalized integers map to [0, 1]
+static float ReadComponent(const GLBAccessor& Accessor, size_t Index, size_t Component)
+{
+	const uint8_t* Element = Accessor.Data + Accessor.Stride * Index + GetComponentSize(Accessor.ComponentType) * Component;
+	switch (Accessor.ComponentType)
+	{
+	case 5121:
+		return Accessor.bNormalized ? Element[0] / 255.0f : float(Element[0]);
+	case 5123:
+	{
+		uint16_t Value;
+		memcpy(&Value, Element, sizeof(Value));
+		return Accessor.bNormalized ? Value / 65535.0f : float(Value);
+	}
+	case 5126:
+	{
+		float Value;
+		memcpy(&Value, Element, sizeof(Value));
+		return Value;
+	}
+	default:
+		return 0.0f;
+	}
+}
+
+static uint32_t ReadIndex(const GLBAccessor& Accessor, size_t Index)
+{
+	const uint8_t* Element = Accessor.Data + Accessor.Stride * Index;
+	switch (Accessor.ComponentType)
+	{
+	case 5121:
+		return Element[0];
+	case 5123:
+	{
+		uint16_t Value;
+		memcpy(&Value, Element, sizeof(Value));
+		return Value;
+	}
+	default:
+	{
+		uint32_t Value;
+		memcpy(&Value, Element, sizeof(Value));
+		return Value;
+	}
+	}
+}
+
+bool CMeshImporter::LoadGLB(const char* Path, CMesh& OutMesh)
+{
+	CMappedFile File;
+	if (!File.Open(Path))
+	{
+		return false;
+	}
+	return ParseGLB(File.GetData(), File.GetSize(), OutMesh.Vertices, OutMesh.Indices);
+}
+
+bool CMeshImporter::ParseGLB(const char* Data, size_t Size, std::vector<Vertex>& OutVertices, std::vector<unsigned int>& OutIndices)
+{
+	// 12 bytes of header then chunks of length, type and data, the JSON chunk first then the binary one
+	uint32_t Header[3];
+	if (Size < sizeof(Header) + 8)
+	{
+		return false;
+	}
+	memcpy(Header, Data, sizeof(Header));
+	if (Header[0] != GLBMagic || Header[1] != 2 || Header[2] > Size)
+	{
+		return false;
+	}
+
+	const char* JsonData = nullptr;
+	const uint8_t* Binary = nullptr;
+	size_t JsonSize = 0, BinarySize = 0;
+	for (size_t Offset = sizeof(Header); Offset + 8 <= Header[2];)
+	{
+		uint32_t Chunk[2];
+		memcpy(Chunk, Data + Offset, sizeof(Chunk));
+		Offset += sizeof(Chunk);
+		if (Chunk[0] > Header[2] - Offset)
+		{
+			return false;
+		}
+		if (Chunk[1] == GLBJsonChunk)
+		{
+			JsonData = Data + Offset;
+			JsonSize = Chunk[0];
+		}
+		else if (Chunk[1] == GLBBinaryChunk)
+		{
+			Binary = reinterpret_cast<const uint8_t*>(Data + Offset);
+			BinarySize = Chunk[0];
+		}
+		Offset += Chunk[0];
+	}
+
+	JsonValue Root;
+	CJsonParser Parser(JsonData, JsonData + JsonSize);
+	const JsonValue* Meshes = JsonData && Parser.Parse(Root) ? Root.Find("meshes") : nullptr;
+	if (!Meshes || Meshes->Type != JsonValue::EType::Array)
+	{
+		return false;
+	}
+
+	// The accessors of every triangle primitive, to size the arrays once
+	struct Primitive
+	{
+		GLBAccessor Positions;
+		GLBAccessor TexCoords;
+		GLBAccessor Indices;
+
+		// Indices of its whole triangles, the strays past the last one are dropped so the next primitive stays aligned
+		size_t GetTriangleIndexCount() const
+		{
+			return (Indices.Data ? Indices.Count : Positions.Count) / 3 * 3;
+		}
+	};
+	std::vector<Primitive> Primitives;
+	size_t VertexCount = 0, IndexCount = 0;
+	for (const JsonValue& Mesh : Meshes->Array)
+	{
+		const JsonValue* MeshPrimitives = Mesh.Find("primitives");
+		if (!MeshPrimitives)
+		{
+			continue;
+		}
+
+		for (const JsonValue& Entry : MeshPrimitives->Array)
+		{
+			const JsonValue* Attributes = Entry.Find("attributes");
+			if (Entry.GetNumber("mode", 4.0) != 4.0 || !Attributes)
+			{
+				continue;
+			}
+
+			Primitive NewPrimitive;
+			if (!FindAccessor(Root, Binary, BinarySize, Attributes->GetNumber("POSITION", -1.0), 3, NewPrimitive.Positions)
+				|| NewPrimitive.Positions.ComponentType != 5126)
+			{
+				return false;
+			}
+			if (Attributes->Find("TEXCOORD_0")
+				&& !FindAccessor(Root, Binary, BinarySize, Attributes->GetNumber("TEXCOORD_0", -1.0), 2, NewPrimitive.TexCoords))
+			{
+				return false;
+			}
+			if (Entry.Find("indices")
+				&& !FindAccessor(Root, Binary, BinarySize, Entry.GetNumber("indices", -1.0), 1, NewPrimitive.Indices))
+			{
+				return false;
+			}
+
+			VertexCount += NewPrimitive.Positions.Count;
+			IndexCount += NewPrimitive.GetTriangleIndexCount();
+			Primitives.push_back(NewPrimitive);
+		}
+	}
+
+	// Like an OBJ without faces, a mesh without a whole triangle has nothing to draw
+	if (IndexCount == 0 || VertexCount >= 0xFFFFFFFFu)
+	{
+		return false;
+	}
+
+	OutVertices.resize(VertexCount);
+	OutIndices.resize(IndexCount);
+	size_t FirstVertex = 0, FirstIndex = 0;
+	for (const Primitive& Entry : Primitives)
+	{
+		const bool bHasTexCoords = Entry.TexCoords.Data && Entry.TexCoords.Count >= Entry.Positions.Count;
+		for (size_t Index = 0; Index < Entry.Positions.Count; ++Index)
+		{
+			Vertex& Output = OutVertices[FirstVertex + Index];
+			Output.Pos = ToLeftHanded(ReadComponent(Entry.Positions, Index, 0), ReadComponent(Entry.Positions, Index, 1),
+				ReadComponent(Entry.Positions, Index, 2));
+			Output.TexCoord = bHasTexCoords ? XMFLOAT2(ReadComponent(Entry.TexCoords, Index, 0), ReadComponent(Entry.TexCoords, Index, 1))
+				: XMFLOAT2(0.0f, 0.0f);
+		}
+
+		const size_t PrimitiveIndexCount = Entry.GetTriangleIndexCount();
+		for (size_t Index = 0; Index < PrimitiveIndexCount; ++Index)
+		{
+			const uint32_t VertexIndex = Entry.Indices.Data ? ReadIndex(Entry.Indices, Index) : uint32_t(Index);
+			if (VertexIndex >= Entry.Positions.Count)
+			{
+				return false;
+			}
+			OutIndices[FirstIndex + Index] = static_cast<unsigned int>(FirstVertex + VertexIndex);
+		}
+
+		FirstVertex += Entry.Positions.Count;
+		FirstIndex += PrimitiveIndexCount;
+	}
+
+	return true;
+}
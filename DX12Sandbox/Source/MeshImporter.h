@@ -0,0 +1,29 @@
+#pragma once
+#include "Mesh.h"
+
+#include <vector>
+
+// Loads the triangles of Wavefront OBJ and binary glTF (.glb) files into a CMesh, before its Init.
+// Files are memory mapped, OBJ text is parsed by several threads, each on a range of whole lines
+class CMeshImporter
+{
+public:
+
+	// Picks the format from the extension then generates the tangent frames, returns false when the file can't be read or parsed
+	static bool Load(const char* Path, CMesh& OutMesh, uint32_t ThreadCount = 0);
+
+	// Positions, texture coordinates and faces, polygons are triangulated as fans. Vertices using the same position
+	// and texture coordinate indices are welded. ThreadCount 0 uses every thread of the job system
+	static bool LoadOBJ(const char* Path, CMesh& OutMesh, uint32_t ThreadCount = 0);
+
+	// Same as LoadOBJ on text already in memory
+	static bool ParseOBJ(const char* Data, size_t Size, std::vector<Vertex>& OutVertices, std::vector<unsigned int>& OutIndices,
+		uint32_t ThreadCount = 0);
+
+	// POSITION, TEXCOORD_0 and the indices of every triangle primitive of every mesh, in the local space of each mesh.
+	// Fails when no primitive has a whole triangle
+	static bool LoadGLB(const char* Path, CMesh& OutMesh);
+
+	// Same as LoadGLB on a file already in memory
+	static bool ParseGLB(const char* Data, size_t Size, std::vector<Vertex>& OutVertices, std::vector<unsigned int>& OutIndices);
+};
@@ -0,0 +1,364 @@
+#include "pch.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+// Size of the cache the vertex cache optimization scores against, and of the FIFO cache of the other passes
+static const int ScoreCacheSize = 32;
+static const uint32_t SimulatedCacheSize = 16;
+
+// Score of a vertex for the vertex cache optimization, higher is drawn first
+static float ScoreVertex(int CachePosition, uint32_t RemainingTriangles)
+{
+	if (RemainingTriangles == 0)
+	{
+		return -1.0f;
+	}
+
+	float Score = 0.0f;
+	if (CachePosition >= 0)
+	{
+		// The vertices of the last triangle get a fixed score, or the next triangle would prefer to reuse only 2 of them
+		Score = CachePosition < 3 ? 0.75f : powf(1.0f - float(CachePosition - 3) / float(ScoreCacheSize - 3), 1.5f);
+	}
+
+	// Vertices left with few triangles are worth finishing, they would come back as lone misses later
+	return Score + 2.0f / sqrtf(float(RemainingTriangles));
+}
+
+// FIFO cache emulated with timestamps : a vertex is cached when it was transformed less than CacheSize misses ago
+struct FIFOCache
+{
+	FIFOCache(size_t VertexCount, uint32_t InCacheSize)
+		: Timestamps(VertexCount, 0), CacheSize(InCacheSize), Time(InCacheSize + 1)
+	{
+	}
+
+	// Returns the number of vertices of the triangle that had to be transformed
+	uint32_t AddTriangle(const unsigned int* Triangle)
+	{
+		uint32_t Misses = 0;
+		for (int Corner = 0; Corner < 3; ++Corner)
+		{
+			if (Time - Timestamps[Triangle[Corner]] > CacheSize)
+			{
+				Timestamps[Triangle[Corner]] = Time++;
+				Misses++;
+			}
+		}
+		return Misses;
+	}
+
+	void Flush()
+	{
+		Time += CacheSize + 1;
+	}
+
+	std::vector<uint32_t> Timestamps;
+	uint32_t CacheSize;
+	uint32_t Time;
+};
+
+void CMeshOptimizer::Optimize(std::vector<Vertex>& Vertices, std::vector<unsigned int>& Indices)
+{
+	OptimizeVertexCache(Indices, Vertices.size());
+	OptimizeOverdraw(Indices, Vertices);
+	OptimizeVertexFetch(Vertices, Indices);
+}
+
+void CMeshOptimizer::OptimizeVertexCache(std::vector<unsigned int>& Indices, size_t VertexCount)
+{
+	const size_t TriangleCount = Indices.size() / 3;
+	if (TriangleCount == 0)
+	{
+		return;
+	}
+
+	// Triangles of each vertex, the first RemainingTriangles[Vertex] of its list are not emitted yet
+	std::vector<uint32_t> RemainingTriangles(VertexCount, 0);
+	for (unsigned int Index : Indices)
+	{
+		RemainingTriangles[Index]++;
+	}
+
+	std::vector<uint32_t> TriangleListOffsets(VertexCount + 1, 0);
+	for (size_t Vertex = 0; Vertex < VertexCount; ++Vertex)
+	{
+		TriangleListOffsets[Vertex + 1] = TriangleListOffsets[Vertex] + RemainingTriangles[Vertex];
+	}
+
+	std::vector<uint32_t> TriangleLists(Indices.size());
+	std::vector<uint32_t> Fill(TriangleListOffsets.begin(), TriangleListOffsets.end() - 1);
+	for (size_t Triangle = 0; Triangle < TriangleCount; ++Triangle)
+	{
+		for (int Corner = 0; Corner < 3; ++Corner)
+		{
+			const unsigned int Vertex = Indices[Triangle * 3 + Corner];
+			TriangleLists[Fill[Vertex]++] = uint32_t(Triangle);
+		}
+	}
+
+	std::vector<int> CachePositions(VertexCount, -1);
+	std::vector<float> VertexScores(VertexCount);
+	for (size_t Vertex = 0; Vertex < VertexCount; ++Vertex)
+	{
+		VertexScores[Vertex] = ScoreVertex(-1, RemainingTriangles[Vertex]);
+	}
+
+	std::vector<float> TriangleScores(TriangleCount);
+	std::vector<bool> Emitted(TriangleCount, false);
+	uint32_t BestTriangle = 0;
+	for (size_t Triangle = 0; Triangle < TriangleCount; ++Triangle)
+	{
+		const unsigned int* Corners = &Indices[Triangle * 3];
+		TriangleScores[Triangle] = VertexScores[Corners[0]] + VertexScores[Corners[1]] + VertexScores[Corners[2]];
+		if (TriangleScores[Triangle] > TriangleScores[BestTriangle])
+		{
+			BestTriangle = uint32_t(Triangle);
+		}
+	}
+
+	// 3 extra entries for the vertices pushed out by the triangle being added
+	std::vector<unsigned int> Cache, NextCache;
+	Cache.reserve(ScoreCacheSize + 3);
+	NextCache.reserve(ScoreCacheSize + 3);
+
+	std::vector<unsigned int> Output;
+	Output.reserve(Indices.size());
+
+	// Next triangle to look at when no cached vertex has a triangle left
+	size_t Cursor = 0;
+
+	for (size_t Emitting = 0; Emitting < TriangleCount; ++Emitting)
+	{
+		const unsigned int* Corners = &Indices[BestTriangle * 3];
+		Output.insert(Output.end(), Corners, Corners + 3);
+		Emitted[BestTriangle] = true;
+
+		// Remove the triangle from the lists of its vertices
+		for (int Corner = 0; Corner < 3; ++Corner)
+		{
+			const unsigned int Vertex = Corners[Corner];
+			uint32_t* List = &TriangleLists[TriangleListOffsets[Vertex]];
+			const uint32_t Count = RemainingTriangles[Vertex];
+			for (uint32_t Entry = 0; Entry < Count; ++Entry)
+			{
+				if (List[Entry] == BestTriangle)
+				{
+					std::swap(List[Entry], List[Count - 1]);
+					break;
+				}
+			}
+			RemainingTriangles[Vertex]--;
+		}
+
+		// The triangle's vertices move to the front of the cache, in order
+		NextCache.assign(Corners, Corners + 3);
+		for (unsigned int Vertex : Cache)
+		{
+			if (Vertex != Corners[0] && Vertex != Corners[1] && Vertex != Corners[2])
+			{
+				NextCache.push_back(Vertex);
+			}
+		}
+
+		// Rescore the cached and evicted vertices, and find the best triangle around them
+		float BestScore = -1.0f;
+		for (size_t Position = 0; Position < NextCache.size(); ++Position)
+		{
+			const unsigned int Vertex = NextCache[Position];
+			CachePositions[Vertex] = Position < size_t(ScoreCacheSize) ? int(Position) : -1;
+
+			const float Score = ScoreVertex(CachePositions[Vertex], RemainingTriangles[Vertex]);
+			const float Delta = Score - VertexScores[Vertex];
+			VertexScores[Vertex] = Score;
+
+			const uint32_t* List = &TriangleLists[TriangleListOffsets[Vertex]];
+			for (uint32_t Entry = 0; Entry < RemainingTriangles[Vertex]; ++Entry)
+			{
+				const uint32_t Triangle = List[Entry];
+				TriangleScores[Triangle] += Delta;
+				if (TriangleScores[Triangle] > BestScore)
+				{
+					BestScore = TriangleScores[Triangle];
+					BestTriangle = Triangle;
+				}
+			}
+		}
+
+		NextCache.resize(std::min(NextCache.size(), size_t(ScoreCacheSize)));
+		Cache.swap(NextCache);
+
+		// Dead end : continue with the next triangle left in the original order
+		if (BestScore < 0.0f)
+		{
+			while (Cursor < TriangleCount && Emitted[Cursor])
+			{
+				Cursor++;
+			}
+			BestTriangle = uint32_t(Cursor);
+		}
+	}
+
+	Indices.swap(Output);
+}
+
+void CMeshOptimizer::OptimizeOverdraw(std::vector<unsigned int>& Indices, const std::vector<Vertex>& Vertices, float Threshold)
+{
+	const size_t TriangleCount = Indices.size() / 3;
+	if (TriangleCount < 2)
+	{
+		return;
+	}
+
+	// Hard boundaries : the cache misses every vertex of the triangle, starting a cluster there costs nothing
+	std::vector<uint32_t> HardClusters;
+	FIFOCache Cache(Vertices.size(), SimulatedCacheSize);
+	for (size_t Triangle = 0; Triangle < TriangleCount; ++Triangle)
+	{
+		if (Cache.AddTriangle(&Indices[Triangle * 3]) == 3)
+		{
+			HardClusters.push_back(uint32_t(Triangle));
+		}
+	}
+	HardClusters.push_back(uint32_t(TriangleCount));
+
+	// Soft boundaries : split a hard cluster when the part since the last split is already cheaper than Threshold times the cluster
+	std::vector<uint32_t> Clusters;
+	for (size_t Hard = 0; Hard + 1 < HardClusters.size(); ++Hard)
+	{
+		const uint32_t Start = HardClusters[Hard];
+		const uint32_t End = HardClusters[Hard + 1];
+
+		Cache.Flush();
+		uint32_t ClusterMisses = 0;
+		for (uint32_t Triangle = Start; Triangle < End; ++Triangle)
+		{
+			ClusterMisses += Cache.AddTriangle(&Indices[Triangle * 3]);
+		}
+		const float MaxACMR = Threshold * float(ClusterMisses) / float(End - Start);
+
+		Cache.Flush();
+		Clusters.push_back(Start);
+		uint32_t Misses = 0;
+		for (uint32_t Triangle = Start; Triangle < End; ++Triangle)
+		{
+			Misses += Cache.AddTriangle(&Indices[Triangle * 3]);
+			if (Triangle + 1 < End && float(Misses) <= MaxACMR * float(Triangle + 1 - Clusters.back()))
+			{
+				Clusters.push_back(Triangle + 1);
+				Cache.Flush();
+				Misses = 0;
+			}
+		}
+	}
+	Clusters.push_back(uint32_t(TriangleCount));
+
+	// Area weighted centroid and normal of every cluster
+	const size_t ClusterCount = Clusters.size() - 1;
+	std::vector<XMFLOAT3> Centroids(ClusterCount), Normals(ClusterCount);
+	XMVECTOR MeshCentroid = XMVectorZero();
+	float MeshArea = 0.0f;
+	for (size_t Cluster = 0; Cluster < ClusterCount; ++Cluster)
+	{
+		XMVECTOR Centroid = XMVectorZero();
+		XMVECTOR Normal = XMVectorZero();
+		float Area = 0.0f;
+		for (uint32_t Triangle = Clusters[Cluster]; Triangle < Clusters[Cluster + 1]; ++Triangle)
+		{
+			const XMVECTOR P0 = XMLoadFloat3(&Vertices[Indices[Triangle * 3 + 0]].Pos);
+			const XMVECTOR P1 = XMLoadFloat3(&Vertices[Indices[Triangle * 3 + 1]].Pos);
+			const XMVECTOR P2 = XMLoadFloat3(&Vertices[Indices[Triangle * 3 + 2]].Pos);
+			const XMVECTOR Cross = XMVector3Cross(P1 - P0, P2 - P0);
+			const float TriangleArea = XMVectorGetX(XMVector3Length(Cross));
+
+			Centroid = XMVectorMultiplyAdd(P0 + P1 + P2, XMVectorReplicate(TriangleArea / 3.0f), Centroid);
+			Normal = Normal + Cross;
+			Area += TriangleArea;
+		}
+
+		MeshCentroid = MeshCentroid + Centroid;
+		MeshArea += Area;
+		XMStoreFloat3(&Centroids[Cluster], Area > 0.0f ? Centroid / Area : Centroid);
+		XMStoreFloat3(&Normals[Cluster], XMVector3Normalize(Normal));
+	}
+	if (MeshArea > 0.0f)
+	{
+		MeshCentroid = MeshCentroid / MeshArea;
+	}
+
+	// Clusters far out along their normal are the most likely to hide the others
+	std::vector<float> SortKeys(ClusterCount);
+	for (size_t Cluster = 0; Cluster < ClusterCount; ++Cluster)
+	{
+		SortKeys[Cluster] = XMVectorGetX(XMVector3Dot(XMLoadFloat3(&Centroids[Cluster]) - MeshCentroid, XMLoadFloat3(&Normals[Cluster])));
+	}
+
+	std::vector<uint32_t> Order(ClusterCount);
+	std::iota(Order.begin(), Order.end(), 0);
+	std::stable_sort(Order.begin(), Order.end(), [&](uint32_t A, uint32_t B)
+	{
+		return SortKeys[A] > SortKeys[B];
+	});
+
+	std::vector<unsigned int> Output;
+	Output.reserve(Indices.size());
+	for (uint32_t Cluster : Order)
+	{
+		Output.insert(Output.end(), Indices.begin() + Clusters[Cluster] * 3, Indices.begin() + Clusters[Cluster + 1] * 3);
+	}
+	Indices.swap(Output);
+}
+
+void CMeshOptimizer::OptimizeVertexFetch(std::vector<Vertex>& Vertices, std::vector<unsigned int>& Indices)
+{
+	const unsigned int Unused = ~0u;
+	std::vector<unsigned int> Remap(Vertices.size(), Unused);
+
+	std::vector<Vertex> Output;
+	Output.reserve(Vertices.size());
+	for (unsigned int& Index : Indices)
+	{
+		if (Remap[Index] == Unused)
+		{
+			Remap[Index] = static_cast<unsigned int>(Output.size());
+			Output.push_back(Vertices[Index]);
+		}
+		Index = Remap[Index];
+	}
+
+	Vertices.swap(Output);
+}
+
+MeshCacheStats CMeshOptimizer::AnalyzeVertexCache(const std::vector<unsigned int>& Indices, size_t VertexCount, uint32_t CacheSize)
+{
+	MeshCacheStats Stats;
+	const size_t TriangleCount = Indices.size() / 3;
+	if (TriangleCount == 0)
+	{
+		return Stats;
+	}
+
+	FIFOCache Cache(VertexCount, CacheSize);
+	std::vector<bool> Referenced(VertexCount, false);
+	uint32_t Misses = 0;
+	uint32_t ReferencedCount = 0;
+	for (size_t Triangle = 0; Triangle < TriangleCount; ++Triangle)
+	{
+		Misses += Cache.AddTriangle(&Indices[Triangle * 3]);
+		for (int Corner = 0; Corner < 3; ++Corner)
+		{
+			if (!Referenced[Indices[Triangle * 3 + Corner]])
+			{
+				Referenced[Indices[Triangle * 3 + Corner]] = true;
+				ReferencedCount++;
+			}
+		}
+	}
+
+	Stats.ACMR = float(Misses) / float(TriangleCount);
+	Stats.ATVR = float(Misses) / float(ReferencedCount);
+	return Stats;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "Mesh.h"
+
+#include <vector>
+
+// Efficiency of an index buffer for a post-transform vertex cache
+struct MeshCacheStats
+{
+	// Vertices transformed per triangle, 0.5 at best on a regular grid, 3 at worst
+	float ACMR = 0.0f;
+
+	// Vertices transformed per vertex of the mesh, 1 at best
+	float ATVR = 0.0f;
+};
+
+// CPU passes run on the vertices and indices of a mesh before its upload, in this order :
+// triangles for the post-transform cache, then clusters of triangles for overdraw, then vertices for fetch locality.
+class CMeshOptimizer
+{
+public:
+	// Runs the three passes
+	static void Optimize(std::vector<Vertex>& Vertices, std::vector<unsigned int>& Indices);
+
+	// Reorders the triangles so their vertices are still in the post-transform cache when reused (Forsyth's algorithm)
+	static void OptimizeVertexCache(std::vector<unsigned int>& Indices, size_t VertexCount);
+
+	// Splits the triangles in clusters where the cache restarts anyway, then draws the clusters facing out of the mesh first
+	// so they hide the rest. The ACMR grows by Threshold at most
+	static void OptimizeOverdraw(std::vector<unsigned int>& Indices, const std::vector<Vertex>& Vertices, float Threshold = 1.05f);
+
+	// Renumbers the vertices in order of first use so they are fetched linearly, unused vertices are removed
+	static void OptimizeVertexFetch(std::vector<Vertex>& Vertices, std::vector<unsigned int>& Indices);
+
+	// Simulates a FIFO post-transform cache of CacheSize vertices
+	static MeshCacheStats AnalyzeVertexCache(const std::vector<unsigned int>& Indices, size_t VertexCount, uint32_t CacheSize = 16);
+};
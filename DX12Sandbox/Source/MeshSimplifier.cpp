@@ -0,0 +1,534 @@
+#include "pch.h"
+#include "MeshSimplifier.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <numeric>
+
+// Fraction of the triangles of the full mesh in each LOD
+static const float LODRatios[] = { 0.5f, 0.25f, 0.125f, 0.0625f };
+static_assert(sizeof(LODRatios) / sizeof(LODRatios[0]) < MESH_MAX_LODS, "The chain has more LODs than a mesh can hold");
+
+// A LOD keeping more than this fraction of the previous one isn't worth its memory
+static const float MinLODReduction = 0.8f;
+
+// Borders and seams weigh more than the surface, they are what the eye notices first
+static const double EdgeWeight = 10.0;
+
+static const unsigned int NoVertex = ~0u;
+static const unsigned int ManyVertices = ~1u;
+
+// How a vertex is allowed to move
+enum class EVertexKind : uint8_t
+{
+	// Collapses onto any neighbour
+	Manifold,
+	// On an open edge, only collapses along it
+	Border,
+	// On a UV seam, only collapses along it with its twin on the other side
+	Seam,
+	// Too complex to move
+	Locked
+};
+
+// Sum of squared distances to planes : Error(p) = p A p + 2 B p + C
+struct Quadric
+{
+	double A00 = 0.0, A11 = 0.0, A22 = 0.0, A01 = 0.0, A02 = 0.0, A12 = 0.0;
+	double B0 = 0.0, B1 = 0.0, B2 = 0.0;
+	double C = 0.0;
+	double Weight = 0.0;
+
+	void AddPlane(double X, double Y, double Z, double D, double InWeight)
+	{
+		A00 += InWeight * X * X;
+		A11 += InWeight * Y * Y;
+		A22 += InWeight * Z * Z;
+		A01 += InWeight * X * Y;
+		A02 += InWeight * X * Z;
+		A12 += InWeight * Y * Z;
+		B0 += InWeight * X * D;
+		B1 += InWeight * Y * D;
+		B2 += InWeight * Z * D;
+		C += InWeight * D * D;
+		Weight += InWeight;
+	}
+
+	void Add(const Quadric& Other)
+	{
+		A00 += Other.A00; A11 += Other.A11; A22 += Other.A22;
+		A01 += Other.A01; A02 += Other.A02; A12 += Other.A12;
+		B0 += Other.B0; B1 += Other.B1; B2 += Other.B2;
+		C += Other.C;
+		Weight += Other.Weight;
+	}
+
+	// Weighted mean of the squared distances
+	float Evaluate(const XMFLOAT3& P) const
+	{
+		const double X = P.x, Y = P.y, Z = P.z;
+		const double Error = A00 * X * X + A11 * Y * Y + A22 * Z * Z + 2.0 * (A01 * X * Y + A02 * X * Z + A12 * Y * Z)
+			+ 2.0 * (B0 * X + B1 * Y + B2 * Z) + C;
+		return Weight > 0.0 ? float(std::max(Error, 0.0) / Weight) : 0.0f;
+	}
+};
+
+struct Collapse
+{
+	unsigned int Source;
+	unsigned int Target;
+	float Cost;
+};
+
+// Vertex to the first vertex at the same position, and a circular list of the vertices sharing each position
+static void BuildPositionRemap(const std::vector<Vertex>& Vertices, std::vector<unsigned int>& OutRemap, std::vector<unsigned int>& OutNextWedge)
+{
+	std::vector<unsigned int> Order(Vertices.size());
+	std::iota(Order.begin(), Order.end(), 0u);
+	std::sort(Order.begin(), Order.end(), [&](unsigned int A, unsigned int B)
+	{
+		const XMFLOAT3& PA = Vertices[A].Pos;
+		const XMFLOAT3& PB = Vertices[B].Pos;
+		if (PA.x != PB.x) return PA.x < PB.x;
+		if (PA.y != PB.y) return PA.y < PB.y;
+		if (PA.z != PB.z) return PA.z < PB.z;
+		return A < B;
+	});
+
+	OutRemap.resize(Vertices.size());
+	OutNextWedge.resize(Vertices.size());
+	size_t GroupStart = 0;
+	for (size_t Entry = 1; Entry <= Order.size(); ++Entry)
+	{
+		const bool bSamePosition = Entry < Order.size()
+			&& Vertices[Order[Entry]].Pos.x == Vertices[Order[GroupStart]].Pos.x
+			&& Vertices[Order[Entry]].Pos.y == Vertices[Order[GroupStart]].Pos.y
+			&& Vertices[Order[Entry]].Pos.z == Vertices[Order[GroupStart]].Pos.z;
+		if (bSamePosition)
+		{
+			continue;
+		}
+
+		// Sorted by index inside the group, the first one is the smallest
+		for (size_t Member = GroupStart; Member < Entry; ++Member)
+		{
+			OutRemap[Order[Member]] = Order[GroupStart];
+			OutNextWedge[Order[Member]] = Order[Member + 1 < Entry ? Member + 1 : GroupStart];
+		}
+		GroupStart = Entry;
+	}
+}
+
+// Targets of the edges leaving each vertex, in compressed rows
+static void BuildEdgeLists(const std::vector<unsigned int>& Indices, const std::vector<unsigned int>& Remap, size_t VertexCount,
+	std::vector<unsigned int>& OutOffsets, std::vector<unsigned int>& OutTargets)
+{
+	OutOffsets.assign(VertexCount + 1, 0);
+	for (unsigned int Index : Indices)
+	{
+		OutOffsets[Remap[Index] + 1]++;
+	}
+	for (size_t Vertex = 0; Vertex < VertexCount; ++Vertex)
+	{
+		OutOffsets[Vertex + 1] += OutOffsets[Vertex];
+	}
+
+	OutTargets.resize(Indices.size());
+	std::vector<unsigned int> Fill(OutOffsets.begin(), OutOffsets.end() - 1);
+	for (size_t Triangle = 0; Triangle < Indices.size() / 3; ++Triangle)
+	{
+		for (int Corner = 0; Corner < 3; ++Corner)
+		{
+			const unsigned int From = Remap[Indices[Triangle * 3 + Corner]];
+			const unsigned int To = Remap[Indices[Triangle * 3 + (Corner + 1) % 3]];
+			OutTargets[Fill[From]++] = To;
+		}
+	}
+}
+
+static bool HasEdge(const std::vector<unsigned int>& Offsets, const std::vector<unsigned int>& Targets, unsigned int From, unsigned int To)
+{
+	for (unsigned int Entry = Offsets[From]; Entry < Offsets[From + 1]; ++Entry)
+	{
+		if (Targets[Entry] == To)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+float CMeshSimplifier::Simplify(const std::vector<Vertex>& Vertices, const std::vector<unsigned int>& Indices, size_t TargetIndexCount,
+	std::vector<unsigned int>& OutIndices)
+{
+	const size_t VertexCount = Vertices.size();
+	OutIndices = Indices;
+
+	std::vector<unsigned int> PositionRemap, NextWedge;
+	BuildPositionRemap(Vertices, PositionRemap, NextWedge);
+
+	std::vector<unsigned int> Identity(VertexCount);
+	std::iota(Identity.begin(), Identity.end(), 0u);
+
+	// Open edges : no triangle uses the edge the other way around. Seams are open between vertices but closed between positions
+	std::vector<unsigned int> EdgeOffsets, EdgeTargets, PositionEdgeOffsets, PositionEdgeTargets;
+	BuildEdgeLists(Indices, Identity, VertexCount, EdgeOffsets, EdgeTargets);
+	BuildEdgeLists(Indices, PositionRemap, VertexCount, PositionEdgeOffsets, PositionEdgeTargets);
+
+	std::vector<unsigned int> OpenOut(VertexCount, NoVertex), OpenIn(VertexCount, NoVertex);
+	std::vector<bool> OnPositionBorder(VertexCount, false);
+	for (size_t Vertex = 0; Vertex < VertexCount; ++Vertex)
+	{
+		for (unsigned int Entry = EdgeOffsets[Vertex]; Entry < EdgeOffsets[Vertex + 1]; ++Entry)
+		{
+			const unsigned int To = EdgeTargets[Entry];
+			if (HasEdge(EdgeOffsets, EdgeTargets, To, static_cast<unsigned int>(Vertex)))
+			{
+				continue;
+			}
+
+			OpenOut[Vertex] = OpenOut[Vertex] == NoVertex ? To : ManyVertices;
+			OpenIn[To] = OpenIn[To] == NoVertex ? static_cast<unsigned int>(Vertex) : ManyVertices;
+			if (!HasEdge(PositionEdgeOffsets, PositionEdgeTargets, PositionRemap[To], PositionRemap[Vertex]))
+			{
+				OnPositionBorder[Vertex] = true;
+				OnPositionBorder[To] = true;
+			}
+		}
+	}
+
+	auto HasSingleOpenLoop = [&](unsigned int Vertex)
+	{
+		return OpenOut[Vertex] < ManyVertices && OpenIn[Vertex] < ManyVertices;
+	};
+
+	std::vector<EVertexKind> Kinds(VertexCount, EVertexKind::Locked);
+	for (size_t Vertex = 0; Vertex < VertexCount; ++Vertex)
+	{
+		const unsigned int Twin = NextWedge[Vertex];
+		if (Twin == Vertex)
+		{
+			if (OpenOut[Vertex] == NoVertex && OpenIn[Vertex] == NoVertex)
+			{
+				Kinds[Vertex] = EVertexKind::Manifold;
+			}
+			else if (HasSingleOpenLoop(static_cast<unsigned int>(Vertex)))
+			{
+				Kinds[Vertex] = EVertexKind::Border;
+			}
+		}
+		else if (NextWedge[Twin] == Vertex && !OnPositionBorder[Vertex] && HasSingleOpenLoop(static_cast<unsigned int>(Vertex)) && HasSingleOpenLoop(Twin))
+		{
+			Kinds[Vertex] = EVertexKind::Seam;
+		}
+	}
+
+	// Quadrics are kept per position, the planes of the triangles and of the open edges
+	std::vector<Quadric> Quadrics(VertexCount);
+	for (size_t Triangle = 0; Triangle < Indices.size() / 3; ++Triangle)
+	{
+		const unsigned int* Corners = &Indices[Triangle * 3];
+		const XMVECTOR P0 = XMLoadFloat3(&Vertices[Corners[0]].Pos);
+		const XMVECTOR P1 = XMLoadFloat3(&Vertices[Corners[1]].Pos);
+		const XMVECTOR P2 = XMLoadFloat3(&Vertices[Corners[2]].Pos);
+		const XMVECTOR Cross = XMVector3Cross(P1 - P0, P2 - P0);
+		const float Length = XMVectorGetX(XMVector3Length(Cross));
+		if (Length == 0.0f)
+		{
+			continue;
+		}
+
+		XMFLOAT3 Normal;
+		XMStoreFloat3(&Normal, Cross / Length);
+		const double D = -XMVectorGetX(XMVector3Dot(Cross / Length, P0));
+		for (int Corner = 0; Corner < 3; ++Corner)
+		{
+			Quadrics[PositionRemap[Corners[Corner]]].AddPlane(Normal.x, Normal.y, Normal.z, D, Length * 0.5);
+		}
+
+		// Planes through the open edges, perpendicular to the triangle, keep the borders and seams in place
+		for (int Corner = 0; Corner < 3; ++Corner)
+		{
+			const unsigned int From = Corners[Corner];
+			const unsigned int To = Corners[(Corner + 1) % 3];
+			if (OpenOut[From] != To && !(OpenOut[From] == ManyVertices && !HasEdge(EdgeOffsets, EdgeTargets, To, From)))
+			{
+				continue;
+			}
+
+			const XMVECTOR PFrom = XMLoadFloat3(&Vertices[From].Pos);
+			const XMVECTOR Edge = XMLoadFloat3(&Vertices[To].Pos) - PFrom;
+			const XMVECTOR EdgeNormal = XMVector3Normalize(XMVector3Cross(Edge, Cross));
+			XMFLOAT3 Plane;
+			XMStoreFloat3(&Plane, EdgeNormal);
+			const double EdgeD = -XMVectorGetX(XMVector3Dot(EdgeNormal, PFrom));
+			const double EdgeLengthSq = XMVectorGetX(XMVector3LengthSq(Edge));
+			Quadrics[PositionRemap[From]].AddPlane(Plane.x, Plane.y, Plane.z, EdgeD, EdgeLengthSq * EdgeWeight);
+			Quadrics[PositionRemap[To]].AddPlane(Plane.x, Plane.y, Plane.z, EdgeD, EdgeLengthSq * EdgeWeight);
+		}
+	}
+
+	// Vertex the twin of a seam vertex collapses onto when Source collapses onto Target, NoVertex if the seam doesn't follow
+	auto FindTwinTarget = [&](unsigned int Source, unsigned int Target)
+	{
+		const unsigned int Twin = NextWedge[Source];
+		if (OpenOut[Twin] < ManyVertices && PositionRemap[OpenOut[Twin]] == PositionRemap[Target])
+		{
+			return OpenOut[Twin];
+		}
+		if (OpenIn[Twin] < ManyVertices && PositionRemap[OpenIn[Twin]] == PositionRemap[Target])
+		{
+			return OpenIn[Twin];
+		}
+		return NoVertex;
+	};
+
+	auto CanCollapse = [&](unsigned int Source, unsigned int Target)
+	{
+		switch (Kinds[Source])
+		{
+		case EVertexKind::Manifold:
+			return true;
+		case EVertexKind::Border:
+		case EVertexKind::Seam:
+			// Along the open edge, unless it closes a hole of 3 edges
+			if (Target == OpenOut[Source])
+			{
+				if (OpenOut[Target] == OpenIn[Source])
+				{
+					return false;
+				}
+			}
+			else if (Target == OpenIn[Source])
+			{
+				if (OpenIn[Target] == OpenOut[Source])
+				{
+					return false;
+				}
+			}
+			else
+			{
+				return false;
+			}
+			return Kinds[Source] == EVertexKind::Border || FindTwinTarget(Source, Target) != NoVertex;
+		default:
+			return false;
+		}
+	};
+
+	// Vertex collapsed during the current pass to the vertex it collapsed onto
+	std::vector<unsigned int> Collapsed(Identity);
+	std::vector<bool> PassLocked(VertexCount);
+	std::vector<unsigned int> TriangleOffsets, TriangleLists;
+	std::vector<Collapse> Candidates;
+	float MaxError = 0.0f;
+
+	// Positions of the triangle after the pending collapses, with Source moved to NewPosition
+	auto CornerPosition = [&](unsigned int Corner, unsigned int SourcePosition, const XMFLOAT3& NewPosition)
+	{
+		const unsigned int Moved = Collapsed[Corner];
+		return PositionRemap[Moved] == SourcePosition ? XMLoadFloat3(&NewPosition) : XMLoadFloat3(&Vertices[Moved].Pos);
+	};
+
+	while (OutIndices.size() > TargetIndexCount)
+	{
+		const size_t TriangleCount = OutIndices.size() / 3;
+
+		// Triangles around each position
+		TriangleOffsets.assign(VertexCount + 1, 0);
+		for (unsigned int Index : OutIndices)
+		{
+			TriangleOffsets[PositionRemap[Index] + 1]++;
+		}
+		for (size_t Vertex = 0; Vertex < VertexCount; ++Vertex)
+		{
+			TriangleOffsets[Vertex + 1] += TriangleOffsets[Vertex];
+		}
+		TriangleLists.resize(OutIndices.size());
+		std::vector<unsigned int> Fill(TriangleOffsets.begin(), TriangleOffsets.end() - 1);
+		for (size_t Triangle = 0; Triangle < TriangleCount; ++Triangle)
+		{
+			for (int Corner = 0; Corner < 3; ++Corner)
+			{
+				TriangleLists[Fill[PositionRemap[OutIndices[Triangle * 3 + Corner]]]++] = static_cast<unsigned int>(Triangle);
+			}
+		}
+
+		// Cheapest direction of every edge, each edge once : from its smaller position or along an open border
+		Candidates.clear();
+		for (size_t Triangle = 0; Triangle < TriangleCount; ++Triangle)
+		{
+			for (int Corner = 0; Corner < 3; ++Corner)
+			{
+				const unsigned int A = OutIndices[Triangle * 3 + Corner];
+				const unsigned int B = OutIndices[Triangle * 3 + (Corner + 1) % 3];
+				if (PositionRemap[A] > PositionRemap[B] && !(Kinds[A] == EVertexKind::Border && OpenOut[A] == B))
+				{
+					continue;
+				}
+
+				const float CostAB = CanCollapse(A, B) ? Quadrics[PositionRemap[A]].Evaluate(Vertices[B].Pos) : FLT_MAX;
+				const float CostBA = CanCollapse(B, A) ? Quadrics[PositionRemap[B]].Evaluate(Vertices[A].Pos) : FLT_MAX;
+				if (CostAB < FLT_MAX || CostBA < FLT_MAX)
+				{
+					Candidates.push_back(CostAB <= CostBA ? Collapse{ A, B, CostAB } : Collapse{ B, A, CostBA });
+				}
+			}
+		}
+
+		std::sort(Candidates.begin(), Candidates.end(), [](const Collapse& A, const Collapse& B)
+		{
+			return A.Cost < B.Cost;
+		});
+
+		// Collapses touching different positions are independent, apply the cheapest ones until the target is reached
+		std::fill(PassLocked.begin(), PassLocked.end(), false);
+		const size_t TrianglesToRemove = (OutIndices.size() - TargetIndexCount + 2) / 3;
+		size_t TrianglesRemoved = 0;
+		for (const Collapse& Candidate : Candidates)
+		{
+			if (TrianglesRemoved >= TrianglesToRemove)
+			{
+				break;
+			}
+
+			const unsigned int SourcePosition = PositionRemap[Candidate.Source];
+			const unsigned int TargetPosition = PositionRemap[Candidate.Target];
+			if (PassLocked[SourcePosition] || PassLocked[TargetPosition])
+			{
+				continue;
+			}
+
+			// Reject collapses flipping a triangle around the source, and count the ones that disappear
+			const XMFLOAT3& NewPosition = Vertices[Candidate.Target].Pos;
+			bool bFlips = false;
+			size_t Removed = 0;
+			for (unsigned int Entry = TriangleOffsets[SourcePosition]; Entry < TriangleOffsets[SourcePosition + 1] && !bFlips; ++Entry)
+			{
+				const unsigned int* Corners = &OutIndices[TriangleLists[Entry] * 3];
+				if (PositionRemap[Collapsed[Corners[0]]] == TargetPosition || PositionRemap[Collapsed[Corners[1]]] == TargetPosition
+					|| PositionRemap[Collapsed[Corners[2]]] == TargetPosition)
+				{
+					Removed++;
+					continue;
+				}
+
+				const XMVECTOR Before = XMVector3Cross(XMLoadFloat3(&Vertices[Collapsed[Corners[1]]].Pos) - XMLoadFloat3(&Vertices[Collapsed[Corners[0]]].Pos),
+					XMLoadFloat3(&Vertices[Collapsed[Corners[2]]].Pos) - XMLoadFloat3(&Vertices[Collapsed[Corners[0]]].Pos));
+				const XMVECTOR P0 = CornerPosition(Corners[0], SourcePosition, NewPosition);
+				const XMVECTOR After = XMVector3Cross(CornerPosition(Corners[1], SourcePosition, NewPosition) - P0,
+					CornerPosition(Corners[2], SourcePosition, NewPosition) - P0);
+				const float Dot = XMVectorGetX(XMVector3Dot(Before, After));
+				bFlips = Dot <= 0.25f * XMVectorGetX(XMVector3Length(Before)) * XMVectorGetX(XMVector3Length(After));
+			}
+			if (bFlips)
+			{
+				continue;
+			}
+
+			// Every vertex at the source position moves : itself, or both sides of the seam
+			Collapsed[Candidate.Source] = Candidate.Target;
+			unsigned int Twin = NoVertex, TwinTarget = NoVertex;
+			if (Kinds[Candidate.Source] == EVertexKind::Seam)
+			{
+				Twin = NextWedge[Candidate.Source];
+				TwinTarget = FindTwinTarget(Candidate.Source, Candidate.Target);
+				Collapsed[Twin] = TwinTarget;
+			}
+
+			// The open edges now go around the source
+			auto UpdateOpenEdges = [&](unsigned int Source, unsigned int Target)
+			{
+				if (Kinds[Source] != EVertexKind::Border && Kinds[Source] != EVertexKind::Seam)
+				{
+					return;
+				}
+				if (Target == OpenOut[Source])
+				{
+					OpenIn[Target] = OpenIn[Source];
+					OpenOut[OpenIn[Source]] = Target;
+				}
+				else
+				{
+					OpenOut[Target] = OpenOut[Source];
+					OpenIn[OpenOut[Source]] = Target;
+				}
+			};
+			UpdateOpenEdges(Candidate.Source, Candidate.Target);
+			if (Twin != NoVertex)
+			{
+				UpdateOpenEdges(Twin, TwinTarget);
+			}
+
+			Quadrics[TargetPosition].Add(Quadrics[SourcePosition]);
+			MaxError = std::max(MaxError, Candidate.Cost);
+			PassLocked[SourcePosition] = true;
+			PassLocked[TargetPosition] = true;
+			TrianglesRemoved += Removed;
+		}
+
+		if (TrianglesRemoved == 0)
+		{
+			break;
+		}
+
+		// Move the corners and drop the triangles that collapsed
+		size_t Written = 0;
+		for (size_t Triangle = 0; Triangle < TriangleCount; ++Triangle)
+		{
+			const unsigned int A = Collapsed[OutIndices[Triangle * 3 + 0]];
+			const unsigned int B = Collapsed[OutIndices[Triangle * 3 + 1]];
+			const unsigned int C = Collapsed[OutIndices[Triangle * 3 + 2]];
+			if (PositionRemap[A] != PositionRemap[B] && PositionRemap[B] != PositionRemap[C] && PositionRemap[A] != PositionRemap[C])
+			{
+				OutIndices[Written++] = A;
+				OutIndices[Written++] = B;
+				OutIndices[Written++] = C;
+			}
+		}
+		OutIndices.resize(Written);
+
+		std::copy(Identity.begin(), Identity.end(), Collapsed.begin());
+	}
+
+	return sqrtf(MaxError);
+}
+
+void CMeshSimplifier::BuildLODChain(const std::vector<Vertex>& Vertices, const std::vector<unsigned int>& Indices, std::vector<MeshLOD>& OutLODs)
+{
+	OutLODs.clear();
+	OutLODs.reserve(sizeof(LODRatios) / sizeof(LODRatios[0]));
+
+	const size_t TriangleCount = Indices.size() / 3;
+	const std::vector<unsigned int>* Source = &Indices;
+	float Error = 0.0f;
+	for (float Ratio : LODRatios)
+	{
+		MeshLOD LOD;
+		const float StepError = Simplify(Vertices, *Source, size_t(float(TriangleCount) * Ratio) * 3, LOD.Indices);
+		if (LOD.Indices.empty() || float(LOD.Indices.size()) > float(Source->size()) * MinLODReduction)
+		{
+			break;
+		}
+
+		// Each LOD is measured against the previous one, the sum bounds the distance to the full mesh
+		Error += StepError;
+		LOD.Error = Error;
+		OutLODs.push_back(std::move(LOD));
+		Source = &OutLODs.back().Indices;
+	}
+}
+
+void CMeshSimplifier::GenerateLODs(const std::vector<CMesh*>& Meshes, uint32_t ThreadCount)
+{
+	// Meshes are handed out one at a time, large and small meshes balance out
+	CJobSystem::Get().ParallelFor(Meshes.size(), 1, [&Meshes](size_t Begin, size_t End)
+	{
+		for (size_t Index = Begin; Index < End; ++Index)
+		{
+			Meshes[Index]->GenerateLODs();
+		}
+	}, ThreadCount);
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "Mesh.h"
+
+#include <vector>
+
+// Edge collapse simplification driven by quadric error metrics. Vertices only collapse onto their neighbours, so every LOD
+// is a new index buffer over the vertices of the full resolution mesh. UV seams and open borders only collapse along
+// themselves, both sides of a seam together, so the texture mapping and the silhouette of open meshes hold.
+class CMeshSimplifier
+{
+public:
+	// Collapses edges until OutIndices has at most TargetIndexCount indices or nothing can be collapsed anymore
+	// Returns the largest distance the surface moved, in local units
+	static float Simplify(const std::vector<Vertex>& Vertices, const std::vector<unsigned int>& Indices, size_t TargetIndexCount,
+		std::vector<unsigned int>& OutIndices);
+
+	// LODs at 50, 25, 12.5 and 6.25% of the triangles, each one simplified from the previous, stops early when a LOD doesn't
+	// get much smaller than the previous one
+	static void BuildLODChain(const std::vector<Vertex>& Vertices, const std::vector<unsigned int>& Indices, std::vector<MeshLOD>& OutLODs);
+
+	// Runs CMesh::GenerateLODs on each mesh, spread over ThreadCount threads of the job system (0 for all)
+	static void GenerateLODs(const std::vector<CMesh*>& Meshes, uint32_t ThreadCount = 0);
+};
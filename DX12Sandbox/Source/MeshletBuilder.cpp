@@ -0,0 +1,278 @@
+#include "pch.h"
+#include "MeshletBuilder.h"
+
+#include <algorithm>
+#include <cmath>
+
+void CMeshletBuilder::Build(const std::vector<Vertex>& Vertices, const std::vector<unsigned int>& Indices, MeshletData& OutData,
+	uint32_t MaxVertices, uint32_t MaxTriangles)
+{
+	OutData = MeshletData();
+	MaxVertices = std::min(MaxVertices, uint32_t(MESHLET_VERTEX_LIMIT));
+	const size_t TriangleCount = Indices.size() / 3;
+	if (TriangleCount == 0)
+	{
+		return;
+	}
+
+	// Triangles of each vertex
+	std::vector<uint32_t> TriangleListOffsets(Vertices.size() + 1, 0);
+	for (unsigned int Index : Indices)
+	{
+		TriangleListOffsets[Index + 1]++;
+	}
+	for (size_t Vertex = 0; Vertex < Vertices.size(); ++Vertex)
+	{
+		TriangleListOffsets[Vertex + 1] += TriangleListOffsets[Vertex];
+	}
+	std::vector<uint32_t> TriangleLists(Indices.size());
+	std::vector<uint32_t> Fill(TriangleListOffsets.begin(), TriangleListOffsets.end() - 1);
+	for (size_t Triangle = 0; Triangle < TriangleCount; ++Triangle)
+	{
+		for (int Corner = 0; Corner < 3; ++Corner)
+		{
+			TriangleLists[Fill[Indices[Triangle * 3 + Corner]]++] = uint32_t(Triangle);
+		}
+	}
+
+	// Index of each mesh vertex in the meshlet being filled, reset when it is closed. Past MESHLET_VERTEX_LIMIT a local
+	// index would be the marker or overflow
+	const uint8_t NotInMeshlet = 0xFF;
+	std::vector<uint8_t> LocalIndices(Vertices.size(), NotInMeshlet);
+	std::vector<bool> Used(TriangleCount, false);
+
+	Meshlet Current;
+
+	// Sum of the positions of the meshlet's vertices, to grow it around its center
+	XMVECTOR PositionSum = XMVectorZero();
+
+	auto CloseMeshlet = [&]()
+	{
+		for (uint32_t Entry = 0; Entry < Current.VertexCount; ++Entry)
+		{
+			LocalIndices[OutData.Vertices[Current.VertexOffset + Entry]] = NotInMeshlet;
+		}
+		OutData.Meshlets.push_back(Current);
+		OutData.Bounds.push_back(ComputeBounds(Vertices, OutData, Current));
+
+		Current = Meshlet();
+		PositionSum = XMVectorZero();
+		Current.VertexOffset = uint32_t(OutData.Vertices.size());
+		Current.TriangleOffset = uint32_t(OutData.Triangles.size() / 3);
+	};
+
+	auto NewVertexCount = [&](uint32_t Triangle)
+	{
+		uint32_t NewVertices = 0;
+		for (int Corner = 0; Corner < 3; ++Corner)
+		{
+			NewVertices += LocalIndices[Indices[Triangle * 3 + Corner]] == NotInMeshlet ? 1 : 0;
+		}
+		return NewVertices;
+	};
+
+	// Next triangle to start a meshlet from when the current one has no neighbour left
+	size_t Cursor = 0;
+	uint32_t Next = 0;
+
+	for (size_t Added = 0; Added < TriangleCount; ++Added)
+	{
+		if (Current.VertexCount + NewVertexCount(Next) > MaxVertices || Current.TriangleCount + 1 > MaxTriangles)
+		{
+			CloseMeshlet();
+		}
+
+		const unsigned int* Corners = &Indices[Next * 3];
+		for (int Corner = 0; Corner < 3; ++Corner)
+		{
+			uint8_t& Local = LocalIndices[Corners[Corner]];
+			if (Local == NotInMeshlet)
+			{
+				Local = uint8_t(Current.VertexCount++);
+				OutData.Vertices.push_back(Corners[Corner]);
+				PositionSum = PositionSum + XMLoadFloat3(&Vertices[Corners[Corner]].Pos);
+			}
+			OutData.Triangles.push_back(Local);
+		}
+		Current.TriangleCount++;
+		Used[Next] = true;
+
+		// Grow through the triangles sharing the most vertices with the meshlet, then the closest to its center,
+		// it keeps the bounds and the cone tight
+		const XMVECTOR Center = PositionSum / float(Current.VertexCount);
+		uint32_t BestNewVertices = 3;
+		float BestDistanceSq = 0.0f;
+		uint32_t Best = ~0u;
+		for (uint32_t Entry = 0; Entry < Current.VertexCount; ++Entry)
+		{
+			const unsigned int Vertex = OutData.Vertices[Current.VertexOffset + Entry];
+			for (uint32_t ListEntry = TriangleListOffsets[Vertex]; ListEntry < TriangleListOffsets[Vertex + 1]; ++ListEntry)
+			{
+				const uint32_t Triangle = TriangleLists[ListEntry];
+				if (Used[Triangle])
+				{
+					continue;
+				}
+
+				const uint32_t NewVertices = NewVertexCount(Triangle);
+				if (NewVertices > BestNewVertices)
+				{
+					continue;
+				}
+
+				const XMVECTOR TriangleCenter = XMLoadFloat3(&Vertices[Indices[Triangle * 3]].Pos)
+					+ XMLoadFloat3(&Vertices[Indices[Triangle * 3 + 1]].Pos) + XMLoadFloat3(&Vertices[Indices[Triangle * 3 + 2]].Pos);
+				const float DistanceSq = XMVectorGetX(XMVector3LengthSq(TriangleCenter / 3.0f - Center));
+				if (NewVertices < BestNewVertices || Best == ~0u || DistanceSq < BestDistanceSq)
+				{
+					BestNewVertices = NewVertices;
+					BestDistanceSq = DistanceSq;
+					Best = Triangle;
+				}
+			}
+		}
+
+		// Close the meshlet when the best neighbour doesn't fit rather than starting an island
+		if (Best != ~0u && Current.VertexCount + BestNewVertices <= MaxVertices && Current.TriangleCount < MaxTriangles)
+		{
+			Next = Best;
+			continue;
+		}
+
+		if (Current.TriangleCount > 0 && Added + 1 < TriangleCount)
+		{
+			CloseMeshlet();
+		}
+
+		// A neighbour starts the next meshlet when there is one, else the next triangle left in the original order
+		if (Best != ~0u)
+		{
+			Next = Best;
+			continue;
+		}
+		while (Cursor < TriangleCount && Used[Cursor])
+		{
+			Cursor++;
+		}
+		Next = uint32_t(Cursor);
+	}
+
+	if (Current.TriangleCount > 0)
+	{
+		CloseMeshlet();
+	}
+}
+
+bool CMeshletBuilder::IsBackfacing(const MeshletBounds& Bounds, const XMFLOAT3& CameraPosition)
+{
+	// The view direction to any point of the sphere is within the cone's complement, conservative for the whole sphere
+	const XMVECTOR ToCenter = XMLoadFloat3(&Bounds.Center) - XMLoadFloat3(&CameraPosition);
+	const float Distance = XMVectorGetX(XMVector3Length(ToCenter));
+	return XMVectorGetX(XMVector3Dot(ToCenter, XMLoadFloat3(&Bounds.ConeAxis))) >= Bounds.ConeCutoff * Distance + Bounds.Radius;
+}
+
+bool CMeshletBuilder::IsOutsideFrustum(const MeshletBounds& Bounds, const XMFLOAT4 Planes[6])
+{
+	for (int Plane = 0; Plane < 6; ++Plane)
+	{
+		const float Distance = Planes[Plane].x * Bounds.Center.x + Planes[Plane].y * Bounds.Center.y + Planes[Plane].z * Bounds.Center.z + Planes[Plane].w;
+		if (Distance < -Bounds.Radius)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+uint32_t CMeshletBuilder::Cull(const MeshletData& Data, const XMFLOAT4X4& World, const XMFLOAT4 Planes[6], const XMFLOAT3& CameraPosition,
+	uint32_t* OutVisible)
+{
+	// Side tests are preserved by affine transforms, bring the planes and the camera to the mesh instead of every meshlet to the world
+	const XMMATRIX WorldMatrix = XMLoadFloat4x4(&World);
+	const XMMATRIX PlaneToLocal = XMMatrixTranspose(WorldMatrix);
+	XMFLOAT4 LocalPlanes[6];
+	for (int Plane = 0; Plane < 6; ++Plane)
+	{
+		const XMVECTOR LocalPlane = XMVector4Transform(XMLoadFloat4(&Planes[Plane]), PlaneToLocal);
+
+		// Normalized again so distances are in local units, like the radii
+		XMStoreFloat4(&LocalPlanes[Plane], LocalPlane / XMVector3Length(LocalPlane));
+	}
+
+	XMFLOAT3 LocalCamera;
+	XMStoreFloat3(&LocalCamera, XMVector3Transform(XMLoadFloat3(&CameraPosition), XMMatrixInverse(nullptr, WorldMatrix)));
+
+	uint32_t VisibleCount = 0;
+	for (uint32_t Index = 0; Index < uint32_t(Data.Meshlets.size()); ++Index)
+	{
+		const MeshletBounds& Bounds = Data.Bounds[Index];
+		if (!IsOutsideFrustum(Bounds, LocalPlanes) && !IsBackfacing(Bounds, LocalCamera))
+		{
+			OutVisible[VisibleCount++] = Index;
+		}
+	}
+	return VisibleCount;
+}
+
+MeshletBounds CMeshletBuilder::ComputeBounds(const std::vector<Vertex>& Vertices, const MeshletData& Data, const Meshlet& InMeshlet)
+{
+	MeshletBounds Bounds;
+	const unsigned int* MeshletVertices = &Data.Vertices[InMeshlet.VertexOffset];
+	const uint8_t* MeshletTriangles = &Data.Triangles[InMeshlet.TriangleOffset * 3];
+
+	// Sphere around the box of the vertices
+	XMVECTOR Min = XMLoadFloat3(&Vertices[MeshletVertices[0]].Pos);
+	XMVECTOR Max = Min;
+	for (uint32_t Entry = 1; Entry < InMeshlet.VertexCount; ++Entry)
+	{
+		const XMVECTOR Position = XMLoadFloat3(&Vertices[MeshletVertices[Entry]].Pos);
+		Min = XMVectorMin(Min, Position);
+		Max = XMVectorMax(Max, Position);
+	}
+
+	const XMVECTOR Center = (Min + Max) * 0.5f;
+	float RadiusSq = 0.0f;
+	for (uint32_t Entry = 0; Entry < InMeshlet.VertexCount; ++Entry)
+	{
+		RadiusSq = std::max(RadiusSq, XMVectorGetX(XMVector3LengthSq(XMLoadFloat3(&Vertices[MeshletVertices[Entry]].Pos) - Center)));
+	}
+	XMStoreFloat3(&Bounds.Center, Center);
+	Bounds.Radius = sqrtf(RadiusSq);
+
+	// Normal cone : average of the triangle normals, opened to the normal furthest from it
+	std::vector<XMVECTOR> Normals;
+	Normals.reserve(InMeshlet.TriangleCount);
+	XMVECTOR Axis = XMVectorZero();
+	for (uint32_t Triangle = 0; Triangle < InMeshlet.TriangleCount; ++Triangle)
+	{
+		const XMVECTOR P0 = XMLoadFloat3(&Vertices[MeshletVertices[MeshletTriangles[Triangle * 3 + 0]]].Pos);
+		const XMVECTOR P1 = XMLoadFloat3(&Vertices[MeshletVertices[MeshletTriangles[Triangle * 3 + 1]]].Pos);
+		const XMVECTOR P2 = XMLoadFloat3(&Vertices[MeshletVertices[MeshletTriangles[Triangle * 3 + 2]]].Pos);
+		const XMVECTOR Cross = XMVector3Cross(P1 - P0, P2 - P0);
+
+		// Degenerate triangles can't be seen from any side
+		if (XMVectorGetX(XMVector3LengthSq(Cross)) > 0.0f)
+		{
+			Normals.push_back(XMVector3Normalize(Cross));
+			Axis = Axis + Normals.back();
+		}
+	}
+
+	if (Normals.empty() || XMVectorGetX(XMVector3LengthSq(Axis)) == 0.0f)
+	{
+		return Bounds;
+	}
+
+	Axis = XMVector3Normalize(Axis);
+	float MinDot = 1.0f;
+	for (const XMVECTOR& Normal : Normals)
+	{
+		MinDot = std::min(MinDot, XMVectorGetX(XMVector3Dot(Axis, Normal)));
+	}
+
+	XMStoreFloat3(&Bounds.ConeAxis, Axis);
+
+	// A cone wider than ~85 degrees would almost never cull, keep it out of the test
+	Bounds.ConeCutoff = MinDot <= 0.1f ? 1.0f : sqrtf(1.0f - MinDot * MinDot);
+	return Bounds;
+}
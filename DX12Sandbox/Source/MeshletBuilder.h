@@ -0,0 +1,71 @@
+#pragma once
+#include "Mesh.h"
+
+#include <vector>
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+// Most vertices a meshlet can ever have, its triangles index them with 8 bits and 0xFF marks a vertex outside of it
+#define MESHLET_VERTEX_LIMIT 254
+
+// A cluster of triangles small enough for a mesh shader thread group, its data lives in MeshletData
+struct Meshlet
+{
+	// First entry in MeshletData::Vertices and MeshletData::Triangles
+	uint32_t VertexOffset = 0;
+	uint32_t TriangleOffset = 0;
+
+	uint32_t VertexCount = 0;
+	uint32_t TriangleCount = 0;
+};
+
+// Culling data of a meshlet, in the local space of the mesh
+struct MeshletBounds
+{
+	XMFLOAT3 Center = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	float Radius = 0.0f;
+
+	// Every triangle normal is within the cone around ConeAxis, ConeCutoff is the sine of the cone half angle,
+	// 1 when the normals are too spread out for the meshlet to ever be entirely backfacing
+	XMFLOAT3 ConeAxis = XMFLOAT3(0.0f, 0.0f, 1.0f);
+	float ConeCutoff = 1.0f;
+};
+
+struct MeshletData
+{
+	std::vector<Meshlet> Meshlets;
+
+	// Same order as Meshlets
+	std::vector<MeshletBounds> Bounds;
+
+	// Indices in the vertices of the mesh, each meshlet references its own range
+	std::vector<unsigned int> Vertices;
+
+	// 3 indices per triangle in the range of Vertices of the meshlet
+	std::vector<uint8_t> Triangles;
+};
+
+// Splits a mesh in meshlets and culls them one by one, meant for mesh shader or compute culled rendering
+class CMeshletBuilder
+{
+public:
+	// Meshlets follow the order of the triangles, run CMeshOptimizer::OptimizeVertexCache first for tight clusters.
+	// MaxVertices is clamped to MESHLET_VERTEX_LIMIT
+	static void Build(const std::vector<Vertex>& Vertices, const std::vector<unsigned int>& Indices, MeshletData& OutData,
+		uint32_t MaxVertices = MESHLET_MAX_VERTICES, uint32_t MaxTriangles = MESHLET_MAX_TRIANGLES);
+
+	// True when the camera can only see the back of every triangle of the meshlet, CameraPosition in local space
+	static bool IsBackfacing(const MeshletBounds& Bounds, const XMFLOAT3& CameraPosition);
+
+	// True when the bounding sphere is outside of one of the planes, in local space
+	static bool IsOutsideFrustum(const MeshletBounds& Bounds, const XMFLOAT4 Planes[6]);
+
+	// Writes the indices of the meshlets passing both tests and returns their count
+	// The planes and the camera are in world space, World is the world matrix of the mesh
+	static uint32_t Cull(const MeshletData& Data, const XMFLOAT4X4& World, const XMFLOAT4 Planes[6], const XMFLOAT3& CameraPosition,
+		uint32_t* OutVisible);
+
+private:
+	static MeshletBounds ComputeBounds(const std::vector<Vertex>& Vertices, const MeshletData& Data, const Meshlet& InMeshlet);
+};
@@ -0,0 +1,449 @@
+#include "pch.h"
+#include "NullRHI.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+// Payloads of the recorded commands
+struct NullBarrierCommand
+{
+	CNullRHIResource* Resource;
+	ERHIResourceState Before;
+	ERHIResourceState After;
+};
+
+struct NullResourceCommand
+{
+	CNullRHIResource* Resource;
+};
+
+struct NullRootParameterCommand
+{
+	uint32_t RootParameterIndex;
+	uint64_t Value;
+};
+
+struct NullDrawCommand
+{
+	uint32_t IndexCountPerInstance;
+	uint32_t InstanceCount;
+	uint32_t StartIndexLocation;
+	int32_t BaseVertexLocation;
+	uint32_t StartInstanceLocation;
+};
+
+struct NullTimestampCommand
+{
+	CNullRHITimestampQueries* Queries;
+	uint32_t Index;
+};
+
+struct NullCopyCommand
+{
+	CNullRHIResource* Dest;
+	uint64_t DestOffset;
+	CNullRHIResource* Source;
+	uint64_t SourceOffset;
+	uint64_t NumBytes;
+};
+
+static double ElapsedMs(std::chrono::high_resolution_clock::time_point Start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - Start).count();
+}
+
+CNullRHIResource::CNullRHIResource(uint64_t InSize, ERHIHeapType InHeapType, ERHIResourceState InitialState, uint64_t InGPUAddress)
+	: State(InitialState), Size(InSize), HeapType(InHeapType), GPUAddress(InGPUAddress)
+{
+}
+
+void* CNullRHIResource::Map()
+{
+	if (HeapType != ERHIHeapType::Upload)
+	{
+		return nullptr;
+	}
+
+	if (!CPUData)
+	{
+		CPUData.reset(new uint8_t[Size]);
+	}
+	return CPUData.get();
+}
+
+uint64_t CNullRHIFence::GetCompletedValue() const
+{
+	const double NowMs = RHINowMs();
+	uint64_t Value = CompletedValue;
+	for (const PendingValue& Pending : PendingValues)
+	{
+		if (Pending.TimeMs > NowMs)
+		{
+			break;
+		}
+		Value = Pending.Value;
+	}
+	return Value;
+}
+
+bool CNullRHIFence::Wait(uint64_t Value)
+{
+	Device->OnFenceWait();
+
+	if (GetCompletedValue() >= Value)
+	{
+		return true;
+	}
+
+	// Sleeps until the simulated GPU gets there, waiting on a value nobody signaled would hang a real GPU
+	for (const PendingValue& Pending : PendingValues)
+	{
+		if (Pending.Value >= Value)
+		{
+			const double WaitMs = Pending.TimeMs - RHINowMs();
+			if (WaitMs > 0.0)
+			{
+				std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(WaitMs));
+			}
+			return true;
+		}
+	}
+	return CompletedValue >= Value;
+}
+
+void CNullRHIFence::Signal(uint64_t Value, double TimeMs)
+{
+	// Values the GPU already passed don't need to be remembered
+	const double NowMs = RHINowMs();
+	size_t Passed = 0;
+	while (Passed < PendingValues.size() && PendingValues[Passed].TimeMs <= NowMs)
+	{
+		CompletedValue = PendingValues[Passed++].Value;
+	}
+	PendingValues.erase(PendingValues.begin(), PendingValues.begin() + Passed);
+
+	if (TimeMs <= NowMs && PendingValues.empty())
+	{
+		CompletedValue = Value;
+	}
+	else
+	{
+		PendingValues.push_back({ Value, TimeMs });
+	}
+}
+
+/* Command List */
+
+bool CNullRHICommandList::Reset(CRHICommandAllocator* InAllocator, CRHIPipelineState* InitialState)
+{
+	if (bRecording)
+	{
+		return false;
+	}
+
+	RecordStart = std::chrono::high_resolution_clock::now();
+
+	Allocator = static_cast<CNullRHICommandAllocator*>(InAllocator);
+	StreamBegin = Allocator->Memory.size();
+	StreamEnd = StreamBegin;
+	bRecording = true;
+
+	if (InitialState)
+	{
+		SetPipelineState(InitialState);
+	}
+	return true;
+}
+
+bool CNullRHICommandList::Close()
+{
+	if (!bRecording)
+	{
+		return false;
+	}
+
+	StreamEnd = Allocator->Memory.size();
+	bRecording = false;
+	RecordTimeMs += ElapsedMs(RecordStart);
+	return true;
+}
+
+void CNullRHICommandList::Push(ENullRHICommand Type, const void* Payload, uint32_t PayloadSize)
+{
+	std::vector<uint8_t>& Memory = Allocator->Memory;
+	const size_t Offset = Memory.size();
+	Memory.resize(Offset + sizeof(NullRHICommandHeader) + PayloadSize);
+
+	NullRHICommandHeader Header = { Type, PayloadSize };
+	memcpy(&Memory[Offset], &Header, sizeof(Header));
+	memcpy(&Memory[Offset + sizeof(Header)], Payload, PayloadSize);
+}
+
+void CNullRHICommandList::ResourceBarrier(CRHIResource* Resource, ERHIResourceState Before, ERHIResourceState After)
+{
+	NullBarrierCommand Command = { static_cast<CNullRHIResource*>(Resource), Before, After };
+	Push(ENullRHICommand::ResourceBarrier, Command);
+}
+
+void CNullRHICommandList::SetRenderTarget(CRHIResource* RenderTarget)
+{
+	NullResourceCommand Command = { static_cast<CNullRHIResource*>(RenderTarget) };
+	Push(ENullRHICommand::SetRenderTarget, Command);
+}
+
+void CNullRHICommandList::ClearRenderTarget(CRHIResource* RenderTarget, const float /*Color*/[4])
+{
+	NullResourceCommand Command = { static_cast<CNullRHIResource*>(RenderTarget) };
+	Push(ENullRHICommand::ClearRenderTarget, Command);
+}
+
+void CNullRHICommandList::ClearDepth(float Depth)
+{
+	Push(ENullRHICommand::ClearDepth, Depth);
+}
+
+void CNullRHICommandList::SetViewport(const RHIViewport& Viewport)
+{
+	Push(ENullRHICommand::SetViewport, Viewport);
+}
+
+void CNullRHICommandList::SetScissorRect(const RHIRect& Rect)
+{
+	Push(ENullRHICommand::SetScissorRect, Rect);
+}
+
+void CNullRHICommandList::SetPipelineState(CRHIPipelineState* PipelineState)
+{
+	Push(ENullRHICommand::SetPipelineState, PipelineState);
+}
+
+void CNullRHICommandList::SetGraphicsRootConstantBufferView(uint32_t RootParameterIndex, uint64_t GPUAddress)
+{
+	NullRootParameterCommand Command = { RootParameterIndex, GPUAddress };
+	Push(ENullRHICommand::SetGraphicsRootConstantBufferView, Command);
+}
+
+void CNullRHICommandList::SetGraphicsRootTexture(uint32_t RootParameterIndex, CRHIResource* Texture)
+{
+	NullRootParameterCommand Command = { RootParameterIndex, Texture->GetGPUVirtualAddress() };
+	Push(ENullRHICommand::SetGraphicsRootTexture, Command);
+}
+
+void CNullRHICommandList::SetPrimitiveTopology(ERHIPrimitiveTopology Topology)
+{
+	Push(ENullRHICommand::SetPrimitiveTopology, Topology);
+}
+
+void CNullRHICommandList::SetVertexBuffers(uint32_t /*StartSlot*/, uint32_t NumViews, const RHIVertexBufferView* Views)
+{
+	Push(ENullRHICommand::SetVertexBuffers, Views, NumViews * sizeof(RHIVertexBufferView));
+}
+
+void CNullRHICommandList::SetIndexBuffer(const RHIIndexBufferView& View)
+{
+	Push(ENullRHICommand::SetIndexBuffer, View);
+}
+
+void CNullRHICommandList::DrawIndexedInstanced(uint32_t IndexCountPerInstance, uint32_t InstanceCount, uint32_t StartIndexLocation, int32_t BaseVertexLocation, uint32_t StartInstanceLocation)
+{
+	NullDrawCommand Command = { IndexCountPerInstance, InstanceCount, StartIndexLocation, BaseVertexLocation, StartInstanceLocation };
+	Push(ENullRHICommand::DrawIndexedInstanced, Command);
+}
+
+void CNullRHICommandList::CopyBufferRegion(CRHIResource* Dest, uint64_t DestOffset, CRHIResource* Source, uint64_t SourceOffset, uint64_t NumBytes)
+{
+	NullCopyCommand Command = { static_cast<CNullRHIResource*>(Dest), DestOffset, static_cast<CNullRHIResource*>(Source), SourceOffset, NumBytes };
+	Push(ENullRHICommand::CopyBufferRegion, Command);
+}
+
+void CNullRHICommandList::WriteTimestamp(CRHITimestampQueries* Queries, uint32_t Index)
+{
+	NullTimestampCommand Command = { static_cast<CNullRHITimestampQueries*>(Queries), Index };
+	Push(ENullRHICommand::WriteTimestamp, Command);
+}
+
+/* Device */
+
+bool CNullRHIDevice::Init(const RHIDeviceDesc& Desc)
+{
+	GPUTrianglesPerMs = Desc.NullGPUTrianglesPerMs;
+	GPUBusyUntilMs = 0.0;
+
+	for (int i = 0; i < Desc.BackBufferCount; ++i)
+	{
+		BackBuffers.push_back(new CNullRHIResource(0, ERHIHeapType::Default, ERHIResourceState::Present, 0));
+	}
+	BackBufferIndex = 0;
+	return true;
+}
+
+void CNullRHIDevice::Shutdown()
+{
+	for (CNullRHIResource* BackBuffer : BackBuffers)
+	{
+		SAFE_RELEASE(BackBuffer);
+	}
+	BackBuffers.clear();
+}
+
+CRHIResource* CNullRHIDevice::CreateBuffer(uint64_t Size, ERHIHeapType HeapType, ERHIResourceState InitialState, const wchar_t* /*Name*/)
+{
+	// Keep the same 64KB placement alignment as committed resources, an empty one still gets its own address
+	const uint64_t GPUAddress = NextGPUAddress.fetch_add((std::max(Size, uint64_t(1)) + 0xFFFF) & ~0xFFFFull);
+	return new CNullRHIResource(Size, HeapType, InitialState, GPUAddress);
+}
+
+CRHIResource* CNullRHIDevice::CreateTextureFromFile(const wchar_t* Filename, CRHICommandList* CommandList)
+{
+	CRHIResource* Texture = CreateBuffer(0, ERHIHeapType::Default, ERHIResourceState::CopyDest, Filename);
+	CommandList->ResourceBarrier(Texture, ERHIResourceState::CopyDest, ERHIResourceState::PixelShaderResource);
+	return Texture;
+}
+
+CRHIPipelineState* CNullRHIDevice::CreatePipelineState(const RHIPipelineStateDesc& /*Desc*/)
+{
+	return new CNullRHIPipelineState;
+}
+
+CRHICommandAllocator* CNullRHIDevice::CreateCommandAllocator()
+{
+	return new CNullRHICommandAllocator;
+}
+
+CRHICommandList* CNullRHIDevice::CreateCommandList(CRHICommandAllocator* Allocator)
+{
+	CNullRHICommandList* CommandList = new CNullRHICommandList;
+	CommandList->Reset(Allocator, nullptr);
+	return CommandList;
+}
+
+CRHIFence* CNullRHIDevice::CreateFence(uint64_t InitialValue)
+{
+	return new CNullRHIFence(this, InitialValue);
+}
+
+CRHITimestampQueries* CNullRHIDevice::CreateTimestampQueries(uint32_t Count)
+{
+	return new CNullRHITimestampQueries(Count);
+}
+
+void CNullRHIDevice::ExecuteCommandLists(uint32_t NumCommandLists, CRHICommandList* const* CommandLists)
+{
+	const std::chrono::high_resolution_clock::time_point Start = std::chrono::high_resolution_clock::now();
+
+	// The GPU starts on the lists once it is done with the ones before
+	GPUBusyUntilMs = std::max(GPUBusyUntilMs, RHINowMs());
+
+	for (uint32_t i = 0; i < NumCommandLists; ++i)
+	{
+		CNullRHICommandList* CommandList = static_cast<CNullRHICommandList*>(CommandLists[i]);
+		Replay(CommandList);
+
+		Stats.RecordTimeMs += CommandList->RecordTimeMs;
+		CommandList->RecordTimeMs = 0.0;
+		Stats.CommandListsExecuted++;
+	}
+
+	Stats.SubmitTimeMs += ElapsedMs(Start);
+}
+
+void CNullRHIDevice::Replay(CNullRHICommandList* CommandList)
+{
+	const uint8_t* Memory = CommandList->Allocator->Memory.data();
+	size_t Offset = CommandList->StreamBegin;
+
+	while (Offset < CommandList->StreamEnd)
+	{
+		NullRHICommandHeader Header;
+		memcpy(&Header, Memory + Offset, sizeof(Header));
+		const uint8_t* Payload = Memory + Offset + sizeof(Header);
+		Offset += sizeof(Header) + Header.PayloadSize;
+		Stats.CommandsExecuted++;
+
+		switch (Header.Type)
+		{
+		case ENullRHICommand::ResourceBarrier:
+		{
+			NullBarrierCommand Command;
+			memcpy(&Command, Payload, sizeof(Command));
+			if (Command.Resource->State != Command.Before)
+			{
+				Stats.BarrierStateMismatches++;
+			}
+			Command.Resource->State = Command.After;
+			Stats.Barriers++;
+			break;
+		}
+		case ENullRHICommand::SetPipelineState:
+			Stats.PipelineStateChanges++;
+			break;
+		case ENullRHICommand::SetGraphicsRootTexture:
+			Stats.DescriptorTableChanges++;
+			break;
+		case ENullRHICommand::SetVertexBuffers:
+			Stats.VertexBufferChanges++;
+			break;
+		case ENullRHICommand::SetIndexBuffer:
+			Stats.IndexBufferChanges++;
+			break;
+		case ENullRHICommand::DrawIndexedInstanced:
+		{
+			NullDrawCommand Command;
+			memcpy(&Command, Payload, sizeof(Command));
+			Stats.DrawCalls++;
+			Stats.InstancesDrawn += Command.InstanceCount;
+			Stats.IndicesDrawn += uint64_t(Command.IndexCountPerInstance) * Command.InstanceCount;
+			if (GPUTrianglesPerMs > 0.0)
+			{
+				GPUBusyUntilMs += double(Command.IndexCountPerInstance / 3) * Command.InstanceCount / GPUTrianglesPerMs;
+			}
+			break;
+		}
+		case ENullRHICommand::WriteTimestamp:
+		{
+			NullTimestampCommand Command;
+			memcpy(&Command, Payload, sizeof(Command));
+			Command.Queries->Times[Command.Index] = GPUBusyUntilMs;
+			break;
+		}
+		case ENullRHICommand::CopyBufferRegion:
+		{
+			NullCopyCommand Command;
+			memcpy(&Command, Payload, sizeof(Command));
+			if (Command.Dest->State != ERHIResourceState::CopyDest)
+			{
+				Stats.BarrierStateMismatches++;
+			}
+			// Upload heaps stay in GenericRead, default heaps have to be transitioned
+			if (Command.Source->State != ERHIResourceState::CopySource && Command.Source->State != ERHIResourceState::GenericRead)
+			{
+				Stats.BarrierStateMismatches++;
+			}
+			Stats.BytesCopied += Command.NumBytes;
+			break;
+		}
+		default:
+			break;
+		}
+	}
+}
+
+bool CNullRHIDevice::Signal(CRHIFence* Fence, uint64_t Value)
+{
+	static_cast<CNullRHIFence*>(Fence)->Signal(Value, GPUBusyUntilMs);
+	Stats.FenceSignals++;
+	return true;
+}
+
+bool CNullRHIDevice::Present()
+{
+	if (BackBuffers[BackBufferIndex]->State != ERHIResourceState::Present)
+	{
+		Stats.BarrierStateMismatches++;
+	}
+
+	BackBufferIndex = (BackBufferIndex + 1) % int(BackBuffers.size());
+	Stats.Presents++;
+	return true;
+}
@@ -0,0 +1,262 @@
+#pragma once
+#include "RHI.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+// Headless backend : commands are serialized into the memory of their allocator and replayed at
+// ExecuteCommandLists to track resource states and count the work. The "GPU" completes instantly, or draws a given
+// number of triangles per ms, its fences then pass once it would be done.
+
+class CNullRHIDevice;
+
+enum class ENullRHICommand : uint32_t
+{
+	ResourceBarrier,
+	SetRenderTarget,
+	ClearRenderTarget,
+	ClearDepth,
+	SetViewport,
+	SetScissorRect,
+	SetPipelineState,
+	SetGraphicsRootConstantBufferView,
+	SetGraphicsRootTexture,
+	SetPrimitiveTopology,
+	SetVertexBuffers,
+	SetIndexBuffer,
+	DrawIndexedInstanced,
+	CopyBufferRegion,
+	WriteTimestamp
+};
+
+// Precedes the payload of every command in the stream
+struct NullRHICommandHeader
+{
+	ENullRHICommand Type;
+	uint32_t PayloadSize;
+};
+
+class CNullRHIResource : public CRHIResource
+{
+public:
+	CNullRHIResource(uint64_t InSize, ERHIHeapType InHeapType, ERHIResourceState InitialState, uint64_t InGPUAddress);
+
+	uint64_t GetGPUVirtualAddress() const override
+	{
+		return GPUAddress;
+	}
+
+	uint64_t GetSize() const override
+	{
+		return Size;
+	}
+
+	void* Map() override;
+
+	void Unmap() override {}
+
+	// State of the resource on the GPU timeline, updated when barriers are replayed
+	ERHIResourceState State;
+
+private:
+	uint64_t Size;
+
+	ERHIHeapType HeapType;
+
+	uint64_t GPUAddress;
+
+	// Only upload heaps get CPU memory, nothing ever reads the content of default heaps
+	std::unique_ptr<uint8_t[]> CPUData;
+};
+
+class CNullRHIPipelineState : public CRHIPipelineState
+{
+};
+
+class CNullRHICommandAllocator : public CRHICommandAllocator
+{
+public:
+	bool Reset() override
+	{
+		// Keep the capacity so steady state recording doesn't allocate
+		Memory.clear();
+		return true;
+	}
+
+	// The recorded commands of every command list using this allocator
+	std::vector<uint8_t> Memory;
+};
+
+class CNullRHIFence : public CRHIFence
+{
+public:
+	CNullRHIFence(CNullRHIDevice* InDevice, uint64_t InitialValue)
+		: Device(InDevice), CompletedValue(InitialValue)
+	{
+	}
+
+	uint64_t GetCompletedValue() const override;
+
+	bool Wait(uint64_t Value) override;
+
+	// Sets the fence to Value at TimeMs on the clock of RHINowMs
+	void Signal(uint64_t Value, double TimeMs);
+
+private:
+	CNullRHIDevice* Device;
+
+	uint64_t CompletedValue;
+
+	// Values signaled by work the GPU is still doing, in the order they were signaled
+	struct PendingValue
+	{
+		uint64_t Value;
+		double TimeMs;
+	};
+
+	std::vector<PendingValue> PendingValues;
+};
+
+class CNullRHITimestampQueries : public CRHITimestampQueries
+{
+public:
+	CNullRHITimestampQueries(uint32_t Count)
+		: Times(Count, 0.0)
+	{
+	}
+
+	double GetTimeMs(uint32_t Index) override
+	{
+		return Times[Index];
+	}
+
+	// Written when the command is replayed, at the time the simulated GPU reaches it
+	std::vector<double> Times;
+};
+
+class CNullRHICommandList : public CRHICommandList
+{
+public:
+	bool Reset(CRHICommandAllocator* Allocator, CRHIPipelineState* InitialState) override;
+
+	bool Close() override;
+
+	void ResourceBarrier(CRHIResource* Resource, ERHIResourceState Before, ERHIResourceState After) override;
+
+	void SetRenderTarget(CRHIResource* RenderTarget) override;
+
+	void ClearRenderTarget(CRHIResource* RenderTarget, const float Color[4]) override;
+
+	void ClearDepth(float Depth) override;
+
+	void SetViewport(const RHIViewport& Viewport) override;
+
+	void SetScissorRect(const RHIRect& Rect) override;
+
+	void SetPipelineState(CRHIPipelineState* PipelineState) override;
+
+	void SetGraphicsRootConstantBufferView(uint32_t RootParameterIndex, uint64_t GPUAddress) override;
+
+	void SetGraphicsRootTexture(uint32_t RootParameterIndex, CRHIResource* Texture) override;
+
+	void SetPrimitiveTopology(ERHIPrimitiveTopology Topology) override;
+
+	void SetVertexBuffers(uint32_t StartSlot, uint32_t NumViews, const RHIVertexBufferView* Views) override;
+
+	void SetIndexBuffer(const RHIIndexBufferView& View) override;
+
+	void DrawIndexedInstanced(uint32_t IndexCountPerInstance, uint32_t InstanceCount, uint32_t StartIndexLocation, int32_t BaseVertexLocation, uint32_t StartInstanceLocation) override;
+
+	void CopyBufferRegion(CRHIResource* Dest, uint64_t DestOffset, CRHIResource* Source, uint64_t SourceOffset, uint64_t NumBytes) override;
+
+	void WriteTimestamp(CRHITimestampQueries* Queries, uint32_t Index) override;
+
+	CNullRHICommandAllocator* Allocator = nullptr;
+
+	// Range of the allocator memory holding this list's commands
+	size_t StreamBegin = 0;
+	size_t StreamEnd = 0;
+
+	bool bRecording = false;
+
+	// Time spent recording since the last execution, merged into the device stats when executed
+	double RecordTimeMs = 0.0;
+
+private:
+	void Push(ENullRHICommand Type, const void* Payload, uint32_t PayloadSize);
+
+	template<typename T>
+	void Push(ENullRHICommand Type, const T& Payload)
+	{
+		Push(Type, &Payload, sizeof(T));
+	}
+
+	std::chrono::high_resolution_clock::time_point RecordStart;
+};
+
+class CNullRHIDevice : public CRHIDevice
+{
+public:
+	ERHIBackend GetBackend() const override
+	{
+		return ERHIBackend::Null;
+	}
+
+	bool Init(const RHIDeviceDesc& Desc) override;
+
+	void Shutdown() override;
+
+	CRHIResource* CreateBuffer(uint64_t Size, ERHIHeapType HeapType, ERHIResourceState InitialState, const wchar_t* Name) override;
+
+	CRHIResource* CreateTextureFromFile(const wchar_t* Filename, CRHICommandList* CommandList) override;
+
+	CRHIPipelineState* CreatePipelineState(const RHIPipelineStateDesc& Desc) override;
+
+	CRHICommandAllocator* CreateCommandAllocator() override;
+
+	CRHICommandList* CreateCommandList(CRHICommandAllocator* Allocator) override;
+
+	CRHIFence* CreateFence(uint64_t InitialValue) override;
+
+	CRHITimestampQueries* CreateTimestampQueries(uint32_t Count) override;
+
+	void ExecuteCommandLists(uint32_t NumCommandLists, CRHICommandList* const* CommandLists) override;
+
+	bool Signal(CRHIFence* Fence, uint64_t Value) override;
+
+	bool Present() override;
+
+	int GetCurrentBackBufferIndex() const override
+	{
+		return BackBufferIndex;
+	}
+
+	CRHIResource* GetBackBuffer(int Index) const override
+	{
+		return BackBuffers[Index];
+	}
+
+	void OnFenceWait()
+	{
+		Stats.FenceWaits++;
+	}
+
+private:
+	// Walks the commands of a closed list as the GPU would
+	void Replay(CNullRHICommandList* CommandList);
+
+	std::vector<CNullRHIResource*> BackBuffers;
+
+	int BackBufferIndex = 0;
+
+	// Triangles the simulated GPU draws per ms, 0 for no GPU time
+	double GPUTrianglesPerMs = 0.0;
+
+	// When the simulated GPU is done with everything submitted so far, on the clock of RHINowMs
+	double GPUBusyUntilMs = 0.0;
+
+	// Fake GPU virtual addresses handed out to buffers, never 0. The recording threads create upload pages
+	std::atomic<uint64_t> NextGPUAddress{ 0x10000 };
+};
@@ -0,0 +1,39 @@
+#include "pch.h"
+#include "RHI.h"
+#include "NullRHI.h"
+#ifdef _WIN32
+#include "D3D12RHI.h"
+#endif
+
+#include <chrono>
+#include <cstring>
+
+double RHINowMs()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+}
+
+CRHIDevice* CRHIDevice::Create(ERHIBackend Backend)
+{
+	switch (Backend)
+	{
+#ifdef _WIN32
+	case ERHIBackend::D3D12:
+		return new CD3D12RHIDevice;
+#endif
+	case ERHIBackend::Null:
+		return new CNullRHIDevice;
+	default:
+		return nullptr;
+	}
+}
+
+void CRHIDevice::UploadBuffer(CRHICommandList* CommandList, CRHIResource* Dest, CRHIResource* UploadBuffer, const void* Data, uint64_t NumBytes)
+{
+	void* MappedData = UploadBuffer->Map();
+	memcpy(MappedData, Data, NumBytes);
+	UploadBuffer->Unmap();
+	TrackUpload(NumBytes);
+
+	CommandList->CopyBufferRegion(Dest, 0, UploadBuffer, 0, NumBytes);
+}
@@ -0,0 +1,317 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// Render Hardware Interface : a thin layer between CRenderer and the graphics API.
+// The D3D12 backend forwards every call to D3D12, the Null backend records the commands in memory
+// so the frame loop can run (and be measured) on a machine without a GPU.
+
+enum class ERHIBackend
+{
+	D3D12,
+	Null
+};
+
+enum class ERHIHeapType
+{
+	Default,	// GPU memory
+	Upload		// CPU writable memory, read by the GPU
+};
+
+enum class ERHIResourceState
+{
+	Common,
+	CopyDest,
+	CopySource,
+	GenericRead,
+	VertexAndConstantBuffer,
+	IndexBuffer,
+	PixelShaderResource,
+	RenderTarget,
+	DepthWrite,
+	Present
+};
+
+enum class ERHIFormat
+{
+	Unknown,
+	R32G32B32A32_Float,
+	R32G32B32_Float,
+	R32G32_Float,
+	R32_UInt,
+	R16G16B16A16_Float,
+	R16G16B16A16_UNorm,
+	R16G16B16A16_SNorm,
+	R16G16_Float,
+	R16G16_UNorm,
+	R16_UInt
+};
+
+enum class ERHIInputClassification
+{
+	PerVertex,
+	PerInstance
+};
+
+enum class ERHIPrimitiveTopology
+{
+	TriangleList
+};
+
+// Describes one attribute of the vertex layout
+struct RHIInputElement
+{
+	const char* SemanticName;
+	uint32_t SemanticIndex;
+	ERHIFormat Format;
+	uint32_t InputSlot;
+	uint32_t AlignedByteOffset;
+	ERHIInputClassification Classification;
+	uint32_t InstanceDataStepRate;
+};
+
+struct RHIPipelineStateDesc
+{
+	const wchar_t* VertexShaderFile = nullptr;
+	const wchar_t* PixelShaderFile = nullptr;
+	const RHIInputElement* InputElements = nullptr;
+	uint32_t NumInputElements = 0;
+};
+
+struct RHIVertexBufferView
+{
+	uint64_t BufferLocation = 0;
+	uint32_t SizeInBytes = 0;
+	uint32_t StrideInBytes = 0;
+};
+
+struct RHIIndexBufferView
+{
+	uint64_t BufferLocation = 0;
+	uint32_t SizeInBytes = 0;
+	ERHIFormat Format = ERHIFormat::R32_UInt;
+};
+
+struct RHIViewport
+{
+	float TopLeftX = 0.0f;
+	float TopLeftY = 0.0f;
+	float Width = 0.0f;
+	float Height = 0.0f;
+	float MinDepth = 0.0f;
+	float MaxDepth = 1.0f;
+};
+
+struct RHIRect
+{
+	int32_t Left = 0;
+	int32_t Top = 0;
+	int32_t Right = 0;
+	int32_t Bottom = 0;
+};
+
+struct RHIDeviceDesc
+{
+	// HWND of the window to present to, unused by the Null backend
+	void* WindowHandle = nullptr;
+	int Width = 1280;
+	int Height = 720;
+	int BackBufferCount = 3;
+	bool bFullScreen = false;
+
+	// Null backend only : triangles its GPU draws per ms, the fences pass once the GPU would be done. 0 finishes the
+	// work as soon as it is submitted
+	double NullGPUTrianglesPerMs = 0.0;
+};
+
+// The clock GPU timestamps are converted to, in ms, the same as std::chrono::high_resolution_clock
+double RHINowMs();
+
+// Counters accumulated by the device, reset with CRHIDevice::ResetStats
+struct RHIStats
+{
+	uint64_t CommandListsExecuted = 0;
+	// Every command replayed, only counted by the Null backend
+	uint64_t CommandsExecuted = 0;
+	uint64_t DrawCalls = 0;
+	uint64_t InstancesDrawn = 0;
+	uint64_t IndicesDrawn = 0;
+	uint64_t PipelineStateChanges = 0;
+	uint64_t DescriptorTableChanges = 0;
+	uint64_t VertexBufferChanges = 0;
+	uint64_t IndexBufferChanges = 0;
+	uint64_t Barriers = 0;
+	// Barriers whose "Before" state didn't match the tracked state of the resource, only tracked by the Null backend
+	uint64_t BarrierStateMismatches = 0;
+	// Bytes written by the CPU into upload heaps
+	uint64_t BytesUploaded = 0;
+	// Bytes copied by the GPU between buffers
+	uint64_t BytesCopied = 0;
+	uint64_t FenceSignals = 0;
+	uint64_t FenceWaits = 0;
+	uint64_t Presents = 0;
+	// CPU time spent between Reset and Close of the command lists
+	double RecordTimeMs = 0.0;
+	// CPU time spent in ExecuteCommandLists
+	double SubmitTimeMs = 0.0;
+};
+
+// Base of every RHI object, released the same way as COM objects so SAFE_RELEASE works on them
+class CRHIObject
+{
+public:
+	virtual void Release() { delete this; }
+
+protected:
+	virtual ~CRHIObject() {}
+};
+
+class CRHIResource : public CRHIObject
+{
+public:
+	virtual uint64_t GetGPUVirtualAddress() const = 0;
+
+	virtual uint64_t GetSize() const = 0;
+
+	// Only valid on upload heaps, the pointer stays valid until Unmap
+	virtual void* Map() = 0;
+
+	virtual void Unmap() = 0;
+};
+
+class CRHIPipelineState : public CRHIObject
+{
+};
+
+class CRHICommandAllocator : public CRHIObject
+{
+public:
+	// Only call once the GPU is done with every command list recorded with this allocator
+	virtual bool Reset() = 0;
+};
+
+class CRHIFence : public CRHIObject
+{
+public:
+	virtual uint64_t GetCompletedValue() const = 0;
+
+	// Blocks until the fence reaches Value
+	virtual bool Wait(uint64_t Value) = 0;
+};
+
+// GPU timestamps written by command lists, converted to the clock of RHINowMs
+class CRHITimestampQueries : public CRHIObject
+{
+public:
+	// Only valid once the GPU is done with the command list that wrote Index
+	virtual double GetTimeMs(uint32_t Index) = 0;
+};
+
+class CRHICommandList : public CRHIObject
+{
+public:
+	virtual bool Reset(CRHICommandAllocator* Allocator, CRHIPipelineState* InitialState) = 0;
+
+	virtual bool Close() = 0;
+
+	virtual void ResourceBarrier(CRHIResource* Resource, ERHIResourceState Before, ERHIResourceState After) = 0;
+
+	// Binds a back buffer and the depth buffer
+	virtual void SetRenderTarget(CRHIResource* RenderTarget) = 0;
+
+	virtual void ClearRenderTarget(CRHIResource* RenderTarget, const float Color[4]) = 0;
+
+	virtual void ClearDepth(float Depth) = 0;
+
+	virtual void SetViewport(const RHIViewport& Viewport) = 0;
+
+	virtual void SetScissorRect(const RHIRect& Rect) = 0;
+
+	virtual void SetPipelineState(CRHIPipelineState* PipelineState) = 0;
+
+	virtual void SetGraphicsRootConstantBufferView(uint32_t RootParameterIndex, uint64_t GPUAddress) = 0;
+
+	// Binds the descriptor table containing the SRV of Texture
+	virtual void SetGraphicsRootTexture(uint32_t RootParameterIndex, CRHIResource* Texture) = 0;
+
+	virtual void SetPrimitiveTopology(ERHIPrimitiveTopology Topology) = 0;
+
+	virtual void SetVertexBuffers(uint32_t StartSlot, uint32_t NumViews, const RHIVertexBufferView* Views) = 0;
+
+	virtual void SetIndexBuffer(const RHIIndexBufferView& View) = 0;
+
+	virtual void DrawIndexedInstanced(uint32_t IndexCountPerInstance, uint32_t InstanceCount, uint32_t StartIndexLocation, int32_t BaseVertexLocation, uint32_t StartInstanceLocation) = 0;
+
+	virtual void CopyBufferRegion(CRHIResource* Dest, uint64_t DestOffset, CRHIResource* Source, uint64_t SourceOffset, uint64_t NumBytes) = 0;
+
+	// Writes the time the GPU reaches this point into Index of Queries
+	virtual void WriteTimestamp(CRHITimestampQueries* Queries, uint32_t Index) = 0;
+};
+
+class CRHIDevice
+{
+public:
+
+	// Returns nullptr if the backend isn't available on this platform
+	static CRHIDevice* Create(ERHIBackend Backend);
+
+	virtual ~CRHIDevice() {}
+
+	virtual ERHIBackend GetBackend() const = 0;
+
+	// Creates the device, the queue, the swap chain and the depth buffer
+	virtual bool Init(const RHIDeviceDesc& Desc) = 0;
+
+	virtual void Shutdown() = 0;
+
+	virtual CRHIResource* CreateBuffer(uint64_t Size, ERHIHeapType HeapType, ERHIResourceState InitialState, const wchar_t* Name) = 0;
+
+	// Loads an image and records its upload into CommandList, the texture ends in the PixelShaderResource state
+	virtual CRHIResource* CreateTextureFromFile(const wchar_t* Filename, CRHICommandList* CommandList) = 0;
+
+	virtual CRHIPipelineState* CreatePipelineState(const RHIPipelineStateDesc& Desc) = 0;
+
+	virtual CRHICommandAllocator* CreateCommandAllocator() = 0;
+
+	// The command list is created open, ready to record
+	virtual CRHICommandList* CreateCommandList(CRHICommandAllocator* Allocator) = 0;
+
+	virtual CRHIFence* CreateFence(uint64_t InitialValue) = 0;
+
+	virtual CRHITimestampQueries* CreateTimestampQueries(uint32_t Count) = 0;
+
+	virtual void ExecuteCommandLists(uint32_t NumCommandLists, CRHICommandList* const* CommandLists) = 0;
+
+	// Sets the fence to Value once the GPU reaches this point of the queue
+	virtual bool Signal(CRHIFence* Fence, uint64_t Value) = 0;
+
+	virtual bool Present() = 0;
+
+	virtual int GetCurrentBackBufferIndex() const = 0;
+
+	virtual CRHIResource* GetBackBuffer(int Index) const = 0;
+
+	// Writes Data into the UploadBuffer then records a copy into Dest
+	void UploadBuffer(CRHICommandList* CommandList, CRHIResource* Dest, CRHIResource* UploadBuffer, const void* Data, uint64_t NumBytes);
+
+	// Account for bytes the CPU wrote directly into a mapped upload heap
+	void TrackUpload(uint64_t NumBytes)
+	{
+		Stats.BytesUploaded += NumBytes;
+	}
+
+	const RHIStats& GetStats() const
+	{
+		return Stats;
+	}
+
+	void ResetStats()
+	{
+		Stats = RHIStats();
+	}
+
+protected:
+
+	RHIStats Stats;
+};
@@ -3,905 +3,1039 @@
 #include "Mesh.h"
 #include "CCube.h"
 #include "Camera.h"
-#include <shlobj.h>
-#include <strsafe.h>
-#include <wincodec.h>
+#include "TransformStore.h"
+#include "UploadAllocator.h"
+#include "GeometryPool.h"
+#include "MeshSimplifier.h"
+#include "MeshImporter.h"
+#include "MeshCache.h"
+#include "StaticBatcher.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cwchar>
+#include <string>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
-#define D3DCOMPILE_DEBUG 1
-
-static std::wstring GetLatestWinPixGpuCapturerPath()
+static void ShowError(const wchar_t* Message)
 {
-	LPWSTR ProgramFilesPath = nullptr;
-	SHGetKnownFolderPath(FOLDERID_ProgramFiles, KF_FLAG_DEFAULT, NULL, &ProgramFilesPath);
-
-	std::wstring PixSearchPath = ProgramFilesPath + std::wstring(L"\\Microsoft PIX\\*");
-
-	WIN32_FIND_DATA FindData;
-	bool bFoundPixInstallation = false;
-	wchar_t NewestVersionFound[MAX_PATH];
-
-	HANDLE hFind = FindFirstFile(PixSearchPath.c_str(), &FindData);
-	if (hFind != INVALID_HANDLE_VALUE)
-	{
-		do
-		{
-			if (((FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == FILE_ATTRIBUTE_DIRECTORY) &&
-				(FindData.cFileName[0] != '.'))
-			{
-				if (!bFoundPixInstallation || wcscmp(NewestVersionFound, FindData.cFileName) <= 0)
-				{
-					bFoundPixInstallation = true;
-					StringCchCopy(NewestVersionFound, _countof(NewestVersionFound), FindData.cFileName);
-				}
-			}
-		} while (FindNextFile(hFind, &FindData) != 0);
-	}
-
-	FindClose(hFind);
+#ifdef _WIN32
+	MessageBox(nullptr, Message, nullptr, 0);
+#else
+	fwprintf(stderr, L"%ls\n", Message);
+#endif
+}
 
-	if (!bFoundPixInstallation)
-	{
-		MessageBox(0, L"Error: no PIX installation found", 0, 0);
-	}
+static double ElapsedMs(std::chrono::high_resolution_clock::time_point Start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - Start).count();
+}
 
-	wchar_t Output[MAX_PATH];
-	StringCchCopy(Output, PixSearchPath.length(), PixSearchPath.data());
-	StringCchCat(Output, MAX_PATH, &NewestVersionFound[0]);
-	StringCchCat(Output, MAX_PATH, L"\\WinPixGpuCapturer.dll");
+// Fewer draws than this per list and the list costs more than the job saves
+static const uint32_t MinDrawsPerList = 1024;
 
-	return &Output[0];
-}
+// Meshes a culling job bounds, culls and picks the LOD of, a multiple of 4 like the culler
+static const uint32_t MeshesPerCullRange = 4096;
 
 CRenderer::CRenderer()
 {
 }
 
-bool CRenderer::InitD3D()
+bool CRenderer::Init()
 {
-	HRESULT Hr;
-
-	// ----- Create the Device by going through the Graphics cards (adapters) and selecting one that has the required feature level -----
-	IDXGIFactory4* Factory;
-	Hr = CreateDXGIFactory1(IID_PPV_ARGS(&Factory));
-	if (FAILED(Hr))
+	Device = CRHIDevice::Create(Backend);
+	if (!Device)
 	{
-		MessageBox(0, L"Couldn't create a factory", 0, 0);
+		ShowError(L"This RHI backend isn't available on this platform");
 		return false;
 	}
 
-	// Check to see if a copy of WinPixGpuCapturer.dll has already been injected into the application.
-	// This may happen if the application is launched through the PIX UI. 
-	if (GetModuleHandle(L"WinPixGpuCapturer.dll") == 0)
+	RHIDeviceDesc DeviceDesc;
+	DeviceDesc.WindowHandle = HWindow;
+	DeviceDesc.Width = WindowWidth;
+	DeviceDesc.Height = WindowHeight;
+	DeviceDesc.BackBufferCount = BackBufferCount;
+	DeviceDesc.bFullScreen = bFullScreen;
+	DeviceDesc.NullGPUTrianglesPerMs = NullGPUTrianglesPerMs;
+	if (!Device->Init(DeviceDesc))
 	{
-		LoadLibrary(GetLatestWinPixGpuCapturerPath().c_str());
+		return false;
 	}
 
-	IDXGIAdapter1* Adapter;
-	int AdapterIndex = 0;
-	bool bAdapterFound = false;
+	FramesInFlight = std::max(1u, FramesInFlight);
+	FrameIndex = 0;
+	BackBufferIndex = Device->GetCurrentBackBufferIndex();
 
-	while (Factory->EnumAdapters1(AdapterIndex, &Adapter) != DXGI_ERROR_NOT_FOUND)
+	// Create the Command Allocators
+	CommandAllocators.assign(FramesInFlight, nullptr);
+	for (uint32_t i = 0; i < FramesInFlight; ++i)
 	{
-		DXGI_ADAPTER_DESC1 AdapterDesc;
-		Adapter->GetDesc1(&AdapterDesc);
-
-		if (AdapterDesc.Flags & DXGI_ADAPTER_FLAG_SOFTWARE)
-		{
-			// This is a software device, not an actual graphics card
-			AdapterIndex++;
-			continue;
-		}
-
-		Hr = D3D12CreateDevice(Adapter, D3D_FEATURE_LEVEL_11_0, _uuidof(ID3D12Device), nullptr);
-		if (SUCCEEDED(Hr))
+		CommandAllocators[i] = Device->CreateCommandAllocator();
+		if (!CommandAllocators[i])
 		{
-			bAdapterFound = true;
-			break;
+			return false;
 		}
-
-		AdapterIndex++;
 	}
 
-	if (!bAdapterFound)
+	// Create the Command list with the first allocator
+	CommandList = Device->CreateCommandList(CommandAllocators[0]);
+	if (!CommandList)
 	{
-		MessageBox(0, L"Didn't find an adapter", 0, 0);
 		return false;
 	}
-	OutputDebugString(L"Found an adapter\n");
 
-	Microsoft::WRL::ComPtr<ID3D12Debug> debugController;
-	if (SUCCEEDED(D3D12GetDebugInterface(IID_PPV_ARGS(&debugController))))
+	// A command list, its allocators and its upload memory per recording thread
+	if (RecordThreadCount == 0)
 	{
-		debugController->EnableDebugLayer();
+		RecordThreadCount = CJobSystem::Get().GetThreadCount();
 	}
+	RecordContexts.resize(RecordThreadCount);
+	for (RenderRecordContext& Context : RecordContexts)
+	{
+		Context.CommandAllocators.assign(FramesInFlight, nullptr);
+		for (uint32_t i = 0; i < FramesInFlight; ++i)
+		{
+			Context.CommandAllocators[i] = Device->CreateCommandAllocator();
+			if (!Context.CommandAllocators[i])
+			{
+				return false;
+			}
+		}
 
-	// Create the Device
-	Hr = D3D12CreateDevice(Adapter, D3D_FEATURE_LEVEL_11_0,	IID_PPV_ARGS(&Device));
-	if (FAILED(Hr))
+		// Lists are created open, every frame starts by resetting them
+		Context.CommandList = Device->CreateCommandList(Context.CommandAllocators[0]);
+		if (!Context.CommandList)
+		{
+			return false;
+		}
+		Context.CommandList->Close();
+
+		// Large instance pages so one draw can hold many instances
+		Context.ConstantAllocator = new CUploadAllocator(Device);
+		Context.InstanceAllocator = new CUploadAllocator(Device, 4 * 1024 * 1024);
+	}
+
+	// Create the Fence
+	Fence = Device->CreateFence(0);
+	if (!Fence)
 	{
-		MessageBox(0, L"Couldn't create the device", 0, 0);
 		return false;
 	}
-	OutputDebugString(L"Device Created\n");
+	FenceValue = 0;
+	FenceValues.assign(FramesInFlight, 0);
 
-	// Create the RTV Command Queue 
-	D3D12_COMMAND_QUEUE_DESC CommandQueueDesc = {};
-	Hr = Device->CreateCommandQueue(&CommandQueueDesc, IID_PPV_ARGS(&CommandQueue));
-	if (FAILED(Hr))
+	FrameTimestamps = Device->CreateTimestampQueries(FramesInFlight * 2);
+	if (!FrameTimestamps)
 	{
-		MessageBox(0, L"Couldn't create the Command Queue", 0, 0);
 		return false;
 	}
-	OutputDebugString(L"Command Queue Created\n");
-
-	// Create the SwapChain
-	DXGI_MODE_DESC BackBufferDesc = {};
-	BackBufferDesc.Width = WindowWidth;
-	BackBufferDesc.Height = WindowHeight;
-	BackBufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-
-	DXGI_SAMPLE_DESC SampleDesc = {};
-	SampleDesc.Count = 1;
+	FrameInputTimes.assign(FramesInFlight, -1.0);
+	LastGPUEndMs = 0.0;
 
-	DXGI_SWAP_CHAIN_DESC SwapChainDesc = {};
-	SwapChainDesc.BufferCount = FrameBufferCount;
-	SwapChainDesc.BufferDesc = BackBufferDesc;
-	SwapChainDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-	SwapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
-	SwapChainDesc.OutputWindow = HWindow;
-	SwapChainDesc.SampleDesc = SampleDesc;
-	SwapChainDesc.Windowed = !bFullScreen;
+	// Create an input layout, generated from the vertex struct
+	static constexpr auto InputLayout = MakeInputLayout<PackedVertex>();
 
-	IDXGISwapChain* TempSwapChain;
-	Factory->CreateSwapChain(CommandQueue, &SwapChainDesc, &TempSwapChain);
-
-	SwapChain = static_cast<IDXGISwapChain3*>(TempSwapChain);
+	// Create a PSO
+	RHIPipelineStateDesc PSODesc;
+	PSODesc.VertexShaderFile = L"Shaders/VertexShader.hlsl";
+	PSODesc.PixelShaderFile = L"Shaders/PixelShader.hlsl";
+	PSODesc.InputElements = InputLayout.data();
+	PSODesc.NumInputElements = uint32_t(InputLayout.size());
+
+	PSO = Device->CreatePipelineState(PSODesc);
+	if (!PSO)
+	{
+		return false;
+	}
 
-	FrameIndex = SwapChain->GetCurrentBackBufferIndex();
-	OutputDebugString(L"Swap Chain Created\n");
+	// Same layout plus the world matrix columns, stepping once per instance on slot 1
+	static constexpr auto InstancedInputLayout = MakeInputLayout<PackedVertex, InstanceData>();
 
-	// Create the Descriptor Heap for the Back Buffers (Render Targets)
-	D3D12_DESCRIPTOR_HEAP_DESC RTVHeapDesc = {};
-	RTVHeapDesc.NumDescriptors = FrameBufferCount;
-	RTVHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
-	RTVHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE; // Not shader visible
+	PSODesc.VertexShaderFile = L"Shaders/InstancedVertexShader.hlsl";
+	PSODesc.InputElements = InstancedInputLayout.data();
+	PSODesc.NumInputElements = uint32_t(InstancedInputLayout.size());
 
-	Hr = Device->CreateDescriptorHeap(&RTVHeapDesc, IID_PPV_ARGS(&RTVDescriptorHeap));
-	if (FAILED(Hr))
+	InstancedPSO = Device->CreatePipelineState(PSODesc);
+	if (!InstancedPSO)
 	{
-		MessageBox(0, L"Couldn't create the RTV Descriptor Heap", 0, 0);
 		return false;
 	}
 
-	RTVDescriptorSize = Device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
-
-	CD3DX12_CPU_DESCRIPTOR_HANDLE RTVHandle(RTVDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
-
-	for (int i = 0; i < FrameBufferCount; ++i)
+	// Load the texture and record its upload, before the meshes since it is part of the material the static batches are grouped by
+	TextureBuffer = Device->CreateTextureFromFile(L"Texture.jpg", CommandList);
+	if (!TextureBuffer)
 	{
-		Hr = SwapChain->GetBuffer(i, IID_PPV_ARGS(&RenderTargets[i]));
-		if (FAILED(Hr))
-		{
-			MessageBox(0, L"Couldn't Get the Buffer", 0, 0);
-			return false;
-		}
-		Device->CreateRenderTargetView(RenderTargets[i], nullptr, RTVHandle);
-		RTVHandle.Offset(1, RTVDescriptorSize);
+		return false;
 	}
-	OutputDebugString(L"RTV Handles Created\n");
 
-	// Create the Command Allocators
-	for (int i = 0; i < FrameBufferCount; ++i)
+	// Create the meshes and the camera for the scene
+	GeometryPool = new CGeometryPool(Device);
+	const int GridSize = int(ceil(cbrt(double(ObjectCount))));
+	const int StaticCount = std::min(StaticObjectCount, ObjectCount - 1);
+	for (int i = 0; i < ObjectCount; ++i)
 	{
-		Hr = Device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&CommandAllocators[i]));
-		if (FAILED(Hr))
+		// Every object draws the buffers of the first one so they can be instanced
+		CMesh* Cube = MeshPath ? new CMesh : new CCube;
+		if (Meshes.empty())
 		{
-			MessageBox(0, L"Couldn't Create the Command Allocator", 0, 0);
-			return false;
+			// A cooked mesh skips the import, the simplification and the packing, the first import cooks one next to the file.
+			// It is cooked again when the file changed since
+			CMeshCache Cache;
+			const std::string CachePath = MeshPath ? std::string(MeshPath) + ".mesh" : std::string();
+			bool bUploaded;
+			if (MeshPath && (Cache.Open(MeshPath) || (Cache.Open(CachePath.c_str()) && Cache.IsUpToDate(MeshPath))))
+			{
+				bUploaded = Cube->InitFromCache(Cache, GeometryPool, CommandList);
+			}
+			else
+			{
+				if (MeshPath && !CMeshImporter::Load(MeshPath, *Cube))
+				{
+					delete Cube;
+					ShowError(L"Couldn't load the mesh");
+					return false;
+				}
+				CMeshSimplifier::GenerateLODs({ Cube });
+				if (MeshPath)
+				{
+					Cache.Close();
+					CMeshCache::Write(CachePath.c_str(), *Cube, MeshPath);
+				}
+				bUploaded = Cube->Init(GeometryPool, CommandList);
+			}
+			if (!bUploaded)
+			{
+				delete Cube;
+				ShowError(L"Couldn't upload the mesh");
+				return false;
+			}
+		}
+		else
+		{
+			Cube->InitShared(Meshes[0]);
 		}
+		if (ObjectCount > 1)
+		{
+			const float Spacing = 2.0f;
+			const float Offset = (GridSize - 1) * Spacing * 0.5f;
+			Cube->SetPosition(DirectX::XMFLOAT3(
+				(i % GridSize) * Spacing - Offset,
+				(i / GridSize % GridSize) * Spacing - Offset,
+				(i / (GridSize * GridSize)) * Spacing - Offset));
+		}
+		if (i >= ObjectCount - StaticCount)
+		{
+			// Turned once so the batches bake more than a translation
+			Cube->SetRotation(DirectX::XMFLOAT3(float(i % 360), float(i * 7 % 360), float(i * 13 % 360)));
+		}
+		Meshes.push_back(Cube);
 	}
-	OutputDebugString(L"Command Allocators Created\n");
 
-	// Create the Command list with the first allocator
-	Hr = Device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, CommandAllocators[0], NULL, IID_PPV_ARGS(&CommandList));
-	if (FAILED(Hr))
+	// The static objects are baked in world space and replaced by the batches, the ones that can't be baked are drawn on
+	// their own after the dynamic meshes but don't move either
+	std::vector<StaticMaterial> BatchMaterials;
+	DynamicMeshCount = uint32_t(Meshes.size() - StaticCount);
+	if (StaticCount > 0)
 	{
-		MessageBox(0, L"Couldn't Create the Command List", 0, 0);
-		return false;
-	}
-	//CommandList->Close();
-	OutputDebugString(L"Command List Created\n");
+		CTransformStore::Get().UpdateWorldMatrices();
+		CStaticBatcher Batcher;
+		StaticMaterial Material;
+		Material.PSO = PSO;
+		Material.Texture = TextureBuffer;
+		std::vector<CMesh*> KeptMeshes(Meshes.begin(), Meshes.end() - StaticCount);
+		std::vector<CMesh*> BakedMeshes;
+		for (auto It = Meshes.end() - StaticCount; It != Meshes.end(); ++It)
+		{
+			if (Batcher.Add(Meshes[0], (*It)->GetWorldMatrix(), Material))
+			{
+				BakedMeshes.push_back(*It);
+			}
+			else
+			{
+				KeptMeshes.push_back(*It);
+			}
+		}
+		for (CMesh* Baked : BakedMeshes)
+		{
+			delete Baked;
+		}
 
-	// Create the Fence and Fence Event
-	for (int i = 0; i < FrameBufferCount; ++i)
-	{
-		Hr = Device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&Fences[i]));
-		if (FAILED(Hr))
+		Meshes = KeptMeshes;
+		FirstBatchMesh = uint32_t(Meshes.size());
+		if (!Batcher.Build(GeometryPool, CommandList, Meshes, BatchMaterials))
 		{
-			MessageBox(0, L"Couldn't Create the Fence", 0, 0);
+			ShowError(L"Couldn't upload the static batches");
 			return false;
 		}
-		FenceValues[i] = 0;
 	}
-
-	FenceEvent = CreateEvent(nullptr, false, false, nullptr);
-	if (!FenceEvent)
+	else
 	{
-		MessageBox(0, L"Couldn't Create the Fence Event", 0, 0);
-		return false;
+		FirstBatchMesh = uint32_t(Meshes.size());
 	}
 
-	OutputDebugString(L"Fences Created\n");
-
-	// Create the Root Signature
-	D3D12_ROOT_DESCRIPTOR RootDescriptor;
-	RootDescriptor.RegisterSpace = 0;
-	RootDescriptor.ShaderRegister = 0;
-
-	// Create the descriptor Range
-	D3D12_DESCRIPTOR_RANGE DescriptorTableRanges[1];
-	DescriptorTableRanges[0].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
-	DescriptorTableRanges[0].NumDescriptors = 1;
-	DescriptorTableRanges[0].BaseShaderRegister = 0;
-	DescriptorTableRanges[0].RegisterSpace = 0;
-	DescriptorTableRanges[0].OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
-
-	// Create the descriptor Table
-	D3D12_ROOT_DESCRIPTOR_TABLE DescriptorTable;
-	DescriptorTable.NumDescriptorRanges = _countof(DescriptorTableRanges);
-	DescriptorTable.pDescriptorRanges = &DescriptorTableRanges[0];
-
-	D3D12_ROOT_PARAMETER RootParameters[2];
-	RootParameters[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
-	RootParameters[0].Descriptor = RootDescriptor;
-	RootParameters[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
-
-	RootParameters[1].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
-	RootParameters[1].DescriptorTable = DescriptorTable;
-	RootParameters[1].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
-
-	// Static Sampler
-	D3D12_STATIC_SAMPLER_DESC Sampler = {
-		D3D12_FILTER_COMPARISON_MIN_MAG_MIP_POINT, D3D12_TEXTURE_ADDRESS_MODE_BORDER, D3D12_TEXTURE_ADDRESS_MODE_BORDER,
-		D3D12_TEXTURE_ADDRESS_MODE_BORDER, 0, 0, D3D12_COMPARISON_FUNC_NEVER,
-		D3D12_STATIC_BORDER_COLOR_TRANSPARENT_BLACK, 0.0f, D3D12_FLOAT32_MAX, 0, 0, D3D12_SHADER_VISIBILITY_PIXEL
-	};
-
-	CD3DX12_ROOT_SIGNATURE_DESC RootSignatureDescriptor;
-	RootSignatureDescriptor.Init(_countof(RootParameters), RootParameters, 1, &Sampler,
-		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT |
-		D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS |
-		D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS |
-		D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS);
-
-	ID3DBlob* Signature = nullptr;
-	Hr = D3D12SerializeRootSignature(&RootSignatureDescriptor, D3D_ROOT_SIGNATURE_VERSION_1, &Signature, nullptr);
-	if (FAILED(Hr))
+	MeshTransforms.resize(Meshes.size());
+	LocalBounds.resize(Meshes.size());
+	WorldBounds.resize(Meshes.size());
+	for (uint32_t i = 0; i < uint32_t(Meshes.size()); ++i)
 	{
-		return false;
+		MeshTransforms[i] = Meshes[i]->GetTransformHandle();
+		LocalBounds[i] = Meshes[i]->GetLocalBounds();
 	}
 
-	Hr = Device->CreateRootSignature(0, Signature->GetBufferPointer(), Signature->GetBufferSize(), IID_PPV_ARGS(&RootSignature));
-	if (FAILED(Hr))
+	// One material per texture, the dynamic meshes use the scene's
+	MaterialTextures.push_back(TextureBuffer);
+	MeshMaterials.assign(Meshes.size(), 0);
+	for (size_t Batch = 0; Batch < BatchMaterials.size(); ++Batch)
 	{
-		return false;
+		auto Found = std::find(MaterialTextures.begin(), MaterialTextures.end(), BatchMaterials[Batch].Texture);
+		if (Found == MaterialTextures.end())
+		{
+			Found = MaterialTextures.insert(Found, BatchMaterials[Batch].Texture);
+		}
+		MeshMaterials[FirstBatchMesh + Batch] = uint32_t(Found - MaterialTextures.begin());
 	}
 
-	// Create the Vertex and Pixel Shader
-	ID3DBlob* VertexShader;
-	ID3DBlob* ErrorBuffer;
-	Hr = D3DCompileFromFile(L"Shaders/VertexShader.hlsl", nullptr, nullptr, "main", "vs_5_0", D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION, 0, &VertexShader, &ErrorBuffer);
-	if (FAILED(Hr))
+	// Meshes drawing the same buffers get the same geometry, their draws end up next to each other and are instanced
+	std::vector<const CMesh*> Geometries;
+	MeshGeometries.resize(Meshes.size());
+	for (uint32_t i = 0; i < uint32_t(Meshes.size()); ++i)
 	{
-		OutputDebugStringA((char*)ErrorBuffer->GetBufferPointer());
-		return false;
+		uint32_t Geometry = 0;
+		while (Geometry < Geometries.size() && !Meshes[i]->SharesGeometryWith(Geometries[Geometry]))
+		{
+			++Geometry;
+		}
+		if (Geometry == Geometries.size())
+		{
+			Geometries.push_back(Meshes[i]);
+		}
+		MeshGeometries[i] = Geometry;
 	}
 
-	D3D12_SHADER_BYTECODE VertexShaderBytecode = {};
-	VertexShaderBytecode.BytecodeLength = VertexShader->GetBufferSize();
-	VertexShaderBytecode.pShaderBytecode = VertexShader->GetBufferPointer();
+	Culler.Resize(uint32_t(Meshes.size()));
+	VisibleMeshes.resize(Culler.GetPaddedCount());
+	VisibleLODs.resize(Culler.GetPaddedCount());
 
-	ID3DBlob* PixelShader;
-	Hr = D3DCompileFromFile(L"Shaders/PixelShader.hlsl", nullptr, nullptr, "main", "ps_5_0", D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION, 0, &PixelShader, &ErrorBuffer);
-	if (FAILED(Hr))
+	// LOD errors relative to the bounding radius, they scale with the mesh
+	LODSelector.Resize(uint32_t(Meshes.size()));
+	for (uint32_t i = 0; i < uint32_t(Meshes.size()); ++i)
 	{
-		OutputDebugStringA((char*)ErrorBuffer->GetBufferPointer());
-		return false;
+		float RelativeErrors[MESH_MAX_LODS - 1];
+		const std::vector<MeshLOD>& LODs = Meshes[i]->LODs;
+		for (size_t Level = 0; Level < LODs.size(); ++Level)
+		{
+			RelativeErrors[Level] = Meshes[i]->BoundsRadius > 0.0f ? LODs[Level].Error / Meshes[i]->BoundsRadius : 0.0f;
+		}
+		LODSelector.SetLODErrors(i, RelativeErrors, uint32_t(LODs.size()));
 	}
 
-	D3D12_SHADER_BYTECODE PixelShaderBytecode = {};
-	PixelShaderBytecode.BytecodeLength = PixelShader->GetBufferSize();
-	PixelShaderBytecode.pShaderBytecode = PixelShader->GetBufferPointer();
+	SceneCamera = new Camera;
 
-	// Create an input layout
-	D3D12_INPUT_ELEMENT_DESC InputLayout[] =
-	{
-		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
-	};
+	// The vertex and index copies end before the first draw
+	GeometryPool->FinishUploads(CommandList);
 
-	D3D12_INPUT_LAYOUT_DESC InputLayoutDesc = {};
-	InputLayoutDesc.NumElements = sizeof(InputLayout) / sizeof(D3D12_INPUT_ELEMENT_DESC);
-	InputLayoutDesc.pInputElementDescs = InputLayout;
+	CommandList->Close();
 
-	// Create a PSO
-	D3D12_GRAPHICS_PIPELINE_STATE_DESC PSODesc = {};
-	PSODesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT); // default depth/stencil state
-	PSODesc.InputLayout = InputLayoutDesc;
-	PSODesc.pRootSignature = RootSignature;
-	PSODesc.VS = VertexShaderBytecode;
-	PSODesc.PS = PixelShaderBytecode;
-	PSODesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
-	PSODesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
-	PSODesc.SampleDesc = SampleDesc;
-	PSODesc.SampleMask = 0xffffffff;
-	PSODesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
-	PSODesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
-	PSODesc.NumRenderTargets = 1;
-
-	Hr = Device->CreateGraphicsPipelineState(&PSODesc, IID_PPV_ARGS(&PSO));
-	if (FAILED(Hr))
+	CRHICommandList* ppCommandLists[] = { CommandList };
+	Device->ExecuteCommandLists(1, ppCommandLists);
+
+	FenceValues[FrameIndex] = ++FenceValue;
+	if (!Device->Signal(Fence, FenceValues[FrameIndex]))
 	{
 		return false;
 	}
 
-	// Create the meshes and the camera for the scene
-	CCube* Cube = new CCube;
-	Mesh = Cube;
-	Mesh->Init(Device, CommandList);
+	// The staging memory of the geometry is released once the copies are done
+	GeometryPool->EndFrame(Fence, FenceValues[FrameIndex]);
 
-	SceneCamera = new Camera;
+	// Fill out the Viewport
+	Viewport.TopLeftX = 0;
+	Viewport.TopLeftY = 0;
+	Viewport.Width = float(WindowWidth);
+	Viewport.Height = float(WindowHeight);
+	Viewport.MinDepth = 0.0f;
+	Viewport.MaxDepth = 1.0f;
 
-	// Depth / Stencil 
+	// Fill out a scissor rect
+	ScissorRect.Left = 0;
+	ScissorRect.Top = 0;
+	ScissorRect.Right = WindowWidth;
+	ScissorRect.Bottom = WindowHeight;
 
-	// Create the Depth/Stencil descriptor heap
-	D3D12_DESCRIPTOR_HEAP_DESC DepthStencilViewHeapDesc = {};
-	DepthStencilViewHeapDesc.NumDescriptors = 1;
-	DepthStencilViewHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
-	DepthStencilViewHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
-	Hr = Device->CreateDescriptorHeap(&DepthStencilViewHeapDesc, IID_PPV_ARGS(&DepthStencilDescriptorHeap));
-	if (FAILED(Hr))
-	{
-		return false;
-	}
+	return true;
+}
 
-	D3D12_DEPTH_STENCIL_VIEW_DESC DepthStencilDesc = {};
-	DepthStencilDesc.Format = DXGI_FORMAT_D32_FLOAT;
-	DepthStencilDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
-	DepthStencilDesc.Flags = D3D12_DSV_FLAG_NONE;
-
-	// the value we want when the depth/stencil is clear
-	D3D12_CLEAR_VALUE DepthClearValue = {};
-	DepthClearValue.Format = DXGI_FORMAT_D32_FLOAT;
-	DepthClearValue.DepthStencil.Depth = 1.0f;
-	DepthClearValue.DepthStencil.Stencil = 0;
-
-	CD3DX12_HEAP_PROPERTIES HeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-	CD3DX12_RESOURCE_DESC Texture = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_D32_FLOAT, WindowWidth, WindowHeight, 1, 0, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL);
-	Device->CreateCommittedResource(
-		&HeapProperties,
-		D3D12_HEAP_FLAG_NONE,
-		&Texture,
-		D3D12_RESOURCE_STATE_DEPTH_WRITE,
-		&DepthClearValue,
-		IID_PPV_ARGS(&DepthStencilBuffer)
-	);
-	Hr = Device->CreateDescriptorHeap(&DepthStencilViewHeapDesc, IID_PPV_ARGS(&DepthStencilDescriptorHeap));
-	if (FAILED(Hr))
+void CRenderer::BeginFrame()
+{
+	// The snapshot of this frame was last drawn SnapshotCount frames ago, the render thread may still be on it. Waited
+	// for before the input is read and the ticks run, what they see is drawn as soon as possible
+	const uint64_t Frame = PublishedFrame + 1;
+	const std::chrono::high_resolution_clock::time_point Start = std::chrono::high_resolution_clock::now();
 	{
-		return false;
+		std::unique_lock<std::mutex> Lock(SnapshotMutex);
+		SnapshotCondition.wait(Lock, [this, Frame]() { return RenderedFrame + SnapshotCount >= Frame; });
 	}
-	DepthStencilDescriptorHeap->SetName(L"Depth/Stencil Resource Heap");
+	const double WaitMs = ElapsedMs(Start);
+	Stats.GameWaitMs += WaitMs;
+	Pacer.AddWait(WaitMs);
 
-	Device->CreateDepthStencilView(DepthStencilBuffer, &DepthStencilDesc, DepthStencilDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
+	FrameStartMs = Pacer.BeginFrame();
+	Stats.PacingDelayMs += Pacer.GetDelayMs();
+	bFrameStarted = true;
+}
 
-	for (int i = 0; i < FRAMEBUFFER_COUNT; i++)
+void CRenderer::Update()
+{
+	if (!bFrameStarted)
 	{
-		CD3DX12_HEAP_PROPERTIES BufferHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-		CD3DX12_RESOURCE_DESC Buffer = CD3DX12_RESOURCE_DESC::Buffer(1024 * 64);
-		Hr = Device->CreateCommittedResource(&BufferHeapProperties, D3D12_HEAP_FLAG_NONE,
-		                                     &Buffer,
-		                                     D3D12_RESOURCE_STATE_GENERIC_READ, nullptr,
-		                                     IID_PPV_ARGS(&ConstantBufferUploadHeaps[i]));
-		ZeroMemory(&ConstantBuffer, sizeof(ConstantBuffer));
-		CD3DX12_RANGE ReadRange(0, 0);
+		BeginFrame();
+	}
+	bFrameStarted = false;
 
-		Hr = ConstantBufferUploadHeaps[i]->Map(0, &ReadRange, reinterpret_cast<void**>(&ConstantBufferGPUAdress[i]));
+	// The first frame runs one tick, the ones after as many as the real time since the last frame covers
+	uint32_t TickCount = TicksPerUpdate;
+	if (TickCount == 0)
+	{
+		UnsimulatedMs += LastFrameStartMs > 0.0 ? FrameStartMs - LastFrameStartMs : TickMs;
+		TickCount = uint32_t(UnsimulatedMs / TickMs);
+		if (TickCount > MaxTicksPerUpdate)
+		{
+			// Too far behind to catch up, the time that doesn't fit is dropped
+			TickCount = MaxTicksPerUpdate;
+			UnsimulatedMs = TickCount * TickMs;
+		}
+		UnsimulatedMs -= TickCount * TickMs;
+	}
+	LastFrameStartMs = FrameStartMs;
 
-		memcpy(ConstantBufferGPUAdress[i], &ConstantBuffer, sizeof(ConstantBuffer));
+	for (uint32_t i = 0; i < TickCount; ++i)
+	{
+		Tick();
 	}
+	Stats.SimulationTicks += TickCount;
+	TickAlpha = TicksPerUpdate > 0 ? 1.0f : float(UnsimulatedMs / TickMs);
 
-#pragma region Texture
+	// Culls the last tick, what is drawn is at most a tick behind it
+	Cull();
 
-	// Load the image from a file
-	D3D12_RESOURCE_DESC TextureDescriptor = {};
-	int ImageBytesPerRow = 0;
-	BYTE* ImageData;
-	int ImageSize = LoadImageDataFromFile(&ImageData, TextureDescriptor, L"Texture.jpg", ImageBytesPerRow);
+	// BeginFrame waited for the snapshot to be free
+	const uint64_t Frame = PublishedFrame + 1;
+	const std::chrono::high_resolution_clock::time_point Start = std::chrono::high_resolution_clock::now();
+	WriteSnapshot(Snapshots[Frame % SnapshotCount]);
+	Stats.SnapshotMs += ElapsedMs(Start);
 
-	if (ImageSize <= 0)
 	{
-        OutputDebugString(L"ImageSize is not valid\n");
-        return false;
+		std::lock_guard<std::mutex> Lock(SnapshotMutex);
+		PublishedFrame = Frame;
 	}
+	SnapshotCondition.notify_all();
+}
 
-	CD3DX12_HEAP_PROPERTIES TextureHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-	Hr = Device->CreateCommittedResource(&TextureHeapProperties, D3D12_HEAP_FLAG_NONE, &TextureDescriptor,
-	                                     D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&TextureBuffer));
-	if (FAILED(Hr))
+void CRenderer::Tick()
+{
+	const float TickSeconds = float(TickMs / 1000.0);
+
+	// Moves by the held keys, not once per key message, the speed doesn't depend on the key repeat or the frame rate
+	if (Input.Forward != 0.0f)
 	{
-		return false;
+		SceneCamera->MoveForward(Input.Forward * TickSeconds);
 	}
-	TextureBuffer->SetName(L"Texture Buffer resource Heap");
-
-	// Upload heap to upload the texture
-	UINT64 TextureUploadBufferSize;
-	Device->GetCopyableFootprints(&TextureDescriptor, 0, 1, 0, nullptr, nullptr, nullptr, &TextureUploadBufferSize);
-
-	CD3DX12_HEAP_PROPERTIES TextureUploadHeapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-	CD3DX12_RESOURCE_DESC TextureUploadHeapResourceDescriptor = CD3DX12_RESOURCE_DESC::Buffer(TextureUploadBufferSize);
-	Hr = Device->CreateCommittedResource(&TextureUploadHeapProperties, D3D12_HEAP_FLAG_NONE,
-	                                     &TextureUploadHeapResourceDescriptor, D3D12_RESOURCE_STATE_GENERIC_READ,
-	                                     nullptr, IID_PPV_ARGS(&TextureBufferUploadHeap));
-	if (FAILED(Hr))
+	if (Input.Right != 0.0f)
 	{
-		return false;
+		SceneCamera->MoveRight(Input.Right * TickSeconds);
+	}
+	if (Input.Up != 0.0f)
+	{
+		SceneCamera->MoveUp(Input.Up * TickSeconds);
 	}
-	TextureBufferUploadHeap->SetName(L"Texture Buffer Upload Resource Heap");
-
-	// Store the texture in an upload heap
-	D3D12_SUBRESOURCE_DATA TextureData = {};
-	TextureData.pData = &ImageData[0];
-	TextureData.RowPitch = ImageBytesPerRow;
-	TextureData.SlicePitch = ImageBytesPerRow * TextureDescriptor.Height;
-
-    UpdateSubresources(CommandList, TextureBuffer, TextureBufferUploadHeap, 0, 0, 1, &TextureData);
-	CD3DX12_RESOURCE_BARRIER Barrier = CD3DX12_RESOURCE_BARRIER::Transition(TextureBuffer, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
-    CommandList->ResourceBarrier(1, &Barrier);
-
-    D3D12_DESCRIPTOR_HEAP_DESC HeapDescriptor = {};
-    HeapDescriptor.NumDescriptors = 1;
-    HeapDescriptor.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-    HeapDescriptor.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-    Hr = Device->CreateDescriptorHeap(&HeapDescriptor, IID_PPV_ARGS(&MainDescriptorHeap));
-    if (FAILED(Hr))
-    {
-        return false;
-    }
-
-    // Create the shader resource view
-	D3D12_SHADER_RESOURCE_VIEW_DESC SrvDesc = {};
-	SrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	SrvDesc.Format = TextureDescriptor.Format;
-	SrvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	SrvDesc.Texture2D.MipLevels = 1;
-	Device->CreateShaderResourceView(TextureBuffer, &SrvDesc, MainDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
-
-#pragma endregion Texture
 
-	CommandList->Close();
+	// Rotate the dynamic meshes, the static objects stay where they were placed and the batches where they were baked
+	const DirectX::XMFLOAT3 Rotation(RotationSpeed.x * TickSeconds, RotationSpeed.y * TickSeconds, RotationSpeed.z * TickSeconds);
+	for (uint32_t i = 0; i < DynamicMeshCount; ++i)
+	{
+		Meshes[i]->AddRotation(Rotation);
+	}
 
-	ID3D12CommandList* ppCommandLists[] = { CommandList };
-	CommandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+	// Recompute the world matrices of everything that moved, the ones before are kept to interpolate from
+	std::chrono::high_resolution_clock::time_point Start = std::chrono::high_resolution_clock::now();
+	CTransformStore::Get().UpdateWorldMatrices();
+	Stats.TransformUpdateMs += ElapsedMs(Start);
+}
 
-	FenceValues[FrameIndex]++;
-	Hr = CommandQueue->Signal(Fences[FrameIndex], FenceValues[FrameIndex]);
-	if (FAILED(Hr))
+void CRenderer::WriteSnapshot(RenderSnapshot& Snapshot)
+{
+	Snapshot.ViewMatrix = SceneCamera->GetInterpolatedViewMatrix(TickAlpha, Snapshot.CameraPosition);
+	Snapshot.ProjectionMatrix = SceneCamera->ProjectionMatrix;
+	Snapshot.InputTimeMs = FrameStartMs;
+
+	Snapshot.MeshIndices.resize(VisibleMeshCount);
+	Snapshot.LODs.resize(VisibleMeshCount);
+	Snapshot.WorldMatrices.resize(VisibleMeshCount);
+	Snapshot.Depths.resize(VisibleMeshCount);
+
+	// Only the visible meshes are copied, the transform store keeps moving under the render thread. Those that moved
+	// during the last tick are drawn between where they were and where they are
+	const XMVECTOR CameraPosition = XMLoadFloat3(&Snapshot.CameraPosition);
+	CJobSystem::Get().ParallelFor(VisibleMeshCount, MeshesPerCullRange, [&](size_t Begin, size_t End)
 	{
-		return false;
-	}
+		const CTransformStore& Store = CTransformStore::Get();
+		for (size_t i = Begin; i < End; ++i)
+		{
+			const uint32_t MeshIndex = VisibleMeshes[i];
+			Snapshot.MeshIndices[i] = MeshIndex;
+			Snapshot.LODs[i] = VisibleLODs[i];
+			Snapshot.WorldMatrices[i] = Store.GetInterpolatedWorldMatrix(MeshTransforms[MeshIndex], TickAlpha);
+			Snapshot.Depths[i] = XMVectorGetX(XMVector3Length(XMLoadFloat3(&WorldBounds[MeshIndex].Center) - CameraPosition));
+		}
+	});
+}
 
-	// We can delete the image data now that we are done using it
-	delete ImageData;
+void CRenderer::Cull()
+{
+	std::chrono::high_resolution_clock::time_point Start = std::chrono::high_resolution_clock::now();
+
+	// Read before the jobs, the camera rebuilds them on demand
+	const XMFLOAT4* FrustumPlanes = SceneCamera->GetFrustumPlanes();
+	const XMFLOAT3 CameraPosition = SceneCamera->GetPosition();
+	const float ProjectionScale = CLODSelector::GetProjectionScale(SceneCamera->ProjectionMatrix, Viewport.Height);
+
+	// Each range is bounded, culled and has its LODs picked by a job, its visible meshes packed at its start
+	const uint32_t MeshCount = uint32_t(Meshes.size());
+	const uint32_t PaddedCount = Culler.GetPaddedCount();
+	CullRanges.resize((PaddedCount + MeshesPerCullRange - 1) / MeshesPerCullRange);
+	CJobSystem::Get().ParallelFor(CullRanges.size(), 1, [&](size_t BeginRange, size_t EndRange)
+	{
+		for (size_t Range = BeginRange; Range < EndRange; ++Range)
+		{
+			const uint32_t First = uint32_t(Range) * MeshesPerCullRange;
+			const uint32_t Last = std::min(First + MeshesPerCullRange, PaddedCount);
+			const uint32_t LastMesh = std::min(Last, MeshCount);
+			CullRange& Result = CullRanges[Range];
+
+			// World bounds of the range in one pass over the transform store
+			CTransformStore::Get().TransformBounds(&MeshTransforms[First], &LocalBounds[First], LastMesh - First, &WorldBounds[First]);
+			for (uint32_t i = First; i < LastMesh; ++i)
+			{
+				Culler.SetSphere(i, WorldBounds[i].Center, WorldBounds[i].Radius);
+			}
 
-	Mesh->VertexBufferView.BufferLocation = Mesh->VertexBuffer->GetGPUVirtualAddress();
-	Mesh->VertexBufferView.StrideInBytes = sizeof(Vertex);
-	Mesh->VertexBufferView.SizeInBytes = Mesh->GetVertexBufferSize();
+			uint32_t* Visible = &VisibleMeshes[First];
+			Result.InFrustumCount = Culler.Cull(FrustumPlanes, First, Last, Visible);
 
-	Mesh->IndexBufferView.BufferLocation = Mesh->IndexBuffer->GetGPUVirtualAddress();
-	Mesh->IndexBufferView.Format = DXGI_FORMAT_R32_UINT;
-	Mesh->IndexBufferView.SizeInBytes = Mesh->GetIndexBufferSize();
+			// Triangles of the full meshes, what the LODs save is measured against them
+			Result.FullTriangles = 0;
+			for (uint32_t i = 0; i < Result.InFrustumCount; ++i)
+			{
+				Result.FullTriangles += Meshes[Visible[i]]->IndexCount / 3;
+			}
 
-	// Fill out the Viewport
-	Viewport.TopLeftX = 0;
-	Viewport.TopLeftY = 0;
-	Viewport.Width = WindowWidth;
-	Viewport.Height = WindowHeight;
-	Viewport.MinDepth = 0.0f;
-	Viewport.MaxDepth = 1.0f;
+			Result.VisibleCount = LODSelector.Select(Culler, CameraPosition, ProjectionScale, Visible, Result.InFrustumCount,
+				Visible, &VisibleLODs[First]);
 
-	// Fill out a scissor rect
-	ScissorRect.left = 0;
-	ScissorRect.top = 0;
-	ScissorRect.right = WindowWidth;
-	ScissorRect.bottom = WindowHeight;
+			Result.SelectedTriangles = 0;
+			for (uint32_t i = 0; i < Result.VisibleCount; ++i)
+			{
+				Result.SelectedTriangles += Meshes[Visible[i]]->GetIndexCount(VisibleLODs[First + i]) / 3;
+			}
+		}
+	});
+
+	// Ranges packed one after the other, the visible meshes stay in index order
+	uint32_t InFrustumCount = 0;
+	uint64_t FullTriangles = 0;
+	uint64_t SelectedTriangles = 0;
+	VisibleMeshCount = 0;
+	for (size_t Range = 0; Range < CullRanges.size(); ++Range)
+	{
+		const CullRange& Result = CullRanges[Range];
+		const uint32_t First = uint32_t(Range) * MeshesPerCullRange;
+		memmove(&VisibleMeshes[VisibleMeshCount], &VisibleMeshes[First], Result.VisibleCount * sizeof(uint32_t));
+		memmove(&VisibleLODs[VisibleMeshCount], &VisibleLODs[First], Result.VisibleCount * sizeof(uint8_t));
+		VisibleMeshCount += Result.VisibleCount;
+		InFrustumCount += Result.InFrustumCount;
+		FullTriangles += Result.FullTriangles;
+		SelectedTriangles += Result.SelectedTriangles;
+	}
 
-	return true;
+	Stats.CullingMs += ElapsedMs(Start);
+	Stats.ObjectsTested += Meshes.size();
+	Stats.ObjectsVisible += VisibleMeshCount;
+	Stats.ObjectsDropped += InFrustumCount - VisibleMeshCount;
+	Stats.TrianglesSelected += SelectedTriangles;
+	Stats.TrianglesSaved += FullTriangles - SelectedTriangles;
 }
 
-void CRenderer::Update()
+void CRenderer::SortDraws(const RenderSnapshot& Snapshot)
 {
-	// Rotate the mesh
-	DirectX::XMFLOAT3 Rotation = Mesh->GetRotation();
-	Rotation.y += 0.01f;
-	Rotation.x += 0.001f;
-	Mesh->SetRotation(Rotation);
-
-	// update constant buffer
-	DirectX::XMMATRIX ViewMatrix = DirectX::XMLoadFloat4x4(&SceneCamera->ViewMatrix);
-	DirectX::XMMATRIX ProjMatrix = DirectX::XMLoadFloat4x4(&SceneCamera->ProjectionMatrix);
-	XMFLOAT4X4 WorldMat = Mesh->GetWorldMatrix();
-	DirectX::XMMATRIX WVPMatrix = DirectX::XMLoadFloat4x4(&WorldMat) * ViewMatrix * ProjMatrix;
-	DirectX::XMMATRIX Transposed = DirectX::XMMatrixTranspose(WVPMatrix);
-	DirectX::XMStoreFloat4x4(&ConstantBuffer.WorldViewProj, Transposed);
-
-	memcpy(ConstantBufferGPUAdress[FrameIndex], &ConstantBuffer, sizeof(ConstantBuffer));
+	std::chrono::high_resolution_clock::time_point Start = std::chrono::high_resolution_clock::now();
+
+	const uint32_t DrawCount = uint32_t(Snapshot.MeshIndices.size());
+	DrawList.Reset(DrawCount);
+	for (uint32_t i = 0; i < DrawCount; ++i)
+	{
+		const uint32_t MeshIndex = Snapshot.MeshIndices[i];
+		DrawList.Add(CDrawList::MakeKey(ERenderPass::Opaque, MeshMaterials[MeshIndex], MeshGeometries[MeshIndex], Snapshot.LODs[i], Snapshot.Depths[i]), i);
+	}
+	DrawList.Sort();
 
+	Stats.SortingMs += ElapsedMs(Start);
 }
 
-void CRenderer::UpdatePipeline()
+bool CRenderer::ContinuesRun(const RenderSnapshot& Snapshot, uint32_t Index) const
+{
+	const uint32_t MeshIndex = Snapshot.MeshIndices[DrawList.GetValue(Index)];
+	const uint32_t PreviousMeshIndex = Snapshot.MeshIndices[DrawList.GetValue(Index - 1)];
+	return bInstancing && CDrawList::GetLOD(DrawList.GetKey(Index)) == CDrawList::GetLOD(DrawList.GetKey(Index - 1))
+		&& MeshMaterials[MeshIndex] == MeshMaterials[PreviousMeshIndex] && Meshes[MeshIndex]->SharesGeometryWith(Meshes[PreviousMeshIndex]);
+}
+
+void CRenderer::UpdatePipeline(const RenderSnapshot& Snapshot)
 {
 	WaitForPreviousFrame();
-	HRESULT Hr = CommandAllocators[FrameIndex]->Reset();
-	if (FAILED(Hr))
+
+	std::chrono::high_resolution_clock::time_point Start = std::chrono::high_resolution_clock::now();
+
+	if (!CommandAllocators[FrameIndex]->Reset())
 	{
-		MessageBox(nullptr, L"Couldn't Reset the Allocator", nullptr, 0);
+		ShowError(L"Couldn't Reset the Allocator");
 		bRunning = false;
 	}
 
-	Hr = CommandList->Reset(CommandAllocators[FrameIndex], PSO);
-	if (FAILED(Hr))
+	if (!CommandList->Reset(CommandAllocators[FrameIndex], PSO))
 	{
-		MessageBox(nullptr, L"Couldn't Reset the Command List", nullptr, 0);
+		ShowError(L"Couldn't Reset the Command List");
 		bRunning = false;
 	}
 
-	// Start recording commands here
+	// Constant buffers and instance data of the frames the GPU finished can be reused
+	for (RenderRecordContext& Context : RecordContexts)
+	{
+		Context.ConstantAllocator->BeginFrame();
+		Context.InstanceAllocator->BeginFrame();
+	}
+	GeometryPool->BeginFrame();
 
-	// We create a resource Barrier to transition from present to render target state and we get a handle to the current RTV
-	CD3DX12_RESOURCE_BARRIER Barrier = CD3DX12_RESOURCE_BARRIER::Transition(RenderTargets[FrameIndex], D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
-	CommandList->ResourceBarrier(1, &Barrier);
+	// Start recording commands here
+	CommandList->WriteTimestamp(FrameTimestamps, FrameIndex * 2);
 
-	const CD3DX12_CPU_DESCRIPTOR_HANDLE RTVHandle(RTVDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), FrameIndex, RTVDescriptorSize);
-	const CD3DX12_CPU_DESCRIPTOR_HANDLE DepthStencilHandle(DepthStencilDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
+	// We create a resource Barrier to transition from present to render target state and we get the current back buffer
+	CRHIResource* RenderTarget = Device->GetBackBuffer(BackBufferIndex);
+	CommandList->ResourceBarrier(RenderTarget, ERHIResourceState::Present, ERHIResourceState::RenderTarget);
 
-	CommandList->OMSetRenderTargets(1, &RTVHandle, false, &DepthStencilHandle);
+	CommandList->SetRenderTarget(RenderTarget);
 
 	// Clear the render target to the desired color
 	const float ClearColor[] = { 0.0f, 0.2f, 0.4f, 1.0f };
-	CommandList->ClearRenderTargetView(RTVHandle, ClearColor, 0, nullptr);
+	CommandList->ClearRenderTarget(RenderTarget, ClearColor);
 
 	// Clear the depth buffer
-	CommandList->ClearDepthStencilView(DepthStencilDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
+	CommandList->ClearDepth(1.0f);
 
-	// Set the root signature
-	CommandList->SetGraphicsRootSignature(RootSignature);
+	if (!CommandList->Close())
+	{
+		ShowError(L"Couldn't close the Command List");
+		bRunning = false;
+	}
 
-	// Set the descriptor heap
-	ID3D12DescriptorHeap* DescriptorHeaps[] = { MainDescriptorHeap };
-	CommandList->SetDescriptorHeaps(_countof(DescriptorHeaps), DescriptorHeaps);
+	DirectX::XMMATRIX ViewMatrix = DirectX::XMLoadFloat4x4(&Snapshot.ViewMatrix);
+	DirectX::XMMATRIX ProjMatrix = DirectX::XMLoadFloat4x4(&Snapshot.ProjectionMatrix);
+	DirectX::XMFLOAT4X4 ViewProj;
+	DirectX::XMStoreFloat4x4(&ViewProj, ViewMatrix * ProjMatrix);
+
+	// Contiguous ranges of the sorted draws, one per list, moved forward so an instanced draw is never cut in two
+	const uint32_t DrawCount = DrawList.GetCount();
+	const uint32_t ListCount = std::max(1u, std::min(uint32_t(RecordContexts.size()), DrawCount / MinDrawsPerList));
+	std::vector<uint32_t> ListStarts(ListCount + 1, DrawCount);
+	ListStarts[0] = 0;
+	for (uint32_t List = 1; List < ListCount; ++List)
+	{
+		uint32_t ListStart = std::max(ListStarts[List - 1], uint32_t(uint64_t(DrawCount) * List / ListCount));
+		while (ListStart > 0 && ListStart < DrawCount && ContinuesRun(Snapshot, ListStart))
+		{
+			++ListStart;
+		}
+		ListStarts[List] = ListStart;
+	}
 
-	// Set the graphics root descriptor table
-	CommandList->SetGraphicsRootDescriptorTable(1, MainDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
+	// A job per list, this thread records the first one
+	CJobCounter Recorded;
+	for (uint32_t List = 1; List < ListCount; ++List)
+	{
+		CJobSystem::Get().Run([this, &Snapshot, List, ListCount, &ListStarts, &ViewProj]()
+		{
+			RecordDraws(RecordContexts[List], Snapshot, ListStarts[List], ListStarts[List + 1], ViewProj, List == ListCount - 1);
+		}, &Recorded);
+	}
+	RecordDraws(RecordContexts[0], Snapshot, ListStarts[0], ListStarts[1], ViewProj, ListCount == 1);
+	CJobSystem::Get().Wait(Recorded);
 
-	CommandList->RSSetViewports(1, &Viewport);
-	CommandList->RSSetScissorRects(1, &ScissorRect);
+	FrameCommandLists.assign(1, CommandList);
+	for (uint32_t List = 0; List < ListCount; ++List)
+	{
+		RenderRecordContext& Context = RecordContexts[List];
+		if (Context.bFailed)
+		{
+			ShowError(L"Couldn't record the draws");
+			bRunning = false;
+		}
+		Device->TrackUpload(Context.BytesUploaded);
+		FrameCommandLists.push_back(Context.CommandList);
+	}
 
-	CommandList->SetGraphicsRootConstantBufferView(0, ConstantBufferUploadHeaps[FrameIndex]->GetGPUVirtualAddress());
+	Stats.RecordingMs += ElapsedMs(Start);
+}
+
+void CRenderer::RecordDraws(RenderRecordContext& Context, const RenderSnapshot& Snapshot, uint32_t Begin, uint32_t End,
+	const DirectX::XMFLOAT4X4& ViewProj, bool bLastList)
+{
+	Context.BytesUploaded = 0;
+	Context.bFailed = false;
+
+	CRHICommandList* DrawCommandList = Context.CommandList;
+	if (!Context.CommandAllocators[FrameIndex]->Reset() || !DrawCommandList->Reset(Context.CommandAllocators[FrameIndex], PSO))
+	{
+		Context.bFailed = true;
+		return;
+	}
+
+	// Nothing carries over from one command list to the next
+	CRHIResource* RenderTarget = Device->GetBackBuffer(BackBufferIndex);
+	DrawCommandList->SetRenderTarget(RenderTarget);
+	DrawCommandList->SetViewport(Viewport);
+	DrawCommandList->SetScissorRect(ScissorRect);
+	DrawCommandList->SetPrimitiveTopology(ERHIPrimitiveTopology::TriangleList);
+
+	const DirectX::XMMATRIX ViewProjMatrix = DirectX::XMLoadFloat4x4(&ViewProj);
+
+	// Constants of the instanced draws, only the dequantization changes from one draw to the other
+	ConstantBufferInstanced InstancedConstants;
+	DirectX::XMStoreFloat4x4(&InstancedConstants.ViewProj, DirectX::XMMatrixTranspose(ViewProjMatrix));
+
+	ConstantBufferPerObject ConstantBuffer;
 
-	Mesh->Draw(CommandList);
+	// Largest instanced draw whose instance data fits in an allocator page
+	const uint32_t MaxInstancesPerDraw = uint32_t(Context.InstanceAllocator->GetPageSize() / sizeof(InstanceData));
 
-	// Transition back to present
-	Barrier = CD3DX12_RESOURCE_BARRIER::Transition(RenderTargets[FrameIndex], D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
-	CommandList->ResourceBarrier(1, &Barrier);
+	// What the command list has bound, the draws are sorted by state so most of it carries over from one draw to the next
+	CRHIPipelineState* CurrentPSO = PSO;
+	uint32_t CurrentMaterial = UINT32_MAX;
+	RHIVertexBufferView CurrentVertexBuffer = {};
+	RHIIndexBufferView CurrentIndexBuffer = {};
 
-	Hr = CommandList->Close();
-	if (FAILED(Hr))
+	// Sorted draws with the same key state drawing the same buffers are drawn with a single instanced draw
+	uint32_t i = Begin;
+	while (i < End)
 	{
-		MessageBox(nullptr, L"Couldn't close the Command List", 0, 0);
-		bRunning = false;
+		const uint32_t Draw = DrawList.GetValue(i);
+		const uint32_t MeshIndex = Snapshot.MeshIndices[Draw];
+		CMesh* Mesh = Meshes[MeshIndex];
+		const uint32_t LOD = CDrawList::GetLOD(DrawList.GetKey(i));
+		const uint32_t Material = MeshMaterials[MeshIndex];
+
+		uint32_t RunEnd = i + 1;
+		while (RunEnd < End && RunEnd - i < MaxInstancesPerDraw && ContinuesRun(Snapshot, RunEnd))
+		{
+			++RunEnd;
+		}
+		const uint32_t InstanceCount = RunEnd - i;
+
+		if (Material != CurrentMaterial)
+		{
+			DrawCommandList->SetGraphicsRootTexture(1, MaterialTextures[Material]);
+			CurrentMaterial = Material;
+		}
+
+		const RHIVertexBufferView VertexBuffer = Mesh->GetVertexBufferView();
+		if (VertexBuffer.BufferLocation != CurrentVertexBuffer.BufferLocation || VertexBuffer.SizeInBytes != CurrentVertexBuffer.SizeInBytes)
+		{
+			DrawCommandList->SetVertexBuffers(0, 1, &VertexBuffer);
+			CurrentVertexBuffer = VertexBuffer;
+		}
+		const RHIIndexBufferView IndexBuffer = Mesh->GetIndexBufferView(LOD);
+		if (IndexBuffer.BufferLocation != CurrentIndexBuffer.BufferLocation || IndexBuffer.SizeInBytes != CurrentIndexBuffer.SizeInBytes
+			|| IndexBuffer.Format != CurrentIndexBuffer.Format)
+		{
+			DrawCommandList->SetIndexBuffer(IndexBuffer);
+			CurrentIndexBuffer = IndexBuffer;
+		}
+
+		if (InstanceCount == 1)
+		{
+			// Alone, a constant buffer is cheaper than an instance buffer
+			const XMFLOAT4X4& WorldMat = Snapshot.WorldMatrices[Draw];
+			DirectX::XMMATRIX WVPMatrix = Mesh->GetDequantizationMatrix() * DirectX::XMLoadFloat4x4(&WorldMat) * ViewProjMatrix;
+			DirectX::XMMATRIX Transposed = DirectX::XMMatrixTranspose(WVPMatrix);
+			DirectX::XMStoreFloat4x4(&ConstantBuffer.WorldViewProj, Transposed);
+			DirectX::XMStoreFloat4x4(&ConstantBuffer.World, DirectX::XMMatrixTranspose(DirectX::XMLoadFloat4x4(&WorldMat)));
+
+			// The inverse transpose, transposed for the shader
+			DirectX::XMStoreFloat4x4(&ConstantBuffer.NormalMatrix, DirectX::XMMatrixInverse(nullptr, DirectX::XMLoadFloat4x4(&WorldMat)));
+
+			RHIUploadAllocation Constants = Context.ConstantAllocator->Allocate(sizeof(ConstantBuffer));
+			if (!Constants.CPUAddress)
+			{
+				Context.bFailed = true;
+				break;
+			}
+
+			memcpy(Constants.CPUAddress, &ConstantBuffer, sizeof(ConstantBuffer));
+			Context.BytesUploaded += sizeof(ConstantBuffer);
+
+			if (CurrentPSO != PSO)
+			{
+				DrawCommandList->SetPipelineState(PSO);
+				CurrentPSO = PSO;
+			}
+			DrawCommandList->SetGraphicsRootConstantBufferView(0, Constants.GPUAddress);
+			Mesh->Draw(DrawCommandList, 1, LOD);
+		}
+		else
+		{
+			RHIUploadAllocation Constants = Context.ConstantAllocator->Allocate(sizeof(InstancedConstants));
+			RHIUploadAllocation Instances = Context.InstanceAllocator->Allocate(InstanceCount * sizeof(InstanceData), 16);
+			if (!Constants.CPUAddress || !Instances.CPUAddress)
+			{
+				Context.bFailed = true;
+				break;
+			}
+
+			// Written in order straight into the upload page, it is write combined memory
+			InstanceData* Instance = reinterpret_cast<InstanceData*>(Instances.CPUAddress);
+			for (uint32_t Index = i; Index < RunEnd; ++Index, ++Instance)
+			{
+				WriteInstanceData(Snapshot.WorldMatrices[DrawList.GetValue(Index)], *Instance);
+			}
+			Context.BytesUploaded += InstanceCount * sizeof(InstanceData);
+
+			InstancedConstants.DequantizationScale = XMFLOAT4(Mesh->QuantizationScale.x, Mesh->QuantizationScale.y, Mesh->QuantizationScale.z, 0.0f);
+			InstancedConstants.DequantizationOffset = XMFLOAT4(Mesh->QuantizationOffset.x, Mesh->QuantizationOffset.y, Mesh->QuantizationOffset.z, 0.0f);
+			memcpy(Constants.CPUAddress, &InstancedConstants, sizeof(InstancedConstants));
+			Context.BytesUploaded += sizeof(InstancedConstants);
+
+			// The instance data is new for every instanced draw, slot 0 stays bound
+			RHIVertexBufferView InstanceBufferView;
+			InstanceBufferView.BufferLocation = Instances.GPUAddress;
+			InstanceBufferView.SizeInBytes = InstanceCount * sizeof(InstanceData);
+			InstanceBufferView.StrideInBytes = sizeof(InstanceData);
+			DrawCommandList->SetVertexBuffers(1, 1, &InstanceBufferView);
+
+			if (CurrentPSO != InstancedPSO)
+			{
+				DrawCommandList->SetPipelineState(InstancedPSO);
+				CurrentPSO = InstancedPSO;
+			}
+			DrawCommandList->SetGraphicsRootConstantBufferView(0, Constants.GPUAddress);
+			Mesh->Draw(DrawCommandList, InstanceCount, LOD);
+		}
+
+		i = RunEnd;
+	}
+
+	// Transition back to present once every draw is done
+	if (bLastList)
+	{
+		DrawCommandList->WriteTimestamp(FrameTimestamps, FrameIndex * 2 + 1);
+		DrawCommandList->ResourceBarrier(RenderTarget, ERHIResourceState::RenderTarget, ERHIResourceState::Present);
+	}
+
+	if (!DrawCommandList->Close())
+	{
+		Context.bFailed = true;
 	}
 }
 
 void CRenderer::Render() 
 {
-	UpdatePipeline();
+	uint64_t Frame;
+	{
+		std::lock_guard<std::mutex> Lock(SnapshotMutex);
+		if (RenderedFrame == PublishedFrame)
+		{
+			return;
+		}
+		Frame = RenderedFrame + 1;
+	}
+	const RenderSnapshot& Snapshot = Snapshots[Frame % SnapshotCount];
 
-	ID3D12CommandList* ppCommandLists[] = { CommandList };
-	CommandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+	// What the frame costs this thread, the wait for the GPU aside, one of the stages the pacer keeps up with
+	std::chrono::high_resolution_clock::time_point Start = std::chrono::high_resolution_clock::now();
+	const double WaitedBefore = Stats.CPUWaitForGPUMs;
 
-	HRESULT Hr = CommandQueue->Signal(Fences[FrameIndex], FenceValues[FrameIndex]);
-	if (FAILED(Hr))
+	SortDraws(Snapshot);
+
+	UpdatePipeline(Snapshot);
+
+	// A single submission, the draws of every list land after the clears in the order they were sorted
+	Device->ExecuteCommandLists(uint32_t(FrameCommandLists.size()), FrameCommandLists.data());
+
+	if (!Device->Signal(Fence, FenceValues[FrameIndex]))
 	{
 		bRunning = false;
 	}
+	FrameInputTimes[FrameIndex] = Snapshot.InputTimeMs;
 
-	Hr = SwapChain->Present(0, 0);
-	if (FAILED(Hr))
+	// This frame's constant buffers and instance data are in use until the fence gets the value
+	for (RenderRecordContext& Context : RecordContexts)
+	{
+		Context.ConstantAllocator->EndFrame(Fence, FenceValues[FrameIndex]);
+		Context.InstanceAllocator->EndFrame(Fence, FenceValues[FrameIndex]);
+	}
+	GeometryPool->EndFrame(Fence, FenceValues[FrameIndex]);
+
+	if (!Device->Present())
 	{
 		bRunning = false;
 	}
+	Pacer.AddRenderFrame(ElapsedMs(Start) - (Stats.CPUWaitForGPUMs - WaitedBefore));
+
+	// The game thread may write the snapshot again
+	{
+		std::lock_guard<std::mutex> Lock(SnapshotMutex);
+		RenderedFrame = Frame;
+	}
+	SnapshotCondition.notify_all();
 }
 
-void CRenderer::Cleanup()
+void CRenderer::StartRenderThread()
 {
-	// Wait for everybody to finish
-	for (int i = 0;  i < FrameBufferCount;  ++i)
+	if (RenderThread.joinable())
 	{
-		FrameIndex = i;
-		WaitForPreviousFrame();
+		return;
 	}
+	bRenderThreadRunning = true;
+	RenderThread = std::thread(&CRenderer::RenderThreadLoop, this);
+}
 
-	// Get SwapChain out of fullscreen before exiting
-	BOOL bFS = false;
-	if (SwapChain->GetFullscreenState(&bFS, nullptr))
+void CRenderer::StopRenderThread()
+{
+	if (!RenderThread.joinable())
 	{
-		SwapChain->SetFullscreenState(false, nullptr);
+		return;
 	}
-
-	SAFE_RELEASE(Device);
-	SAFE_RELEASE(SwapChain);
-	SAFE_RELEASE(CommandQueue);
-	SAFE_RELEASE(RTVDescriptorHeap);
-	SAFE_RELEASE(CommandList);
-	SAFE_RELEASE(PSO);
-	SAFE_RELEASE(RootSignature);
-	SAFE_RELEASE(DepthStencilBuffer);
-	SAFE_RELEASE(DepthStencilDescriptorHeap);
-
-	for (int i = 0; i < FrameBufferCount; ++i)
 	{
-		SAFE_RELEASE(RenderTargets[i]);
-		SAFE_RELEASE(CommandAllocators[i]);
-		SAFE_RELEASE(Fences[i]);
-		SAFE_RELEASE(ConstantBufferUploadHeaps[i]);
+		std::lock_guard<std::mutex> Lock(SnapshotMutex);
+		bRenderThreadRunning = false;
 	}
+	SnapshotCondition.notify_all();
+	RenderThread.join();
+}
 
-	delete Mesh;
-	delete SceneCamera;
+void CRenderer::RenderThreadLoop()
+{
+	for (;;)
+	{
+		// Keeps drawing after a failure, the game thread would wait for its snapshots forever otherwise
+		std::chrono::high_resolution_clock::time_point Start = std::chrono::high_resolution_clock::now();
+		{
+			std::unique_lock<std::mutex> Lock(SnapshotMutex);
+			SnapshotCondition.wait(Lock, [this]() { return PublishedFrame > RenderedFrame || !bRenderThreadRunning; });
+			if (PublishedFrame == RenderedFrame)
+			{
+				return;
+			}
+		}
+		Stats.RenderWaitMs += ElapsedMs(Start);
+
+		Render();
+	}
 }
 
-void CRenderer::WaitForPreviousFrame()
+void CRenderer::Cleanup()
 {
-	HRESULT Hr;
+	if (!Device)
+	{
+		return;
+	}
+
+	StopRenderThread();
 
-	FrameIndex = SwapChain->GetCurrentBackBufferIndex();
-	
-	if (Fences[FrameIndex]->GetCompletedValue() < FenceValues[FrameIndex])
+	// Wait for everybody to finish
+	if (Fence)
 	{
-		Hr = Fences[FrameIndex]->SetEventOnCompletion(FenceValues[FrameIndex], FenceEvent);
-		if (FAILED(Hr))
+		Fence->Wait(FenceValue);
+	}
+
+	SAFE_RELEASE(CommandList);
+	SAFE_RELEASE(PSO);
+	SAFE_RELEASE(InstancedPSO);
+	SAFE_RELEASE(TextureBuffer);
+
+	for (RenderRecordContext& Context : RecordContexts)
+	{
+		SAFE_RELEASE(Context.CommandList);
+		for (CRHICommandAllocator*& Allocator : Context.CommandAllocators)
 		{
-			bRunning = false;
+			SAFE_RELEASE(Allocator);
 		}
+		delete Context.ConstantAllocator;
+		delete Context.InstanceAllocator;
+	}
+	RecordContexts.clear();
 
-		WaitForSingleObject(FenceEvent, INFINITE);
+	for (CRHICommandAllocator*& Allocator : CommandAllocators)
+	{
+		SAFE_RELEASE(Allocator);
 	}
+	CommandAllocators.clear();
+	SAFE_RELEASE(Fence);
+	SAFE_RELEASE(FrameTimestamps);
 
-	FenceValues[FrameIndex]++;
-}
+	for (CMesh* Mesh : Meshes)
+	{
+		delete Mesh;
+	}
+	Meshes.clear();
 
-// get the dxgi format equivilent of a wic format
-DXGI_FORMAT CRenderer::GetDXGIFormatFromWICFormat(WICPixelFormatGUID& WicFormatGUID)
-{
-    if (WicFormatGUID == GUID_WICPixelFormat128bppRGBAFloat) return DXGI_FORMAT_R32G32B32A32_FLOAT;
-    if (WicFormatGUID == GUID_WICPixelFormat64bppRGBAHalf) return DXGI_FORMAT_R16G16B16A16_FLOAT;
-    if (WicFormatGUID == GUID_WICPixelFormat64bppRGBA) return DXGI_FORMAT_R16G16B16A16_UNORM;
-    if (WicFormatGUID == GUID_WICPixelFormat32bppRGBA) return DXGI_FORMAT_R8G8B8A8_UNORM;
-    if (WicFormatGUID == GUID_WICPixelFormat32bppBGRA) return DXGI_FORMAT_B8G8R8A8_UNORM;
-    if (WicFormatGUID == GUID_WICPixelFormat32bppBGR) return DXGI_FORMAT_B8G8R8X8_UNORM;
-    if (WicFormatGUID == GUID_WICPixelFormat32bppRGBA1010102XR) return DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM;
-
-    if (WicFormatGUID == GUID_WICPixelFormat32bppRGBA1010102) return DXGI_FORMAT_R10G10B10A2_UNORM;
-    if (WicFormatGUID == GUID_WICPixelFormat16bppBGRA5551) return DXGI_FORMAT_B5G5R5A1_UNORM;
-    if (WicFormatGUID == GUID_WICPixelFormat16bppBGR565) return DXGI_FORMAT_B5G6R5_UNORM;
-    if (WicFormatGUID == GUID_WICPixelFormat32bppGrayFloat) return DXGI_FORMAT_R32_FLOAT;
-    if (WicFormatGUID == GUID_WICPixelFormat16bppGrayHalf) return DXGI_FORMAT_R16_FLOAT;
-    if (WicFormatGUID == GUID_WICPixelFormat16bppGray) return DXGI_FORMAT_R16_UNORM;
-    if (WicFormatGUID == GUID_WICPixelFormat8bppGray) return DXGI_FORMAT_R8_UNORM;
-    if (WicFormatGUID == GUID_WICPixelFormat8bppAlpha) return DXGI_FORMAT_A8_UNORM;
-
-    return DXGI_FORMAT_UNKNOWN;
-}
+	// After the meshes, they give their ranges back to the pool
+	delete GeometryPool;
+	GeometryPool = nullptr;
 
-// get a dxgi compatible wic format from another wic format
-WICPixelFormatGUID CRenderer::GetConvertToWICFormat(WICPixelFormatGUID& WicFormatGUID)
-{
-    if (WicFormatGUID == GUID_WICPixelFormatBlackWhite) return GUID_WICPixelFormat8bppGray;
-    if (WicFormatGUID == GUID_WICPixelFormat1bppIndexed) return GUID_WICPixelFormat32bppRGBA;
-    if (WicFormatGUID == GUID_WICPixelFormat2bppIndexed) return GUID_WICPixelFormat32bppRGBA;
-    if (WicFormatGUID == GUID_WICPixelFormat4bppIndexed) return GUID_WICPixelFormat32bppRGBA;
-    if (WicFormatGUID == GUID_WICPixelFormat8bppIndexed) return GUID_WICPixelFormat32bppRGBA;
-    if (WicFormatGUID == GUID_WICPixelFormat2bppGray) return GUID_WICPixelFormat8bppGray;
-    if (WicFormatGUID == GUID_WICPixelFormat4bppGray) return GUID_WICPixelFormat8bppGray;
-    if (WicFormatGUID == GUID_WICPixelFormat16bppGrayFixedPoint) return GUID_WICPixelFormat16bppGrayHalf;
-    if (WicFormatGUID == GUID_WICPixelFormat32bppGrayFixedPoint) return GUID_WICPixelFormat32bppGrayFloat;
-    if (WicFormatGUID == GUID_WICPixelFormat16bppBGR555) return GUID_WICPixelFormat16bppBGRA5551;
-    if (WicFormatGUID == GUID_WICPixelFormat32bppBGR101010) return GUID_WICPixelFormat32bppRGBA1010102;
-    if (WicFormatGUID == GUID_WICPixelFormat24bppBGR) return GUID_WICPixelFormat32bppRGBA;
-    if (WicFormatGUID == GUID_WICPixelFormat24bppRGB) return GUID_WICPixelFormat32bppRGBA;
-    if (WicFormatGUID == GUID_WICPixelFormat32bppPBGRA) return GUID_WICPixelFormat32bppRGBA;
-    if (WicFormatGUID == GUID_WICPixelFormat32bppPRGBA) return GUID_WICPixelFormat32bppRGBA;
-    if (WicFormatGUID == GUID_WICPixelFormat48bppRGB) return GUID_WICPixelFormat64bppRGBA;
-    if (WicFormatGUID == GUID_WICPixelFormat48bppBGR) return GUID_WICPixelFormat64bppRGBA;
-    if (WicFormatGUID == GUID_WICPixelFormat64bppBGRA) return GUID_WICPixelFormat64bppRGBA;
-    if (WicFormatGUID == GUID_WICPixelFormat64bppPRGBA) return GUID_WICPixelFormat64bppRGBA;
-    if (WicFormatGUID == GUID_WICPixelFormat64bppPBGRA) return GUID_WICPixelFormat64bppRGBA;
-    if (WicFormatGUID == GUID_WICPixelFormat48bppRGBFixedPoint) return GUID_WICPixelFormat64bppRGBAHalf;
-    if (WicFormatGUID == GUID_WICPixelFormat48bppBGRFixedPoint) return GUID_WICPixelFormat64bppRGBAHalf;
-    if (WicFormatGUID == GUID_WICPixelFormat64bppRGBAFixedPoint) return GUID_WICPixelFormat64bppRGBAHalf;
-    if (WicFormatGUID == GUID_WICPixelFormat64bppBGRAFixedPoint) return GUID_WICPixelFormat64bppRGBAHalf;
-    if (WicFormatGUID == GUID_WICPixelFormat64bppRGBFixedPoint) return GUID_WICPixelFormat64bppRGBAHalf;
-    if (WicFormatGUID == GUID_WICPixelFormat64bppRGBHalf) return GUID_WICPixelFormat64bppRGBAHalf;
-    if (WicFormatGUID == GUID_WICPixelFormat48bppRGBHalf) return GUID_WICPixelFormat64bppRGBAHalf;
-    if (WicFormatGUID == GUID_WICPixelFormat128bppPRGBAFloat) return GUID_WICPixelFormat128bppRGBAFloat;
-    if (WicFormatGUID == GUID_WICPixelFormat128bppRGBFloat) return GUID_WICPixelFormat128bppRGBAFloat;
-    if (WicFormatGUID == GUID_WICPixelFormat128bppRGBAFixedPoint) return GUID_WICPixelFormat128bppRGBAFloat;
-    if (WicFormatGUID == GUID_WICPixelFormat128bppRGBFixedPoint) return GUID_WICPixelFormat128bppRGBAFloat;
-    if (WicFormatGUID == GUID_WICPixelFormat32bppRGBE) return GUID_WICPixelFormat128bppRGBAFloat;
-    if (WicFormatGUID == GUID_WICPixelFormat32bppCMYK) return GUID_WICPixelFormat32bppRGBA;
-    if (WicFormatGUID == GUID_WICPixelFormat64bppCMYK) return GUID_WICPixelFormat64bppRGBA;
-    if (WicFormatGUID == GUID_WICPixelFormat40bppCMYKAlpha) return GUID_WICPixelFormat64bppRGBA;
-    if (WicFormatGUID == GUID_WICPixelFormat80bppCMYKAlpha) return GUID_WICPixelFormat64bppRGBA;
-
-#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8) || defined(_WIN7_PLATFORM_UPDATE)
-    if (WicFormatGUID == GUID_WICPixelFormat32bppRGB) return GUID_WICPixelFormat32bppRGBA;
-    if (WicFormatGUID == GUID_WICPixelFormat64bppRGB) return GUID_WICPixelFormat64bppRGBA;
-    if (WicFormatGUID == GUID_WICPixelFormat64bppPRGBAHalf) return GUID_WICPixelFormat64bppRGBAHalf;
-#endif
+	delete SceneCamera;
+	SceneCamera = nullptr;
 
-    return GUID_WICPixelFormatDontCare;
+	Device->Shutdown();
+	delete Device;
+	Device = nullptr;
 }
 
-// get the number of bits per pixel for a dxgi format
-int CRenderer::GetDXGIFormatBitsPerPixel(DXGI_FORMAT& DxgiFormat)
+void CRenderer::WaitForPreviousFrame()
 {
-    if (DxgiFormat == DXGI_FORMAT_R32G32B32A32_FLOAT) return 128;
-    if (DxgiFormat == DXGI_FORMAT_R16G16B16A16_FLOAT) return 64;
-    if (DxgiFormat == DXGI_FORMAT_R16G16B16A16_UNORM) return 64;
-    if (DxgiFormat == DXGI_FORMAT_R8G8B8A8_UNORM) return 32;
-    if (DxgiFormat == DXGI_FORMAT_B8G8R8A8_UNORM) return 32;
-    if (DxgiFormat == DXGI_FORMAT_B8G8R8X8_UNORM) return 32;
-    if (DxgiFormat == DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM) return 32;
-
-    if (DxgiFormat == DXGI_FORMAT_R10G10B10A2_UNORM) return 32;
-    if (DxgiFormat == DXGI_FORMAT_B5G5R5A1_UNORM) return 16;
-    if (DxgiFormat == DXGI_FORMAT_B5G6R5_UNORM) return 16;
-    if (DxgiFormat == DXGI_FORMAT_R32_FLOAT) return 32;
-    if (DxgiFormat == DXGI_FORMAT_R16_FLOAT) return 16;
-    if (DxgiFormat == DXGI_FORMAT_R16_UNORM) return 16;
-    if (DxgiFormat == DXGI_FORMAT_R8_UNORM) return 8;
-    if (DxgiFormat == DXGI_FORMAT_A8_UNORM) return 8;
-	return 0;
-}
+	// The frames in flight are used in turn, whatever back buffer the swap chain hands out
+	FrameIndex = (FrameIndex + 1) % FramesInFlight;
+	BackBufferIndex = Device->GetCurrentBackBufferIndex();
 
-// load and decode image from file
-int CRenderer::LoadImageDataFromFile(BYTE** ImageData, D3D12_RESOURCE_DESC& ResourceDescription, LPCWSTR Filename, int& BytesPerRow)
-{
-    HRESULT Hr;
-
-    // we only need one instance of the imaging factory to create decoders and frames
-    static IWICImagingFactory* WicFactory;
-
-    // reset decoder, frame and converter since these will be different for each image we load
-    IWICBitmapDecoder* WicDecoder = NULL;
-    IWICBitmapFrameDecode* WicFrame = NULL;
-    IWICFormatConverter* WicConverter = NULL;
-
-    bool bImageConverted = false;
-
-    if (WicFactory == NULL)
-    {
-        // Initialize the COM library
-        CoInitialize(NULL);
-
-        // create the WIC factory
-        Hr = CoCreateInstance(
-            CLSID_WICImagingFactory,
-            NULL,
-            CLSCTX_INPROC_SERVER,
-            IID_PPV_ARGS(&WicFactory)
-        );
-        if (FAILED(Hr)) return 0;
-    }
-
-    // load a decoder for the image
-    Hr = WicFactory->CreateDecoderFromFilename(
-        Filename,                        // Image we want to load in
-        NULL,                            // This is a vendor ID, we do not prefer a specific one so set to null
-        GENERIC_READ,                    // We want to read from this file
-        WICDecodeMetadataCacheOnLoad,    // We will cache the metadata right away, rather than when needed, which might be unknown
-        &WicDecoder                      // the wic decoder to be created
-    );
-    if (FAILED(Hr)) return 0;
-
-    // get image from decoder (this will decode the "frame")
-    Hr = WicDecoder->GetFrame(0, &WicFrame);
-    if (FAILED(Hr)) return 0;
-
-    // get wic pixel format of image
-    WICPixelFormatGUID PixelFormat;
-    Hr = WicFrame->GetPixelFormat(&PixelFormat);
-    if (FAILED(Hr)) return 0;
-
-    // get size of image
-    UINT TextureWidth, TextureHeight;
-    Hr = WicFrame->GetSize(&TextureWidth, &TextureHeight);
-    if (FAILED(Hr)) return 0;
-
-    // we are not handling sRGB types in this tutorial, so if you need that support, you'll have to figure
-    // out how to implement the support yourself
-
-    // convert wic pixel format to dxgi pixel format
-    DXGI_FORMAT DxgiFormat = GetDXGIFormatFromWICFormat(PixelFormat);
-
-    // if the format of the image is not a supported dxgi format, try to convert it
-    if (DxgiFormat == DXGI_FORMAT_UNKNOWN)
-    {
-        // get a dxgi compatible wic format from the current image format
-        WICPixelFormatGUID ConvertToPixelFormat = GetConvertToWICFormat(PixelFormat);
-
-        // return if no dxgi compatible format was found
-        if (ConvertToPixelFormat == GUID_WICPixelFormatDontCare) return 0;
-
-        // set the dxgi format
-        DxgiFormat = GetDXGIFormatFromWICFormat(ConvertToPixelFormat);
-
-        // create the format converter
-        Hr = WicFactory->CreateFormatConverter(&WicConverter);
-        if (FAILED(Hr)) return 0;
-
-        // make sure we can convert to the dxgi compatible format
-        BOOL bCanConvert = FALSE;
-        Hr = WicConverter->CanConvert(PixelFormat, ConvertToPixelFormat, &bCanConvert);
-        if (FAILED(Hr) || !bCanConvert) return 0;
-
-        // do the conversion (wicConverter will contain the converted image)
-        Hr = WicConverter->Initialize(WicFrame, ConvertToPixelFormat, WICBitmapDitherTypeErrorDiffusion, 0, 0, WICBitmapPaletteTypeCustom);
-        if (FAILED(Hr)) return 0;
-
-        // this is so we know to get the image data from the wicConverter (otherwise we will get from wicFrame)
-        bImageConverted = true;
-    }
-
-    int BitsPerPixel = GetDXGIFormatBitsPerPixel(DxgiFormat); // number of bits per pixel
-    BytesPerRow = (TextureWidth * BitsPerPixel) / 8; // number of bytes in each row of the image data
-    int ImageSize = BytesPerRow * TextureHeight; // total image size in bytes
-
-    // allocate enough memory for the raw image data, and set imageData to point to that memory
-    *ImageData = (BYTE*)malloc(ImageSize);
-
-    // copy (decoded) raw image data into the newly allocated memory (imageData)
-    if (bImageConverted)
-    {
-        // if image format needed to be converted, the wic converter will contain the converted image
-        Hr = WicConverter->CopyPixels(0, BytesPerRow, ImageSize, *ImageData);
-        if (FAILED(Hr)) return 0;
-    }
-    else
-    {
-        // no need to convert, just copy data from the wic frame
-        Hr = WicFrame->CopyPixels(0, BytesPerRow, ImageSize, *ImageData);
-        if (FAILED(Hr)) return 0;
-    }
-
-    // now describe the texture with the information we have obtained from the image
-    ResourceDescription = {};
-    ResourceDescription.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-    ResourceDescription.Alignment = 0; // may be 0, 4KB, 64KB, or 4MB. 0 will let runtime decide between 64KB and 4MB (4MB for multi-sampled textures)
-    ResourceDescription.Width = TextureWidth; // width of the texture
-    ResourceDescription.Height = TextureHeight; // height of the texture
-    ResourceDescription.DepthOrArraySize = 1; // if 3d image, depth of 3d image. Otherwise an array of 1D or 2D textures (we only have one image, so we set 1)
-    ResourceDescription.MipLevels = 1; // Number of mipmaps. We are not generating mipmaps for this texture, so we have only one level
-    ResourceDescription.Format = DxgiFormat; // This is the dxgi format of the image (format of the pixels)
-    ResourceDescription.SampleDesc.Count = 1; // This is the number of samples per pixel, we just want 1 sample
-    ResourceDescription.SampleDesc.Quality = 0; // The quality level of the samples. Higher is better quality, but worse performance
-    ResourceDescription.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN; // The arrangement of the pixels. Setting to unknown lets the driver choose the most efficient one
-    ResourceDescription.Flags = D3D12_RESOURCE_FLAG_NONE; // no flags
-
-    // return the size of the image. remember to delete the image once your done with it (in this tutorial once its uploaded to the gpu)
-    return ImageSize;
+	std::chrono::high_resolution_clock::time_point Start = std::chrono::high_resolution_clock::now();
+	if (!Fence->Wait(FenceValues[FrameIndex]))
+	{
+		bRunning = false;
+	}
+	const double WaitMs = ElapsedMs(Start);
+	Stats.CPUWaitForGPUMs += WaitMs;
+	Pacer.AddWait(WaitMs);
+
+	// The GPU is done with the last frame of this slot, and with the frames before it in order
+	if (FrameInputTimes[FrameIndex] >= 0.0)
+	{
+		const double GPUStartMs = FrameTimestamps->GetTimeMs(FrameIndex * 2);
+		const double GPUEndMs = FrameTimestamps->GetTimeMs(FrameIndex * 2 + 1);
+		if (LastGPUEndMs > 0.0)
+		{
+			Stats.GPUWaitForCPUMs += std::max(GPUStartMs - LastGPUEndMs, 0.0);
+		}
+		LastGPUEndMs = GPUEndMs;
+		Pacer.AddGPUFrame(GPUEndMs - GPUStartMs);
+
+		const double LatencyMs = GPUEndMs - FrameInputTimes[FrameIndex];
+		Stats.InputLatencyMs += LatencyMs;
+		Stats.MaxInputLatencyMs = std::max(Stats.MaxInputLatencyMs, LatencyMs);
+		Stats.LatencyFrames++;
+		FrameInputTimes[FrameIndex] = -1.0;
+	}
+
+	FenceValues[FrameIndex] = ++FenceValue;
 }
@@ -1,13 +1,130 @@
 #pragma once
 #include "pch.h"
+#include "RHI.h"
+#include "FrustumCuller.h"
+#include "LODSelector.h"
+#include "Bounds.h"
+#include "DrawList.h"
+#include "FramePacer.h"
 #include <DirectXMath.h>
-#include <wincodec.h>
-
-#define FRAMEBUFFER_COUNT 3
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 struct ConstantBufferPerObject
 {
 	DirectX::XMFLOAT4X4 WorldViewProj;
+
+	// Without the dequantization, rotates the tangent
+	DirectX::XMFLOAT4X4 World;
+
+	// Inverse transpose of World, keeps the normal perpendicular to the surface under a non uniform scale
+	DirectX::XMFLOAT4X4 NormalMatrix;
+};
+
+// Constants of an instanced draw, the world matrices come from the instance buffer
+struct ConstantBufferInstanced
+{
+	DirectX::XMFLOAT4X4 ViewProj;
+
+	// Box of the mesh the quantized positions are relative to
+	DirectX::XMFLOAT4 DequantizationScale;
+	DirectX::XMFLOAT4 DequantizationOffset;
+};
+
+// What one recording thread owns, the threads never write to the same objects
+struct RenderRecordContext
+{
+	// One per frame in flight, reset by the thread once the GPU is done with its frame
+	std::vector<CRHICommandAllocator*> CommandAllocators;
+
+	CRHICommandList* CommandList = nullptr;
+
+	// Constants and instance data of the draws this thread records
+	class CUploadAllocator* ConstantAllocator = nullptr;
+	class CUploadAllocator* InstanceAllocator = nullptr;
+
+	// Bytes written into the upload pages this frame, added to the device stats once the threads are done
+	uint64_t BytesUploaded = 0;
+
+	// An allocation failed, the frame is stopped once the threads are done
+	bool bFailed = false;
+};
+
+// What the render thread draws a frame from. Written by the game thread, then left untouched until the frame is drawn
+struct RenderSnapshot
+{
+	DirectX::XMFLOAT4X4 ViewMatrix;
+	DirectX::XMFLOAT4X4 ProjectionMatrix;
+	DirectX::XMFLOAT3 CameraPosition;
+
+	// When the game thread started the frame and read the input, on the clock of RHINowMs
+	double InputTimeMs = 0.0;
+
+	// The visible meshes as indices in Meshes, with their LOD, world matrix and distance to the camera, same order
+	std::vector<uint32_t> MeshIndices;
+	std::vector<uint8_t> LODs;
+	std::vector<DirectX::XMFLOAT4X4> WorldMatrices;
+	std::vector<float> Depths;
+};
+
+// Held movement of the camera, each axis from -1 to 1. Set by the game thread from the keys, applied once per tick
+struct CameraInput
+{
+	float Forward = 0.0f;
+	float Right = 0.0f;
+	float Up = 0.0f;
+};
+
+// CPU time spent in the stages of the frame, accumulated until reset
+struct RendererStats
+{
+	// Fixed ticks simulated, none on the frames faster than a tick
+	uint64_t SimulationTicks = 0;
+
+	double TransformUpdateMs = 0.0;
+
+	double CullingMs = 0.0;
+
+	// Copying the visible meshes and the camera into the snapshot
+	double SnapshotMs = 0.0;
+
+	// Game thread waiting for the render thread to be done with a snapshot, and render thread waiting for a new one
+	double GameWaitMs = 0.0;
+	double RenderWaitMs = 0.0;
+
+	// Render thread waiting for the GPU to be done with a frame in flight, and GPU idle between two frames waiting for
+	// the CPU to submit the next one, from its timestamps
+	double CPUWaitForGPUMs = 0.0;
+	double GPUWaitForCPUMs = 0.0;
+
+	// Game thread sleeping in low latency mode before reading the input
+	double PacingDelayMs = 0.0;
+
+	// From the input read for a frame to the GPU done drawing it, the present is queued right after. Only the frames
+	// the GPU finished are counted
+	double InputLatencyMs = 0.0;
+	double MaxInputLatencyMs = 0.0;
+	uint64_t LatencyFrames = 0;
+
+	// Building and sorting the draw keys
+	double SortingMs = 0.0;
+
+	// Wall time of the command recording, from the first list reset to the last recording thread done
+	double RecordingMs = 0.0;
+
+	// Meshes tested against the frustum and meshes that passed
+	uint64_t ObjectsTested = 0;
+	uint64_t ObjectsVisible = 0;
+
+	// Visible meshes too small on screen to be drawn
+	uint64_t ObjectsDropped = 0;
+
+	// Triangles of the selected LODs, and the triangles the full meshes would have added
+	uint64_t TrianglesSelected = 0;
+	uint64_t TrianglesSaved = 0;
 };
 
 class CRenderer
@@ -16,35 +133,88 @@ public:
 
 	CRenderer();
 
-	// Initialize DirectX12
-	bool InitD3D();
+	// Create the RHI device and the resources of the scene
+	bool Init();
 
-	// Update the App's logic
+	// Game thread : starts a frame, the input is read after it. Waits while the render thread still draws from the
+	// snapshot this frame reuses, then sleeps in low latency mode, until the frame would reach the GPU as it gets free.
+	// Update calls it when it wasn't
+	void BeginFrame();
+
+	// Game thread : run the simulation ticks the time since the last frame covers, cull, then publish what to draw as a
+	// snapshot, interpolated between the last two ticks
 	void Update();
 
-	// Update the D3D Pipeline (command lists)
-	void UpdatePipeline();
+	// Find the meshes inside the camera frustum and big enough on screen, only those are drawn, and pick their LOD
+	void Cull();
 
-	// Execute the command list
+	// Render thread : draws the oldest published snapshot not drawn yet, returns right away when there is none
 	void Render();
 
-	// Release Com objects and release memory
+	// Runs Render on a thread of its own, the next Update is simulated while the last snapshot is drawn.
+	// Without it, Render is called after Update on the same thread
+	void StartRenderThread();
+
+	// Waits until every published snapshot is drawn, then joins the render thread
+	void StopRenderThread();
+
+	// Release Com objects and release memory, stops the render thread first
 	void Cleanup();
 
-	// Wait until the GPU is finished with a command list
+	// Moves to the next frame in flight and waits until the GPU is finished with the frame that used it last
 	void WaitForPreviousFrame();
 
-	DXGI_FORMAT GetDXGIFormatFromWICFormat(WICPixelFormatGUID& WicFormatGUID);
-	WICPixelFormatGUID GetConvertToWICFormat(WICPixelFormatGUID& WicFormatGUID);
-	int GetDXGIFormatBitsPerPixel(DXGI_FORMAT& DxgiFormat);
-	// Load an image in the form of a bitmap
-	int LoadImageDataFromFile(BYTE** ImageData, D3D12_RESOURCE_DESC& ResourceDescription, LPCWSTR Filename, int& BytesPerRow);
+	// Cleared by either thread when something fails
+	std::atomic<bool> bRunning{ true };
+
+	// Number of cubes Init spawns, laid out on a grid around the origin
+	int ObjectCount = 1;
+
+	// How many of the last ObjectCount objects never move, they are baked into static batches. The first object always
+	// moves, it holds the geometry the others share
+	int StaticObjectCount = 0;
 
-	bool bRunning = true;
+	// OBJ, glb or cooked .mesh file Init spawns instead of the cubes, when set
+	const char* MeshPath = nullptr;
+
+	// Command lists the draws are split into, each recorded by a job, 0 for one per job system thread
+	uint32_t RecordThreadCount = 0;
+
+	// Meshes drawing the same buffers are drawn with one instanced draw, off to measure the cost of a draw per mesh
+	bool bInstancing = true;
+
+	// Frames the CPU may record while the GPU is still on the ones before, read by Init. Fewer frames lower the latency,
+	// more absorb the spikes of either side
+	uint32_t FramesInFlight = 2;
+
+	// Measures the waits on both sides of the GPU, its low latency mode starts the frames just in time
+	CFramePacer Pacer;
+
+	// Triangles the Null backend's GPU draws per ms, 0 for a GPU that finishes as soon as the work is submitted
+	double NullGPUTrianglesPerMs = 0.0;
+
+	// The simulation advances by fixed ticks whatever the frame rate, so it behaves the same at any frame rate
+	double TickMs = 1000.0 / 60.0;
+
+	// Ticks an Update runs at most, past that the simulation slows down rather than every frame getting slower
+	uint32_t MaxTicksPerUpdate = 4;
+
+	// When not 0, every Update runs this many ticks and draws the last one, whatever the time. For the benchmarks that
+	// measure a simulated frame
+	uint32_t TicksPerUpdate = 0;
+
+	// Degrees per second the dynamic meshes turn by
+	DirectX::XMFLOAT3 RotationSpeed = DirectX::XMFLOAT3(0.06f, 0.6f, 0.0f);
+
+	// Read by every tick, the game thread keeps it up to date
+	CameraInput Input;
+
+	RendererStats Stats;
 
 	/********** Window Parameters **********/
 
-	HWND HWindow;
+	// HWND of the window, unused by the Null backend
+	void* HWindow = nullptr;
 
 	int WindowWidth = 1280;
 
@@ -54,86 +224,174 @@ public:
 
 	/********** EndWindow Parameters **********/
 
-	/********** Direct 3D Variables **********/
-
-	// The number of FramBuffers (3 for tripleBuffering)
-	const int FrameBufferCount = FRAMEBUFFER_COUNT;
+	/********** RHI Variables **********/
 
-	// The direct3D Device
-	ID3D12Device* Device;
+	// The backend Init creates the device with
+	ERHIBackend Backend = ERHIBackend::D3D12;
 
-	// SwapChain to switch between render targets
-	IDXGISwapChain3* SwapChain;
+	// Buffers of the swap chain (3 for triple buffering), independent of FramesInFlight
+	int BackBufferCount = 3;
 
-	// Command Queue to contain Command Lists
-	ID3D12CommandQueue* CommandQueue;
+	// The device wrapping the graphics API
+	CRHIDevice* Device = nullptr;
 
-	// Descriptor Heap to hold Resources
-	ID3D12DescriptorHeap* RTVDescriptorHeap;
+	// Allocators of CommandList per frame in flight, the recording threads have as many each
+	std::vector<CRHICommandAllocator*> CommandAllocators;
 
-	// FrameBufferCount Render Targets
-	ID3D12Resource* RenderTargets[FRAMEBUFFER_COUNT];
+	// Records the uploads of Init and the start of each frame, the barrier and the clears, before the draws
+	CRHICommandList* CommandList = nullptr;
 
-	// Allocators : FrameBufferCount * NumberOfThreads
-	ID3D12CommandAllocator* CommandAllocators[FRAMEBUFFER_COUNT];
+	// One per recording thread, the draws are split in ranges recorded side by side then executed in order
+	std::vector<RenderRecordContext> RecordContexts;
 
-	// The Command list to record commands into then execute to render
-	ID3D12GraphicsCommandList* CommandList;
+	// CommandList then the lists recorded this frame, in execution order
+	std::vector<CRHICommandList*> FrameCommandLists;
 
 	// PSO containing a pipeline state
-	ID3D12PipelineState* PSO;
-
-	// Depth/Stencil
-	ID3D12Resource* DepthStencilBuffer; // This is the memory for our depth buffer
-	ID3D12DescriptorHeap* DepthStencilDescriptorHeap; // This is a heap for our depth/stencil buffer descriptor
+	CRHIPipelineState* PSO = nullptr;
 
-	// Defines the data that shaders will access
-	ID3D12RootSignature* RootSignature;
+	// Same as PSO, the world matrix comes from a per instance vertex buffer
+	CRHIPipelineState* InstancedPSO = nullptr;
 
 	// Area that output from the rasterizer will be stretched to
-	D3D12_VIEWPORT Viewport;
+	RHIViewport Viewport;
 
 	// The area to draw in, pixels outside will be culled
-	D3D12_RECT ScissorRect;
+	RHIRect ScissorRect;
 
-	// One fence per allocator to know when the command list is being executed
-	ID3D12Fence* Fences[FRAMEBUFFER_COUNT];
+	// Signaled with a new value at the end of every frame, the GPU passes them in order
+	CRHIFence* Fence = nullptr;
 
-	// Handle to an event for our fence
-	HANDLE FenceEvent;
+	// Last value signaled
+	uint64_t FenceValue = 0;
 
-	// Value incremented each frame for each Fence
-	UINT64 FenceValues[FRAMEBUFFER_COUNT];
+	// Value signaled by the last frame of each frame in flight
+	std::vector<uint64_t> FenceValues;
+
+	// Frame in flight being recorded, its allocators and upload memory are free
+	uint32_t FrameIndex = 0;
 
 	// Current RenderTarget
-	int FrameIndex;
+	int BackBufferIndex = 0;
+
+	// When the GPU started and finished each frame in flight, two timestamps per frame
+	CRHITimestampQueries* FrameTimestamps = nullptr;
+
+	// Input time of the last frame of each frame in flight, negative until one is submitted
+	std::vector<double> FrameInputTimes;
+
+	// When the GPU finished the frame before, its idle time is measured from there
+	double LastGPUEndMs = 0.0;
+
+	// Vertices and indices of every mesh
+	class CGeometryPool* GeometryPool = nullptr;
+
+	/********** End RHI Variables **********/
+
+	std::vector<class CMesh*> Meshes;
 
-	// Size of the Render Target Descriptor
-	int RTVDescriptorSize;
+	// Only the first DynamicMeshCount meshes move. Then come the static objects that couldn't be baked, as when the mesh
+	// comes from the cache without a CPU copy, and from FirstBatchMesh the static batches, already in world space
+	uint32_t DynamicMeshCount = 0;
 
-	// *** Constant Buffer *** //
-	// The heap to store the descriptor of our constant buffer
-	int ConstantBufferPerObjectAlignedSize = (sizeof(ConstantBufferPerObject) + 255) & ~255;
+	uint32_t FirstBatchMesh = 0;
 
-	ConstantBufferPerObject ConstantBuffer;
+	// Transform handles and local bounds of Meshes, same order, gathered once so the bounds are moved in a single batch
+	std::vector<uint32_t> MeshTransforms;
+	std::vector<BoundingVolume> LocalBounds;
 
-	// The memory in GPU where our constant buffer will be
-	ID3D12Resource* ConstantBufferUploadHeaps[FRAMEBUFFER_COUNT];
+	// LocalBounds moved by the world matrices of this frame
+	std::vector<BoundingVolume> WorldBounds;
 
-	// A pointer to the memory location of our constant buffer
-	UINT8* ConstantBufferGPUAdress[FRAMEBUFFER_COUNT];
+	// World bounding spheres of Meshes, same order
+	CFrustumCuller Culler;
 
-	/********** End Direct 3D Variables **********/
+	// Indices in Meshes of the meshes to draw this frame, the first VisibleMeshCount are valid
+	std::vector<uint32_t> VisibleMeshes;
 
-	class CMesh* Mesh = nullptr;
+	uint32_t VisibleMeshCount = 0;
+
+	// Picks the LOD of the meshes passing the frustum test, drops the ones smaller than a pixel
+	CLODSelector LODSelector;
+
+	// LOD of each entry of VisibleMeshes
+	std::vector<uint8_t> VisibleLODs;
+
+	// Material and geometry fields of the draw keys of Meshes, same order. Meshes drawing the same buffers share a geometry
+	std::vector<uint32_t> MeshMaterials;
+	std::vector<uint32_t> MeshGeometries;
+
+	// Texture of each material
+	std::vector<CRHIResource*> MaterialTextures;
+
+	// The draws of the snapshot being drawn sorted by key, the values are indices in its visible meshes
+	CDrawList DrawList;
 
 	// Camera 
 	class Camera* SceneCamera = nullptr;
 
 	/* TEXTURE */
-	ID3D12Resource* TextureBuffer;
+	CRHIResource* TextureBuffer = nullptr;
+
+private:
+
+	// What a culling job found in its range of Meshes, packed once every job is done
+	struct CullRange
+	{
+		uint32_t InFrustumCount;
+		uint32_t VisibleCount;
+		uint64_t FullTriangles;
+		uint64_t SelectedTriangles;
+	};
+
+	std::vector<CullRange> CullRanges;
+
+	// Two snapshots, the game thread writes one while the render thread draws the other, frame N goes in N % SnapshotCount
+	static constexpr uint32_t SnapshotCount = 2;
+	RenderSnapshot Snapshots[SnapshotCount];
+
+	// Last frame published by the game thread and last frame drawn by the render thread, both start at 0 for none
+	uint64_t PublishedFrame = 0;
+	uint64_t RenderedFrame = 0;
+
+	// Guards the two frame numbers and bRenderThreadRunning, notified when either frame number moves
+	std::mutex SnapshotMutex;
+	std::condition_variable SnapshotCondition;
+
+	std::thread RenderThread;
+	bool bRenderThreadRunning = false;
+
+	// Game thread, set by BeginFrame until Update
+	bool bFrameStarted = false;
+	double FrameStartMs = 0.0;
+
+	// Game thread, start of the last frame and real time not simulated yet, less than a tick once the ticks ran
+	double LastFrameStartMs = 0.0;
+	double UnsimulatedMs = 0.0;
+
+	// Where the frame is between the last two ticks, 1 for the last one
+	float TickAlpha = 1.0f;
+
+	// Moves the camera from the input, turns the meshes and resolves the world matrices, by TickMs
+	void Tick();
+
+	// Copies the camera and the visible meshes Cull found into Snapshot
+	void WriteSnapshot(RenderSnapshot& Snapshot);
+
+	// Render until stopped and every snapshot is drawn
+	void RenderThreadLoop();
+
+	// Fills DrawList with the visible meshes of Snapshot and sorts it by state then depth
+	void SortDraws(const RenderSnapshot& Snapshot);
+
+	// Update the D3D Pipeline (command lists) with the sorted draws of Snapshot
+	void UpdatePipeline(const RenderSnapshot& Snapshot);
 
-	ID3D12DescriptorHeap* MainDescriptorHeap;
+	// Records the sorted draws Begin to End into the list of Context, the last list also transitions the back buffer
+	// back to present. Only touches Context, runs on any thread
+	void RecordDraws(RenderRecordContext& Context, const RenderSnapshot& Snapshot, uint32_t Begin, uint32_t End,
+		const DirectX::XMFLOAT4X4& ViewProj, bool bLastList);
 
-	ID3D12Resource* TextureBufferUploadHeap;
+	// Whether the sorted draw Index can be drawn in the same instanced draw as the one before it
+	bool ContinuesRun(const RenderSnapshot& Snapshot, uint32_t Index) const;
 };
\ No newline at end of file
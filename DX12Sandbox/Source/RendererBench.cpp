@@ -0,0 +1,231 @@
+#include "pch.h"
+#include "Bench.h"
+#include "Camera.h"
+#include "CCube.h"
+#include "DrawList.h"
+#include "MeshCache.h"
+#include "MeshSimplifier.h"
+#include "Renderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+// Draw keys of a frame with a few geometries at random depths, each with its index as value
+static std::vector<std::pair<uint64_t, uint32_t>> BuildDrawKeys(uint32_t DrawCount)
+{
+	std::vector<std::pair<uint64_t, uint32_t>> Draws(DrawCount);
+	uint32_t Seed = 1;
+	for (uint32_t Index = 0; Index < DrawCount; ++Index)
+	{
+		Seed = Seed * 1664525u + 1013904223u;
+		Draws[Index] = { CDrawList::MakeKey(ERenderPass::Opaque, 0, Seed >> 28, Seed >> 8 & 3, float(Seed >> 12 & 0xFFFF) * 0.01f), Index };
+	}
+	return Draws;
+}
+
+static void SortDrawList(const std::vector<std::pair<uint64_t, uint32_t>>& Draws, CDrawList& DrawList)
+{
+	DrawList.Reset(uint32_t(Draws.size()));
+	for (const std::pair<uint64_t, uint32_t>& Draw : Draws)
+	{
+		DrawList.Add(Draw.first, Draw.second);
+	}
+	DrawList.Sort();
+}
+
+void RunRendererBenchmarks()
+{
+	// Draw keys radix sorted then compared sorting pairs with std::sort
+	const uint32_t DrawCount = 100000;
+	const int SortIterations = 64;
+	const std::vector<std::pair<uint64_t, uint32_t>> Draws = BuildDrawKeys(DrawCount);
+	CDrawList DrawList;
+	const double RadixSortNs = MeasureNs(SortIterations, [&](int) { SortDrawList(Draws, DrawList); });
+	std::vector<std::pair<uint64_t, uint32_t>> SortedDraws;
+	const double StdSortNs = MeasureNs(SortIterations, [&](int)
+	{
+		SortedDraws = Draws;
+		std::sort(SortedDraws.begin(), SortedDraws.end());
+	});
+	printf("Sorting %u draw keys, radix      : %.3f ms\n", DrawCount, RadixSortNs / 1e6);
+	printf("Sorting %u draw keys, std::sort  : %.3f ms\n", DrawCount, StdSortNs / 1e6);
+
+	// Whole frames with the render thread drawing one behind the game thread, against both on the same thread
+	printf("Frame with 65536 cubes, one draw per cube :\n");
+	for (bool bRenderThread : { false, true })
+	{
+		CRenderer* FrameRenderer = new CRenderer;
+		FrameRenderer->Backend = ERHIBackend::Null;
+		FrameRenderer->ObjectCount = 65536;
+		FrameRenderer->bInstancing = false;
+		FrameRenderer->TicksPerUpdate = 1;
+		if (FrameRenderer->Init())
+		{
+			FrameRenderer->SceneCamera->SetPosition(XMFLOAT3(0.0f, 0.0f, -150.0f));
+			FrameRenderer->Update();
+			FrameRenderer->Render();
+			FrameRenderer->Stats = RendererStats();
+			if (bRenderThread)
+			{
+				FrameRenderer->StartRenderThread();
+			}
+
+			const int BenchFrames = 16;
+			const double FrameMs = MeasureNs(BenchFrames, [&](int)
+			{
+				FrameRenderer->Update();
+				if (!bRenderThread)
+				{
+					FrameRenderer->Render();
+				}
+			}) / 1e6;
+			FrameRenderer->StopRenderThread();
+
+			const RendererStats& FrameStats = FrameRenderer->Stats;
+			const double SimulationMs = (FrameStats.TransformUpdateMs + FrameStats.CullingMs + FrameStats.SnapshotMs) / BenchFrames;
+			const double RenderingMs = (FrameStats.SortingMs + FrameStats.RecordingMs) / BenchFrames;
+			printf("  %s : %.2f ms/frame (game %.2f ms, render %.2f ms, game waits %.2f ms)\n",
+				bRenderThread ? "render thread " : "single thread ", FrameMs, SimulationMs, RenderingMs, FrameStats.GameWaitMs / BenchFrames);
+		}
+		FrameRenderer->Cleanup();
+		delete FrameRenderer;
+	}
+
+	// A GPU bound frame, the Null GPU drawing the visible cubes in about 4 ms, with more and more frames in flight
+	printf("Frame pacing, 4096 cubes and a 4 ms GPU frame :\n");
+	for (uint32_t Config = 0; Config < 4; ++Config)
+	{
+		CRenderer* PacedRenderer = new CRenderer;
+		PacedRenderer->Backend = ERHIBackend::Null;
+		PacedRenderer->ObjectCount = 4096;
+		PacedRenderer->NullGPUTrianglesPerMs = 1600.0;
+		PacedRenderer->FramesInFlight = Config < 3 ? Config + 1 : 2;
+		PacedRenderer->Pacer.bLowLatency = Config == 3;
+		if (PacedRenderer->Init())
+		{
+			// Long enough for the queues to fill and the pacer to settle before measuring
+			PacedRenderer->StartRenderThread();
+			for (int Frame = 0; Frame < 30; ++Frame)
+			{
+				PacedRenderer->Update();
+			}
+			PacedRenderer->StopRenderThread();
+			PacedRenderer->Stats = RendererStats();
+			PacedRenderer->StartRenderThread();
+
+			const int BenchFrames = 60;
+			const double FrameMs = MeasureNs(BenchFrames, [&](int) { PacedRenderer->Update(); }) / 1e6;
+			PacedRenderer->StopRenderThread();
+
+			const RendererStats& FrameStats = PacedRenderer->Stats;
+			printf("  %u in flight%s : %.2f ms/frame, CPU waiting %.2f ms, GPU waiting %.2f ms, input to GPU done %.2f ms\n",
+				PacedRenderer->FramesInFlight, PacedRenderer->Pacer.bLowLatency ? ", low latency" : "             ", FrameMs,
+				FrameStats.CPUWaitForGPUMs / BenchFrames, FrameStats.GPUWaitForCPUMs / BenchFrames,
+				FrameStats.LatencyFrames > 0 ? FrameStats.InputLatencyMs / FrameStats.LatencyFrames : 0.0);
+		}
+		PacedRenderer->Cleanup();
+		delete PacedRenderer;
+	}
+}
+
+bool RunRendererChecks()
+{
+	// The radix sort must give the order of std::sort on (key, value) pairs : equal keys keep the order they were added in
+	const std::vector<std::pair<uint64_t, uint32_t>> Draws = BuildDrawKeys(100000);
+	CDrawList DrawList;
+	SortDrawList(Draws, DrawList);
+	std::vector<std::pair<uint64_t, uint32_t>> SortedDraws = Draws;
+	std::sort(SortedDraws.begin(), SortedDraws.end());
+	uint32_t Misplaced = 0;
+	for (uint32_t Index = 0; Index < DrawList.GetCount(); ++Index)
+	{
+		Misplaced += DrawList.GetKey(Index) != SortedDraws[Index].first || DrawList.GetValue(Index) != SortedDraws[Index].second ? 1 : 0;
+	}
+	bool bPassed = Check(DrawList.GetCount() == SortedDraws.size() && Misplaced == 0, "draw sorting : %u of %zu draws not where std::sort puts them",
+		Misplaced, SortedDraws.size());
+
+	// A child turned under a rotated, non uniformly scaled parent : its world matrix shears. Mirrored too for the second
+	const XMMATRIX ChildLocal = XMMatrixRotationX(XMConvertToRadians(30.0f)) * XMMatrixRotationZ(XMConvertToRadians(40.0f)) * XMMatrixTranslation(1.0f, 2.0f, 3.0f);
+	for (float MirrorScale : { 1.0f, -1.0f })
+	{
+		const XMMATRIX ParentWorld = XMMatrixScaling(3.0f, MirrorScale, 0.25f) * XMMatrixRotationY(XMConvertToRadians(60.0f)) * XMMatrixTranslation(-4.0f, 0.0f, 5.0f);
+		XMFLOAT4X4 World;
+		XMStoreFloat4x4(&World, ChildLocal * ParentWorld);
+		InstanceData Instance;
+		WriteInstanceData(World, Instance);
+
+		// What the non instanced shader does with the inverse of World in the constant buffer, read transposed
+		const XMMATRIX NormalMatrix = XMMatrixTranspose(XMMatrixInverse(nullptr, XMLoadFloat4x4(&World)));
+
+		float MaxDifference = 0.0f, MaxCosine = 0.0f;
+		const XMFLOAT3 Normals[] = { XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT3(0.6f, -0.48f, 0.64f) };
+		for (const XMFLOAT3& LocalNormal : Normals)
+		{
+			// What the instanced shader does with the instance data
+			const XMVECTOR Normal = XMLoadFloat3(&LocalNormal);
+			const XMVECTOR Instanced = XMVector3Normalize(XMVectorSet(XMVectorGetX(XMVector3Dot(Normal, XMLoadFloat3(&Instance.Normal[0]))),
+				XMVectorGetX(XMVector3Dot(Normal, XMLoadFloat3(&Instance.Normal[1]))), XMVectorGetX(XMVector3Dot(Normal, XMLoadFloat3(&Instance.Normal[2]))), 0.0f));
+			const XMVECTOR NonInstanced = XMVector3Normalize(XMVector3TransformNormal(Normal, NormalMatrix));
+			MaxDifference = std::max(MaxDifference, XMVectorGetX(XMVector3Length(Instanced - NonInstanced)));
+
+			// Both stay perpendicular to the surface, to the world directions of two local tangents
+			const XMVECTOR Tangent = XMVector3Normalize(XMVector3Cross(Normal, XMVectorSet(0.3f, 0.5f, 0.7f, 0.0f)));
+			for (XMVECTOR LocalTangent : { Tangent, XMVector3Cross(Normal, Tangent) })
+			{
+				const XMVECTOR WorldTangent = XMVector3Normalize(XMVector3TransformNormal(LocalTangent, XMLoadFloat4x4(&World)));
+				MaxCosine = std::max(MaxCosine, fabsf(XMVectorGetX(XMVector3Dot(Instanced, WorldTangent))));
+			}
+		}
+		bPassed &= Check(MaxDifference < 1e-4f && MaxCosine < 1e-4f,
+			"instance data : %s sheared world, instanced normals %.6f from the non instanced ones, %.6f cosine to the surface",
+			MirrorScale < 0.0f ? "mirrored" : "a", MaxDifference, MaxCosine);
+	}
+
+	// Static objects of a cooked cube : the mesh has no CPU copy so none is baked, they are drawn on their own but still
+	// never move while the dynamic ones turn
+	const char* CachePath = "CheckCube.mesh";
+	CCube* CookedCube = new CCube;
+	CMeshSimplifier::GenerateLODs({ CookedCube });
+	const bool bCooked = CMeshCache::Write(CachePath, *CookedCube);
+	delete CookedCube;
+
+	CRenderer* StaticRenderer = new CRenderer;
+	StaticRenderer->Backend = ERHIBackend::Null;
+	StaticRenderer->ObjectCount = 8;
+	StaticRenderer->StaticObjectCount = 4;
+	StaticRenderer->MeshPath = CachePath;
+	StaticRenderer->TicksPerUpdate = 1;
+	const bool bInitialized = bCooked && StaticRenderer->Init();
+	uint32_t MovedStatic = 0, MovedDynamic = 0;
+	if (bInitialized)
+	{
+		std::vector<XMFLOAT4X4> Before;
+		for (const CMesh* Mesh : StaticRenderer->Meshes)
+		{
+			Before.push_back(Mesh->GetWorldMatrix());
+		}
+		for (int Frame = 0; Frame < 4; ++Frame)
+		{
+			StaticRenderer->Update();
+			StaticRenderer->Render();
+		}
+		for (uint32_t Index = 0; Index < uint32_t(Before.size()); ++Index)
+		{
+			const XMFLOAT4X4 After = StaticRenderer->Meshes[Index]->GetWorldMatrix();
+			const bool bMoved = memcmp(&Before[Index], &After, sizeof(After)) != 0;
+			(Index < StaticRenderer->DynamicMeshCount ? MovedDynamic : MovedStatic) += bMoved ? 1 : 0;
+		}
+	}
+	bPassed &= Check(bInitialized && StaticRenderer->DynamicMeshCount == 4 && StaticRenderer->FirstBatchMesh == 8
+		&& StaticRenderer->Meshes.size() == 8 && MovedStatic == 0 && MovedDynamic == 4,
+		"static objects of a cached mesh : %u dynamic, %u not baked, %u of them moved, %u of the dynamic ones turned",
+		StaticRenderer->DynamicMeshCount, StaticRenderer->FirstBatchMesh - StaticRenderer->DynamicMeshCount, MovedStatic, MovedDynamic);
+	StaticRenderer->Cleanup();
+	delete StaticRenderer;
+	remove(CachePath);
+	return bPassed;
+}
@@ -0,0 +1,151 @@
+#include "pch.h"
+#include "StaticBatcher.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <functional>
+
+// Bits of each axis in a Morton code, 3 of them fit in 64 bits
+static const uint32_t MortonBits = 21;
+
+// Spreads the low 21 bits of Value 3 bits apart
+static uint64_t SpreadBits(uint64_t Value)
+{
+	Value &= 0x1FFFFF;
+	Value = (Value | Value << 32) & 0x001F00000000FFFFull;
+	Value = (Value | Value << 16) & 0x001F0000FF0000FFull;
+	Value = (Value | Value << 8) & 0x100F00F00F00F00Full;
+	Value = (Value | Value << 4) & 0x10C30C30C30C30C3ull;
+	Value = (Value | Value << 2) & 0x1249249249249249ull;
+	return Value;
+}
+
+bool CStaticBatcher::Add(const CMesh* Geometry, const XMFLOAT4X4& World, const StaticMaterial& Material)
+{
+	// The batches are neither optimized nor given tangent frames, they keep those of the meshes baked into them
+	if (Geometry->Vertices.empty() || Geometry->Indices.empty() || !Geometry->bOptimized || !Geometry->bHasTangentFrames)
+	{
+		return false;
+	}
+	Instances.push_back({ Geometry, World, Material, 0 });
+	return true;
+}
+
+void CStaticBatcher::Bake(const StaticInstance& Instance, std::vector<Vertex>& OutVertices, std::vector<unsigned int>& OutIndices)
+{
+	const XMMATRIX World = XMLoadFloat4x4(&Instance.World);
+
+	// Normals follow the inverse transpose so they stay perpendicular under a non uniform scale, a mirroring transform
+	// flips the handedness and the winding
+	XMVECTOR Determinant;
+	const XMMATRIX NormalMatrix = XMMatrixTranspose(XMMatrixInverse(&Determinant, World));
+	const bool bMirrored = XMVectorGetX(Determinant) < 0.0f;
+
+	const std::vector<Vertex>& Vertices = Instance.Geometry->Vertices;
+	const unsigned int FirstVertex = static_cast<unsigned int>(OutVertices.size());
+	OutVertices.resize(OutVertices.size() + Vertices.size());
+	for (size_t Index = 0; Index < Vertices.size(); ++Index)
+	{
+		const Vertex& Source = Vertices[Index];
+		Vertex& Baked = OutVertices[FirstVertex + Index];
+		XMStoreFloat3(&Baked.Pos, XMVector3TransformCoord(XMLoadFloat3(&Source.Pos), World));
+		Baked.TexCoord = Source.TexCoord;
+
+		const XMVECTOR Normal = XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&Source.Normal), NormalMatrix));
+		XMVECTOR Tangent = XMVector3TransformNormal(XMVectorSetW(XMLoadFloat4(&Source.Tangent), 0.0f), World);
+		Tangent = XMVector3Normalize(Tangent - Normal * XMVector3Dot(Normal, Tangent));
+		XMStoreFloat3(&Baked.Normal, Normal);
+		XMStoreFloat4(&Baked.Tangent, XMVectorSetW(Tangent, bMirrored ? -Source.Tangent.w : Source.Tangent.w));
+	}
+
+	const std::vector<unsigned int>& Indices = Instance.Geometry->Indices;
+	const size_t FirstIndex = OutIndices.size();
+	OutIndices.resize(OutIndices.size() + Indices.size());
+	for (size_t Index = 0; Index < Indices.size(); Index += 3)
+	{
+		OutIndices[FirstIndex + Index] = FirstVertex + Indices[Index];
+		OutIndices[FirstIndex + Index + 1] = FirstVertex + Indices[bMirrored ? Index + 2 : Index + 1];
+		OutIndices[FirstIndex + Index + 2] = FirstVertex + Indices[bMirrored ? Index + 1 : Index + 2];
+	}
+}
+
+bool CStaticBatcher::Build(CGeometryPool* GeometryPool, CRHICommandList* CommandList, std::vector<CMesh*>& OutBatches,
+	std::vector<StaticMaterial>& OutMaterials)
+{
+	if (Instances.empty())
+	{
+		return true;
+	}
+
+	// Centers of the meshes in world space, quantized in their box to order them along the Morton curve
+	std::vector<XMFLOAT3> Centers(Instances.size());
+	XMVECTOR Min = XMVectorReplicate(FLT_MAX);
+	XMVECTOR Max = XMVectorReplicate(-FLT_MAX);
+	for (size_t Index = 0; Index < Instances.size(); ++Index)
+	{
+		const XMVECTOR Center = XMVector3TransformCoord(XMLoadFloat3(&Instances[Index].Geometry->BoundsCenter), XMLoadFloat4x4(&Instances[Index].World));
+		XMStoreFloat3(&Centers[Index], Center);
+		Min = XMVectorMin(Min, Center);
+		Max = XMVectorMax(Max, Center);
+	}
+	const XMVECTOR Scale = XMVectorReplicate(float((1u << MortonBits) - 1)) / XMVectorMax(Max - Min, XMVectorReplicate(FLT_MIN));
+	for (size_t Index = 0; Index < Instances.size(); ++Index)
+	{
+		XMFLOAT3 Cell;
+		XMStoreFloat3(&Cell, (XMLoadFloat3(&Centers[Index]) - Min) * Scale);
+		Instances[Index].MortonCode = SpreadBits(uint64_t(Cell.x)) | SpreadBits(uint64_t(Cell.y)) << 1 | SpreadBits(uint64_t(Cell.z)) << 2;
+	}
+
+	// Materials first so a sub-batch never mixes two of them, stable so equal codes keep the order they were added in
+	std::stable_sort(Instances.begin(), Instances.end(), [](const StaticInstance& A, const StaticInstance& B)
+	{
+		if (A.Material.PSO != B.Material.PSO) return std::less<CRHIPipelineState*>()(A.Material.PSO, B.Material.PSO);
+		if (A.Material.Texture != B.Material.Texture) return std::less<CRHIResource*>()(A.Material.Texture, B.Material.Texture);
+		return A.MortonCode < B.MortonCode;
+	});
+
+	size_t First = 0;
+	while (First < Instances.size())
+	{
+		// Nearby meshes of the same material until the next one would overflow the vertex budget
+		size_t End = First + 1;
+		size_t VertexCount = Instances[First].Geometry->Vertices.size();
+		while (End < Instances.size() && Instances[End].Material == Instances[First].Material
+			&& VertexCount + Instances[End].Geometry->Vertices.size() <= MaxSubBatchVertices)
+		{
+			VertexCount += Instances[End].Geometry->Vertices.size();
+			++End;
+		}
+
+		CMesh* Batch = new CMesh;
+		Batch->Vertices.reserve(VertexCount);
+		for (size_t Index = First; Index < End; ++Index)
+		{
+			Bake(Instances[Index], Batch->Vertices, Batch->Indices);
+		}
+
+		// Add only takes meshes already in vertex cache order with their tangent frames, Init only packs and uploads
+		Batch->bHasTangentFrames = true;
+		Batch->bOptimized = true;
+		if (!Batch->Init(GeometryPool, CommandList))
+		{
+			delete Batch;
+			Instances.clear();
+			return false;
+		}
+
+		// The CPU copy is only needed to create the buffers
+		if (!bKeepCPUCopy)
+		{
+			std::vector<Vertex>().swap(Batch->Vertices);
+			std::vector<unsigned int>().swap(Batch->Indices);
+		}
+
+		OutBatches.push_back(Batch);
+		OutMaterials.push_back(Instances[First].Material);
+		First = End;
+	}
+
+	Instances.clear();
+	return true;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "Mesh.h"
+
+#include <vector>
+
+// What a draw binds besides its geometry, only static meshes with the same material are merged
+struct StaticMaterial
+{
+	CRHIPipelineState* PSO = nullptr;
+	CRHIResource* Texture = nullptr;
+
+	bool operator==(const StaticMaterial& Other) const
+	{
+		return PSO == Other.PSO && Texture == Other.Texture;
+	}
+};
+
+// Bakes meshes that never move into a few meshes already in world space, one draw per sub-batch instead of one per mesh.
+// Meshes are grouped by material then cut along a Morton curve into sub-batches of nearby meshes, each with its own bounds
+// so they are still culled. Sub-batches are only drawn at full detail, the LODs of the baked meshes are dropped
+class CStaticBatcher
+{
+public:
+	// Geometry is the mesh whose CPU Vertices and Indices are baked, the mesh itself or the source of a shared mesh.
+	// Returns false when Geometry has no CPU copy, as with a mesh loaded from a cache, or was not optimized with its
+	// tangent frames yet, as Init does. It then has to be drawn on its own
+	bool Add(const CMesh* Geometry, const XMFLOAT4X4& World, const StaticMaterial& Material);
+
+	// Records the upload of one new mesh per sub-batch, with an identity transform, and forgets the added meshes.
+	// The caller owns the meshes appended to OutBatches, OutMaterials gets the material of each one. Returns false when
+	// the pool is out of memory, the batches uploaded before are still appended
+	bool Build(CGeometryPool* GeometryPool, CRHICommandList* CommandList, std::vector<CMesh*>& OutBatches,
+		std::vector<StaticMaterial>& OutMaterials);
+
+	// Largest number of vertices of a sub-batch, a bigger mesh gets a sub-batch of its own. Up to 0x10000 they use 16 bits
+	// indices, smaller sub-batches cover less space and are culled more tightly for a few more draws
+	uint32_t MaxSubBatchVertices = 0x4000;
+
+	// Keeps the Vertices and Indices of the batches after their upload instead of freeing them, to check them
+	bool bKeepCPUCopy = false;
+
+private:
+
+	struct StaticInstance
+	{
+		const CMesh* Geometry;
+		XMFLOAT4X4 World;
+		StaticMaterial Material;
+
+		// Position of the mesh's center along the Morton curve, filled by Build
+		uint64_t MortonCode;
+	};
+
+	// Appends Instance moved to world space to the vertices and indices of a sub-batch
+	static void Bake(const StaticInstance& Instance, std::vector<Vertex>& OutVertices, std::vector<unsigned int>& OutIndices);
+
+	std::vector<StaticInstance> Instances;
+};
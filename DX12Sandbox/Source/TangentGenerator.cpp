@@ -0,0 +1,283 @@
+#include "pch.h"
+#include "TangentGenerator.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+// Triangles or vertices a job takes at a time
+static const size_t BatchSize = 1 << 14;
+
+// Smallest w of an encoded quaternion, one step of a 16 bits component, its sign must survive the quantization
+static const float QTangentBias = 1.0f / 32767.0f;
+
+// Runs Function(Begin, End) over [0, Count) on at most ThreadCount threads of the job system
+template<typename FunctionType>
+static void ParallelFor(size_t Count, uint32_t ThreadCount, const FunctionType& Function)
+{
+	CJobSystem::Get().ParallelFor(Count, BatchSize, Function, ThreadCount);
+}
+
+// Any unit vector perpendicular to Normal, for tangents the texture coordinates can't give
+static XMVECTOR AnyPerpendicular(FXMVECTOR Normal)
+{
+	const XMVECTOR Axis = fabsf(XMVectorGetX(Normal)) < 0.9f ? g_XMIdentityR0 : g_XMIdentityR1;
+	return XMVector3Normalize(XMVector3Cross(Normal, Axis));
+}
+
+void CTangentGenerator::Generate(std::vector<Vertex>& Vertices, std::vector<unsigned int>& Indices, uint32_t ThreadCount)
+{
+	const size_t TriangleCount = Indices.size() / 3;
+
+	// Per corner : the direction of its face and its angle. Per triangle : the direction of increasing U and the
+	// handedness of the texture mapping, 0 when the texture coordinates are degenerate
+	std::vector<XMFLOAT3> CornerNormals(TriangleCount * 3);
+	std::vector<float> CornerAngles(TriangleCount * 3);
+	std::vector<XMFLOAT3> TriangleTangents(TriangleCount);
+	std::vector<int8_t> TriangleSigns(TriangleCount);
+
+	ParallelFor(TriangleCount, ThreadCount, [&](size_t Begin, size_t End)
+	{
+		for (size_t Triangle = Begin; Triangle < End; ++Triangle)
+		{
+			const Vertex* Corners[3] = { &Vertices[Indices[Triangle * 3]], &Vertices[Indices[Triangle * 3 + 1]], &Vertices[Indices[Triangle * 3 + 2]] };
+			const XMVECTOR Positions[3] = { XMLoadFloat3(&Corners[0]->Pos), XMLoadFloat3(&Corners[1]->Pos), XMLoadFloat3(&Corners[2]->Pos) };
+
+			const XMVECTOR Edge1 = Positions[1] - Positions[0];
+			const XMVECTOR Edge2 = Positions[2] - Positions[0];
+			const XMVECTOR FaceNormal = XMVector3Normalize(XMVector3Cross(Edge1, Edge2));
+
+			for (uint32_t Corner = 0; Corner < 3; ++Corner)
+			{
+				const XMVECTOR ToNext = XMVector3Normalize(Positions[(Corner + 1) % 3] - Positions[Corner]);
+				const XMVECTOR ToPrevious = XMVector3Normalize(Positions[(Corner + 2) % 3] - Positions[Corner]);
+				const float Cosine = std::min(std::max(XMVectorGetX(XMVector3Dot(ToNext, ToPrevious)), -1.0f), 1.0f);
+				XMStoreFloat3(&CornerNormals[Triangle * 3 + Corner], FaceNormal);
+				CornerAngles[Triangle * 3 + Corner] = acosf(Cosine);
+			}
+
+			const float DeltaU1 = Corners[1]->TexCoord.x - Corners[0]->TexCoord.x;
+			const float DeltaV1 = Corners[1]->TexCoord.y - Corners[0]->TexCoord.y;
+			const float DeltaU2 = Corners[2]->TexCoord.x - Corners[0]->TexCoord.x;
+			const float DeltaV2 = Corners[2]->TexCoord.y - Corners[0]->TexCoord.y;
+			const float Area = DeltaU1 * DeltaV2 - DeltaV1 * DeltaU2;
+
+			// Derivatives of the position along U and V, up to the factor 1 / Area whose sign is the one that matters
+			const float AreaSign = Area < 0.0f ? -1.0f : 1.0f;
+			const XMVECTOR AlongU = (Edge1 * DeltaV2 - Edge2 * DeltaV1) * AreaSign;
+			const XMVECTOR AlongV = (Edge2 * DeltaU1 - Edge1 * DeltaU2) * AreaSign;
+			const float Handedness = XMVectorGetX(XMVector3Dot(XMVector3Cross(FaceNormal, AlongU), AlongV));
+
+			const bool bDegenerate = Area == 0.0f || XMVector3Equal(XMVector3LengthSq(AlongU), XMVectorZero()) || Handedness == 0.0f;
+			XMStoreFloat3(&TriangleTangents[Triangle], bDegenerate ? XMVectorZero() : XMVector3Normalize(AlongU));
+			TriangleSigns[Triangle] = bDegenerate ? 0 : (Handedness < 0.0f ? -1 : 1);
+		}
+	});
+
+	// A vertex used by mirrored and non mirrored triangles is split, the mirrored ones get the copy
+	const size_t SourceVertexCount = Vertices.size();
+	std::vector<uint8_t> UsedSigns(SourceVertexCount, 0);
+	for (size_t Corner = 0; Corner < Indices.size(); ++Corner)
+	{
+		const int8_t Sign = TriangleSigns[Corner / 3];
+		UsedSigns[Indices[Corner]] |= Sign > 0 ? 1 : (Sign < 0 ? 2 : 0);
+	}
+	std::vector<unsigned int> MirroredCopies(SourceVertexCount, 0);
+	for (size_t Index = 0; Index < SourceVertexCount; ++Index)
+	{
+		if (UsedSigns[Index] == 3)
+		{
+			MirroredCopies[Index] = static_cast<unsigned int>(Vertices.size());
+			Vertices.push_back(Vertices[Index]);
+		}
+	}
+	for (size_t Corner = 0; Corner < Indices.size(); ++Corner)
+	{
+		if (TriangleSigns[Corner / 3] < 0 && UsedSigns[Indices[Corner]] == 3)
+		{
+			Indices[Corner] = MirroredCopies[Indices[Corner]];
+		}
+	}
+
+	// Corners of each vertex in index order, the sums over them don't depend on the threads
+	const size_t VertexCount = Vertices.size();
+	std::vector<uint32_t> FirstCorners(VertexCount + 1, 0);
+	for (unsigned int Index : Indices)
+	{
+		++FirstCorners[Index + 1];
+	}
+	std::partial_sum(FirstCorners.begin(), FirstCorners.end(), FirstCorners.begin());
+	std::vector<uint32_t> VertexCorners(Indices.size());
+	{
+		std::vector<uint32_t> Cursors(FirstCorners.begin(), FirstCorners.end() - 1);
+		for (size_t Corner = 0; Corner < Indices.size(); ++Corner)
+		{
+			VertexCorners[Cursors[Indices[Corner]]++] = uint32_t(Corner);
+		}
+	}
+
+	// Vertices at the same position, split by texture seams or by the handedness, are next to each other in this order.
+	// The positions are sorted along with the indices, the comparisons don't go back to the vertices
+	struct PositionKey
+	{
+		XMFLOAT3 Pos;
+		uint32_t Index;
+	};
+	std::vector<PositionKey> Keys(VertexCount);
+	for (uint32_t Index = 0; Index < VertexCount; ++Index)
+	{
+		Keys[Index] = { Vertices[Index].Pos, Index };
+	}
+	std::sort(Keys.begin(), Keys.end(), [](const PositionKey& A, const PositionKey& B)
+	{
+		if (A.Pos.x != B.Pos.x) return A.Pos.x < B.Pos.x;
+		if (A.Pos.y != B.Pos.y) return A.Pos.y < B.Pos.y;
+		if (A.Pos.z != B.Pos.z) return A.Pos.z < B.Pos.z;
+		return A.Index < B.Index;
+	});
+	std::vector<uint32_t> PositionOrder(VertexCount);
+	std::vector<uint32_t> GroupStarts;
+	for (uint32_t Position = 0; Position < VertexCount; ++Position)
+	{
+		const XMFLOAT3& Current = Keys[Position].Pos;
+		const XMFLOAT3* Previous = Position > 0 ? &Keys[Position - 1].Pos : nullptr;
+		if (!Previous || Previous->x != Current.x || Previous->y != Current.y || Previous->z != Current.z)
+		{
+			GroupStarts.push_back(Position);
+		}
+		PositionOrder[Position] = Keys[Position].Index;
+	}
+	GroupStarts.push_back(uint32_t(VertexCount));
+
+	// Normals, angle weighted over the corners of the group close enough to the vertex's own faces
+	const float CosCrease = cosf(CreaseAngle);
+	const float CosHalfCrease = cosf(CreaseAngle * 0.5f);
+	ParallelFor(GroupStarts.size() - 1, ThreadCount, [&](size_t Begin, size_t End)
+	{
+		for (size_t Group = Begin; Group < End; ++Group)
+		{
+			const uint32_t* GroupVertices = PositionOrder.data() + GroupStarts[Group];
+			const uint32_t GroupSize = GroupStarts[Group + 1] - GroupStarts[Group];
+
+			// Sums the corners of the group accepted by Filter, in the same order for every vertex of the group
+			auto SumCorners = [&](auto Filter)
+			{
+				XMVECTOR Sum = XMVectorZero();
+				for (uint32_t Member = 0; Member < GroupSize; ++Member)
+				{
+					for (uint32_t Slot = FirstCorners[GroupVertices[Member]]; Slot < FirstCorners[GroupVertices[Member] + 1]; ++Slot)
+					{
+						const XMVECTOR CornerNormal = XMLoadFloat3(&CornerNormals[VertexCorners[Slot]]);
+						if (Filter(GroupVertices[Member], CornerNormal))
+						{
+							Sum += CornerNormal * CornerAngles[VertexCorners[Slot]];
+						}
+					}
+				}
+				return Sum;
+			};
+
+			// Usually the vertex is alone or every face of the group is within half the crease angle of their average, they
+			// are then all within the crease angle of each other and every vertex of the group gets the same normal
+			const XMVECTOR GroupNormal = XMVector3Normalize(SumCorners([](uint32_t, FXMVECTOR) { return true; }));
+			bool bSmooth = true;
+			if (GroupSize > 1)
+			{
+				SumCorners([&](uint32_t, FXMVECTOR CornerNormal)
+				{
+					bSmooth &= XMVectorGetX(XMVector3Dot(CornerNormal, GroupNormal)) >= CosHalfCrease || XMVector3Equal(CornerNormal, XMVectorZero());
+					return false;
+				});
+			}
+
+			for (uint32_t Member = 0; Member < GroupSize; ++Member)
+			{
+				const uint32_t Index = GroupVertices[Member];
+				XMVECTOR Normal = GroupNormal;
+				if (!bSmooth)
+				{
+					const XMVECTOR Own = XMVector3Normalize(SumCorners([&](uint32_t Owner, FXMVECTOR) { return Owner == Index; }));
+					Normal = XMVector3Normalize(SumCorners([&](uint32_t Owner, FXMVECTOR CornerNormal)
+					{
+						return Owner == Index || XMVectorGetX(XMVector3Dot(CornerNormal, Own)) >= CosCrease;
+					}));
+				}
+				if (XMVector3Equal(XMVector3LengthSq(Normal), XMVectorZero()) || XMVector3IsNaN(Normal))
+				{
+					Normal = g_XMIdentityR1;
+				}
+				XMStoreFloat3(&Vertices[Index].Normal, Normal);
+			}
+		}
+	});
+
+	// Tangents, the tangent of each triangle projected on the vertex normal and weighted by the corner angle
+	ParallelFor(VertexCount, ThreadCount, [&](size_t Begin, size_t End)
+	{
+		for (size_t Index = Begin; Index < End; ++Index)
+		{
+			const XMVECTOR Normal = XMLoadFloat3(&Vertices[Index].Normal);
+			XMVECTOR Tangent = XMVectorZero();
+			float Sign = 1.0f;
+			for (uint32_t Slot = FirstCorners[Index]; Slot < FirstCorners[Index + 1]; ++Slot)
+			{
+				const uint32_t Corner = VertexCorners[Slot];
+				const XMVECTOR TriangleTangent = XMLoadFloat3(&TriangleTangents[Corner / 3]);
+				const XMVECTOR Projected = TriangleTangent - Normal * XMVector3Dot(Normal, TriangleTangent);
+				if (TriangleSigns[Corner / 3] != 0 && !XMVector3Equal(XMVector3LengthSq(Projected), XMVectorZero()))
+				{
+					Tangent += XMVector3Normalize(Projected) * CornerAngles[Corner];
+					Sign = float(TriangleSigns[Corner / 3]);
+				}
+			}
+
+			// Summed projections are in the plane up to rounding, Gram-Schmidt keeps the frame orthonormal
+			Tangent = Tangent - Normal * XMVector3Dot(Normal, Tangent);
+			Tangent = XMVector3Equal(XMVector3LengthSq(Tangent), XMVectorZero()) ? AnyPerpendicular(Normal) : XMVector3Normalize(Tangent);
+			XMStoreFloat4(&Vertices[Index].Tangent, XMVectorSetW(Tangent, Sign));
+		}
+	});
+}
+
+PackedVector::XMSHORTN4 CTangentGenerator::EncodeQTangent(const XMFLOAT3& Normal, const XMFLOAT4& Tangent)
+{
+	const XMVECTOR N = XMLoadFloat3(&Normal);
+	const XMVECTOR T = XMVectorSetW(XMLoadFloat4(&Tangent), 0.0f);
+	const XMMATRIX Frame(T, XMVector3Cross(N, T), N, g_XMIdentityR3);
+
+	// q and -q are the same rotation, w is made positive then the sign of the whole quaternion is the handedness
+	XMVECTOR Quaternion = XMQuaternionNormalize(XMQuaternionRotationMatrix(Frame));
+	if (XMVectorGetW(Quaternion) < 0.0f)
+	{
+		Quaternion = -Quaternion;
+	}
+	if (XMVectorGetW(Quaternion) < QTangentBias)
+	{
+		const float Scale = sqrtf(1.0f - QTangentBias * QTangentBias);
+		Quaternion = XMVectorSetW(XMVector3Normalize(Quaternion) * Scale, QTangentBias);
+	}
+	if (Tangent.w < 0.0f)
+	{
+		Quaternion = -Quaternion;
+	}
+
+	PackedVector::XMSHORTN4 Packed;
+	PackedVector::XMStoreShortN4(&Packed, Quaternion);
+	return Packed;
+}
+
+void CTangentGenerator::DecodeQTangent(const PackedVector::XMSHORTN4& QTangent, XMFLOAT3& OutNormal, XMFLOAT4& OutTangent)
+{
+	// Same math as the vertex shaders : v + 2 * cross(q.xyz, cross(q.xyz, v) + q.w * v)
+	const XMVECTOR Quaternion = XMQuaternionNormalize(PackedVector::XMLoadShortN4(&QTangent));
+	const XMVECTOR Axis = XMVectorSetW(Quaternion, 0.0f);
+	const XMVECTOR W = XMVectorSplatW(Quaternion);
+	auto Rotate = [&](FXMVECTOR V)
+	{
+		return V + 2.0f * XMVector3Cross(Axis, XMVector3Cross(Axis, V) + W * V);
+	};
+
+	XMStoreFloat3(&OutNormal, Rotate(g_XMIdentityR2));
+	XMStoreFloat4(&OutTangent, XMVectorSetW(Rotate(g_XMIdentityR0), XMVectorGetW(Quaternion) < 0.0f ? -1.0f : 1.0f));
+}
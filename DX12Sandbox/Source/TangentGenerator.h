@@ -0,0 +1,28 @@
+#pragma once
+#include "Mesh.h"
+
+#include <vector>
+
+// Builds the normals and tangents of a mesh from its positions and texture coordinates. The tangents follow MikkTSpace:
+// the tangent of each triangle is projected on the vertex normal and weighted by the corner angle, and vertices shared by
+// mirrored and non mirrored triangles are split so each copy has a single handedness.
+// The output only depends on the mesh, not on the number of threads : triangles write their own corners, vertices sum
+// their corners in index order.
+class CTangentGenerator
+{
+public:
+	// Fills Normal and Tangent of every vertex, may append vertices and remap Indices to split the handedness
+	// Normals point to the side the triangles are clockwise from, like the front faces of the renderer. Vertices at the same
+	// position share their normal unless their faces are further apart than the crease angle
+	static void Generate(std::vector<Vertex>& Vertices, std::vector<unsigned int>& Indices, uint32_t ThreadCount = 0);
+
+	// Quaternion of the rotation taking X, Y and Z to the tangent, the bitangent and the normal, 16 bits per component.
+	// w is kept away from 0 so its sign can hold the handedness
+	static PackedVector::XMSHORTN4 EncodeQTangent(const XMFLOAT3& Normal, const XMFLOAT4& Tangent);
+
+	// Back to the normal and the tangent, what the vertex shaders do
+	static void DecodeQTangent(const PackedVector::XMSHORTN4& QTangent, XMFLOAT3& OutNormal, XMFLOAT4& OutTangent);
+
+	// Faces further apart than this don't smooth their normals together, in radians
+	static constexpr float CreaseAngle = XM_PI / 3.0f;
+};
@@ -0,0 +1,279 @@
+#include "pch.h"
+#include "Bench.h"
+#include "Actor.h"
+#include "TransformStore.h"
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+// Moving and turning transforms through the store, against what the Actor setters used to do : the world matrix
+// rebuilt on every call
+static void BenchmarkTransformUpdate()
+{
+	const int ActorCount = 4096;
+	const int Iterations = 256;
+
+	// Keeps the compiler from removing the work
+	volatile float Sink = 0.0f;
+
+	struct EagerTransform
+	{
+		XMFLOAT3 Position;
+		XMFLOAT3 Rotation;
+		XMFLOAT4X4 WorldMatrix;
+	};
+	std::vector<EagerTransform> EagerTransforms(ActorCount);
+	auto RecomputeEager = [](EagerTransform& Transform)
+	{
+		const XMMATRIX RotationMatrix = XMMatrixRotationRollPitchYaw(XMConvertToRadians(Transform.Rotation.x),
+			XMConvertToRadians(Transform.Rotation.y), XMConvertToRadians(Transform.Rotation.z));
+		XMStoreFloat4x4(&Transform.WorldMatrix, RotationMatrix * XMMatrixTranslation(Transform.Position.x, Transform.Position.y, Transform.Position.z));
+	};
+	const double EagerNs = MeasureNs(Iterations, [&](int Iteration)
+	{
+		for (int Index = 0; Index < ActorCount; ++Index)
+		{
+			EagerTransform& Transform = EagerTransforms[Index];
+			Transform.Rotation = XMFLOAT3(float(Index % 360 + Iteration), float(Index * 7 % 360), float(Index * 13 % 360));
+			RecomputeEager(Transform);
+			Transform.Position = XMFLOAT3(float(Index), float(Iteration), 0.0f);
+			RecomputeEager(Transform);
+		}
+		Sink = Sink + EagerTransforms[Iteration % ActorCount].WorldMatrix._41;
+	}) / ActorCount;
+
+	// The setters only write the arrays and flag the transform, the matrices are rebuilt once, 4 at a time
+	CTransformStore& Store = CTransformStore::Get();
+	std::vector<uint32_t> Handles(ActorCount);
+	for (int Index = 0; Index < ActorCount; ++Index)
+	{
+		Handles[Index] = Store.Allocate();
+	}
+	const double StoreNs = MeasureNs(Iterations, [&](int Iteration)
+	{
+		for (int Index = 0; Index < ActorCount; ++Index)
+		{
+			Store.SetRotation(Handles[Index], XMFLOAT3(float(Index % 360 + Iteration), float(Index * 7 % 360), float(Index * 13 % 360)));
+			Store.SetPosition(Handles[Index], XMFLOAT3(float(Index), float(Iteration), 0.0f));
+		}
+		Store.UpdateWorldMatrices();
+		Sink = Sink + Store.GetWorldMatrix(Handles[Iteration % ActorCount])._41;
+	}) / ActorCount;
+	for (uint32_t Handle : Handles)
+	{
+		Store.Free(Handle);
+	}
+
+	printf("Move and turn, rebuilt per setter    : %.2f ns/actor\n", EagerNs);
+	printf("Move and turn, store then update     : %.2f ns/actor\n", StoreNs);
+}
+
+void RunTransformBenchmarks()
+{
+	BenchmarkTransformUpdate();
+
+	const int ActorCount = 4096;
+	const int Iterations = 1 << 20;
+
+	std::vector<Actor*> Actors;
+	std::vector<XMFLOAT3> EulerRotations;
+	for (int Index = 0; Index < ActorCount; ++Index)
+	{
+		Actor* NewActor = new Actor();
+		EulerRotations.push_back(XMFLOAT3(float(Index % 360), float(Index * 7 % 360), float(Index * 13 % 360)));
+		NewActor->SetRotation(EulerRotations.back());
+		Actors.push_back(NewActor);
+	}
+
+	// Keeps the compiler from removing the work
+	volatile float Sink = 0.0f;
+
+	// What the direction getters used to do : a full rotation matrix built per axis and per call
+	const double MatrixNs = MeasureNs(Iterations, [&](int Iteration)
+	{
+		const XMFLOAT3& Rotation = EulerRotations[Iteration % ActorCount];
+		const XMMATRIX RotationMatrix = XMMatrixRotationRollPitchYaw(XMConvertToRadians(Rotation.x), XMConvertToRadians(Rotation.y), XMConvertToRadians(Rotation.z));
+		const XMVECTOR Forward = XMVector3TransformNormal(XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), RotationMatrix);
+		const XMVECTOR Right = XMVector3TransformNormal(XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f), RotationMatrix);
+		const XMVECTOR Up = XMVector3TransformNormal(XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f), RotationMatrix);
+		Sink = Sink + XMVectorGetX(Forward + Right + Up);
+	});
+
+	const double CachedNs = MeasureNs(Iterations, [&](int Iteration)
+	{
+		const Actor* CurrentActor = Actors[Iteration % ActorCount];
+		const XMFLOAT3 Forward = CurrentActor->GetForwardVector();
+		const XMFLOAT3 Right = CurrentActor->GetRightVector();
+		const XMFLOAT3 Up = CurrentActor->GetUpVector();
+		Sink = Sink + Forward.x + Right.x + Up.x;
+	});
+
+	printf("Forward/Right/Up from rotation matrix: %.2f ns\n", MatrixNs);
+	printf("Forward/Right/Up from cached basis   : %.2f ns\n", CachedNs);
+
+	// World bounds of the same actors, one at a time through their world matrix then in a batch over the store
+	CTransformStore::Get().UpdateWorldMatrices();
+	std::vector<uint32_t> Handles;
+	std::vector<BoundingVolume> LocalVolumes(ActorCount), WorldVolumes(ActorCount);
+	for (int Index = 0; Index < ActorCount; ++Index)
+	{
+		Handles.push_back(Actors[Index]->GetTransformHandle());
+		LocalVolumes[Index].Center = XMFLOAT3(0.1f, 0.2f, 0.3f);
+		LocalVolumes[Index].Extents = XMFLOAT3(1.0f, 2.0f, 0.5f);
+		LocalVolumes[Index].Radius = 2.3f;
+	}
+
+	const double SingleBoundsNs = MeasureNs(256, [&](int)
+	{
+		for (int Index = 0; Index < ActorCount; ++Index)
+		{
+			const XMFLOAT4X4 World = Actors[Index]->GetWorldMatrix();
+			WorldVolumes[Index] = TransformBoundingVolume(XMLoadFloat4x4(&World), LocalVolumes[Index]);
+		}
+	}) / ActorCount;
+	const double BatchBoundsNs = MeasureNs(256, [&](int)
+	{
+		CTransformStore::Get().TransformBounds(Handles.data(), LocalVolumes.data(), ActorCount, WorldVolumes.data());
+	}) / ActorCount;
+
+	printf("World bounds, one actor at a time    : %.2f ns\n", SingleBoundsNs);
+	printf("World bounds, batched                : %.2f ns\n", BatchBoundsNs);
+
+	for (Actor* CurrentActor : Actors)
+	{
+		delete CurrentActor;
+	}
+}
+
+// Scale, then rotation around X, Y and Z in degrees, then translation, the order the store composes them in
+static XMMATRIX XM_CALLCONV ComposeLocalMatrix(const XMFLOAT3& Position, const XMFLOAT3& Rotation, const XMFLOAT3& Scale)
+{
+	return XMMatrixScaling(Scale.x, Scale.y, Scale.z) * XMMatrixRotationX(XMConvertToRadians(Rotation.x))
+		* XMMatrixRotationY(XMConvertToRadians(Rotation.y)) * XMMatrixRotationZ(XMConvertToRadians(Rotation.z))
+		* XMMatrixTranslation(Position.x, Position.y, Position.z);
+}
+
+static bool IsNearlyEqual(const XMFLOAT4X4& Actual, XMMATRIX Expected)
+{
+	XMFLOAT4X4 ExpectedValues;
+	XMStoreFloat4x4(&ExpectedValues, Expected);
+	for (int Row = 0; Row < 4; ++Row)
+	{
+		for (int Column = 0; Column < 4; ++Column)
+		{
+			if (fabsf(Actual.m[Row][Column] - ExpectedValues.m[Row][Column]) > 1e-4f)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool RunTransformChecks()
+{
+	CTransformStore& Store = CTransformStore::Get();
+	bool bPassed = true;
+
+	// A chain of three, the root scaled non uniformly and every level turned and moved
+	Actor* Root = new Actor();
+	Actor* Child = new Actor();
+	Actor* GrandChild = new Actor();
+	const XMFLOAT3 ChildPosition(1.0f, 0.5f, 0.0f), ChildRotation(0.0f, 30.0f, 10.0f), One(1.0f, 1.0f, 1.0f);
+	const XMFLOAT3 GrandChildPosition(0.0f, 2.0f, -1.0f), GrandChildRotation(45.0f, 0.0f, 0.0f);
+	Child->SetPosition(ChildPosition);
+	Child->SetRotation(ChildRotation);
+	GrandChild->SetPosition(GrandChildPosition);
+	GrandChild->SetRotation(GrandChildRotation);
+	bPassed &= Check(Child->SetParent(Root) && GrandChild->SetParent(Child), "parenting : a chain of three is accepted");
+	bPassed &= Check(!Root->SetParent(GrandChild) && !Child->SetParent(Child) && Root->GetParent() == nullptr,
+		"parenting : a parent can't become its own descendant");
+
+	auto ExpectedGrandChildWorld = [&](const XMFLOAT3& RootPosition, const XMFLOAT3& RootRotation, const XMFLOAT3& RootScale)
+	{
+		return ComposeLocalMatrix(GrandChildPosition, GrandChildRotation, One) * ComposeLocalMatrix(ChildPosition, ChildRotation, One)
+			* ComposeLocalMatrix(RootPosition, RootRotation, RootScale);
+	};
+
+	XMFLOAT3 RootPosition(3.0f, -1.0f, 2.0f), RootRotation(0.0f, 90.0f, 0.0f);
+	const XMFLOAT3 RootScale(2.0f, 1.0f, 0.5f);
+	Root->SetPosition(RootPosition);
+	Root->SetRotation(RootRotation);
+	Root->SetScale(RootScale);
+	Store.UpdateWorldMatrices();
+	bPassed &= Check(IsNearlyEqual(GrandChild->GetWorldMatrix(), ExpectedGrandChildWorld(RootPosition, RootRotation, RootScale)),
+		"propagation : the grand child combines the three local matrices after an update");
+
+	// Moving the root only flags it, the getter resolves the chain until the next update
+	RootPosition = XMFLOAT3(-5.0f, 4.0f, 1.0f);
+	RootRotation = XMFLOAT3(20.0f, -60.0f, 0.0f);
+	Root->SetPosition(RootPosition);
+	Root->SetRotation(RootRotation);
+	bPassed &= Check(IsNearlyEqual(GrandChild->GetWorldMatrix(), ExpectedGrandChildWorld(RootPosition, RootRotation, RootScale)),
+		"propagation : a moved root is seen by the grand child before the update");
+	Store.UpdateWorldMatrices();
+	bPassed &= Check(IsNearlyEqual(GrandChild->GetWorldMatrix(), ExpectedGrandChildWorld(RootPosition, RootRotation, RootScale)),
+		"propagation : and after it");
+
+	// Detached, the child's local transform is its world transform again, and the grand child follows it
+	Child->SetParent(nullptr);
+	Store.UpdateWorldMatrices();
+	bPassed &= Check(IsNearlyEqual(Child->GetWorldMatrix(), ComposeLocalMatrix(ChildPosition, ChildRotation, One))
+		&& IsNearlyEqual(GrandChild->GetWorldMatrix(), ComposeLocalMatrix(GrandChildPosition, GrandChildRotation, One)
+			* ComposeLocalMatrix(ChildPosition, ChildRotation, One)), "propagation : a detached child stops following its old parent");
+
+	delete GrandChild;
+	delete Child;
+	delete Root;
+
+	// Interpolation of a child under a sheared parent : the parent turned under a root scaled non uniformly, all three
+	// moved by the update. The result must not go through the world matrices, their decomposition would lose the shear
+	Actor* Levels[3] = { new Actor(), new Actor(), new Actor() };
+	Levels[1]->SetParent(Levels[0]);
+	Levels[2]->SetParent(Levels[1]);
+	const XMFLOAT3 Positions[2][3] = { { XMFLOAT3(1.0f, 0.0f, 2.0f), XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 1.0f, 0.0f) },
+		{ XMFLOAT3(2.0f, -1.0f, 2.0f), XMFLOAT3(1.0f, 0.5f, 0.0f), XMFLOAT3(0.0f, 2.0f, 1.0f) } };
+	const XMFLOAT3 Rotations[2][3] = { { XMFLOAT3(0.0f, 40.0f, 0.0f), XMFLOAT3(30.0f, 0.0f, 20.0f), XMFLOAT3(10.0f, 0.0f, 0.0f) },
+		{ XMFLOAT3(0.0f, 70.0f, 10.0f), XMFLOAT3(50.0f, 10.0f, 20.0f), XMFLOAT3(10.0f, 30.0f, 0.0f) } };
+	const XMFLOAT3 Scales[2][3] = { { XMFLOAT3(2.0f, 1.0f, 0.5f), One, One }, { XMFLOAT3(1.5f, 1.0f, 0.75f), One, XMFLOAT3(1.0f, 2.0f, 1.0f) } };
+	XMFLOAT4 Quaternions[2][3];
+	for (int Update = 0; Update < 2; ++Update)
+	{
+		for (int Level = 0; Level < 3; ++Level)
+		{
+			Levels[Level]->SetPosition(Positions[Update][Level]);
+			Levels[Level]->SetRotation(Rotations[Update][Level]);
+			Levels[Level]->SetScale(Scales[Update][Level]);
+			Quaternions[Update][Level] = Levels[Level]->GetRotationQuaternion();
+		}
+		Store.UpdateWorldMatrices();
+	}
+
+	auto ExpectedChildWorld = [&](int Update)
+	{
+		return ComposeLocalMatrix(Positions[Update][2], Rotations[Update][2], Scales[Update][2])
+			* ComposeLocalMatrix(Positions[Update][1], Rotations[Update][1], Scales[Update][1])
+			* ComposeLocalMatrix(Positions[Update][0], Rotations[Update][0], Scales[Update][0]);
+	};
+	XMMATRIX HalfwayChildWorld = XMMatrixIdentity();
+	for (int Level = 0; Level < 3; ++Level)
+	{
+		HalfwayChildWorld = HalfwayChildWorld * XMMatrixAffineTransformation(
+			XMVectorLerp(XMLoadFloat3(&Scales[0][Level]), XMLoadFloat3(&Scales[1][Level]), 0.5f), XMVectorZero(),
+			XMQuaternionSlerp(XMLoadFloat4(&Quaternions[0][Level]), XMLoadFloat4(&Quaternions[1][Level]), 0.5f),
+			XMVectorLerp(XMLoadFloat3(&Positions[0][Level]), XMLoadFloat3(&Positions[1][Level]), 0.5f));
+	}
+	const uint32_t ChildHandle = Levels[2]->GetTransformHandle();
+	bPassed &= Check(IsNearlyEqual(Store.GetInterpolatedWorldMatrix(ChildHandle, 0.0f), ExpectedChildWorld(0))
+		&& IsNearlyEqual(Store.GetInterpolatedWorldMatrix(ChildHandle, 1.0f), ExpectedChildWorld(1)),
+		"interpolation : a child under a sheared parent is where it was at 0 and where it is at 1");
+	bPassed &= Check(IsNearlyEqual(Store.GetInterpolatedWorldMatrix(ChildHandle, 0.5f), HalfwayChildWorld),
+		"interpolation : and halfway, its local transform and its parents' halfway combined");
+
+	for (int Level = 2; Level >= 0; --Level)
+	{
+		delete Levels[Level];
+	}
+	return bPassed;
+}
@@ -0,0 +1,731 @@
+#include "pch.h"
+#include "TransformStore.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Transforms a job updates at a time, a multiple of 4 so the batches line up with the vectors
+static const size_t TransformsPerBatch = 4096;
+
+// The SoA arrays are only float aligned, unaligned loads cost the same on any recent CPU
+static inline XMVECTOR XM_CALLCONV LoadFloat4(const float* Source)
+{
+	return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(Source));
+}
+
+// Reorders Array so that its element i is the element Order[i] of the old array
+template<typename T>
+static void Permute(std::vector<T>& Array, const std::vector<uint32_t>& Order)
+{
+	std::vector<T> Sorted(Array.size());
+	for (size_t Index = 0; Index < Order.size(); ++Index)
+	{
+		Sorted[Index] = Array[Order[Index]];
+	}
+	Array.swap(Sorted);
+}
+
+CTransformStore& CTransformStore::Get()
+{
+	static CTransformStore Store;
+	return Store;
+}
+
+uint32_t CTransformStore::Allocate()
+{
+	uint32_t Handle;
+	if (!FreeHandles.empty())
+	{
+		Handle = FreeHandles.back();
+		FreeHandles.pop_back();
+	}
+	else
+	{
+		Handle = uint32_t(HandleToIndex.size());
+		HandleToIndex.push_back(0);
+	}
+
+	// A new root at the end keeps the depth first order
+	HandleToIndex[Handle] = GetCount();
+	IndexToHandle.push_back(Handle);
+
+	PositionX.push_back(0.0f);
+	PositionY.push_back(0.0f);
+	PositionZ.push_back(0.0f);
+	RotationX.push_back(0.0f);
+	RotationY.push_back(0.0f);
+	RotationZ.push_back(0.0f);
+	RotationW.push_back(1.0f);
+	RightX.push_back(1.0f);
+	RightY.push_back(0.0f);
+	RightZ.push_back(0.0f);
+	UpX.push_back(0.0f);
+	UpY.push_back(1.0f);
+	UpZ.push_back(0.0f);
+	ForwardX.push_back(0.0f);
+	ForwardY.push_back(0.0f);
+	ForwardZ.push_back(1.0f);
+	ScaleX.push_back(1.0f);
+	ScaleY.push_back(1.0f);
+	ScaleZ.push_back(1.0f);
+	PreviousPositionX.push_back(0.0f);
+	PreviousPositionY.push_back(0.0f);
+	PreviousPositionZ.push_back(0.0f);
+	PreviousRotationX.push_back(0.0f);
+	PreviousRotationY.push_back(0.0f);
+	PreviousRotationZ.push_back(0.0f);
+	PreviousRotationW.push_back(1.0f);
+	PreviousScaleX.push_back(1.0f);
+	PreviousScaleY.push_back(1.0f);
+	PreviousScaleZ.push_back(1.0f);
+	Dirty.push_back(0);
+	SubtreeDirty.push_back(0);
+	ParentHandles.push_back(INVALID_TRANSFORM_HANDLE);
+	ParentIndices.push_back(INVALID_TRANSFORM_HANDLE);
+	SubtreeSizes.push_back(1);
+
+	XMFLOAT4X4 Identity;
+	XMStoreFloat4x4(&Identity, XMMatrixIdentity());
+	LocalMatrices.push_back(Identity);
+	WorldMatrices.push_back(Identity);
+	Interpolated.push_back(0);
+	LocalChanged.push_back(0);
+
+	// Wherever it is first placed, it doesn't slide there from the origin
+	Teleported.push_back(1);
+
+	return Handle;
+}
+
+void CTransformStore::Free(uint32_t Handle)
+{
+	const uint32_t Index = HandleToIndex[Handle];
+	const uint32_t LastIndex = GetCount() - 1;
+
+	// Orphans keep their local transform, which is now relative to the world
+	for (uint32_t Child = 0; Child <= LastIndex; ++Child)
+	{
+		if (ParentHandles[Child] == Handle)
+		{
+			ParentHandles[Child] = INVALID_TRANSFORM_HANDLE;
+			Teleported[Child] = 1;
+			Dirty[Child] = 1;
+			bAnyDirty = true;
+			bHierarchyDirty = true;
+		}
+	}
+
+	// Move the last transform in the hole to keep the arrays packed
+	if (Index != LastIndex)
+	{
+		PositionX[Index] = PositionX[LastIndex];
+		PositionY[Index] = PositionY[LastIndex];
+		PositionZ[Index] = PositionZ[LastIndex];
+		RotationX[Index] = RotationX[LastIndex];
+		RotationY[Index] = RotationY[LastIndex];
+		RotationZ[Index] = RotationZ[LastIndex];
+		RotationW[Index] = RotationW[LastIndex];
+		RightX[Index] = RightX[LastIndex];
+		RightY[Index] = RightY[LastIndex];
+		RightZ[Index] = RightZ[LastIndex];
+		UpX[Index] = UpX[LastIndex];
+		UpY[Index] = UpY[LastIndex];
+		UpZ[Index] = UpZ[LastIndex];
+		ForwardX[Index] = ForwardX[LastIndex];
+		ForwardY[Index] = ForwardY[LastIndex];
+		ForwardZ[Index] = ForwardZ[LastIndex];
+		ScaleX[Index] = ScaleX[LastIndex];
+		ScaleY[Index] = ScaleY[LastIndex];
+		ScaleZ[Index] = ScaleZ[LastIndex];
+		PreviousPositionX[Index] = PreviousPositionX[LastIndex];
+		PreviousPositionY[Index] = PreviousPositionY[LastIndex];
+		PreviousPositionZ[Index] = PreviousPositionZ[LastIndex];
+		PreviousRotationX[Index] = PreviousRotationX[LastIndex];
+		PreviousRotationY[Index] = PreviousRotationY[LastIndex];
+		PreviousRotationZ[Index] = PreviousRotationZ[LastIndex];
+		PreviousRotationW[Index] = PreviousRotationW[LastIndex];
+		PreviousScaleX[Index] = PreviousScaleX[LastIndex];
+		PreviousScaleY[Index] = PreviousScaleY[LastIndex];
+		PreviousScaleZ[Index] = PreviousScaleZ[LastIndex];
+		Dirty[Index] = Dirty[LastIndex];
+		SubtreeDirty[Index] = SubtreeDirty[LastIndex];
+		ParentHandles[Index] = ParentHandles[LastIndex];
+		LocalMatrices[Index] = LocalMatrices[LastIndex];
+		WorldMatrices[Index] = WorldMatrices[LastIndex];
+		Interpolated[Index] = Interpolated[LastIndex];
+		LocalChanged[Index] = LocalChanged[LastIndex];
+		Teleported[Index] = Teleported[LastIndex];
+
+		const uint32_t MovedHandle = IndexToHandle[LastIndex];
+		IndexToHandle[Index] = MovedHandle;
+		HandleToIndex[MovedHandle] = Index;
+
+		// The moved transform may now be before its parent or in the middle of another subtree
+		bHierarchyDirty = true;
+	}
+	else if (ParentHandles[Index] != INVALID_TRANSFORM_HANDLE)
+	{
+		// Removing the last element keeps the order but the ancestors' subtree sizes are now wrong
+		bHierarchyDirty = true;
+	}
+
+	PositionX.pop_back();
+	PositionY.pop_back();
+	PositionZ.pop_back();
+	RotationX.pop_back();
+	RotationY.pop_back();
+	RotationZ.pop_back();
+	RotationW.pop_back();
+	RightX.pop_back();
+	RightY.pop_back();
+	RightZ.pop_back();
+	UpX.pop_back();
+	UpY.pop_back();
+	UpZ.pop_back();
+	ForwardX.pop_back();
+	ForwardY.pop_back();
+	ForwardZ.pop_back();
+	ScaleX.pop_back();
+	ScaleY.pop_back();
+	ScaleZ.pop_back();
+	PreviousPositionX.pop_back();
+	PreviousPositionY.pop_back();
+	PreviousPositionZ.pop_back();
+	PreviousRotationX.pop_back();
+	PreviousRotationY.pop_back();
+	PreviousRotationZ.pop_back();
+	PreviousRotationW.pop_back();
+	PreviousScaleX.pop_back();
+	PreviousScaleY.pop_back();
+	PreviousScaleZ.pop_back();
+	Dirty.pop_back();
+	SubtreeDirty.pop_back();
+	ParentHandles.pop_back();
+	ParentIndices.pop_back();
+	SubtreeSizes.pop_back();
+	LocalMatrices.pop_back();
+	WorldMatrices.pop_back();
+	Interpolated.pop_back();
+	LocalChanged.pop_back();
+	Teleported.pop_back();
+	IndexToHandle.pop_back();
+
+	FreeHandles.push_back(Handle);
+}
+
+void CTransformStore::MarkDirty(uint32_t Index)
+{
+	Dirty[Index] = 1;
+	bAnyDirty = true;
+
+	// Flag the path to the root so the update can skip the subtrees that are not on it
+	// Stops at the first flagged ancestor, the rest of the path is already flagged
+	// Not needed when the hierarchy will be sorted, sorting recomputes every flag
+	if (!bHierarchyDirty)
+	{
+		while (Index != INVALID_TRANSFORM_HANDLE && !SubtreeDirty[Index])
+		{
+			SubtreeDirty[Index] = 1;
+			Index = ParentIndices[Index];
+		}
+	}
+}
+
+void CTransformStore::SavePreviousLocal(uint32_t Index)
+{
+	// Once dirty, the values of the last update were already saved or the transform is teleported
+	if (Dirty[Index])
+	{
+		return;
+	}
+	PreviousPositionX[Index] = PositionX[Index];
+	PreviousPositionY[Index] = PositionY[Index];
+	PreviousPositionZ[Index] = PositionZ[Index];
+	PreviousRotationX[Index] = RotationX[Index];
+	PreviousRotationY[Index] = RotationY[Index];
+	PreviousRotationZ[Index] = RotationZ[Index];
+	PreviousRotationW[Index] = RotationW[Index];
+	PreviousScaleX[Index] = ScaleX[Index];
+	PreviousScaleY[Index] = ScaleY[Index];
+	PreviousScaleZ[Index] = ScaleZ[Index];
+}
+
+void CTransformStore::SetPosition(uint32_t Handle, const XMFLOAT3& InPosition)
+{
+	const uint32_t Index = HandleToIndex[Handle];
+	SavePreviousLocal(Index);
+	PositionX[Index] = InPosition.x;
+	PositionY[Index] = InPosition.y;
+	PositionZ[Index] = InPosition.z;
+	MarkDirty(Index);
+}
+
+XMFLOAT3 CTransformStore::GetRotation(uint32_t Handle) const
+{
+	// Angles of RotationX * RotationY * RotationZ read back from the cached rows
+	const uint32_t Index = HandleToIndex[Handle];
+	const float SinY = -std::max(-1.0f, std::min(1.0f, RightZ[Index]));
+	if (RightX[Index] * RightX[Index] + RightY[Index] * RightY[Index] < 1e-10f)
+	{
+		// Gimbal lock, X and Z rotate around the same axis so put everything in X
+		return XMFLOAT3(XMConvertToDegrees(atan2f(UpX[Index] * SinY, UpY[Index])), XMConvertToDegrees(asinf(SinY)), 0.0f);
+	}
+	return XMFLOAT3(
+		XMConvertToDegrees(atan2f(UpZ[Index], ForwardZ[Index])),
+		XMConvertToDegrees(asinf(SinY)),
+		XMConvertToDegrees(atan2f(RightY[Index], RightX[Index])));
+}
+
+void CTransformStore::SetRotation(uint32_t Handle, const XMFLOAT3& InRotation)
+{
+	// Rotate around X, then Y, then Z
+	const XMVECTOR RotationXQuat = XMQuaternionRotationNormal(XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f), XMConvertToRadians(InRotation.x));
+	const XMVECTOR RotationYQuat = XMQuaternionRotationNormal(XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f), XMConvertToRadians(InRotation.y));
+	const XMVECTOR RotationZQuat = XMQuaternionRotationNormal(XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), XMConvertToRadians(InRotation.z));
+
+	const uint32_t Index = HandleToIndex[Handle];
+	SavePreviousLocal(Index);
+	StoreRotation(Index, XMQuaternionMultiply(XMQuaternionMultiply(RotationXQuat, RotationYQuat), RotationZQuat));
+	MarkDirty(Index);
+}
+
+void CTransformStore::SetRotationQuaternion(uint32_t Handle, const XMFLOAT4& InRotation)
+{
+	const uint32_t Index = HandleToIndex[Handle];
+	SavePreviousLocal(Index);
+	StoreRotation(Index, XMQuaternionNormalize(XMLoadFloat4(&InRotation)));
+	MarkDirty(Index);
+}
+
+void XM_CALLCONV CTransformStore::StoreRotation(uint32_t Index, FXMVECTOR Quaternion)
+{
+	XMFLOAT4 Q;
+	XMStoreFloat4(&Q, Quaternion);
+	RotationX[Index] = Q.x;
+	RotationY[Index] = Q.y;
+	RotationZ[Index] = Q.z;
+	RotationW[Index] = Q.w;
+
+	// Same rows as XMMatrixRotationQuaternion, no trigonometry involved
+	const float XX = Q.x * Q.x, YY = Q.y * Q.y, ZZ = Q.z * Q.z;
+	const float XY = Q.x * Q.y, XZ = Q.x * Q.z, YZ = Q.y * Q.z;
+	const float WX = Q.w * Q.x, WY = Q.w * Q.y, WZ = Q.w * Q.z;
+
+	RightX[Index] = 1.0f - 2.0f * (YY + ZZ);
+	RightY[Index] = 2.0f * (XY + WZ);
+	RightZ[Index] = 2.0f * (XZ - WY);
+
+	UpX[Index] = 2.0f * (XY - WZ);
+	UpY[Index] = 1.0f - 2.0f * (XX + ZZ);
+	UpZ[Index] = 2.0f * (YZ + WX);
+
+	ForwardX[Index] = 2.0f * (XZ + WY);
+	ForwardY[Index] = 2.0f * (YZ - WX);
+	ForwardZ[Index] = 1.0f - 2.0f * (XX + YY);
+}
+
+void CTransformStore::SetScale(uint32_t Handle, const XMFLOAT3& InScale)
+{
+	const uint32_t Index = HandleToIndex[Handle];
+	SavePreviousLocal(Index);
+	ScaleX[Index] = InScale.x;
+	ScaleY[Index] = InScale.y;
+	ScaleZ[Index] = InScale.z;
+	MarkDirty(Index);
+}
+
+bool CTransformStore::SetParent(uint32_t Handle, uint32_t ParentHandle)
+{
+	const uint32_t Index = HandleToIndex[Handle];
+	if (ParentHandles[Index] == ParentHandle)
+	{
+		return true;
+	}
+
+	// Refuse to parent a transform to itself or to one of its descendants
+	for (uint32_t Ancestor = ParentHandle; Ancestor != INVALID_TRANSFORM_HANDLE; Ancestor = ParentHandles[HandleToIndex[Ancestor]])
+	{
+		if (Ancestor == Handle)
+		{
+			return false;
+		}
+	}
+
+	// The local transform it had was relative to the old parent, there is nothing to interpolate from
+	ParentHandles[Index] = ParentHandle;
+	Teleported[Index] = 1;
+	bHierarchyDirty = true;
+	MarkDirty(Index);
+	return true;
+}
+
+XMMATRIX XM_CALLCONV CTransformStore::ComputeLocalMatrix(uint32_t Index) const
+{
+	// Compute Scale
+	XMMATRIX ScaleMatrix = XMMatrixScaling(ScaleX[Index], ScaleY[Index], ScaleZ[Index]);
+
+	// Rotation from the cached axes
+	XMMATRIX RotationMatrix(
+		XMVectorSet(RightX[Index], RightY[Index], RightZ[Index], 0.0f),
+		XMVectorSet(UpX[Index], UpY[Index], UpZ[Index], 0.0f),
+		XMVectorSet(ForwardX[Index], ForwardY[Index], ForwardZ[Index], 0.0f),
+		XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f));
+
+	// Compute Translation
+	XMMATRIX TranslationMatrix = XMMatrixTranslation(PositionX[Index], PositionY[Index], PositionZ[Index]);
+	return ScaleMatrix * RotationMatrix * TranslationMatrix;
+}
+
+XMMATRIX XM_CALLCONV CTransformStore::ComputeWorldMatrix(uint32_t Index) const
+{
+	XMMATRIX World = ComputeLocalMatrix(Index);
+	for (uint32_t Parent = ParentHandles[Index]; Parent != INVALID_TRANSFORM_HANDLE; Parent = ParentHandles[Index])
+	{
+		Index = HandleToIndex[Parent];
+		World = World * ComputeLocalMatrix(Index);
+	}
+	return World;
+}
+
+XMFLOAT4X4 CTransformStore::GetWorldMatrix(uint32_t Handle) const
+{
+	const uint32_t Index = HandleToIndex[Handle];
+	if (!bAnyDirty)
+	{
+		return WorldMatrices[Index];
+	}
+
+	// Off the per frame path, the cached matrices may be stale so resolve the parent chain without touching them
+	XMFLOAT4X4 World;
+	XMStoreFloat4x4(&World, ComputeWorldMatrix(Index));
+	return World;
+}
+
+void CTransformStore::Teleport(uint32_t Handle)
+{
+	const uint32_t Index = HandleToIndex[Handle];
+	Teleported[Index] = 1;
+	MarkDirty(Index);
+}
+
+XMMATRIX XM_CALLCONV CTransformStore::ComputeInterpolatedLocalMatrix(uint32_t Index, float Alpha) const
+{
+	if (!LocalChanged[Index])
+	{
+		return XMLoadFloat4x4(&LocalMatrices[Index]);
+	}
+
+	// Blending the matrices would shear and shrink them, the parts are blended instead
+	const XMVECTOR Scale = XMVectorLerp(XMVectorSet(PreviousScaleX[Index], PreviousScaleY[Index], PreviousScaleZ[Index], 0.0f),
+		XMVectorSet(ScaleX[Index], ScaleY[Index], ScaleZ[Index], 0.0f), Alpha);
+	const XMVECTOR Rotation = XMQuaternionSlerp(
+		XMVectorSet(PreviousRotationX[Index], PreviousRotationY[Index], PreviousRotationZ[Index], PreviousRotationW[Index]),
+		XMVectorSet(RotationX[Index], RotationY[Index], RotationZ[Index], RotationW[Index]), Alpha);
+	const XMVECTOR Position = XMVectorLerp(XMVectorSet(PreviousPositionX[Index], PreviousPositionY[Index], PreviousPositionZ[Index], 0.0f),
+		XMVectorSet(PositionX[Index], PositionY[Index], PositionZ[Index], 0.0f), Alpha);
+	return XMMatrixScalingFromVector(Scale) * XMMatrixRotationQuaternion(Rotation) * XMMatrixTranslationFromVector(Position);
+}
+
+XMFLOAT4X4 CTransformStore::GetInterpolatedWorldMatrix(uint32_t Handle, float Alpha) const
+{
+	uint32_t Index = HandleToIndex[Handle];
+	if (bAnyDirty)
+	{
+		return GetWorldMatrix(Handle);
+	}
+	if (!Interpolated[Index] || Alpha >= 1.0f)
+	{
+		return WorldMatrices[Index];
+	}
+
+	// Combined like the update does, up to the first parent it didn't move. A moved parent is never teleported here,
+	// the whole subtree of a teleported transform isn't interpolated
+	XMMATRIX World = ComputeInterpolatedLocalMatrix(Index, Alpha);
+	for (uint32_t Parent = ParentHandles[Index]; Parent != INVALID_TRANSFORM_HANDLE; Parent = ParentHandles[Index])
+	{
+		Index = HandleToIndex[Parent];
+		if (!Interpolated[Index])
+		{
+			World = World * XMLoadFloat4x4(&WorldMatrices[Index]);
+			break;
+		}
+		World = World * ComputeInterpolatedLocalMatrix(Index, Alpha);
+	}
+
+	XMFLOAT4X4 InterpolatedWorld;
+	XMStoreFloat4x4(&InterpolatedWorld, World);
+	return InterpolatedWorld;
+}
+
+void CTransformStore::TransformBounds(const uint32_t* Handles, const BoundingVolume* LocalVolumes, uint32_t Count, BoundingVolume* OutVolumes) const
+{
+	if (bAnyDirty)
+	{
+		for (uint32_t Entry = 0; Entry < Count; ++Entry)
+		{
+			OutVolumes[Entry] = TransformBoundingVolume(ComputeWorldMatrix(HandleToIndex[Handles[Entry]]), LocalVolumes[Entry]);
+		}
+		return;
+	}
+
+	for (uint32_t Entry = 0; Entry < Count; ++Entry)
+	{
+		OutVolumes[Entry] = TransformBoundingVolume(XMLoadFloat4x4(&WorldMatrices[HandleToIndex[Handles[Entry]]]), LocalVolumes[Entry]);
+	}
+}
+
+void CTransformStore::SortHierarchy()
+{
+	const uint32_t Count = GetCount();
+
+	// Children lists of every transform, roots keep their relative order
+	std::vector<uint32_t> FirstChild(Count, INVALID_TRANSFORM_HANDLE);
+	std::vector<uint32_t> NextSibling(Count, INVALID_TRANSFORM_HANDLE);
+	std::vector<uint32_t> Roots;
+	for (uint32_t Index = Count; Index-- > 0;)
+	{
+		if (ParentHandles[Index] == INVALID_TRANSFORM_HANDLE)
+		{
+			Roots.push_back(Index);
+		}
+		else
+		{
+			const uint32_t Parent = HandleToIndex[ParentHandles[Index]];
+			NextSibling[Index] = FirstChild[Parent];
+			FirstChild[Parent] = Index;
+		}
+	}
+
+	// Pre-order depth first walk, Roots is used as the stack and was filled in reverse order
+	std::vector<uint32_t> Order;
+	Order.reserve(Count);
+	while (!Roots.empty())
+	{
+		const uint32_t Index = Roots.back();
+		Roots.pop_back();
+		Order.push_back(Index);
+
+		// Push in reverse so the first child is visited first
+		const size_t Mark = Roots.size();
+		for (uint32_t Child = FirstChild[Index]; Child != INVALID_TRANSFORM_HANDLE; Child = NextSibling[Child])
+		{
+			Roots.push_back(Child);
+		}
+		std::reverse(Roots.begin() + Mark, Roots.end());
+	}
+
+	Permute(PositionX, Order);
+	Permute(PositionY, Order);
+	Permute(PositionZ, Order);
+	Permute(RotationX, Order);
+	Permute(RotationY, Order);
+	Permute(RotationZ, Order);
+	Permute(RotationW, Order);
+	Permute(RightX, Order);
+	Permute(RightY, Order);
+	Permute(RightZ, Order);
+	Permute(UpX, Order);
+	Permute(UpY, Order);
+	Permute(UpZ, Order);
+	Permute(ForwardX, Order);
+	Permute(ForwardY, Order);
+	Permute(ForwardZ, Order);
+	Permute(ScaleX, Order);
+	Permute(ScaleY, Order);
+	Permute(ScaleZ, Order);
+	Permute(PreviousPositionX, Order);
+	Permute(PreviousPositionY, Order);
+	Permute(PreviousPositionZ, Order);
+	Permute(PreviousRotationX, Order);
+	Permute(PreviousRotationY, Order);
+	Permute(PreviousRotationZ, Order);
+	Permute(PreviousRotationW, Order);
+	Permute(PreviousScaleX, Order);
+	Permute(PreviousScaleY, Order);
+	Permute(PreviousScaleZ, Order);
+	Permute(Dirty, Order);
+	Permute(ParentHandles, Order);
+	Permute(LocalMatrices, Order);
+	Permute(WorldMatrices, Order);
+	Permute(Interpolated, Order);
+	Permute(LocalChanged, Order);
+	Permute(Teleported, Order);
+	Permute(IndexToHandle, Order);
+
+	for (uint32_t Index = 0; Index < Count; ++Index)
+	{
+		HandleToIndex[IndexToHandle[Index]] = Index;
+	}
+
+	// Parents are before their children so accumulating backward gives every subtree size and flag in one pass
+	for (uint32_t Index = 0; Index < Count; ++Index)
+	{
+		ParentIndices[Index] = ParentHandles[Index] == INVALID_TRANSFORM_HANDLE ? INVALID_TRANSFORM_HANDLE : HandleToIndex[ParentHandles[Index]];
+		SubtreeSizes[Index] = 1;
+		SubtreeDirty[Index] = Dirty[Index];
+	}
+	for (uint32_t Index = Count; Index-- > 0;)
+	{
+		const uint32_t Parent = ParentIndices[Index];
+		if (Parent != INVALID_TRANSFORM_HANDLE)
+		{
+			SubtreeSizes[Parent] += SubtreeSizes[Index];
+			SubtreeDirty[Parent] |= SubtreeDirty[Index];
+		}
+	}
+
+	bHierarchyDirty = false;
+}
+
+void CTransformStore::UpdateLocalMatrices(uint32_t Begin, uint32_t End)
+{
+	const XMVECTOR Zero = XMVectorZero();
+	const XMVECTOR One = XMVectorSplatOne();
+
+	uint32_t Index = Begin;
+
+	// Each lane of the vectors holds a different transform
+	for (; Index + 4 <= End; Index += 4)
+	{
+		uint32_t DirtyMask;
+		memcpy(&DirtyMask, &Dirty[Index], sizeof(DirtyMask));
+		if (DirtyMask == 0)
+		{
+			continue;
+		}
+
+		// Rows of the rotation, each one scaled by the matching axis of the scale
+		const XMVECTOR Scale0 = LoadFloat4(&ScaleX[Index]);
+		const XMVECTOR Scale1 = LoadFloat4(&ScaleY[Index]);
+		const XMVECTOR Scale2 = LoadFloat4(&ScaleZ[Index]);
+
+		const XMVECTOR M00 = LoadFloat4(&RightX[Index]) * Scale0;
+		const XMVECTOR M01 = LoadFloat4(&RightY[Index]) * Scale0;
+		const XMVECTOR M02 = LoadFloat4(&RightZ[Index]) * Scale0;
+
+		const XMVECTOR M10 = LoadFloat4(&UpX[Index]) * Scale1;
+		const XMVECTOR M11 = LoadFloat4(&UpY[Index]) * Scale1;
+		const XMVECTOR M12 = LoadFloat4(&UpZ[Index]) * Scale1;
+
+		const XMVECTOR M20 = LoadFloat4(&ForwardX[Index]) * Scale2;
+		const XMVECTOR M21 = LoadFloat4(&ForwardY[Index]) * Scale2;
+		const XMVECTOR M22 = LoadFloat4(&ForwardZ[Index]) * Scale2;
+
+		// Transpose back so that each vector holds one row of one transform
+		const XMMATRIX Rows0 = XMMatrixTranspose(XMMATRIX(M00, M01, M02, Zero));
+		const XMMATRIX Rows1 = XMMatrixTranspose(XMMATRIX(M10, M11, M12, Zero));
+		const XMMATRIX Rows2 = XMMatrixTranspose(XMMATRIX(M20, M21, M22, Zero));
+		const XMMATRIX Rows3 = XMMatrixTranspose(XMMATRIX(LoadFloat4(&PositionX[Index]), LoadFloat4(&PositionY[Index]), LoadFloat4(&PositionZ[Index]), One));
+
+		for (int Lane = 0; Lane < 4; ++Lane)
+		{
+			XMStoreFloat4x4(&LocalMatrices[Index + Lane], XMMATRIX(Rows0.r[Lane], Rows1.r[Lane], Rows2.r[Lane], Rows3.r[Lane]));
+		}
+	}
+
+	// Remaining transforms that don't fill a vector
+	for (; Index < End; ++Index)
+	{
+		if (Dirty[Index])
+		{
+			XMStoreFloat4x4(&LocalMatrices[Index], ComputeLocalMatrix(Index));
+		}
+	}
+}
+
+void CTransformStore::UpdateWorldMatrices()
+{
+	// Only what this update moves is interpolated
+	if (bAnyInterpolated)
+	{
+		std::fill(Interpolated.begin(), Interpolated.end(), uint8_t(0));
+		std::fill(LocalChanged.begin(), LocalChanged.end(), uint8_t(0));
+		bAnyInterpolated = false;
+	}
+
+	if (!bAnyDirty)
+	{
+		return;
+	}
+
+	if (bHierarchyDirty)
+	{
+		SortHierarchy();
+	}
+
+	const uint32_t Count = GetCount();
+
+	// Dirty flags are kept until the world pass, it needs them to know which subtrees moved
+	CJobSystem::Get().ParallelFor(Count, TransformsPerBatch, [this](size_t Begin, size_t End)
+	{
+		UpdateLocalMatrices(uint32_t(Begin), uint32_t(End));
+	});
+
+	CJobSystem::Get().ParallelFor(Count, TransformsPerBatch, [this](size_t Begin, size_t End)
+	{
+		UpdateWorldMatrices(uint32_t(Begin), uint32_t(End));
+	});
+
+	bAnyDirty = false;
+	bAnyInterpolated = true;
+}
+
+void CTransformStore::UpdateWorldMatrices(uint32_t Begin, uint32_t End)
+{
+	// Both ends moved the same way, the range before ends where this one starts
+	const uint32_t Count = GetCount();
+	while (Begin < Count && ParentIndices[Begin] != INVALID_TRANSFORM_HANDLE)
+	{
+		++Begin;
+	}
+	while (End < Count && ParentIndices[End] != INVALID_TRANSFORM_HANDLE)
+	{
+		++End;
+	}
+
+	// Everything before MovedEnd is in the subtree of a transform whose world matrix changed, and everything before
+	// TeleportedEnd in the subtree of a teleported one
+	uint32_t MovedEnd = 0;
+	uint32_t TeleportedEnd = 0;
+
+	uint32_t Index = Begin;
+	while (Index < End)
+	{
+		if (Index >= MovedEnd && !SubtreeDirty[Index])
+		{
+			// Nothing moved in this subtree
+			Index += SubtreeSizes[Index];
+			continue;
+		}
+
+		if (Index < MovedEnd || Dirty[Index])
+		{
+			if (Teleported[Index])
+			{
+				TeleportedEnd = std::max(TeleportedEnd, Index + SubtreeSizes[Index]);
+				Teleported[Index] = 0;
+			}
+			Interpolated[Index] = Index >= TeleportedEnd;
+			LocalChanged[Index] = Dirty[Index];
+
+			const uint32_t Parent = ParentIndices[Index];
+			if (Parent == INVALID_TRANSFORM_HANDLE)
+			{
+				WorldMatrices[Index] = LocalMatrices[Index];
+			}
+			else
+			{
+				// The parent is earlier in the arrays so it is already up to date
+				XMStoreFloat4x4(&WorldMatrices[Index], XMLoadFloat4x4(&LocalMatrices[Index]) * XMLoadFloat4x4(&WorldMatrices[Parent]));
+			}
+
+			MovedEnd = std::max(MovedEnd, Index + SubtreeSizes[Index]);
+			Dirty[Index] = 0;
+		}
+
+		SubtreeDirty[Index] = 0;
+		++Index;
+	}
+}
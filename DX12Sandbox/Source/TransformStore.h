@@ -0,0 +1,208 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+#include "pch.h"
+#include "Bounds.h"
+
+using namespace DirectX;
+
+#define INVALID_TRANSFORM_HANDLE 0xFFFFFFFFu
+
+// Holds the transforms of every Actor in Structure of Arrays form so the world matrices
+// can be recomputed 4 at a time with SIMD instead of one Actor at a time.
+// Rotations are quaternions, their axes are cached so direction queries are plain loads.
+// Actors reference their transform with a handle that stays valid when others are freed.
+//
+// Transforms are relative to their parent. The arrays are kept in depth first order (a parent is
+// always before its children and a subtree is contiguous) so that world matrices are resolved in
+// a single linear pass, and subtrees in which nothing moved are skipped as a whole.
+class CTransformStore
+{
+public:
+
+	static CTransformStore& Get();
+
+	// Returns the handle of a new identity transform without parent
+	uint32_t Allocate();
+
+	// Children of the freed transform become roots
+	void Free(uint32_t Handle);
+
+	XMFLOAT3 GetPosition(uint32_t Handle) const
+	{
+		const uint32_t Index = HandleToIndex[Handle];
+		return XMFLOAT3(PositionX[Index], PositionY[Index], PositionZ[Index]);
+	}
+	// Euler angles in degrees, applied in X, Y then Z order, derived from the quaternion
+	XMFLOAT3 GetRotation(uint32_t Handle) const;
+
+	XMFLOAT4 GetRotationQuaternion(uint32_t Handle) const
+	{
+		const uint32_t Index = HandleToIndex[Handle];
+		return XMFLOAT4(RotationX[Index], RotationY[Index], RotationZ[Index], RotationW[Index]);
+	}
+	XMFLOAT3 GetScale(uint32_t Handle) const
+	{
+		const uint32_t Index = HandleToIndex[Handle];
+		return XMFLOAT3(ScaleX[Index], ScaleY[Index], ScaleZ[Index]);
+	}
+
+	// Axes of the rotation relative to the parent, cached when the rotation is set
+	XMFLOAT3 GetRightVector(uint32_t Handle) const
+	{
+		const uint32_t Index = HandleToIndex[Handle];
+		return XMFLOAT3(RightX[Index], RightY[Index], RightZ[Index]);
+	}
+	XMFLOAT3 GetUpVector(uint32_t Handle) const
+	{
+		const uint32_t Index = HandleToIndex[Handle];
+		return XMFLOAT3(UpX[Index], UpY[Index], UpZ[Index]);
+	}
+	XMFLOAT3 GetForwardVector(uint32_t Handle) const
+	{
+		const uint32_t Index = HandleToIndex[Handle];
+		return XMFLOAT3(ForwardX[Index], ForwardY[Index], ForwardZ[Index]);
+	}
+
+	void SetPosition(uint32_t Handle, const XMFLOAT3& InPosition);
+	void SetRotation(uint32_t Handle, const XMFLOAT3& InRotation);
+	void SetRotationQuaternion(uint32_t Handle, const XMFLOAT4& InRotation);
+	void SetScale(uint32_t Handle, const XMFLOAT3& InScale);
+
+	// Makes the transform relative to ParentHandle (INVALID_TRANSFORM_HANDLE for none), it is teleported there
+	// Returns false if it would create a cycle
+	bool SetParent(uint32_t Handle, uint32_t ParentHandle);
+
+	uint32_t GetParent(uint32_t Handle) const
+	{
+		return ParentHandles[HandleToIndex[Handle]];
+	}
+
+	// Uses the result of the last UpdateWorldMatrices if nothing changed since, otherwise only resolves this transform's parent chain
+	XMFLOAT4X4 GetWorldMatrix(uint32_t Handle) const;
+
+	// Moves the transform and its children straight to where the next UpdateWorldMatrices puts them, without
+	// interpolating from where they were
+	void Teleport(uint32_t Handle);
+
+	// World matrix Alpha of the way from before the last UpdateWorldMatrices to after it. The local scales and
+	// positions of the moved transforms are lerped, their rotations slerped, then combined with their parents' like the
+	// update does. Transforms the update didn't move return their cached matrix
+	XMFLOAT4X4 GetInterpolatedWorldMatrix(uint32_t Handle, float Alpha) const;
+
+	// World bounds of the transforms of Handles, LocalVolumes and OutVolumes in the same order
+	// Meant to run after UpdateWorldMatrices, the cached matrices are then read in a single pass
+	void TransformBounds(const uint32_t* Handles, const BoundingVolume* LocalVolumes, uint32_t Count, BoundingVolume* OutVolumes) const;
+
+	// Resolves the world matrix of every transform that moved, or whose parent moved, since the last call. The local
+	// transforms they had are kept to interpolate from
+	void UpdateWorldMatrices();
+
+	uint32_t GetCount() const
+	{
+		return uint32_t(IndexToHandle.size());
+	}
+
+private:
+
+	void MarkDirty(uint32_t Index);
+
+	// Keeps the local transform of the last update before its first change since
+	void SavePreviousLocal(uint32_t Index);
+
+	// Stores the normalized quaternion and the axes derived from it
+	void XM_CALLCONV StoreRotation(uint32_t Index, FXMVECTOR Quaternion);
+
+	XMMATRIX XM_CALLCONV ComputeLocalMatrix(uint32_t Index) const;
+
+	XMMATRIX XM_CALLCONV ComputeWorldMatrix(uint32_t Index) const;
+
+	// Local matrix Alpha of the way from the one before the last update to the current one
+	XMMATRIX XM_CALLCONV ComputeInterpolatedLocalMatrix(uint32_t Index, float Alpha) const;
+
+	// Recomputes the local matrices of the dirty transforms from Begin, a multiple of 4, to End, 4 per iteration
+	void UpdateLocalMatrices(uint32_t Begin, uint32_t End);
+
+	// World matrices of the subtrees starting between Begin and End, Begin is moved to the first root. Ranges cut at
+	// roots share no subtree, they can be updated at the same time
+	void UpdateWorldMatrices(uint32_t Begin, uint32_t End);
+
+	// Restores the depth first order after the hierarchy changed
+	void SortHierarchy();
+
+	// Position in world units
+	std::vector<float> PositionX;
+	std::vector<float> PositionY;
+	std::vector<float> PositionZ;
+
+	// Unit quaternion
+	std::vector<float> RotationX;
+	std::vector<float> RotationY;
+	std::vector<float> RotationZ;
+	std::vector<float> RotationW;
+
+	// Rows of the rotation matrix, the local matrix is built from them without touching the quaternion
+	std::vector<float> RightX;
+	std::vector<float> RightY;
+	std::vector<float> RightZ;
+	std::vector<float> UpX;
+	std::vector<float> UpY;
+	std::vector<float> UpZ;
+	std::vector<float> ForwardX;
+	std::vector<float> ForwardY;
+	std::vector<float> ForwardZ;
+
+	std::vector<float> ScaleX;
+	std::vector<float> ScaleY;
+	std::vector<float> ScaleZ;
+
+	// Local transform before the last update, only valid where LocalChanged is set
+	std::vector<float> PreviousPositionX;
+	std::vector<float> PreviousPositionY;
+	std::vector<float> PreviousPositionZ;
+	std::vector<float> PreviousRotationX;
+	std::vector<float> PreviousRotationY;
+	std::vector<float> PreviousRotationZ;
+	std::vector<float> PreviousRotationW;
+	std::vector<float> PreviousScaleX;
+	std::vector<float> PreviousScaleY;
+	std::vector<float> PreviousScaleZ;
+
+	// 1 when the transform changed since the last update
+	std::vector<uint8_t> Dirty;
+
+	// 1 when the transform or one of its descendants is dirty
+	std::vector<uint8_t> SubtreeDirty;
+
+	std::vector<uint32_t> ParentHandles;
+
+	// Only valid while the hierarchy is sorted
+	std::vector<uint32_t> ParentIndices;
+	std::vector<uint32_t> SubtreeSizes;
+
+	std::vector<XMFLOAT4X4> LocalMatrices;
+	std::vector<XMFLOAT4X4> WorldMatrices;
+
+	// 1 when the last update moved the transform and it wasn't teleported
+	std::vector<uint8_t> Interpolated;
+
+	// 1 when the last update changed the local transform itself, not only one of its parents
+	std::vector<uint8_t> LocalChanged;
+
+	// 1 until the next update once teleported, new transforms start teleported
+	std::vector<uint8_t> Teleported;
+
+	// Handles are stable, indices change when a transform is freed or the hierarchy is sorted
+	std::vector<uint32_t> HandleToIndex;
+	std::vector<uint32_t> IndexToHandle;
+	std::vector<uint32_t> FreeHandles;
+
+	bool bAnyDirty = false;
+
+	bool bHierarchyDirty = false;
+
+	// Some Interpolated flag is set
+	bool bAnyInterpolated = false;
+};
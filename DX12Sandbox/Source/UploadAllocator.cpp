@@ -0,0 +1,129 @@
+#include "pch.h"
+#include "UploadAllocator.h"
+
+CUploadAllocator::CUploadAllocator(CRHIDevice* InDevice, uint64_t InPageSize)
+	: Device(InDevice), PageSize(InPageSize)
+{
+}
+
+CUploadAllocator::~CUploadAllocator()
+{
+	for (Page& CurrentPage : FramePages)
+	{
+		ReleasePage(CurrentPage);
+	}
+	for (RetiredPages& Retired : InFlightPages)
+	{
+		for (Page& CurrentPage : Retired.Pages)
+		{
+			ReleasePage(CurrentPage);
+		}
+	}
+	for (Page& CurrentPage : FreePages)
+	{
+		ReleasePage(CurrentPage);
+	}
+}
+
+void CUploadAllocator::BeginFrame()
+{
+	// Frames complete in order, stop at the first one still in flight
+	while (!InFlightPages.empty() && InFlightPages.front().Fence->GetCompletedValue() >= InFlightPages.front().FenceValue)
+	{
+		for (Page& CurrentPage : InFlightPages.front().Pages)
+		{
+			// Pages made for a large allocation are not worth keeping around
+			if (CurrentPage.Size == PageSize)
+			{
+				FreePages.push_back(CurrentPage);
+			}
+			else
+			{
+				ReleasePage(CurrentPage);
+			}
+		}
+		InFlightPages.pop_front();
+	}
+}
+
+RHIUploadAllocation CUploadAllocator::Allocate(uint64_t Size, uint64_t Alignment)
+{
+	uint64_t AlignedOffset = (Offset + Alignment - 1) & ~(Alignment - 1);
+	if (FramePages.empty() || AlignedOffset + Size > FramePages.back().Size)
+	{
+		if (!AcquirePage(Size))
+		{
+			return RHIUploadAllocation();
+		}
+
+		// Pages start on a 64KB boundary, no need to align
+		AlignedOffset = 0;
+	}
+
+	const Page& CurrentPage = FramePages.back();
+	Offset = AlignedOffset + Size;
+
+	RHIUploadAllocation Allocation;
+	Allocation.CPUAddress = CurrentPage.CPUAddress + AlignedOffset;
+	Allocation.GPUAddress = CurrentPage.GPUAddress + AlignedOffset;
+	Allocation.Resource = CurrentPage.Resource;
+	Allocation.Offset = AlignedOffset;
+	return Allocation;
+}
+
+void CUploadAllocator::EndFrame(CRHIFence* Fence, uint64_t FenceValue)
+{
+	if (FramePages.empty())
+	{
+		return;
+	}
+
+	RetiredPages Retired;
+	Retired.Fence = Fence;
+	Retired.FenceValue = FenceValue;
+	Retired.Pages.swap(FramePages);
+	InFlightPages.push_back(std::move(Retired));
+
+	Offset = 0;
+}
+
+void CUploadAllocator::ReleaseFreePages()
+{
+	for (Page& CurrentPage : FreePages)
+	{
+		ReleasePage(CurrentPage);
+	}
+	FreePages.clear();
+}
+
+bool CUploadAllocator::AcquirePage(uint64_t MinSize)
+{
+	if (MinSize <= PageSize && !FreePages.empty())
+	{
+		FramePages.push_back(FreePages.back());
+		FreePages.pop_back();
+		return true;
+	}
+
+	Page NewPage;
+	NewPage.Size = MinSize <= PageSize ? PageSize : (MinSize + 0xFFFF) & ~uint64_t(0xFFFF);
+	NewPage.Resource = Device->CreateBuffer(NewPage.Size, ERHIHeapType::Upload, ERHIResourceState::GenericRead, L"Upload Allocator Page");
+	if (!NewPage.Resource)
+	{
+		return false;
+	}
+
+	// Upload heaps can stay mapped for their whole life
+	NewPage.CPUAddress = static_cast<uint8_t*>(NewPage.Resource->Map());
+	NewPage.GPUAddress = NewPage.Resource->GetGPUVirtualAddress();
+	FramePages.push_back(NewPage);
+	PageCount++;
+	return true;
+}
+
+void CUploadAllocator::ReleasePage(Page& InPage)
+{
+	InPage.Resource->Unmap();
+	SAFE_RELEASE(InPage.Resource);
+	PageCount--;
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include "RHI.h"
+
+#include <deque>
+#include <vector>
+
+// D3D12 requires constant buffer views to start on a 256 bytes boundary
+#define RHI_CONSTANT_BUFFER_ALIGNMENT 256
+
+// Memory the CPU writes and the GPU reads during one frame
+struct RHIUploadAllocation
+{
+	uint8_t* CPUAddress = nullptr;
+	uint64_t GPUAddress = 0;
+
+	// Page and offset in it, to copy from the allocation
+	CRHIResource* Resource = nullptr;
+	uint64_t Offset = 0;
+};
+
+// Linear allocator handing out per frame upload memory (constants, instance data) from persistently mapped pages.
+// Allocating is a pointer bump, a new page is taken when the current one is full, and the pages used by a frame
+// go back to the pool once the GPU passed the fence value given to EndFrame.
+class CUploadAllocator
+{
+public:
+	CUploadAllocator(CRHIDevice* InDevice, uint64_t InPageSize = 64 * 1024);
+
+	// The GPU must be done with every page
+	~CUploadAllocator();
+
+	CUploadAllocator(const CUploadAllocator&) = delete;
+	CUploadAllocator& operator=(const CUploadAllocator&) = delete;
+
+	// Takes back the pages whose fence completed, call before the first allocation of a frame
+	void BeginFrame();
+
+	// The memory stays valid until the fence passed to the next EndFrame completes
+	// Returns a null allocation if the device couldn't create a page
+	RHIUploadAllocation Allocate(uint64_t Size, uint64_t Alignment = RHI_CONSTANT_BUFFER_ALIGNMENT);
+
+	// The pages used since BeginFrame can be reused once Fence reaches FenceValue
+	void EndFrame(CRHIFence* Fence, uint64_t FenceValue);
+
+	// Releases the pages sitting in the pool, for allocators that are only used once in a while
+	void ReleaseFreePages();
+
+	uint64_t GetPageSize() const
+	{
+		return PageSize;
+	}
+
+	// Pages owned by the allocator, in use or not
+	uint32_t GetPageCount() const
+	{
+		return PageCount;
+	}
+
+private:
+	struct Page
+	{
+		CRHIResource* Resource = nullptr;
+		uint8_t* CPUAddress = nullptr;
+		uint64_t GPUAddress = 0;
+		uint64_t Size = 0;
+	};
+
+	struct RetiredPages
+	{
+		CRHIFence* Fence;
+		uint64_t FenceValue;
+		std::vector<Page> Pages;
+	};
+
+	// Takes a page from the pool or creates one, bigger than the default size for large allocations
+	bool AcquirePage(uint64_t MinSize);
+
+	void ReleasePage(Page& InPage);
+
+	CRHIDevice* Device;
+
+	uint64_t PageSize;
+
+	uint32_t PageCount = 0;
+
+	// Pages written by the frame being recorded, the last one is the current page
+	std::vector<Page> FramePages;
+
+	// Offset of the next allocation in the current page
+	uint64_t Offset = 0;
+
+	// Pages of the frames in flight, oldest first
+	std::deque<RetiredPages> InFlightPages;
+
+	// Pages of the default size the GPU is done with
+	std::vector<Page> FreePages;
+};
@@ -0,0 +1,60 @@
+#pragma once
+#include "RHI.h"
+
+#include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+// Input layouts generated from the vertex structs at compile time, so the formats and offsets can't drift from the C++ side.
+// Each stream type specializes TVertexLayout with its classification and one RHI_VERTEX_ELEMENT per member,
+// MakeInputLayout then concatenates the streams, the Nth type being bound on slot N.
+
+// Format of an attribute of type T
+template<typename T>
+struct TRHIFormatOf;
+
+template<> struct TRHIFormatOf<DirectX::XMFLOAT2> { static constexpr ERHIFormat Value = ERHIFormat::R32G32_Float; };
+template<> struct TRHIFormatOf<DirectX::XMFLOAT3> { static constexpr ERHIFormat Value = ERHIFormat::R32G32B32_Float; };
+template<> struct TRHIFormatOf<DirectX::XMFLOAT4> { static constexpr ERHIFormat Value = ERHIFormat::R32G32B32A32_Float; };
+template<> struct TRHIFormatOf<DirectX::PackedVector::XMHALF2> { static constexpr ERHIFormat Value = ERHIFormat::R16G16_Float; };
+template<> struct TRHIFormatOf<DirectX::PackedVector::XMHALF4> { static constexpr ERHIFormat Value = ERHIFormat::R16G16B16A16_Float; };
+template<> struct TRHIFormatOf<DirectX::PackedVector::XMUSHORTN2> { static constexpr ERHIFormat Value = ERHIFormat::R16G16_UNorm; };
+template<> struct TRHIFormatOf<DirectX::PackedVector::XMUSHORTN4> { static constexpr ERHIFormat Value = ERHIFormat::R16G16B16A16_UNorm; };
+template<> struct TRHIFormatOf<DirectX::PackedVector::XMSHORTN4> { static constexpr ERHIFormat Value = ERHIFormat::R16G16B16A16_SNorm; };
+
+// Layout of one stream, specialized next to the struct
+template<typename T>
+struct TVertexLayout;
+
+// Element for Member of Type, the slot and the classification are filled by MakeInputLayout
+#define RHI_VERTEX_ELEMENT(Type, Member, Semantic, SemanticIndex) \
+	RHIInputElement{ Semantic, SemanticIndex, TRHIFormatOf<std::decay_t<decltype(std::declval<Type>().Member)>>::Value, \
+		0, uint32_t(offsetof(Type, Member)), ERHIInputClassification::PerVertex, 0 }
+
+template<typename... Streams>
+constexpr std::array<RHIInputElement, (std::size(TVertexLayout<Streams>::Elements) + ...)> MakeInputLayout()
+{
+	std::array<RHIInputElement, (std::size(TVertexLayout<Streams>::Elements) + ...)> Layout = {};
+	size_t Index = 0;
+	uint32_t Slot = 0;
+
+	auto AppendStream = [&](const auto& Elements, ERHIInputClassification Classification)
+	{
+		for (const RHIInputElement& Element : Elements)
+		{
+			Layout[Index] = Element;
+			Layout[Index].InputSlot = Slot;
+			Layout[Index].Classification = Classification;
+			Layout[Index].InstanceDataStepRate = Classification == ERHIInputClassification::PerInstance ? 1 : 0;
+			Index++;
+		}
+		Slot++;
+	};
+	(AppendStream(TVertexLayout<Streams>::Elements, TVertexLayout<Streams>::Classification), ...);
+
+	return Layout;
+}
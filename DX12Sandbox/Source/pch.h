@@ -1,16 +1,20 @@
+#ifdef _WIN32
 #include <windows.h>
 #include "../resource.h"
+#endif
 #include "stdlib.h"
 
 #ifndef WIN32_LEAN_AND_MEAN
 #define WIN32_LEAN_AND_MEAN             // Exclude rarely-used stuff from Windows headers.
 #endif
 
+#ifdef _WIN32
 #include <d3d12.h>
 #include <dxgi1_4.h>
 #include <D3Dcompiler.h>
-#include <DirectXMath.h>
 #include "d3dx12.h"
+#endif
+#include <DirectXMath.h>
 
 // this will only call release if an object exists (prevents exceptions calling release on non existant objects)
 #define SAFE_RELEASE(p) { if ( (p) ) { (p)->Release(); (p) = 0; } }